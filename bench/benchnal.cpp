@@ -0,0 +1,182 @@
+// Start code scanning and caps probing on 4K H.265 access units: what the
+// loop thread does to every frame before it is queued, and to keyframes
+// when the caps are built. Runs on a recording given with --input, or on a
+// generated stream of the same shape.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <vector>
+
+#include "sspbench.h"
+#include "sspesstream.h"
+#include "sspnal.h"
+#include "sspparamsets.h"
+
+#define GENERATED_FPS 29.97
+
+static gchar* input;
+static gint64 bitrate = 100000000;
+
+typedef void (*BenchFunc) (const SspEsStream& stream, const SspEsFrame& frame,
+                           gpointer scratch);
+
+static void
+find_start_codes(const SspEsStream& stream, const SspEsFrame& frame, gpointer scratch)
+{
+    const guint8* p = stream.data.data() + frame.offset;
+    const guint8* end = p + frame.size;
+    guint n = 0;
+
+    for (p = ssp_nal_find_start_code(p, end); p < end; p = ssp_nal_find_start_code(p + 3, end)) {
+        n++;
+    }
+    *(guint*)scratch = n;
+}
+
+// The whole frame, as the codec detection did before the index stopped at
+// the first slice
+static void
+index_full(const SspEsStream& stream, const SspEsFrame& frame, gpointer scratch)
+{
+    ssp_nal_index_build((SspNalIndex*)scratch, stream.data.data() + frame.offset, frame.size,
+                        stream.codec, FALSE);
+}
+
+// What SspThread::on_video_data does once the codec is known
+static void
+index_prefix(const SspEsStream& stream, const SspEsFrame& frame, gpointer scratch)
+{
+    ssp_nal_index_build((SspNalIndex*)scratch, stream.data.data() + frame.offset, frame.size,
+                        stream.codec, TRUE);
+}
+
+// Caps from a keyframe as gst_ssp_src_make_video_caps() builds them,
+// codec_data included as for stream-format=packetized
+static void
+probe_caps(const SspEsStream& stream, const SspEsFrame& frame, gpointer scratch)
+{
+    SspNalIndex* index = (SspNalIndex*)scratch;
+    const guint8* data = stream.data.data() + frame.offset;
+    SspVideoParams params;
+    GstCaps* caps;
+
+    ssp_nal_index_build(index, data, frame.size, SSP_NAL_CODEC_UNKNOWN, TRUE);
+    if (!ssp_param_sets_parse(index, data, &params)) {
+        return;
+    }
+    caps = gst_caps_new_simple(stream.codec == SSP_NAL_CODEC_H265 ? "video/x-h265" : "video/x-h264",
+                               "stream-format", G_TYPE_STRING,
+                               stream.codec == SSP_NAL_CODEC_H265 ? "hvc1" : "avc",
+                               "alignment", G_TYPE_STRING, "au", NULL);
+    GstBuffer* codec_data = ssp_param_sets_codec_data(index, data, &params);
+    if (codec_data) {
+        gst_caps_set_simple(caps, "codec_data", GST_TYPE_BUFFER, codec_data, NULL);
+        gst_buffer_unref(codec_data);
+    }
+    ssp_video_params_fill_caps(&params, caps);
+    gst_caps_unref(caps);
+}
+
+static void
+packetize(const SspEsStream& stream, const SspEsFrame& frame, gpointer scratch)
+{
+    ssp_nal_to_packetized(stream.codec, stream.data.data() + frame.offset, frame.size,
+                          (guint8*)scratch);
+}
+
+static void
+run(SspBenchReport* report, const gchar* name, const SspEsStream& stream,
+    gboolean keyframes_only, gint frames, BenchFunc func, gpointer scratch)
+{
+    std::vector<const SspEsFrame*> input_frames;
+    SspBenchResult result(name);
+
+    for (const SspEsFrame& frame : stream.frames) {
+        if (!keyframes_only || frame.keyframe) {
+            input_frames.push_back(&frame);
+        }
+    }
+    if (input_frames.empty()) {
+        return;
+    }
+
+    // One pass to fault in the input and warm the caches
+    for (const SspEsFrame* frame : input_frames) {
+        func(stream, *frame, scratch);
+    }
+
+    gint64 allocs = ssp_bench_allocs();
+    GstClockTime start = gst_util_get_timestamp();
+    for (gint i = 0; i < frames; i++) {
+        const SspEsFrame& frame = *input_frames[i % input_frames.size()];
+        GstClockTime begin = gst_util_get_timestamp();
+
+        func(stream, frame, scratch);
+        result.add_latency(gst_util_get_timestamp() - begin);
+        result.bytes += frame.size;
+    }
+    result.elapsed = gst_util_get_timestamp() - start;
+    result.frames = frames;
+    if (allocs >= 0) {
+        result.allocs = ssp_bench_allocs() - allocs;
+    }
+    report->add(result);
+}
+
+int
+main(int argc, char** argv)
+{
+    SspBenchOptions options = { nullptr, 3000, 1 };
+    GOptionEntry entries[] = {
+        { "input", 'i', 0, G_OPTION_ARG_FILENAME, &input,
+          "Annex-B H.264/H.265 recording, generated 4K H.265 without", "FILE" },
+        { "bitrate", 'r', 0, G_OPTION_ARG_INT64, &bitrate,
+          "Bits/s of the generated stream (100000000)", "BPS" },
+        { nullptr }
+    };
+    SspBenchReport report("nal");
+    SspEsStream stream;
+    GError* error = nullptr;
+
+    ssp_bench_init(&argc, &argv, "Start code scanning and caps probing", entries, &options);
+
+    if (input) {
+        if (!ssp_es_load(input, &stream, &error)) {
+            g_printerr("%s\n", error->message);
+            return 1;
+        }
+        report.set_input("file", input);
+    } else {
+        SspEsParams params = { SSP_NAL_CODEC_H265, 3840, 2160, GENERATED_FPS, bitrate, 30 };
+        GRand* rand = g_rand_new_with_seed(1);
+
+        ssp_es_generate(params, rand, &stream);
+        g_rand_free(rand);
+        report.set_input("generated", "3840x2160 H.265 Main 10");
+        report.set_input_uint("bitrate", bitrate);
+    }
+    report.set_input("codec", stream.codec == SSP_NAL_CODEC_H265 ? "h265" : "h264");
+    report.set_input_uint("frames", stream.frames.size());
+    report.set_input("avg_frame_bytes", (gdouble)stream.data.size() / stream.frames.size());
+
+    gsize max_frame = 0;
+    for (const SspEsFrame& frame : stream.frames) {
+        max_frame = MAX(max_frame, frame.size);
+    }
+    SspNalIndex* index = g_new0(SspNalIndex, 1);
+    guint8* out = (guint8*)g_malloc(max_frame * 2);
+    guint n_start_codes;
+
+    run(&report, "find-start-codes", stream, FALSE, options.frames, find_start_codes,
+        &n_start_codes);
+    run(&report, "index-full", stream, FALSE, options.frames, index_full, index);
+    run(&report, "index-prefix", stream, FALSE, options.frames, index_prefix, index);
+    run(&report, "caps-probe", stream, TRUE, options.frames, probe_caps, index);
+    run(&report, "packetize", stream, FALSE, options.frames, packetize, out);
+
+    g_free(out);
+    g_free(index);
+    return report.write(options.output) ? 0 : 1;
+}
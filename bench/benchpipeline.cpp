@@ -0,0 +1,235 @@
+// sspsrc ! fakesink end to end. The "replay" runs feed sspfilesrc a capture
+// of a generated 4K H.265 stream, as fast as it goes and paced at the frame
+// rate; with --server the "mock-server-epoll" and "mock-server-io_uring"
+// runs connect sspsrc to a local ssp-mock-server (native client builds)
+// over either receive path, with the client's system calls per frame and
+// the process' CPU time per Gbit received. The latency is from the libssp
+// callback to the sink, taken from GstSspIngestMeta.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "gstsspmeta.h"
+#include "sspbench.h"
+#include "sspbenchsrc.h"
+#include "sspnal.h"
+
+static gint64 bitrate = 100000000;
+static gint width = 3840;
+static gint height = 2160;
+static gdouble fps = 30;
+static gchar* server;
+
+struct Sink {
+    GstElement* element;
+    GstElement* src;
+    SspBenchResult* result;
+    GType meta_api;             // GstSspIngestMeta as registered by the plugin
+    guint64 limit_frames;       // 0 for no limit
+    GstClockTime limit_time;    // GST_CLOCK_TIME_NONE for no limit
+
+    GstClockTime start;         // first buffer, not counted
+    GstClockTime last;
+    gint64 allocs;
+    gint64 syscalls;            // -1 when the source does not count them
+    GstClockTime cpu;
+    gboolean done;
+};
+
+// Counters since the first buffer
+static void
+finish(Sink* sink)
+{
+    if (sink->allocs >= 0) {
+        sink->result->allocs = ssp_bench_allocs() - sink->allocs;
+    }
+    if (sink->syscalls >= 0) {
+        sink->syscalls = ssp_bench_receive_syscalls(sink->src) - sink->syscalls;
+    }
+    sink->cpu = ssp_bench_cpu_time() - sink->cpu;
+}
+
+static GstPadProbeReturn
+on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    Sink* sink = (Sink*)data;
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstClockTime now = gst_util_get_timestamp();
+
+    if (sink->done) {
+        return GST_PAD_PROBE_OK;
+    }
+    if (!GST_CLOCK_TIME_IS_VALID(sink->start)) {
+        sink->start = now;
+        sink->last = now;
+        sink->allocs = ssp_bench_allocs();
+        sink->syscalls = ssp_bench_receive_syscalls(sink->src);
+        sink->cpu = ssp_bench_cpu_time();
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstSspIngestMeta* meta = (GstSspIngestMeta*)gst_buffer_get_meta(buffer, sink->meta_api);
+    if (meta && GST_CLOCK_TIME_IS_VALID(meta->received)) {
+        sink->result->add_latency(now - meta->received);
+    }
+    sink->result->frames++;
+    sink->result->bytes += gst_buffer_get_size(buffer);
+    sink->last = now;
+
+    if ((sink->limit_frames && sink->result->frames >= sink->limit_frames) ||
+        (GST_CLOCK_TIME_IS_VALID(sink->limit_time) && now - sink->start >= sink->limit_time)) {
+        sink->done = TRUE;
+        finish(sink);
+        gst_element_post_message(sink->element,
+                                 gst_message_new_application(GST_OBJECT(sink->element),
+                                     gst_structure_new_empty("bench-done")));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+// Runs @src ! fakesink until the sink has seen enough, EOS or an error
+static gboolean
+run(SspBenchReport* report, const gchar* name, GstElement* src, guint64 limit_frames,
+    GstClockTime limit_time)
+{
+    SspBenchResult result(name);
+    GstElement* pipeline = gst_pipeline_new(nullptr);
+    GstElement* fakesink = gst_element_factory_make("fakesink", nullptr);
+    Sink sink = { fakesink, src, &result, g_type_from_name("GstSspIngestMetaAPI"), limit_frames,
+                  limit_time, GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, -1, -1, 0, FALSE };
+    gboolean ok = TRUE;
+
+    g_object_set(src, "ingest-meta", TRUE, nullptr);
+    g_object_set(fakesink, "sync", FALSE, nullptr);
+    gst_bin_add_many(GST_BIN(pipeline), src, fakesink, nullptr);
+    gst_element_link(src, fakesink);
+
+    GstPad* pad = gst_element_get_static_pad(fakesink, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_buffer, &sink, nullptr);
+    gst_object_unref(pad);
+
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus* bus = gst_element_get_bus(pipeline);
+    GstMessage* msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR | GST_MESSAGE_APPLICATION));
+    if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+        GError* error = nullptr;
+
+        gst_message_parse_error(msg, &error, nullptr);
+        g_printerr("%s: %s\n", name, error->message);
+        g_error_free(error);
+        ok = FALSE;
+    }
+    gst_message_unref(msg);
+    if (ok && !sink.done && GST_CLOCK_TIME_IS_VALID(sink.start)) {
+        finish(&sink);
+    }
+    const gchar* backend = ssp_bench_io_backend(src);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+
+    if (!ok) {
+        return FALSE;
+    }
+    if (GST_CLOCK_TIME_IS_VALID(sink.start)) {
+        result.elapsed = sink.last - sink.start;
+    }
+    result.set_json("io_backend", std::string("\"") + backend + "\"");
+    result.set("syscalls_per_frame",
+               sink.syscalls >= 0 && result.frames ? (gdouble)sink.syscalls / result.frames : NAN);
+    result.set("cpu_ms_per_gbit",
+               result.bytes ? sink.cpu / 1e6 / (result.bytes * 8 / 1e9) : NAN);
+    report->add(result);
+    return TRUE;
+}
+
+int
+main(int argc, char** argv)
+{
+    SspBenchOptions options = { nullptr, 3000, 5 };
+    GOptionEntry entries[] = {
+        { "bitrate", 'r', 0, G_OPTION_ARG_INT64, &bitrate, "Bits/s of the stream (100000000)", "BPS" },
+        { "width", 'W', 0, G_OPTION_ARG_INT, &width, "Width of the stream (3840)", "PX" },
+        { "height", 'H', 0, G_OPTION_ARG_INT, &height, "Height of the stream (2160)", "PX" },
+        { "fps", 'f', 0, G_OPTION_ARG_DOUBLE, &fps, "Frame rate of the stream (30)", "FPS" },
+        { "server", 0, 0, G_OPTION_ARG_FILENAME, &server,
+          "ssp-mock-server to run sspsrc against, native client builds only", "PATH" },
+        { nullptr }
+    };
+    SspBenchReport report("pipeline");
+    SspEsStream stream;
+    gchar* path = nullptr;
+    gint fd;
+
+    ssp_bench_init(&argc, &argv, "sspsrc ! fakesink throughput and latency", entries, &options);
+
+    GstElementFactory* factory = gst_element_factory_find("sspfilesrc");
+    if (!factory) {
+        g_printerr("sspfilesrc not found, set GST_PLUGIN_PATH to the build's src directory\n");
+        return 1;
+    }
+    gst_object_unref(factory);
+
+    SspEsParams params = { SSP_NAL_CODEC_H265, (guint)width, (guint)height, fps, bitrate, 30 };
+    GRand* rand = g_rand_new_with_seed(1);
+    ssp_es_generate(params, rand, &stream);
+    g_rand_free(rand);
+    report.set_input("generated", "H.265 Main 10");
+    report.set_input_uint("width", width);
+    report.set_input_uint("height", height);
+    report.set_input("fps", fps);
+    report.set_input_uint("bitrate", bitrate);
+
+    fd = g_file_open_tmp("ssp-bench-XXXXXX.sspcap", &path, nullptr);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (fd < 0 || !ssp_bench_write_capture(path, stream, width, height, fps)) {
+        g_printerr("Could not write the capture\n");
+        return 1;
+    }
+
+    // Looping, so the frame count is not bounded by the capture
+    GstElement* src = gst_element_factory_make("sspfilesrc", nullptr);
+    g_object_set(src, "location", path, "loop", TRUE, nullptr);
+    gst_util_set_object_arg(G_OBJECT(src), "pace", "fast");
+    gboolean ok = run(&report, "replay-fast", src, options.frames, GST_CLOCK_TIME_NONE);
+
+    src = gst_element_factory_make("sspfilesrc", nullptr);
+    g_object_set(src, "location", path, "loop", TRUE, nullptr);
+    gst_util_set_object_arg(G_OBJECT(src), "pace", "recorded");
+    ok &= run(&report, "replay-paced", src, 0, (GstClockTime)(options.seconds * GST_SECOND));
+
+    g_unlink(path);
+    g_free(path);
+
+    if (server) {
+        GPid pid;
+        gint port;
+
+        ok &= ssp_bench_spawn_server(server, params, &pid, &port);
+        if (ok) {
+            // io_backend tells whether the kernel had io_uring for the second
+            const gchar* backends[] = { "epoll", "io_uring" };
+            for (const gchar* backend : backends) {
+                gchar* name = g_strdup_printf("mock-server-%s", backend);
+
+                ssp_bench_set_io_backend(backend);
+                src = gst_element_factory_make("sspsrc", nullptr);
+                g_object_set(src, "ip", "127.0.0.1", "port", (guint)port, nullptr);
+                ok &= run(&report, name, src, 0, (GstClockTime)(options.seconds * GST_SECOND));
+                g_free(name);
+            }
+            ssp_bench_set_io_backend("auto");
+            ssp_bench_stop_server(pid);
+        }
+    }
+
+    return report.write(options.output) && ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// The loop thread to streaming thread hand-off of sspsrc without the
+// element around it: wrap the receive region in a borrowed GstMemory,
+// index the frame prefix, build the GstBuffer, take ownership of the
+// payload (gst_ssp_memory_reclaim) and push it into an SspFrameRing that
+// a second thread drains, in the order SspThread::on_video_data,
+// on_video_data_cb and gst_ssp_src_enqueue do it.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsspmemory.h"
+#include "sspbench.h"
+#include "sspesstream.h"
+#include "sspnal.h"
+#include "sspring.h"
+
+// sspsrc defaults
+#define QUEUE_FRAMES 256
+#define QUEUE_BYTES (256 * 1024 * 1024)
+
+static gint64 bitrate = 100000000;
+static gint width = 3840;
+static gint height = 2160;
+
+struct Consumer {
+    SspFrameRing* ring;
+    SspBenchResult* result;
+    gint frames;
+
+    // Hand-off mode: the producer waits for each frame to be taken
+    gboolean handoff;
+    GMutex lock;
+    GCond cond;
+    gint taken;
+};
+
+static gpointer
+consume(gpointer data)
+{
+    Consumer* c = (Consumer*)data;
+
+    for (gint i = 0; i < c->frames; i++) {
+        GstClockTime latency;
+        GstBuffer* buffer = c->ring->pop(-1, &latency);
+
+        if (!buffer) {
+            break;
+        }
+        c->result->add_latency(latency);
+        gst_buffer_unref(buffer);
+
+        if (c->handoff) {
+            g_mutex_lock(&c->lock);
+            c->taken++;
+            g_cond_signal(&c->cond);
+            g_mutex_unlock(&c->lock);
+        }
+    }
+    return nullptr;
+}
+
+// One frame through the loop thread's side of the path. The stream
+// stands in for libssp's receive buffer, borrowed and given back per frame.
+static void
+produce(SspFrameRing* ring, const SspEsStream& stream, const SspEsFrame& frame,
+        guint64 n, SspNalIndex* index)
+{
+    const guint8* data = stream.data.data() + frame.offset;
+    GstMemory* memory = gst_ssp_memory_new_borrowed(data, frame.size);
+
+    ssp_nal_index_build(index, data, frame.size, stream.codec, TRUE);
+
+    GstBuffer* buffer = gst_buffer_new();
+    gst_buffer_append_memory(buffer, gst_memory_ref(memory));
+    GST_BUFFER_PTS(buffer) = n * GST_SECOND / 30;
+    GST_BUFFER_OFFSET(buffer) = n;
+    if (!index->has_idr) {
+        GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    }
+
+    if (ring) {
+        gsize size = frame.size;
+
+        if (ring->full(size)) {
+            ring->wait_space(size);
+        }
+        gst_ssp_memory_reclaim(memory);
+        ring->push(buffer);
+    } else {
+        gst_buffer_unref(buffer);
+    }
+
+    gst_ssp_memory_reclaim(memory);
+    gst_memory_unref(memory);
+}
+
+static void
+run(SspBenchReport* report, const gchar* name, const SspEsStream& stream,
+    gint frames, gboolean threaded, gboolean handoff)
+{
+    SspBenchResult result(name);
+    SspNalIndex* index = g_new0(SspNalIndex, 1);
+    SspFrameRing* ring = nullptr;
+    GThread* thread = nullptr;
+    Consumer consumer;
+    GstSspAllocatorStats before, after;
+
+    if (threaded) {
+        ring = new SspFrameRing(QUEUE_FRAMES, QUEUE_BYTES, 0);
+        consumer.ring = ring;
+        consumer.result = &result;
+        consumer.frames = frames;
+        consumer.handoff = handoff;
+        consumer.taken = 0;
+        g_mutex_init(&consumer.lock);
+        g_cond_init(&consumer.cond);
+    }
+
+    gst_ssp_allocator_get_stats(&before);
+    gint64 allocs = ssp_bench_allocs();
+    GstClockTime start = gst_util_get_timestamp();
+    if (threaded) {
+        thread = g_thread_new("bench-consumer", consume, &consumer);
+    }
+    for (gint i = 0; i < frames; i++) {
+        const SspEsFrame& frame = stream.frames[i % stream.frames.size()];
+
+        produce(ring, stream, frame, i, index);
+        result.bytes += frame.size;
+
+        if (handoff) {
+            g_mutex_lock(&consumer.lock);
+            while (consumer.taken <= i) {
+                g_cond_wait(&consumer.cond, &consumer.lock);
+            }
+            g_mutex_unlock(&consumer.lock);
+        }
+    }
+    if (thread) {
+        g_thread_join(thread);
+    }
+    result.elapsed = gst_util_get_timestamp() - start;
+    result.frames = frames;
+    if (allocs >= 0) {
+        result.allocs = ssp_bench_allocs() - allocs;
+    }
+    gst_ssp_allocator_get_stats(&after);
+    result.set("copies_per_frame", (gdouble)(after.copies - before.copies) / frames);
+    result.set("block_allocs_per_frame", (gdouble)(after.allocs - before.allocs) / frames);
+    report->add(result);
+
+    if (threaded) {
+        g_mutex_clear(&consumer.lock);
+        g_cond_clear(&consumer.cond);
+        delete ring;
+    }
+    g_free(index);
+}
+
+int
+main(int argc, char** argv)
+{
+    SspBenchOptions options = { nullptr, 3000, 1 };
+    GOptionEntry entries[] = {
+        { "bitrate", 'r', 0, G_OPTION_ARG_INT64, &bitrate,
+          "Bits/s of the generated stream, sets the frame size (100000000)", "BPS" },
+        { "width", 'W', 0, G_OPTION_ARG_INT, &width, "Width of the generated stream (3840)", "PX" },
+        { "height", 'H', 0, G_OPTION_ARG_INT, &height, "Height of the generated stream (2160)", "PX" },
+        { nullptr }
+    };
+    SspBenchReport report("queue");
+    SspEsStream stream;
+
+    ssp_bench_init(&argc, &argv, "Frame wrap, enqueue and dequeue", entries, &options);
+
+    SspEsParams params = { SSP_NAL_CODEC_H265, (guint)width, (guint)height, 30, bitrate, 30 };
+    GRand* rand = g_rand_new_with_seed(1);
+    ssp_es_generate(params, rand, &stream);
+    g_rand_free(rand);
+    report.set_input("generated", "H.265 Main 10");
+    report.set_input_uint("width", width);
+    report.set_input_uint("height", height);
+    report.set_input_uint("bitrate", bitrate);
+    report.set_input("avg_frame_bytes", (gdouble)stream.data.size() / stream.frames.size());
+
+    // Loop thread work alone, nothing queued so nothing is copied
+    run(&report, "wrap", stream, options.frames, FALSE, FALSE);
+    // Producer as fast as it can, the consumer drains; the latency is the
+    // time frames spend queued behind each other
+    run(&report, "enqueue-dequeue", stream, options.frames, TRUE, FALSE);
+    // One frame at a time into a sleeping consumer, as at camera rates:
+    // the latency is the wake-up of the streaming thread
+    run(&report, "handoff", stream, options.frames, TRUE, TRUE);
+
+    return report.write(options.output) ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+// N cameras in one process, for N from --cameras: each an sspsrc connected
+// to the ssp-mock-server given with --server, or with --source sspfilesrc
+// an sspfilesrc replaying a capture at its recorded rate, into its own
+// fakesink. Every result names its source. One result per N
+// with the aggregate throughput, the latency over all cameras, CPU time per
+// camera, RSS, threads and drops, plus the per camera latencies, so the
+// results form a scaling curve. The server runs in its own process and is
+// not part of the CPU time. --io-backend picks the native client's receive
+// path, whose system calls per frame and CPU time per Gbit are reported
+// for comparing them.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "gstsspmeta.h"
+#include "sspbench.h"
+#include "sspbenchsrc.h"
+#include "sspnal.h"
+
+// Time for all cameras to deliver their first frame
+#define STARTUP_TIMEOUT (10 * GST_SECOND)
+// Then queues, caches and the allocator settle before measuring
+#define WARMUP (GST_SECOND / 2)
+
+static gchar* cameras = (gchar*)"1,2,4,8,16,32";
+static gint64 bitrate = 100000000;
+static gint width = 3840;
+static gint height = 2160;
+static gdouble fps = 30;
+static gchar* source = (gchar*)"sspsrc";
+static gchar* server;
+static gchar* io_backend = (gchar*)"auto";
+
+struct Camera {
+    GstElement* src;
+    SspBenchResult* result;
+    GType meta_api;
+    gint* measuring;
+    gint started;
+    guint64 dropped;
+};
+
+static GstPadProbeReturn
+on_buffer(GstPad* pad, GstPadProbeInfo* info, gpointer data)
+{
+    Camera* camera = (Camera*)data;
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+
+    g_atomic_int_set(&camera->started, TRUE);
+    if (!g_atomic_int_get(camera->measuring)) {
+        return GST_PAD_PROBE_OK;
+    }
+
+    GstSspIngestMeta* meta = (GstSspIngestMeta*)gst_buffer_get_meta(buffer, camera->meta_api);
+    if (meta && GST_CLOCK_TIME_IS_VALID(meta->received)) {
+        camera->result->add_latency(gst_util_get_timestamp() - meta->received);
+    }
+    camera->result->frames++;
+    camera->result->bytes += gst_buffer_get_size(buffer);
+    return GST_PAD_PROBE_OK;
+}
+
+// Resident set size and thread count from /proc
+static void
+read_proc(guint64* rss, guint* threads)
+{
+    gchar* contents = nullptr;
+    unsigned long long pages = 0;
+
+    *rss = 0;
+    *threads = 0;
+    if (g_file_get_contents("/proc/self/statm", &contents, nullptr, nullptr) &&
+        sscanf(contents, "%*u %llu", &pages) == 1) {
+        *rss = pages * sysconf(_SC_PAGESIZE);
+    }
+    g_free(contents);
+    contents = nullptr;
+    if (g_file_get_contents("/proc/self/status", &contents, nullptr, nullptr)) {
+        const gchar* line = strstr(contents, "\nThreads:");
+        if (line) {
+            *threads = (guint)strtoul(line + strlen("\nThreads:"), nullptr, 10);
+        }
+    }
+    g_free(contents);
+}
+
+// The video dropped-frames counter of the element's stats
+static guint64
+dropped_frames(GstElement* src)
+{
+    GstStructure* stats = nullptr;
+    GstStructure* video = nullptr;
+    guint64 dropped = 0;
+
+    g_object_get(src, "stats", &stats, nullptr);
+    if (stats && gst_structure_get(stats, "video", GST_TYPE_STRUCTURE, &video, nullptr)) {
+        gst_structure_get_uint64(video, "dropped-frames", &dropped);
+        gst_structure_free(video);
+    }
+    if (stats) {
+        gst_structure_free(stats);
+    }
+    return dropped;
+}
+
+static GstElement*
+make_source(const gchar* capture, gint port)
+{
+    GstElement* src = gst_element_factory_make(source, nullptr);
+
+    if (g_str_equal(source, "sspfilesrc")) {
+        g_object_set(src, "location", capture, "loop", TRUE, nullptr);
+        gst_util_set_object_arg(G_OBJECT(src), "pace", "recorded");
+    } else {
+        g_object_set(src, "ip", "127.0.0.1", "port", (guint)port, nullptr);
+    }
+    g_object_set(src, "ingest-meta", TRUE, nullptr);
+    return src;
+}
+
+// Waits on the bus until @deadline, FALSE on an error
+static gboolean
+wait_until(GstBus* bus, GstClockTime deadline)
+{
+    for (;;) {
+        GstClockTime now = gst_util_get_timestamp();
+        if (now >= deadline) {
+            return TRUE;
+        }
+        GstMessage* msg = gst_bus_timed_pop_filtered(bus, MIN(deadline - now, 10 * GST_MSECOND),
+            (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+        if (msg) {
+            GError* error = nullptr;
+
+            if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) {
+                gst_message_parse_error(msg, &error, nullptr);
+                g_printerr("%s: %s\n", GST_OBJECT_NAME(GST_MESSAGE_SRC(msg)), error->message);
+                g_error_free(error);
+            } else {
+                g_printerr("%s: unexpected EOS\n", GST_OBJECT_NAME(GST_MESSAGE_SRC(msg)));
+            }
+            gst_message_unref(msg);
+            return FALSE;
+        }
+    }
+}
+
+static gboolean
+run(SspBenchReport* report, guint n, const gchar* capture, gint port, GstClockTime duration)
+{
+    gchar* name = g_strdup_printf("cameras-%u", n);
+    SspBenchResult result(name);
+    std::vector<SspBenchResult*> results;
+    std::vector<Camera> cams(n);
+    GstElement* pipeline = gst_pipeline_new(nullptr);
+    GType meta_api = g_type_from_name("GstSspIngestMetaAPI");
+    gint measuring = FALSE;
+    gboolean ok;
+
+    for (guint i = 0; i < n; i++) {
+        gchar* camera_name = g_strdup_printf("camera-%u", i);
+        GstElement* sink = gst_element_factory_make("fakesink", nullptr);
+
+        results.push_back(new SspBenchResult(camera_name));
+        cams[i] = { make_source(capture, port), results[i], meta_api, &measuring, FALSE, 0 };
+        g_object_set(sink, "sync", FALSE, nullptr);
+        gst_bin_add_many(GST_BIN(pipeline), cams[i].src, sink, nullptr);
+        gst_element_link(cams[i].src, sink);
+
+        GstPad* pad = gst_element_get_static_pad(sink, "sink");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, on_buffer, &cams[i], nullptr);
+        gst_object_unref(pad);
+        g_free(camera_name);
+    }
+
+    GstBus* bus = gst_element_get_bus(pipeline);
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+
+    // Every camera streaming, then settled
+    GstClockTime deadline = gst_util_get_timestamp() + STARTUP_TIMEOUT;
+    guint started = 0;
+    ok = TRUE;
+    while (ok && started < n) {
+        GstClockTime now = gst_util_get_timestamp();
+
+        if (now >= deadline) {
+            g_printerr("%s: only %u cameras started\n", name, started);
+            ok = FALSE;
+            break;
+        }
+        ok = wait_until(bus, now + 10 * GST_MSECOND);
+        started = 0;
+        for (const Camera& camera : cams) {
+            started += g_atomic_int_get(&camera.started) ? 1 : 0;
+        }
+    }
+    ok = ok && wait_until(bus, gst_util_get_timestamp() + WARMUP);
+
+    if (ok) {
+        for (Camera& camera : cams) {
+            camera.dropped = dropped_frames(camera.src);
+        }
+        gint64 allocs = ssp_bench_allocs();
+        gint64 syscalls = ssp_bench_receive_syscalls(cams[0].src);
+        GstClockTime cpu = ssp_bench_cpu_time();
+        GstClockTime start = gst_util_get_timestamp();
+        g_atomic_int_set(&measuring, TRUE);
+
+        ok = wait_until(bus, start + duration);
+
+        g_atomic_int_set(&measuring, FALSE);
+        result.elapsed = gst_util_get_timestamp() - start;
+        cpu = ssp_bench_cpu_time() - cpu;
+        if (syscalls >= 0) {
+            syscalls = ssp_bench_receive_syscalls(cams[0].src) - syscalls;
+        }
+        if (allocs >= 0) {
+            result.allocs = ssp_bench_allocs() - allocs;
+        }
+
+        guint64 rss, dropped = 0;
+        guint threads;
+        read_proc(&rss, &threads);
+        const gchar* backend = ssp_bench_io_backend(cams[0].src);
+        for (Camera& camera : cams) {
+            dropped += dropped_frames(camera.src) - camera.dropped;
+        }
+
+        gst_element_set_state(pipeline, GST_STATE_NULL);
+
+        // Streaming threads are gone, the per camera results are final
+        GString* detail = g_string_new("[");
+        gdouble seconds = (gdouble)result.elapsed / GST_SECOND;
+        gdouble min_fps = -1;
+        for (guint i = 0; i < n; i++) {
+            SspBenchResult* r = results[i];
+
+            r->elapsed = result.elapsed;
+            r->set_json("source", std::string("\"") + source + "\"");
+            result.frames += r->frames;
+            result.bytes += r->bytes;
+            result.add_latencies(*r);
+            if (min_fps < 0 || r->frames / seconds < min_fps) {
+                min_fps = r->frames / seconds;
+            }
+            if (i) {
+                g_string_append(detail, ", ");
+            }
+            r->append_json(detail);
+        }
+        g_string_append(detail, "]");
+
+        result.set_json("source", std::string("\"") + source + "\"");
+        result.set_uint("cameras", n);
+        result.set("expected_frames_per_s", n * fps);
+        result.set("min_camera_frames_per_s", min_fps);
+        result.set_uint("dropped_frames", dropped);
+        result.set("cpu_percent", 100.0 * cpu / result.elapsed);
+        result.set("cpu_percent_per_camera", 100.0 * cpu / result.elapsed / n);
+        result.set("cpu_ns_per_frame", result.frames ? (gdouble)cpu / result.frames : NAN);
+        result.set("cpu_ms_per_gbit", result.bytes ? cpu / 1e6 / (result.bytes * 8 / 1e9) : NAN);
+        result.set("syscalls_per_frame",
+                   syscalls >= 0 && result.frames ? (gdouble)syscalls / result.frames : NAN);
+        result.set_json("io_backend", std::string("\"") + backend + "\"");
+        result.set_uint("rss_bytes", rss);
+        result.set_uint("threads", threads);
+        result.set_json("per_camera", detail->str);
+        g_string_free(detail, TRUE);
+        report->add(result);
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(bus);
+    gst_object_unref(pipeline);
+    for (SspBenchResult* r : results) {
+        delete r;
+    }
+    g_free(name);
+    return ok;
+}
+
+int
+main(int argc, char** argv)
+{
+    SspBenchOptions options = { nullptr, 3000, 5 };
+    GOptionEntry entries[] = {
+        { "cameras", 'c', 0, G_OPTION_ARG_STRING, &cameras,
+          "Comma separated camera counts (1,2,4,8,16,32)", "N,..." },
+        { "bitrate", 'r', 0, G_OPTION_ARG_INT64, &bitrate, "Bits/s per camera (100000000)", "BPS" },
+        { "width", 'W', 0, G_OPTION_ARG_INT, &width, "Width of the streams (3840)", "PX" },
+        { "height", 'H', 0, G_OPTION_ARG_INT, &height, "Height of the streams (2160)", "PX" },
+        { "fps", 'f', 0, G_OPTION_ARG_DOUBLE, &fps, "Frame rate of the streams (30)", "FPS" },
+        { "source", 's', 0, G_OPTION_ARG_STRING, &source,
+          "Element of each camera: sspsrc, or sspfilesrc replaying a capture (sspsrc)", "NAME" },
+        { "server", 0, 0, G_OPTION_ARG_FILENAME, &server,
+          "ssp-mock-server for sspsrc to connect to, native client builds only", "PATH" },
+        { "io-backend", 0, 0, G_OPTION_ARG_STRING, &io_backend,
+          "Receive path of the native client: auto, epoll or io_uring (auto)", "NAME" },
+        { nullptr }
+    };
+    SspBenchReport report("scaling");
+    std::vector<guint> counts;
+    gchar* path = nullptr;
+    GPid pid = 0;
+    gint port = 0;
+
+    ssp_bench_init(&argc, &argv, "sspsrc scaling with the number of cameras", entries,
+                   &options);
+
+    gchar** parts = g_strsplit(cameras, ",", -1);
+    for (gchar** part = parts; *part; part++) {
+        gint n = atoi(*part);
+
+        if (n < 1) {
+            g_printerr("Bad camera count '%s'\n", *part);
+            return 1;
+        }
+        counts.push_back(n);
+    }
+    g_strfreev(parts);
+
+    // Never fall back to the other element, results of the two do not compare
+    if (g_str_equal(source, "sspsrc")) {
+        if (!server) {
+            g_printerr("sspsrc needs --server with an ssp-mock-server of a native client "
+                       "build, or run --source sspfilesrc\n");
+            return 1;
+        }
+    } else if (g_str_equal(source, "sspfilesrc")) {
+        if (server) {
+            g_printerr("--server is for --source sspsrc only\n");
+            return 1;
+        }
+    } else {
+        g_printerr("Bad source '%s'\n", source);
+        return 1;
+    }
+
+    GstElementFactory* factory = gst_element_factory_find(source);
+    if (!factory) {
+        g_printerr("%s not found, set GST_PLUGIN_PATH to the build's src directory\n", source);
+        return 1;
+    }
+    gst_object_unref(factory);
+
+    if (!g_str_equal(io_backend, "auto") && !g_str_equal(io_backend, "epoll") &&
+        !g_str_equal(io_backend, "io_uring")) {
+        g_printerr("Bad io backend '%s'\n", io_backend);
+        return 1;
+    }
+    ssp_bench_set_io_backend(io_backend);
+
+    SspEsParams params = { SSP_NAL_CODEC_H265, (guint)width, (guint)height, fps, bitrate, 30 };
+    report.set_input("source", source);
+    report.set_input("input", server ? "mock-server" : "capture");
+    report.set_input("io_backend", io_backend);
+    report.set_input("generated", "H.265 Main 10");
+    report.set_input_uint("width", width);
+    report.set_input_uint("height", height);
+    report.set_input("fps", fps);
+    report.set_input_uint("bitrate_per_camera", bitrate);
+
+    if (server) {
+        if (!ssp_bench_spawn_server(server, params, &pid, &port)) {
+            return 1;
+        }
+    } else {
+        // One capture shared by all cameras, each maps it
+        SspEsStream stream;
+        GRand* rand = g_rand_new_with_seed(1);
+        gint fd;
+
+        ssp_es_generate(params, rand, &stream);
+        g_rand_free(rand);
+        fd = g_file_open_tmp("ssp-bench-XXXXXX.sspcap", &path, nullptr);
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (fd < 0 || !ssp_bench_write_capture(path, stream, width, height, fps)) {
+            g_printerr("Could not write the capture\n");
+            return 1;
+        }
+    }
+
+    gboolean ok = TRUE;
+    for (guint n : counts) {
+        if (!run(&report, n, path, port, (GstClockTime)(options.seconds * GST_SECOND))) {
+            ok = FALSE;
+            break;
+        }
+    }
+
+    if (server) {
+        ssp_bench_stop_server(pid);
+    } else {
+        g_unlink(path);
+        g_free(path);
+    }
+    return report.write(options.output) && ok ? 0 : 1;
+}
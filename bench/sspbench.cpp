@@ -0,0 +1,325 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sspbench.h"
+
+#include <algorithm>
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+// ---------------------------------------------------------------------------
+// Allocation counting. The executable's malloc wins over libc's for every
+// library in the process; GLib, GStreamer and the plugin sources linked in
+// all allocate through it.
+
+static std::atomic<guint64> n_allocs(0);
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void*
+malloc(size_t size)
+{
+    n_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void*
+calloc(size_t n, size_t size)
+{
+    n_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void*
+realloc(void* ptr, size_t size)
+{
+    n_allocs.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+#endif
+
+gint64
+ssp_bench_allocs()
+{
+#ifdef __GLIBC__
+    return n_allocs.load(std::memory_order_relaxed);
+#else
+    return -1;
+#endif
+}
+
+GstClockTime
+ssp_bench_cpu_time()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+    return GST_TIMEVAL_TO_TIME(usage.ru_utime) + GST_TIMEVAL_TO_TIME(usage.ru_stime);
+}
+
+// ---------------------------------------------------------------------------
+// JSON
+
+static std::string
+quote(const std::string& value)
+{
+    std::string out = "\"";
+
+    for (guchar c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            gchar escape[8];
+            g_snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Counts, sizes and nanoseconds, exact at any magnitude
+static std::string
+integer(guint64 value)
+{
+    gchar buf[24];
+
+    g_snprintf(buf, sizeof(buf), "%" G_GUINT64_FORMAT, value);
+    return buf;
+}
+
+// Locale independent, with enough digits to read back the same double
+static std::string
+number(gdouble value)
+{
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+    if (!isfinite(value)) {
+        return "null";
+    }
+    g_ascii_formatd(buf, sizeof(buf), "%.17g", value);
+    return buf;
+}
+
+static void
+append_field(GString* out, const std::string& key, const std::string& json, gboolean* first)
+{
+    if (!*first) {
+        g_string_append(out, ", ");
+    }
+    *first = FALSE;
+    g_string_append(out, quote(key).c_str());
+    g_string_append(out, ": ");
+    g_string_append(out, json.c_str());
+}
+
+// ---------------------------------------------------------------------------
+
+SspBenchResult::SspBenchResult(const std::string& name)
+    : name(name)
+    , frames(0)
+    , bytes(0)
+    , elapsed(0)
+    , allocs(-1)
+    , sorted_(TRUE)
+{
+}
+
+GstClockTime
+SspBenchResult::percentile(gdouble p)
+{
+    if (latencies_.empty()) {
+        return GST_CLOCK_TIME_NONE;
+    }
+    if (!sorted_) {
+        std::sort(latencies_.begin(), latencies_.end());
+        sorted_ = TRUE;
+    }
+    // Nearest rank
+    gsize rank = (gsize)ceil(p / 100.0 * latencies_.size());
+    return latencies_[CLAMP(rank, 1, latencies_.size()) - 1];
+}
+
+void
+SspBenchResult::set(const std::string& key, gdouble value)
+{
+    set_json(key, number(value));
+}
+
+void
+SspBenchResult::set_uint(const std::string& key, guint64 value)
+{
+    set_json(key, integer(value));
+}
+
+void
+SspBenchResult::set_json(const std::string& key, const std::string& json)
+{
+    extra_.push_back({ key, json });
+}
+
+void
+SspBenchResult::append_json(GString* out)
+{
+    gdouble seconds = (gdouble)elapsed / GST_SECOND;
+    gboolean first = TRUE;
+
+    g_string_append(out, "{");
+    append_field(out, "name", quote(name), &first);
+    append_field(out, "frames", integer(frames), &first);
+    append_field(out, "bytes", integer(bytes), &first);
+    append_field(out, "seconds", number(seconds), &first);
+    append_field(out, "frames_per_s", number(elapsed ? frames / seconds : NAN), &first);
+    append_field(out, "ns_per_frame", number(frames ? (gdouble)elapsed / frames : NAN), &first);
+    append_field(out, "mbit_per_s", number(elapsed ? bytes * 8 / seconds / 1e6 : NAN), &first);
+    if (latencies_.empty()) {
+        append_field(out, "latency_p50_ns", "null", &first);
+        append_field(out, "latency_p99_ns", "null", &first);
+        append_field(out, "latency_max_ns", "null", &first);
+    } else {
+        append_field(out, "latency_p50_ns", integer(percentile(50)), &first);
+        append_field(out, "latency_p99_ns", integer(percentile(99)), &first);
+        append_field(out, "latency_max_ns", integer(percentile(100)), &first);
+    }
+    append_field(out, "allocs_per_frame",
+                 number(allocs >= 0 && frames ? (gdouble)allocs / frames : NAN), &first);
+    for (const auto& field : extra_) {
+        append_field(out, field.first, field.second, &first);
+    }
+    g_string_append(out, "}");
+}
+
+SspBenchReport::SspBenchReport(const std::string& suite)
+    : suite_(suite)
+    , results_(g_string_new(nullptr))
+    , n_results_(0)
+{
+}
+
+SspBenchReport::~SspBenchReport()
+{
+    g_string_free(results_, TRUE);
+}
+
+void
+SspBenchReport::set_input(const std::string& key, const std::string& value)
+{
+    input_.push_back({ key, quote(value) });
+}
+
+void
+SspBenchReport::set_input(const std::string& key, gdouble value)
+{
+    input_.push_back({ key, number(value) });
+}
+
+void
+SspBenchReport::set_input_uint(const std::string& key, guint64 value)
+{
+    input_.push_back({ key, integer(value) });
+}
+
+void
+SspBenchReport::add(SspBenchResult& result)
+{
+    if (n_results_++) {
+        g_string_append(results_, ",\n    ");
+    }
+    result.append_json(results_);
+
+    g_printerr("%-24s %10.1f frames/s %12.0f ns/frame", result.name.c_str(),
+               result.elapsed ? result.frames / ((gdouble)result.elapsed / GST_SECOND) : 0.0,
+               result.frames ? (gdouble)result.elapsed / result.frames : 0.0);
+    if (GST_CLOCK_TIME_IS_VALID(result.percentile(50))) {
+        g_printerr("  p50 %8.1f us  p99 %8.1f us", result.percentile(50) / 1000.0,
+                   result.percentile(99) / 1000.0);
+    }
+    if (result.allocs >= 0 && result.frames) {
+        g_printerr("  %.2f allocs/frame", (gdouble)result.allocs / result.frames);
+    }
+    g_printerr("\n");
+}
+
+gboolean
+SspBenchReport::write(const gchar* path)
+{
+    GString* out = g_string_new("{");
+    gboolean first = TRUE;
+    GString* input = g_string_new("{");
+    gboolean input_first = TRUE;
+    gboolean ok = TRUE;
+
+    for (const auto& field : input_) {
+        append_field(input, field.first, field.second, &input_first);
+    }
+    g_string_append(input, "}");
+
+    append_field(out, "suite", quote(suite_), &first);
+    append_field(out, "version", "\"" PACKAGE_VERSION "\"", &first);
+    append_field(out, "client", "\"" SSP_CLIENT "\"", &first);
+    append_field(out, "cpus", integer(g_get_num_processors()), &first);
+    append_field(out, "input", input->str, &first);
+    g_string_append_printf(out, ",\n  \"results\": [\n    %s\n  ]}\n", results_->str);
+
+    if (!path || g_str_equal(path, "-")) {
+        fputs(out->str, stdout);
+        fflush(stdout);
+    } else {
+        GError* error = nullptr;
+
+        ok = g_file_set_contents(path, out->str, out->len, &error);
+        if (!ok) {
+            g_printerr("%s\n", error->message);
+            g_error_free(error);
+        }
+    }
+
+    g_string_free(input, TRUE);
+    g_string_free(out, TRUE);
+    return ok;
+}
+
+void
+ssp_bench_init(int* argc, char*** argv, const gchar* summary,
+               const GOptionEntry* entries, SspBenchOptions* options)
+{
+    GError* error = nullptr;
+    GOptionEntry common[] = {
+        { "output", 'o', 0, G_OPTION_ARG_FILENAME, &options->output,
+          "Write the JSON report here instead of stdout", "FILE" },
+        { "frames", 'n', 0, G_OPTION_ARG_INT, &options->frames,
+          "Frames per benchmark", "N" },
+        { "seconds", 's', 0, G_OPTION_ARG_DOUBLE, &options->seconds,
+          "Duration of the timed benchmarks", "S" },
+        { nullptr }
+    };
+
+    GOptionContext* context = g_option_context_new(nullptr);
+    g_option_context_set_summary(context, summary);
+    g_option_context_add_main_entries(context, common, nullptr);
+    if (entries) {
+        g_option_context_add_main_entries(context, entries, nullptr);
+    }
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, argc, argv, &error)) {
+        g_printerr("%s\n", error->message);
+        exit(1);
+    }
+    g_option_context_free(context);
+
+    if (options->frames < 1 || options->seconds <= 0) {
+        g_printerr("frames and seconds must be positive\n");
+        exit(1);
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef __SSP_BENCH_H__
+#define __SSP_BENCH_H__
+
+#include <gst/gst.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Shared by the benchmarks: per frame latency samples, allocation counts
+// and the JSON report, one object per run so runs diff across commits:
+//
+//   {"suite": "nal", "version": "1.0.0", "client": "libssp", "cpus": 8,
+//    "input": {...}, "results": [
+//     {"name": "scan", "frames": 6000, "bytes": ..., "seconds": ...,
+//      "frames_per_s": ..., "ns_per_frame": ..., "mbit_per_s": ...,
+//      "latency_p50_ns": ..., "latency_p99_ns": ..., "latency_max_ns": ...,
+//      "allocs_per_frame": ...}, ...]}
+//
+// Latencies and allocations are null when a benchmark does not measure
+// them, allocations are counted on glibc only.
+
+class SspBenchResult {
+public:
+    explicit SspBenchResult(const std::string& name);
+
+    std::string name;
+    guint64 frames;
+    guint64 bytes;
+    GstClockTime elapsed;
+    gint64 allocs;              // -1 when not counted
+
+    void add_latency(GstClockTime latency)
+    {
+        latencies_.push_back(latency);
+        sorted_ = FALSE;
+    }
+    // All samples of @other, for a result summed over several streams
+    void add_latencies(const SspBenchResult& other)
+    {
+        latencies_.insert(latencies_.end(), other.latencies_.begin(), other.latencies_.end());
+        sorted_ = FALSE;
+    }
+    GstClockTime percentile(gdouble p);
+    // Extra number or preformatted JSON value, written after the standard
+    // fields. Integers go through set_uint() so they are written exactly.
+    void set(const std::string& key, gdouble value);
+    void set_uint(const std::string& key, guint64 value);
+    void set_json(const std::string& key, const std::string& json);
+
+    void append_json(GString* out);
+
+private:
+    std::vector<GstClockTime> latencies_;
+    gboolean sorted_;
+    std::vector<std::pair<std::string, std::string>> extra_;
+};
+
+class SspBenchReport {
+public:
+    explicit SspBenchReport(const std::string& suite);
+    ~SspBenchReport();
+
+    void set_input(const std::string& key, const std::string& value);
+    void set_input(const std::string& key, gdouble value);
+    void set_input_uint(const std::string& key, guint64 value);
+    // Also prints a one line summary of the result to stderr
+    void add(SspBenchResult& result);
+
+    // NULL or "-" writes the JSON to stdout
+    gboolean write(const gchar* path);
+
+private:
+    std::string suite_;
+    std::vector<std::pair<std::string, std::string>> input_;
+    GString* results_;
+    guint n_results_;
+};
+
+// malloc, calloc and realloc calls by the whole process so far, -1 when
+// they cannot be counted
+gint64 ssp_bench_allocs();
+
+// User plus system CPU time of the whole process so far
+GstClockTime ssp_bench_cpu_time();
+
+// Frame count or duration given on the command line, both common to all
+// benchmarks
+struct SspBenchOptions {
+    gchar* output;
+    gint frames;
+    gdouble seconds;
+};
+
+// Parses the common options plus @entries, initializes GStreamer. Exits
+// on bad arguments.
+void ssp_bench_init(int* argc, char*** argv, const gchar* summary,
+                    const GOptionEntry* entries, SspBenchOptions* options);
+
+#endif /* __SSP_BENCH_H__ */
@@ -0,0 +1,143 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "sspbenchsrc.h"
+
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sspcapture.h"
+#include "sspnal.h"
+
+gboolean
+ssp_bench_write_capture(const gchar* path, const SspEsStream& stream, guint width,
+                        guint height, gdouble fps)
+{
+    SspCaptureWriter writer;
+    SspWireMeta meta = SspWireMeta();
+    GstClockTime frame_ns = (GstClockTime)(GST_SECOND / fps);
+
+    if (!writer.open(path)) {
+        return FALSE;
+    }
+    GstClockTime base = gst_util_get_timestamp();
+
+    meta.width = width;
+    meta.height = height;
+    meta.timescale = (guint32)llround(fps * 1000);
+    meta.unit = 1000;
+    meta.gop = stream.gop;
+    meta.encoder = stream.codec;
+    writer.write_meta(&meta, base);
+
+    for (gsize i = 0; i < stream.frames.size(); i++) {
+        const SspEsFrame& f = stream.frames[i];
+        SspWireFrame frame = { i * meta.unit, 0, (guint32)i,
+                               f.keyframe ? (guint32)SSP_WIRE_FRAME_IDR : 1 };
+
+        writer.write_frame(SSP_WIRE_VIDEO, &frame, stream.data.data() + f.offset, f.size,
+                           base + i * frame_ns);
+    }
+    writer.close();
+    return TRUE;
+}
+
+gboolean
+ssp_bench_spawn_server(const gchar* server, const SspEsParams& params, GPid* pid, gint* port)
+{
+    gchar* args[] = {
+        (gchar*)server, (gchar*)"--port", (gchar*)"0",
+        (gchar*)"--codec", (gchar*)(params.codec == SSP_NAL_CODEC_H265 ? "h265" : "h264"),
+        (gchar*)"--width", g_strdup_printf("%u", params.width),
+        (gchar*)"--height", g_strdup_printf("%u", params.height),
+        (gchar*)"--bitrate", g_strdup_printf("%" G_GINT64_FORMAT, params.bitrate),
+        (gchar*)"--fps", g_strdup_printf("%g", params.fps),
+        (gchar*)"--gop", g_strdup_printf("%u", params.gop), nullptr
+    };
+    GError* error = nullptr;
+    gint out = -1;
+    gchar line[512];
+    gboolean ok;
+
+    ok = g_spawn_async_with_pipes(nullptr, args, nullptr, G_SPAWN_DEFAULT, nullptr, nullptr,
+                                  pid, nullptr, &out, nullptr, &error);
+    for (guint i = 6; i < G_N_ELEMENTS(args) - 1; i += 2) {
+        g_free(args[i]);
+    }
+    if (!ok) {
+        g_printerr("%s\n", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    // The rest of its output is a few lines per client, left in the pipe
+    FILE* file = fdopen(out, "r");
+    const gchar* colon;
+    ok = fgets(line, sizeof(line), file) && g_str_has_prefix(line, "Serving") &&
+         (colon = strrchr(line, ':')) && (*port = atoi(colon + 1)) > 0;
+    if (!ok) {
+        g_printerr("%s did not start\n", server);
+        ssp_bench_stop_server(*pid);
+    }
+    return ok;
+}
+
+void
+ssp_bench_stop_server(GPid pid)
+{
+    kill(pid, SIGTERM);
+    g_spawn_close_pid(pid);
+}
+
+void
+ssp_bench_set_io_backend(const gchar* backend)
+{
+    if (!backend || g_str_equal(backend, "auto")) {
+        g_unsetenv("GST_SSP_IO");
+    } else {
+        g_setenv("GST_SSP_IO", backend, TRUE);
+    }
+}
+
+const gchar*
+ssp_bench_io_backend(GstElement* src)
+{
+    GstStructure* info = nullptr;
+    const gchar* backend = "replay";
+
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(src), "receive-info")) {
+        return backend;
+    }
+    g_object_get(src, "receive-info", &info, nullptr);
+    // Interned, the structure's copy does not outlive it
+    backend = info ? gst_structure_get_string(info, "io-backend") : nullptr;
+    backend = g_intern_string(backend ? backend : "libssp");
+    if (info) {
+        gst_structure_free(info);
+    }
+    return backend;
+}
+
+gint64
+ssp_bench_receive_syscalls(GstElement* src)
+{
+    GstStructure* stats = nullptr;
+    guint64 syscalls;
+    gint64 result = -1;
+
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(src), "loop-stats")) {
+        return -1;
+    }
+    g_object_get(src, "loop-stats", &stats, nullptr);
+    if (stats && gst_structure_get_uint64(stats, "receive-syscalls", &syscalls)) {
+        result = (gint64)syscalls;
+    }
+    if (stats) {
+        gst_structure_free(stats);
+    }
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef __SSP_BENCH_SRC_H__
+#define __SSP_BENCH_SRC_H__
+
+#include <gst/gst.h>
+
+#include "sspesstream.h"
+
+// Stand-ins for a camera, shared by the benchmarks that run sspsrc and
+// sspfilesrc: a capture file for sspfilesrc, or ssp-mock-server for sspsrc
+// in native client builds.
+
+// @stream as SspThread would have captured it arriving at @fps
+gboolean ssp_bench_write_capture(const gchar* path, const SspEsStream& stream,
+                                 guint width, guint height, gdouble fps);
+
+// Starts ssp-mock-server generating what @params describe on a free port
+// of 127.0.0.1. Every connection gets its own stream.
+gboolean ssp_bench_spawn_server(const gchar* server, const SspEsParams& params,
+                                GPid* pid, gint* port);
+void ssp_bench_stop_server(GPid pid);
+
+// Receive path of the native client for the sspsrc elements created from
+// now on: "auto", "epoll" or "io_uring". Sets GST_SSP_IO, which the
+// client reads when it connects.
+void ssp_bench_set_io_backend(const gchar* backend);
+// The receive path @src connected with, "libssp" or "replay" when it has
+// none of its own
+const gchar* ssp_bench_io_backend(GstElement* src);
+// Receive system calls of all native clients in the process so far, -1
+// when not counted
+gint64 ssp_bench_receive_syscalls(GstElement* src);
+
+#endif /* __SSP_BENCH_SRC_H__ */
@@ -0,0 +1,186 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsspfilesrc.h"
+#include "sspthread.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_ssp_file_src_debug);
+#define GST_CAT_DEFAULT gst_ssp_file_src_debug
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_PACE,
+  PROP_LOOP
+};
+
+#define DEFAULT_LOCATION NULL
+#define DEFAULT_PACE GST_SSP_FILE_SRC_PACE_RECORDED
+#define DEFAULT_LOOP FALSE
+
+#define gst_ssp_file_src_parent_class parent_class
+G_DEFINE_TYPE (GstSspFileSrc, gst_ssp_file_src, GST_TYPE_SSP_SRC);
+
+static void gst_ssp_file_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_ssp_file_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_ssp_file_src_finalize (GObject * object);
+static gboolean gst_ssp_file_src_start_client (GstSspSrc * src);
+
+#define GST_TYPE_SSP_FILE_SRC_PACE (gst_ssp_file_src_pace_get_type ())
+static GType
+gst_ssp_file_src_pace_get_type (void)
+{
+  static GType pace_type = 0;
+  static const GEnumValue paces[] = {
+    {GST_SSP_FILE_SRC_PACE_RECORDED, "At the recorded arrival times", "recorded"},
+    {GST_SSP_FILE_SRC_PACE_FAST, "As fast as downstream takes it", "fast"},
+    {0, NULL, NULL}
+  };
+
+  if (!pace_type) {
+    pace_type = g_enum_register_static ("GstSspFileSrcPace", paces);
+  }
+  return pace_type;
+}
+
+static void
+gst_ssp_file_src_class_init (GstSspFileSrcClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstElementClass *gstelement_class = (GstElementClass *) klass;
+  GstSspSrcClass *gstsspsrc_class = (GstSspSrcClass *) klass;
+
+  gobject_class->set_property = gst_ssp_file_src_set_property;
+  gobject_class->get_property = gst_ssp_file_src_get_property;
+  gobject_class->finalize = gst_ssp_file_src_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "Capture file written by sspsrc capture-location", DEFAULT_LOCATION,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_PACE,
+      g_param_spec_enum ("pace", "Pace",
+          "Replay at the recorded arrival times as a live source, or as fast "
+          "as possible as a non-live one", GST_TYPE_SSP_FILE_SRC_PACE,
+          DEFAULT_PACE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP,
+      g_param_spec_boolean ("loop", "Loop",
+          "Start over at the end, with timestamps and frame numbers continuing",
+          DEFAULT_LOOP, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "SSP File Source",
+      "Source/File",
+      "Replay an SSP capture through the sspsrc receive path",
+      "Your Name <your.email@example.com>");
+
+  gstsspsrc_class->start_client =
+      GST_DEBUG_FUNCPTR (gst_ssp_file_src_start_client);
+
+  GST_DEBUG_CATEGORY_INIT (gst_ssp_file_src_debug, "sspfilesrc", 0,
+      "SSP capture replay");
+}
+
+static void
+gst_ssp_file_src_init (GstSspFileSrc * self)
+{
+  GstSspSrc *src = GST_SSP_SRC (self);
+
+  self->location = g_strdup (DEFAULT_LOCATION);
+  self->pace = DEFAULT_PACE;
+  self->loop = DEFAULT_LOOP;
+
+  /* A file neither disconnects nor stalls, and a replay is only
+   * reproducible if nothing is dropped: block the replay thread instead */
+  src->reconnect = FALSE;
+  src->stall_frames = 0;
+  src->overflow_policy = GST_SSP_OVERFLOW_BLOCK;
+}
+
+static void
+gst_ssp_file_src_finalize (GObject * object)
+{
+  GstSspFileSrc *self = GST_SSP_FILE_SRC (object);
+
+  g_free (self->location);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ssp_file_src_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstSspFileSrc *self = GST_SSP_FILE_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_free (self->location);
+      self->location = g_value_dup_string (value);
+      break;
+    case PROP_PACE:
+      self->pace = (GstSspFileSrcPace) g_value_get_enum (value);
+      gst_base_src_set_live (GST_BASE_SRC (self),
+          self->pace == GST_SSP_FILE_SRC_PACE_RECORDED);
+      break;
+    case PROP_LOOP:
+      self->loop = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_ssp_file_src_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstSspFileSrc *self = GST_SSP_FILE_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, self->location);
+      break;
+    case PROP_PACE:
+      g_value_set_enum (value, self->pace);
+      break;
+    case PROP_LOOP:
+      g_value_set_boolean (value, self->loop);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* Everything after the SspThread, caps, timestamps, queues, GOP cache and
+ * statistics, is sspsrc's own code */
+static gboolean
+gst_ssp_file_src_start_client (GstSspSrc * src)
+{
+  GstSspFileSrc *self = GST_SSP_FILE_SRC (src);
+
+  if (!self->location || !*self->location) {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND,
+        ("No capture file given"), ("Set the location property"));
+    return FALSE;
+  }
+
+  if (!((SspThread *) src->ssp_thread)->start_replay (self->location,
+          self->pace == GST_SSP_FILE_SRC_PACE_RECORDED, self->loop,
+          (SspCaptureWriter *) src->capture)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+        ("Could not read capture file %s", self->location), (NULL));
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (src, "Replaying %s", self->location);
+  return TRUE;
+}
@@ -0,0 +1,42 @@
+#ifndef __GST_SSP_FILE_SRC_H__
+#define __GST_SSP_FILE_SRC_H__
+
+#include "gstsspsrc.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SSP_FILE_SRC \
+  (gst_ssp_file_src_get_type())
+#define GST_SSP_FILE_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SSP_FILE_SRC,GstSspFileSrc))
+#define GST_IS_SSP_FILE_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SSP_FILE_SRC))
+
+typedef struct _GstSspFileSrc      GstSspFileSrc;
+typedef struct _GstSspFileSrcClass GstSspFileSrcClass;
+
+typedef enum {
+  GST_SSP_FILE_SRC_PACE_RECORDED = 0,
+  GST_SSP_FILE_SRC_PACE_FAST = 1
+} GstSspFileSrcPace;
+
+/* sspsrc fed from a capture-location file instead of a camera */
+struct _GstSspFileSrc
+{
+  GstSspSrc parent;
+
+  gchar *location;
+  GstSspFileSrcPace pace;
+  gboolean loop;
+};
+
+struct _GstSspFileSrcClass
+{
+  GstSspSrcClass parent_class;
+};
+
+GType gst_ssp_file_src_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_SSP_FILE_SRC_H__ */
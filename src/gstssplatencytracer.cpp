@@ -0,0 +1,299 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstssplatencytracer.h"
+#include "gstsspmeta.h"
+#include "gstsspsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_ssp_latency_tracer_debug);
+#define GST_CAT_DEFAULT gst_ssp_latency_tracer_debug
+
+/* Power of two buckets in microseconds: below 1 us, below 2 us, ... below
+ * 2^23 us (8.4 s), the last one takes everything slower */
+#define SSP_LATENCY_BUCKETS 25
+
+typedef enum {
+  SSP_LATENCY_CAMERA,         /* capture to received */
+  SSP_LATENCY_INGEST,         /* received to enqueued */
+  SSP_LATENCY_QUEUE,          /* enqueued to dequeued */
+  SSP_LATENCY_PUSH,           /* dequeued to pushed */
+  SSP_LATENCY_DOWNSTREAM,     /* pushed to a sink */
+  SSP_LATENCY_TOTAL,          /* received to a sink */
+  SSP_LATENCY_STAGES
+} SspLatencyStage;
+
+static const gchar *stage_names[SSP_LATENCY_STAGES] = {
+  "camera", "ingest", "queue", "push", "downstream", "total"
+};
+
+typedef struct {
+  guint64 count;
+  guint64 sum;
+  guint64 max;
+  guint64 buckets[SSP_LATENCY_BUCKETS];
+} SspLatencyHistogram;
+
+typedef struct {
+  GQuark origin;
+  SspLatencyHistogram stages[SSP_LATENCY_STAGES];
+} SspLatencyOrigin;
+
+struct _GstSspLatencyTracer
+{
+  GstTracer parent;
+
+  GMutex lock;
+  GHashTable *origins;        /* GQuark origin -> SspLatencyOrigin */
+  GstClockTime interval;      /* histogram dump period, 0 = at exit only */
+  GstClockTime last_dump;
+};
+
+struct _GstSspLatencyTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+static GstTracerRecord *tr_latency;
+static GstTracerRecord *tr_histogram;
+static gint active_tracers = 0;
+
+#define gst_ssp_latency_tracer_parent_class parent_class
+G_DEFINE_TYPE (GstSspLatencyTracer, gst_ssp_latency_tracer, GST_TYPE_TRACER);
+
+gboolean
+gst_ssp_latency_tracer_is_active (void)
+{
+  return g_atomic_int_get (&active_tracers) > 0;
+}
+
+static guint
+latency_to_bucket (GstClockTime latency)
+{
+  guint64 us = latency / GST_USECOND;
+  guint bucket = us ? g_bit_storage (us) : 0;
+
+  return MIN (bucket, SSP_LATENCY_BUCKETS - 1);
+}
+
+/* One record per origin and stage: count, mean and max in ns and the
+ * non-empty buckets as upper-bound:count pairs, e.g. 512us:40/1024us:3 */
+static void
+dump_histograms_locked (GstSspLatencyTracer * self)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint i, b;
+
+  g_hash_table_iter_init (&iter, self->origins);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    SspLatencyOrigin *origin = (SspLatencyOrigin *) value;
+
+    for (i = 0; i < SSP_LATENCY_STAGES; i++) {
+      SspLatencyHistogram *h = &origin->stages[i];
+      GString *buckets;
+
+      if (h->count == 0)
+        continue;
+
+      buckets = g_string_new (NULL);
+      for (b = 0; b < SSP_LATENCY_BUCKETS; b++) {
+        if (h->buckets[b] == 0)
+          continue;
+        if (buckets->len)
+          g_string_append_c (buckets, '/');
+        if (b == SSP_LATENCY_BUCKETS - 1)
+          g_string_append_printf (buckets, "more:%" G_GUINT64_FORMAT,
+              h->buckets[b]);
+        else
+          g_string_append_printf (buckets, "%" G_GUINT64_FORMAT "us:%"
+              G_GUINT64_FORMAT, G_GUINT64_CONSTANT (1) << b, h->buckets[b]);
+      }
+
+      gst_tracer_record_log (tr_histogram, g_quark_to_string (origin->origin),
+          stage_names[i], h->count, h->sum / h->count, h->max, buckets->str);
+      g_string_free (buckets, TRUE);
+    }
+  }
+}
+
+static void
+log_stage (GstSspLatencyTracer * self, GQuark origin, SspLatencyStage stage,
+    GstClockTime from, GstClockTime to)
+{
+  SspLatencyOrigin *entry;
+  SspLatencyHistogram *h;
+  GstClockTime latency;
+
+  /* Unset, or a camera clock running ahead of ours */
+  if (!GST_CLOCK_TIME_IS_VALID (from) || !GST_CLOCK_TIME_IS_VALID (to) ||
+      to < from)
+    return;
+
+  latency = to - from;
+  gst_tracer_record_log (tr_latency, g_quark_to_string (origin),
+      stage_names[stage], latency);
+
+  g_mutex_lock (&self->lock);
+  entry = (SspLatencyOrigin *) g_hash_table_lookup (self->origins,
+      GUINT_TO_POINTER (origin));
+  if (!entry) {
+    entry = g_new0 (SspLatencyOrigin, 1);
+    entry->origin = origin;
+    g_hash_table_insert (self->origins, GUINT_TO_POINTER (origin), entry);
+  }
+  h = &entry->stages[stage];
+  h->count++;
+  h->sum += latency;
+  h->max = MAX (h->max, latency);
+  h->buckets[latency_to_bucket (latency)]++;
+
+  if (self->interval && to - self->last_dump >= self->interval) {
+    dump_histograms_locked (self);
+    self->last_dump = to;
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+/* Leaving sspsrc closes the element's own stages, entering a sink the
+ * downstream ones; a sspsrc linked straight to a sink does both */
+static void
+do_push_buffer_pre (GstTracer * tracer, GstClockTime ts, GstPad * pad,
+    GstBuffer * buffer)
+{
+  GstSspLatencyTracer *self = GST_SSP_LATENCY_TRACER (tracer);
+  GstSspIngestMeta *meta = gst_buffer_get_ssp_ingest_meta (buffer);
+  GstObject *parent;
+  GstPad *peer;
+  GstClockTime now;
+
+  if (!meta)
+    return;
+
+  now = gst_util_get_timestamp ();
+
+  parent = GST_OBJECT_PARENT (pad);
+  if (parent && GST_IS_SSP_SRC (parent)) {
+    log_stage (self, meta->origin, SSP_LATENCY_CAMERA, meta->capture,
+        meta->received);
+    log_stage (self, meta->origin, SSP_LATENCY_INGEST, meta->received,
+        meta->enqueued);
+    log_stage (self, meta->origin, SSP_LATENCY_QUEUE, meta->enqueued,
+        meta->dequeued);
+    log_stage (self, meta->origin, SSP_LATENCY_PUSH, meta->dequeued, now);
+  }
+
+  /* Bins carry the sink flag of their children, count the real sink only */
+  peer = GST_PAD_PEER (pad);
+  parent = peer ? GST_OBJECT_PARENT (peer) : NULL;
+  if (parent && GST_IS_ELEMENT (parent) && !GST_IS_BIN (parent) &&
+      GST_OBJECT_FLAG_IS_SET (parent, GST_ELEMENT_FLAG_SINK)) {
+    log_stage (self, meta->origin, SSP_LATENCY_DOWNSTREAM, meta->pushed, now);
+    log_stage (self, meta->origin, SSP_LATENCY_TOTAL, meta->received, now);
+  }
+}
+
+static void
+gst_ssp_latency_tracer_constructed (GObject * object)
+{
+  GstSspLatencyTracer *self = GST_SSP_LATENCY_TRACER (object);
+  gchar *params, *tmp;
+  GstStructure *s;
+  gint interval;
+
+  g_object_get (object, "params", &params, NULL);
+  if (params) {
+    tmp = g_strdup_printf ("sspsrc-latency,%s", params);
+    s = gst_structure_from_string (tmp, NULL);
+    if (!s)
+      GST_WARNING_OBJECT (self, "Cannot parse params '%s'", params);
+    else if (gst_structure_get_int (s, "interval", &interval) && interval > 0)
+      self->interval = interval * GST_SECOND;
+    if (s)
+      gst_structure_free (s);
+    g_free (tmp);
+    g_free (params);
+  }
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gst_ssp_latency_tracer_finalize (GObject * object)
+{
+  GstSspLatencyTracer *self = GST_SSP_LATENCY_TRACER (object);
+
+  g_atomic_int_add (&active_tracers, -1);
+
+  g_mutex_lock (&self->lock);
+  dump_histograms_locked (self);
+  g_mutex_unlock (&self->lock);
+
+  g_hash_table_destroy (self->origins);
+  g_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ssp_latency_tracer_class_init (GstSspLatencyTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_ssp_latency_tracer_constructed;
+  gobject_class->finalize = gst_ssp_latency_tracer_finalize;
+
+  GST_DEBUG_CATEGORY_INIT (gst_ssp_latency_tracer_debug, "sspsrc-latency", 0,
+      "sspsrc per-stage latency tracer");
+
+  tr_latency = gst_tracer_record_new ("sspsrc-latency.class",
+      "origin", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING, "sspsrc element and stream", NULL),
+      "stage", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING,
+          "camera, ingest, queue, push, downstream or total", NULL),
+      "time", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "time spent in the stage in ns",
+          "min", G_TYPE_UINT64, G_GUINT64_CONSTANT (0),
+          "max", G_TYPE_UINT64, G_MAXUINT64, NULL), NULL);
+  GST_OBJECT_FLAG_SET (tr_latency, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+
+  tr_histogram = gst_tracer_record_new ("sspsrc-latency-histogram.class",
+      "origin", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING, "sspsrc element and stream", NULL),
+      "stage", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING, "latency stage", NULL),
+      "count", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "frames measured", NULL),
+      "mean", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "mean time in ns", NULL),
+      "max", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+          "description", G_TYPE_STRING, "maximum time in ns", NULL),
+      "buckets", gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING,
+          "upper-bound:count pairs separated by /", NULL), NULL);
+  GST_OBJECT_FLAG_SET (tr_histogram, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void
+gst_ssp_latency_tracer_init (GstSspLatencyTracer * self)
+{
+  g_mutex_init (&self->lock);
+  self->origins = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  self->interval = 0;
+  self->last_dump = gst_util_get_timestamp ();
+
+  gst_tracing_register_hook (GST_TRACER (self), "pad-push-pre",
+      G_CALLBACK (do_push_buffer_pre));
+
+  g_atomic_int_inc (&active_tracers);
+}
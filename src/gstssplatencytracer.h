@@ -0,0 +1,26 @@
+#ifndef __GST_SSP_LATENCY_TRACER_H__
+#define __GST_SSP_LATENCY_TRACER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_SSP_LATENCY_TRACER \
+  (gst_ssp_latency_tracer_get_type())
+#define GST_SSP_LATENCY_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SSP_LATENCY_TRACER,GstSspLatencyTracer))
+#define GST_IS_SSP_LATENCY_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SSP_LATENCY_TRACER))
+
+typedef struct _GstSspLatencyTracer      GstSspLatencyTracer;
+typedef struct _GstSspLatencyTracerClass GstSspLatencyTracerClass;
+
+GType gst_ssp_latency_tracer_get_type (void);
+
+/* Whether an sspsrc-latency tracer is loaded. sspsrc then stamps every
+ * frame with a GstSspIngestMeta. */
+gboolean gst_ssp_latency_tracer_is_active (void);
+
+G_END_DECLS
+
+#endif /* __GST_SSP_LATENCY_TRACER_H__ */
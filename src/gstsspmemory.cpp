@@ -0,0 +1,365 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsspmemory.h"
+
+#include <atomic>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (gst_ssp_memory_debug);
+#define GST_CAT_DEFAULT gst_ssp_memory_debug
+
+/* Backing blocks are rounded up to a power of two between 4 KiB and 64 MiB
+ * and recycled through per-class free lists. Larger requests bypass the
+ * pool. */
+#define SSP_POOL_MIN_SHIFT 12
+#define SSP_POOL_MAX_SHIFT 26
+#define SSP_POOL_CLASSES (SSP_POOL_MAX_SHIFT - SSP_POOL_MIN_SHIFT + 1)
+#define SSP_POOL_MAX_FREE_PER_CLASS 8
+#define SSP_POOL_NO_CLASS ((guint) -1)
+
+struct _GstSspAllocator
+{
+  GstAllocator parent;
+
+  GMutex lock;
+  gpointer free_blocks[SSP_POOL_CLASSES];   /* intrusive singly-linked lists */
+  guint n_free[SSP_POOL_CLASSES];
+};
+
+struct _GstSspAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+typedef struct
+{
+  GstMemory mem;
+
+  guint8 *data;          /* payload: borrowed region or inside block */
+  guint8 *block;         /* pooled backing block, NULL when borrowed or shared */
+  guint size_class;
+  gboolean borrowed;
+} GstSspMemory;
+
+static std::atomic<guint64> stat_borrowed (0);
+static std::atomic<guint64> stat_released (0);
+static std::atomic<guint64> stat_copies (0);
+static std::atomic<guint64> stat_copied_bytes (0);
+static std::atomic<guint64> stat_allocs (0);
+static std::atomic<guint64> stat_reuses (0);
+
+#define gst_ssp_allocator_parent_class parent_class
+G_DEFINE_TYPE (GstSspAllocator, gst_ssp_allocator, GST_TYPE_ALLOCATOR);
+
+static guint
+size_to_class (gsize size)
+{
+  guint shift = SSP_POOL_MIN_SHIFT;
+
+  while (shift <= SSP_POOL_MAX_SHIFT && ((gsize) 1 << shift) < size)
+    shift++;
+
+  return shift <= SSP_POOL_MAX_SHIFT ? shift - SSP_POOL_MIN_SHIFT : SSP_POOL_NO_CLASS;
+}
+
+static guint8 *
+pool_acquire (GstSspAllocator * alloc, gsize size, guint * size_class)
+{
+  guint cls = size_to_class (size);
+  guint8 *block = NULL;
+
+  *size_class = cls;
+
+  if (cls == SSP_POOL_NO_CLASS) {
+    stat_allocs.fetch_add (1, std::memory_order_relaxed);
+    return (guint8 *) g_malloc (size);
+  }
+
+  g_mutex_lock (&alloc->lock);
+  if (alloc->free_blocks[cls]) {
+    block = (guint8 *) alloc->free_blocks[cls];
+    alloc->free_blocks[cls] = *(gpointer *) block;
+    alloc->n_free[cls]--;
+  }
+  g_mutex_unlock (&alloc->lock);
+
+  if (block) {
+    stat_reuses.fetch_add (1, std::memory_order_relaxed);
+    return block;
+  }
+
+  stat_allocs.fetch_add (1, std::memory_order_relaxed);
+  return (guint8 *) g_malloc ((gsize) 1 << (cls + SSP_POOL_MIN_SHIFT));
+}
+
+static void
+pool_release (GstSspAllocator * alloc, guint8 * block, guint cls)
+{
+  if (cls == SSP_POOL_NO_CLASS) {
+    g_free (block);
+    return;
+  }
+
+  g_mutex_lock (&alloc->lock);
+  if (alloc->n_free[cls] < SSP_POOL_MAX_FREE_PER_CLASS) {
+    *(gpointer *) block = alloc->free_blocks[cls];
+    alloc->free_blocks[cls] = block;
+    alloc->n_free[cls]++;
+    block = NULL;
+  }
+  g_mutex_unlock (&alloc->lock);
+
+  g_free (block);
+}
+
+static GstSspMemory *
+ssp_memory_new_block (GstAllocator * allocator, GstMemoryFlags flags,
+    gsize maxsize, gsize align, gsize offset, gsize size)
+{
+  GstSspMemory *mem;
+  gsize aoffset;
+
+  mem = g_slice_new (GstSspMemory);
+  mem->block = pool_acquire (GST_SSP_ALLOCATOR (allocator), maxsize + align,
+      &mem->size_class);
+  mem->data = mem->block;
+  mem->borrowed = FALSE;
+
+  if ((aoffset = ((guintptr) mem->data & align))) {
+    aoffset = (align + 1) - aoffset;
+    mem->data += aoffset;
+  }
+
+  gst_memory_init (GST_MEMORY_CAST (mem), flags, allocator, NULL, maxsize,
+      align, offset, size);
+
+  return mem;
+}
+
+static GstMemory *
+gst_ssp_allocator_alloc (GstAllocator * allocator, gsize size,
+    GstAllocationParams * params)
+{
+  gsize maxsize = size + params->prefix + params->padding;
+
+  return GST_MEMORY_CAST (ssp_memory_new_block (allocator, params->flags,
+          maxsize, params->align, params->prefix, size));
+}
+
+static void
+gst_ssp_allocator_free (GstAllocator * allocator, GstMemory * memory)
+{
+  GstSspMemory *mem = (GstSspMemory *) memory;
+
+  if (mem->block)
+    pool_release (GST_SSP_ALLOCATOR (allocator), mem->block, mem->size_class);
+
+  g_slice_free (GstSspMemory, mem);
+}
+
+static gpointer
+gst_ssp_memory_map (GstMemory * memory, gsize maxsize, GstMapFlags flags)
+{
+  GstSspMemory *mem = (GstSspMemory *) memory;
+
+  /* A borrowed memory that has been detached has no payload any more */
+  return mem->data;
+}
+
+static void
+gst_ssp_memory_unmap (GstMemory * memory)
+{
+}
+
+static GstMemory *
+gst_ssp_memory_share (GstMemory * memory, gssize offset, gssize size)
+{
+  GstSspMemory *mem = (GstSspMemory *) memory;
+  GstSspMemory *sub;
+  GstMemory *parent;
+
+  /* Borrowed memories carry GST_MEMORY_FLAG_NO_SHARE so this is only ever
+   * reached once the payload is owned */
+  g_return_val_if_fail (!mem->borrowed, NULL);
+
+  if (size == -1)
+    size = memory->size - offset;
+
+  if ((parent = memory->parent) == NULL)
+    parent = memory;
+
+  sub = g_slice_new (GstSspMemory);
+  sub->data = mem->data;
+  sub->block = NULL;
+  sub->size_class = SSP_POOL_NO_CLASS;
+  sub->borrowed = FALSE;
+
+  gst_memory_init (GST_MEMORY_CAST (sub),
+      (GstMemoryFlags) (GST_MINI_OBJECT_FLAGS (parent) |
+          GST_MINI_OBJECT_FLAG_LOCK_READONLY), memory->allocator, parent,
+      memory->maxsize, memory->align, memory->offset + offset, size);
+
+  return GST_MEMORY_CAST (sub);
+}
+
+static gboolean
+gst_ssp_memory_is_span (GstMemory * mem1, GstMemory * mem2, gsize * offset)
+{
+  GstSspMemory *m1 = (GstSspMemory *) mem1;
+  GstSspMemory *m2 = (GstSspMemory *) mem2;
+
+  if (m1->data != m2->data)
+    return FALSE;
+
+  if (offset)
+    *offset = mem1->offset - (mem1->parent ? mem1->parent->offset : 0);
+
+  return mem1->offset + mem1->size == mem2->offset;
+}
+
+static void
+gst_ssp_allocator_finalize (GObject * object)
+{
+  GstSspAllocator *alloc = GST_SSP_ALLOCATOR (object);
+  guint i;
+
+  for (i = 0; i < SSP_POOL_CLASSES; i++) {
+    while (alloc->free_blocks[i]) {
+      gpointer block = alloc->free_blocks[i];
+      alloc->free_blocks[i] = *(gpointer *) block;
+      g_free (block);
+    }
+  }
+  g_mutex_clear (&alloc->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_ssp_allocator_class_init (GstSspAllocatorClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstAllocatorClass *allocator_class = (GstAllocatorClass *) klass;
+
+  gobject_class->finalize = gst_ssp_allocator_finalize;
+
+  allocator_class->alloc = gst_ssp_allocator_alloc;
+  allocator_class->free = gst_ssp_allocator_free;
+
+  GST_DEBUG_CATEGORY_INIT (gst_ssp_memory_debug, "sspmemory", 0,
+      "SSP zero-copy memory");
+}
+
+static void
+gst_ssp_allocator_init (GstSspAllocator * alloc)
+{
+  GstAllocator *allocator = GST_ALLOCATOR_CAST (alloc);
+
+  allocator->mem_type = GST_SSP_MEMORY_TYPE;
+  allocator->mem_map = gst_ssp_memory_map;
+  allocator->mem_unmap = gst_ssp_memory_unmap;
+  allocator->mem_share = gst_ssp_memory_share;
+  allocator->mem_is_span = gst_ssp_memory_is_span;
+
+  GST_OBJECT_FLAG_SET (alloc, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+
+  g_mutex_init (&alloc->lock);
+  memset (alloc->free_blocks, 0, sizeof (alloc->free_blocks));
+  memset (alloc->n_free, 0, sizeof (alloc->n_free));
+}
+
+GstAllocator *
+gst_ssp_allocator_get (void)
+{
+  static GstAllocator *allocator = NULL;
+
+  if (g_once_init_enter (&allocator)) {
+    GstAllocator *a = (GstAllocator *) g_object_new (GST_TYPE_SSP_ALLOCATOR, NULL);
+    gst_object_ref_sink (a);
+    GST_OBJECT_FLAG_SET (a, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+    g_once_init_leave (&allocator, a);
+  }
+
+  return allocator;
+}
+
+GstMemory *
+gst_ssp_memory_new_borrowed (const guint8 * data, gsize size)
+{
+  GstSspMemory *mem;
+
+  mem = g_slice_new (GstSspMemory);
+  mem->data = (guint8 *) data;
+  mem->block = NULL;
+  mem->size_class = SSP_POOL_NO_CLASS;
+  mem->borrowed = TRUE;
+
+  gst_memory_init (GST_MEMORY_CAST (mem),
+      (GstMemoryFlags) (GST_MEMORY_FLAG_READONLY | GST_MEMORY_FLAG_NO_SHARE),
+      gst_ssp_allocator_get (), NULL, size, 0, 0, size);
+
+  stat_borrowed.fetch_add (1, std::memory_order_relaxed);
+
+  return GST_MEMORY_CAST (mem);
+}
+
+GstMemory *
+gst_ssp_memory_new (gsize size)
+{
+  return GST_MEMORY_CAST (ssp_memory_new_block (gst_ssp_allocator_get (),
+          (GstMemoryFlags) 0, size, 0, 0, size));
+}
+
+gboolean
+gst_ssp_memory_is_borrowed (GstMemory * mem)
+{
+  g_return_val_if_fail (mem != NULL, FALSE);
+
+  return mem->allocator == gst_ssp_allocator_get () &&
+      ((GstSspMemory *) mem)->borrowed;
+}
+
+void
+gst_ssp_memory_reclaim (GstMemory * memory)
+{
+  GstSspMemory *mem = (GstSspMemory *) memory;
+
+  if (!gst_ssp_memory_is_borrowed (memory))
+    return;
+
+  mem->borrowed = FALSE;
+
+  if (GST_MINI_OBJECT_REFCOUNT_VALUE (memory) <= 1) {
+    /* Only the producer still holds it, nobody will map it again */
+    mem->data = NULL;
+    stat_released.fetch_add (1, std::memory_order_relaxed);
+    return;
+  }
+
+  mem->block = pool_acquire (GST_SSP_ALLOCATOR (memory->allocator),
+      memory->maxsize, &mem->size_class);
+  memcpy (mem->block, mem->data, memory->maxsize);
+  mem->data = mem->block;
+
+  GST_MINI_OBJECT_FLAG_UNSET (memory, GST_MEMORY_FLAG_NO_SHARE);
+
+  stat_copies.fetch_add (1, std::memory_order_relaxed);
+  stat_copied_bytes.fetch_add (memory->maxsize, std::memory_order_relaxed);
+
+  GST_LOG ("reclaimed %" G_GSIZE_FORMAT " bytes by copy", memory->maxsize);
+}
+
+void
+gst_ssp_allocator_get_stats (GstSspAllocatorStats * stats)
+{
+  g_return_if_fail (stats != NULL);
+
+  stats->borrowed = stat_borrowed.load (std::memory_order_relaxed);
+  stats->released = stat_released.load (std::memory_order_relaxed);
+  stats->copies = stat_copies.load (std::memory_order_relaxed);
+  stats->copied_bytes = stat_copied_bytes.load (std::memory_order_relaxed);
+  stats->allocs = stat_allocs.load (std::memory_order_relaxed);
+  stats->reuses = stat_reuses.load (std::memory_order_relaxed);
+}
@@ -0,0 +1,55 @@
+#ifndef __GST_SSP_MEMORY_H__
+#define __GST_SSP_MEMORY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_SSP_MEMORY_TYPE "SspMemory"
+
+#define GST_TYPE_SSP_ALLOCATOR \
+  (gst_ssp_allocator_get_type())
+#define GST_SSP_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_SSP_ALLOCATOR,GstSspAllocator))
+#define GST_IS_SSP_ALLOCATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SSP_ALLOCATOR))
+
+typedef struct _GstSspAllocator      GstSspAllocator;
+typedef struct _GstSspAllocatorClass GstSspAllocatorClass;
+
+/* Process-wide counters, all monotonic */
+typedef struct {
+  guint64 borrowed;       /* memories wrapping a receive region without copying */
+  guint64 released;       /* borrowed memories dropped before the region was reclaimed */
+  guint64 copies;         /* fallback copies because the region had to be reclaimed */
+  guint64 copied_bytes;
+  guint64 allocs;         /* backing blocks allocated from the heap */
+  guint64 reuses;         /* backing blocks served from the free list */
+} GstSspAllocatorStats;
+
+GType gst_ssp_allocator_get_type (void);
+
+/* transfer none, the allocator lives for the whole process */
+GstAllocator * gst_ssp_allocator_get (void);
+
+/* Wrap @data without copying. The memory is only valid until
+ * gst_ssp_memory_reclaim() is called on it, which must happen before the
+ * owner of @data reuses the region and before the memory is handed to
+ * another thread. */
+GstMemory * gst_ssp_memory_new_borrowed (const guint8 * data, gsize size);
+
+/* Allocate a pooled memory of @size bytes, contents undefined */
+GstMemory * gst_ssp_memory_new (gsize size);
+
+gboolean gst_ssp_memory_is_borrowed (GstMemory * mem);
+
+/* The region behind a borrowed memory is about to be reused. If anyone
+ * else still holds a reference the payload is copied into a pooled block,
+ * otherwise the memory is simply detached. No-op for owned memory. */
+void gst_ssp_memory_reclaim (GstMemory * mem);
+
+void gst_ssp_allocator_get_stats (GstSspAllocatorStats * stats);
+
+G_END_DECLS
+
+#endif /* __GST_SSP_MEMORY_H__ */
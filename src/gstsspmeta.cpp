@@ -0,0 +1,157 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsspmeta.h"
+
+GType
+gst_ssp_ingest_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstSspIngestMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static gboolean
+gst_ssp_ingest_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  GstSspIngestMeta *imeta = (GstSspIngestMeta *) meta;
+
+  imeta->origin = 0;
+  imeta->capture = GST_CLOCK_TIME_NONE;
+  imeta->received = GST_CLOCK_TIME_NONE;
+  imeta->enqueued = GST_CLOCK_TIME_NONE;
+  imeta->dequeued = GST_CLOCK_TIME_NONE;
+  imeta->pushed = GST_CLOCK_TIME_NONE;
+
+  return TRUE;
+}
+
+/* The stamps describe the frame, not its memory: every copy keeps them */
+static gboolean
+gst_ssp_ingest_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstSspIngestMeta *smeta = (GstSspIngestMeta *) meta;
+  GstSspIngestMeta *dmeta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  dmeta = gst_buffer_add_ssp_ingest_meta (dest, smeta->origin);
+  if (!dmeta)
+    return FALSE;
+
+  dmeta->capture = smeta->capture;
+  dmeta->received = smeta->received;
+  dmeta->enqueued = smeta->enqueued;
+  dmeta->dequeued = smeta->dequeued;
+  dmeta->pushed = smeta->pushed;
+
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_ssp_ingest_meta_get_info (void)
+{
+  static gsize meta_info = 0;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_SSP_INGEST_META_API_TYPE,
+        "GstSspIngestMeta", sizeof (GstSspIngestMeta),
+        gst_ssp_ingest_meta_init, NULL, gst_ssp_ingest_meta_transform);
+    g_once_init_leave (&meta_info, (gsize) mi);
+  }
+  return (const GstMetaInfo *) meta_info;
+}
+
+GstSspIngestMeta *
+gst_buffer_add_ssp_ingest_meta (GstBuffer * buffer, GQuark origin)
+{
+  GstSspIngestMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = (GstSspIngestMeta *) gst_buffer_add_meta (buffer,
+      GST_SSP_INGEST_META_INFO, NULL);
+  if (meta)
+    meta->origin = origin;
+
+  return meta;
+}
+
+GType
+gst_ssp_caps_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstSspCapsMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static gboolean
+gst_ssp_caps_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  ((GstSspCapsMeta *) meta)->caps = NULL;
+
+  return TRUE;
+}
+
+static void
+gst_ssp_caps_meta_free (GstMeta * meta, GstBuffer * buffer)
+{
+  gst_caps_replace (&((GstSspCapsMeta *) meta)->caps, NULL);
+}
+
+/* Replays from the GOP cache are copies, their keyframe keeps its caps */
+static gboolean
+gst_ssp_caps_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstSspCapsMeta *smeta = (GstSspCapsMeta *) meta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  return gst_buffer_add_ssp_caps_meta (dest, smeta->caps) != NULL;
+}
+
+const GstMetaInfo *
+gst_ssp_caps_meta_get_info (void)
+{
+  static gsize meta_info = 0;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_SSP_CAPS_META_API_TYPE,
+        "GstSspCapsMeta", sizeof (GstSspCapsMeta),
+        gst_ssp_caps_meta_init, gst_ssp_caps_meta_free,
+        gst_ssp_caps_meta_transform);
+    g_once_init_leave (&meta_info, (gsize) mi);
+  }
+  return (const GstMetaInfo *) meta_info;
+}
+
+GstSspCapsMeta *
+gst_buffer_add_ssp_caps_meta (GstBuffer * buffer, GstCaps * caps)
+{
+  GstSspCapsMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (GST_IS_CAPS (caps), NULL);
+
+  meta = (GstSspCapsMeta *) gst_buffer_add_meta (buffer,
+      GST_SSP_CAPS_META_INFO, NULL);
+  if (meta)
+    meta->caps = gst_caps_ref (caps);
+
+  return meta;
+}
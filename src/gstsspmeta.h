@@ -0,0 +1,67 @@
+#ifndef __GST_SSP_META_H__
+#define __GST_SSP_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_SSP_INGEST_META_API_TYPE (gst_ssp_ingest_meta_api_get_type())
+#define GST_SSP_INGEST_META_INFO (gst_ssp_ingest_meta_get_info())
+
+typedef struct _GstSspIngestMeta GstSspIngestMeta;
+
+/* Where a frame was on its way through sspsrc. All times are
+ * gst_util_get_timestamp() values of this process, GST_CLOCK_TIME_NONE when
+ * the frame has not reached that point. The meta has no tags, so elements
+ * that copy untagged metas carry it downstream. */
+struct _GstSspIngestMeta
+{
+  GstMeta meta;
+
+  GQuark origin;              /* "<element>/video" or "<element>/audio" */
+  GstClockTime capture;       /* from the camera's wall-clock NTP time, only
+                               * meaningful when both clocks are synchronized */
+  GstClockTime received;      /* libssp callback entry */
+  GstClockTime enqueued;      /* handed to the streaming thread's queue */
+  GstClockTime dequeued;      /* taken by the streaming thread */
+  GstClockTime pushed;        /* leaving the element */
+};
+
+GType gst_ssp_ingest_meta_api_get_type (void);
+const GstMetaInfo * gst_ssp_ingest_meta_get_info (void);
+
+#define gst_buffer_get_ssp_ingest_meta(b) \
+  ((GstSspIngestMeta *) gst_buffer_get_meta ((b), GST_SSP_INGEST_META_API_TYPE))
+
+/* All times start out as GST_CLOCK_TIME_NONE */
+GstSspIngestMeta * gst_buffer_add_ssp_ingest_meta (GstBuffer * buffer,
+    GQuark origin);
+
+#define GST_SSP_CAPS_META_API_TYPE (gst_ssp_caps_meta_api_get_type())
+#define GST_SSP_CAPS_META_INFO (gst_ssp_caps_meta_get_info())
+
+typedef struct _GstSspCapsMeta GstSspCapsMeta;
+
+/* The caps a video keyframe and the frames after it need, carried through
+ * sspsrc's queue so they are set when this frame leaves and not when the
+ * loop thread built them. Internal to sspsrc, removed before the push. */
+struct _GstSspCapsMeta
+{
+  GstMeta meta;
+
+  GstCaps *caps;
+};
+
+GType gst_ssp_caps_meta_api_get_type (void);
+const GstMetaInfo * gst_ssp_caps_meta_get_info (void);
+
+#define gst_buffer_get_ssp_caps_meta(b) \
+  ((GstSspCapsMeta *) gst_buffer_get_meta ((b), GST_SSP_CAPS_META_API_TYPE))
+
+/* Takes a ref on @caps */
+GstSspCapsMeta * gst_buffer_add_ssp_caps_meta (GstBuffer * buffer,
+    GstCaps * caps);
+
+G_END_DECLS
+
+#endif /* __GST_SSP_META_H__ */
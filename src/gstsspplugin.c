@@ -4,6 +4,8 @@
 
 #include <gst/gst.h>
 #include "gstsspsrc.h"
+#include "gstsspfilesrc.h"
+#include "gstssplatencytracer.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -12,6 +14,16 @@ plugin_init (GstPlugin * plugin)
           GST_TYPE_SSP_SRC))
     return FALSE;
 
+  if (!gst_element_register (plugin, "sspfilesrc", GST_RANK_NONE,
+          GST_TYPE_SSP_FILE_SRC))
+    return FALSE;
+
+#ifndef GST_DISABLE_GST_TRACER_HOOKS
+  if (!gst_tracer_register (plugin, "sspsrc-latency",
+          GST_TYPE_SSP_LATENCY_TRACER))
+    return FALSE;
+#endif
+
   return TRUE;
 }
 
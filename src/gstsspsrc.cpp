@@ -3,12 +3,22 @@
 #endif
 
 #include "gstsspsrc.h"
+#include "gstsspmemory.h"
+#include "gstsspmeta.h"
+#include "gstssplatencytracer.h"
+#include "sspcapture.h"
+#include "sspgopcache.h"
+#include "sspparamsets.h"
+#include "sspring.h"
+#include "sspsched.h"
+#include "sspstats.h"
 #include "sspthread.h"
+#include "ssptimestamp.h"
 
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 #include <gst/video/video.h>
-#include <unistd.h>
+#include <string.h>
 #include <gst/audio/audio.h>
 
 GST_DEBUG_CATEGORY_STATIC (gst_ssp_src_debug);
@@ -30,7 +40,39 @@ enum
   PROP_MODE,
   PROP_BUFFER_SIZE,
   PROP_CAPABILITY,
-  PROP_IS_HLG
+  PROP_IS_HLG,
+  PROP_MAX_QUEUE_FRAMES,
+  PROP_MAX_QUEUE_BYTES,
+  PROP_MAX_QUEUE_TIME,
+  PROP_TIMESTAMP_MODE,
+  PROP_TIMECODE_FORMAT,
+  PROP_STREAM_FORMAT,
+  PROP_OVERFLOW_POLICY,
+  PROP_CONNECT_TIMEOUT,
+  PROP_META_TIMEOUT,
+  PROP_FIRST_FRAME_TIMEOUT,
+  PROP_SOCKET_BUFFER_SIZE,
+  PROP_LOW_LATENCY,
+  PROP_RECEIVE_INFO,
+  PROP_RECONNECT,
+  PROP_RECONNECT_DELAY,
+  PROP_RECONNECT_MAX_DELAY,
+  PROP_RECONNECT_ATTEMPTS,
+  PROP_STALL_FRAMES,
+  PROP_GOP_CACHE_SIZE,
+  PROP_GOP_REPLAY,
+  PROP_LOOP_THREADS,
+  PROP_LOOP_STATS,
+  PROP_LOOP_CPUS,
+  PROP_STREAMING_CPUS,
+  PROP_SCHED_POLICY,
+  PROP_SCHED_PRIORITY,
+  PROP_NICE,
+  PROP_THREAD_INFO,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
+  PROP_INGEST_META,
+  PROP_CAPTURE_LOCATION
 };
 
 #define DEFAULT_IP "192.168.1.100"
@@ -40,22 +82,58 @@ enum
 #define DEFAULT_BUFFER_SIZE 0x400000
 #define DEFAULT_CAPABILITY 0
 #define DEFAULT_IS_HLG FALSE
+#define DEFAULT_MAX_QUEUE_FRAMES 256
+#define DEFAULT_MAX_QUEUE_BYTES (256 * 1024 * 1024)
+#define DEFAULT_MAX_QUEUE_TIME 0
+#define DEFAULT_TIMESTAMP_MODE GST_SSP_TIMESTAMP_CAMERA
+#define DEFAULT_TIMECODE_FORMAT GST_SSP_TIMECODE_BCD
+#define DEFAULT_STREAM_FORMAT GST_SSP_STREAM_FORMAT_BYTE_STREAM
+#define DEFAULT_OVERFLOW_POLICY GST_SSP_OVERFLOW_DROP_TO_KEYFRAME
+#define DEFAULT_CONNECT_TIMEOUT (10 * GST_SECOND)
+#define DEFAULT_META_TIMEOUT (10 * GST_SECOND)
+#define DEFAULT_FIRST_FRAME_TIMEOUT (10 * GST_SECOND)
+#define DEFAULT_SOCKET_BUFFER_SIZE 0
+#define DEFAULT_LOW_LATENCY FALSE
+#define DEFAULT_RECONNECT TRUE
+#define DEFAULT_RECONNECT_DELAY (500 * GST_MSECOND)
+#define DEFAULT_RECONNECT_MAX_DELAY (10 * GST_SECOND)
+#define DEFAULT_RECONNECT_ATTEMPTS 0
+#define DEFAULT_STALL_FRAMES 15
+#define DEFAULT_GOP_CACHE_SIZE 0
+#define DEFAULT_GOP_REPLAY GST_SSP_GOP_REPLAY_LIVE
+#define DEFAULT_LOOP_THREADS -1
+#define DEFAULT_LOOP_CPUS NULL
+#define DEFAULT_STREAMING_CPUS NULL
+#define DEFAULT_SCHED_POLICY GST_SSP_SCHED_OTHER
+#define DEFAULT_SCHED_PRIORITY 10
+#define DEFAULT_NICE 0
+#define DEFAULT_STATS_INTERVAL 0
+#define DEFAULT_INGEST_META FALSE
+#define DEFAULT_CAPTURE_LOCATION NULL
 
 /* Use encoder types from libssp */
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("video/x-h264, stream-format=byte-stream, alignment=nal; "
-                     "video/x-h265, stream-format=byte-stream, alignment=nal, "
-                     "profile=main, profile=main-10, profile=main-444-10, "
-                     "chroma-format=4:2:0, chroma-format=4:2:2, chroma-format=4:4:4, "
-                     "bit-depth-luma=8, bit-depth-luma=10, bit-depth-luma=12, "
-                     "bit-depth-chroma=8, bit-depth-chroma=10, bit-depth-chroma=12; "
+    GST_STATIC_CAPS ("video/x-h264, stream-format=(string){ byte-stream, avc }, alignment=au; "
+                     "video/x-h265, stream-format=(string){ byte-stream, hvc1 }, alignment=au; "
                      "audio/mpeg, mpegversion=4, stream-format=raw; "
                      "audio/x-raw, format=S16LE, layout=interleaved")
     );
 
+/* In mode=both the always pad carries video and audio gets its own pad */
+static GstStaticPadTemplate audio_template = GST_STATIC_PAD_TEMPLATE ("audio",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("audio/mpeg, mpegversion=4, stream-format=raw; "
+                     "audio/x-raw, format=S16LE, layout=interleaved")
+    );
+
+/* Attached to every buffer that carries a camera NTP time */
+static GstStaticCaps ntp_reference_caps = GST_STATIC_CAPS ("timestamp/x-ntp");
+static GstCaps *ntp_caps = NULL;
+
 #define gst_ssp_src_parent_class parent_class
 G_DEFINE_TYPE (GstSspSrc, gst_ssp_src, GST_TYPE_PUSH_SRC);
 
@@ -65,14 +143,24 @@ static void gst_ssp_src_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static void gst_ssp_src_finalize (GObject * object);
 
+static GstStateChangeReturn gst_ssp_src_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean gst_ssp_src_post_message (GstElement * element,
+    GstMessage * message);
 static gboolean gst_ssp_src_start (GstBaseSrc * basesrc);
 static gboolean gst_ssp_src_stop (GstBaseSrc * basesrc);
 static GstFlowReturn gst_ssp_src_create (GstPushSrc * psrc, GstBuffer ** buf);
 static gboolean gst_ssp_src_unlock (GstBaseSrc * basesrc);
 static gboolean gst_ssp_src_unlock_stop (GstBaseSrc * basesrc);
+static gboolean gst_ssp_src_event (GstBaseSrc * basesrc, GstEvent * event);
 static void gst_ssp_src_get_times (GstBaseSrc * basesrc, GstBuffer * buffer,
     GstClockTime * start, GstClockTime * end);
 
+/* audio pad */
+static void gst_ssp_src_audio_loop (GstPad * pad);
+static gboolean gst_ssp_src_audio_query (GstPad * pad, GstObject * parent,
+    GstQuery * query);
+
 /* SSP callbacks */
 static void on_video_data_cb (SspVideoData data, gpointer user_data);
 static void on_audio_data_cb (SspAudioData data, gpointer user_data);
@@ -80,6 +168,14 @@ static void on_meta_cb (SspVideoMeta video_meta, SspAudioMeta audio_meta, SspMet
 static void on_connected_cb (gpointer user_data);
 static void on_disconnected_cb (gpointer user_data);
 static void on_exception_cb (gint code, const gchar* description, gpointer user_data);
+static void on_buffer_full_cb (gpointer user_data);
+static void on_end_cb (gpointer user_data);
+
+static gboolean gst_ssp_src_default_start_client (GstSspSrc * src);
+static gpointer gst_ssp_src_reconnect_loop (gpointer user_data);
+static void gst_ssp_src_release_streaming_thread (GstSspSrc * src,
+    GThread ** thread, gint * tid, gpointer * sched);
+static void gst_ssp_src_post_element (GstSspSrc * src, GstStructure * s);
 
 /* Stream style enum */
 #define GST_TYPE_SSP_STREAM_STYLE (gst_ssp_stream_style_get_type ())
@@ -119,6 +215,117 @@ gst_ssp_mode_get_type (void)
   return mode_type;
 }
 
+/* Timestamp mode enum */
+#define GST_TYPE_SSP_TIMESTAMP_MODE (gst_ssp_timestamp_mode_get_type ())
+static GType
+gst_ssp_timestamp_mode_get_type (void)
+{
+  static GType timestamp_mode_type = 0;
+  static const GEnumValue timestamp_modes[] = {
+    {GST_SSP_TIMESTAMP_CAMERA, "Camera PTS mapped through the stream timescale", "camera"},
+    {GST_SSP_TIMESTAMP_ARRIVAL, "Local arrival time (fallback)", "arrival"},
+    {GST_SSP_TIMESTAMP_NTP, "Camera NTP time when the camera PTS is wall clock, camera PTS otherwise", "ntp"},
+    {0, NULL, NULL}
+  };
+
+  if (!timestamp_mode_type) {
+    timestamp_mode_type = g_enum_register_static ("GstSspTimestampMode", timestamp_modes);
+  }
+  return timestamp_mode_type;
+}
+
+/* Timecode format enum */
+#define GST_TYPE_SSP_TIMECODE_FORMAT (gst_ssp_timecode_format_get_type ())
+static GType
+gst_ssp_timecode_format_get_type (void)
+{
+  static GType timecode_format_type = 0;
+  static const GEnumValue timecode_formats[] = {
+    {GST_SSP_TIMECODE_BCD, "Two BCD digits per field (SMPTE 12M)", "bcd"},
+    {GST_SSP_TIMECODE_BINARY, "Binary value per field", "binary"},
+    {0, NULL, NULL}
+  };
+
+  if (!timecode_format_type) {
+    timecode_format_type = g_enum_register_static ("GstSspTimecodeFormat", timecode_formats);
+  }
+  return timecode_format_type;
+}
+
+/* Stream format enum */
+#define GST_TYPE_SSP_STREAM_FORMAT (gst_ssp_stream_format_get_type ())
+static GType
+gst_ssp_stream_format_get_type (void)
+{
+  static GType stream_format_type = 0;
+  static const GEnumValue stream_formats[] = {
+    {GST_SSP_STREAM_FORMAT_BYTE_STREAM, "Annex-B byte-stream as sent by the camera", "byte-stream"},
+    {GST_SSP_STREAM_FORMAT_PACKETIZED, "Length-prefixed avc (H.264) or hvc1 (H.265) with codec_data", "packetized"},
+    {0, NULL, NULL}
+  };
+
+  if (!stream_format_type) {
+    stream_format_type = g_enum_register_static ("GstSspStreamFormat", stream_formats);
+  }
+  return stream_format_type;
+}
+
+/* Overflow policy enum */
+#define GST_TYPE_SSP_OVERFLOW_POLICY (gst_ssp_overflow_policy_get_type ())
+static GType
+gst_ssp_overflow_policy_get_type (void)
+{
+  static GType overflow_policy_type = 0;
+  static const GEnumValue overflow_policies[] = {
+    {GST_SSP_OVERFLOW_BLOCK, "Stall the SSP connection until there is room", "block"},
+    {GST_SSP_OVERFLOW_DROP_OLDEST, "Evict the oldest queued frames, up to the next queued keyframe", "drop-oldest"},
+    {GST_SSP_OVERFLOW_DROP_TO_KEYFRAME, "Drop new frames until the next keyframe", "drop-to-keyframe"},
+    {0, NULL, NULL}
+  };
+
+  if (!overflow_policy_type) {
+    overflow_policy_type = g_enum_register_static ("GstSspOverflowPolicy", overflow_policies);
+  }
+  return overflow_policy_type;
+}
+
+/* GOP replay enum */
+#define GST_TYPE_SSP_GOP_REPLAY (gst_ssp_gop_replay_get_type ())
+static GType
+gst_ssp_gop_replay_get_type (void)
+{
+  static GType gop_replay_type = 0;
+  static const GEnumValue gop_replays[] = {
+    {GST_SSP_GOP_REPLAY_ORIGINAL, "Replay with the original timestamps", "original"},
+    {GST_SSP_GOP_REPLAY_LIVE, "Squeeze the replay into the frame interval after the last frame pushed, only its last frame is displayed", "live"},
+    {0, NULL, NULL}
+  };
+
+  if (!gop_replay_type) {
+    gop_replay_type = g_enum_register_static ("GstSspGopReplay", gop_replays);
+  }
+  return gop_replay_type;
+}
+
+/* Scheduling policy enum */
+#define GST_TYPE_SSP_SCHED_POLICY (gst_ssp_sched_policy_get_type ())
+static GType
+gst_ssp_sched_policy_get_type (void)
+{
+  static GType sched_policy_type = 0;
+  static const GEnumValue sched_policies[] = {
+    {GST_SSP_SCHED_OTHER, "Default time-sharing scheduling, adjusted by nice", "other"},
+    {GST_SSP_SCHED_FIFO, "Real-time first-in first-out (SCHED_FIFO)", "fifo"},
+    {GST_SSP_SCHED_RR, "Real-time round-robin (SCHED_RR)", "rr"},
+    {0, NULL, NULL}
+  };
+
+  if (!sched_policy_type) {
+    sched_policy_type = g_enum_register_static ("GstSspSchedPolicy", sched_policies);
+  }
+  return sched_policy_type;
+}
+
 static void
 gst_ssp_src_class_init (GstSspSrcClass * klass)
 {
@@ -158,17 +365,208 @@ gst_ssp_src_class_init (GstSspSrcClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_BUFFER_SIZE,
       g_param_spec_uint ("buffer-size", "Buffer Size",
-          "Receive buffer size", 1024, G_MAXUINT, DEFAULT_BUFFER_SIZE,
+          "Size in bytes of the libssp receive buffer, must hold the largest frame", 1024, G_MAXUINT, DEFAULT_BUFFER_SIZE,
           (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_CAPABILITY,
       g_param_spec_uint ("capability", "Capability",
-          "SSP capability flags", 0, G_MAXUINT32, DEFAULT_CAPABILITY,
+          "SSP capability flags sent to the camera (0 = libssp default)", 0, G_MAXUINT32, DEFAULT_CAPABILITY,
           (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   g_object_class_install_property (gobject_class, PROP_IS_HLG,
       g_param_spec_boolean ("is-hlg", "Is HLG",
-          "Enable HLG mode", DEFAULT_IS_HLG,
+          "Assume HLG colorimetry when the stream does not signal its own", DEFAULT_IS_HLG,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_FRAMES,
+      g_param_spec_uint ("max-queue-frames", "Max Queue Frames",
+          "Maximum number of frames queued per stream between the SSP thread and the streaming thread",
+          1, 65536, DEFAULT_MAX_QUEUE_FRAMES,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_BYTES,
+      g_param_spec_uint64 ("max-queue-bytes", "Max Queue Bytes",
+          "Maximum number of bytes queued per stream (0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_MAX_QUEUE_BYTES,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUE_TIME,
+      g_param_spec_uint64 ("max-queue-time", "Max Queue Time",
+          "Maximum age in ns of the oldest queued frame per stream (0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_MAX_QUEUE_TIME,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TIMESTAMP_MODE,
+      g_param_spec_enum ("timestamp-mode", "Timestamp Mode",
+          "How buffer timestamps are derived", GST_TYPE_SSP_TIMESTAMP_MODE,
+          DEFAULT_TIMESTAMP_MODE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TIMECODE_FORMAT,
+      g_param_spec_enum ("timecode-format", "Timecode Format",
+          "How the camera encodes the HH:MM:SS:FF bytes of its timecode",
+          GST_TYPE_SSP_TIMECODE_FORMAT, DEFAULT_TIMECODE_FORMAT,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STREAM_FORMAT,
+      g_param_spec_enum ("stream-format", "Stream Format",
+          "Video stream format, one access unit per buffer either way",
+          GST_TYPE_SSP_STREAM_FORMAT, DEFAULT_STREAM_FORMAT,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_OVERFLOW_POLICY,
+      g_param_spec_enum ("overflow-policy", "Overflow Policy",
+          "What to do when a queue exceeds max-queue-frames/bytes/time or "
+          "libssp runs out of receive buffer", GST_TYPE_SSP_OVERFLOW_POLICY,
+          DEFAULT_OVERFLOW_POLICY, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CONNECT_TIMEOUT,
+      g_param_spec_uint64 ("connect-timeout", "Connect Timeout",
+          "Time in ns to wait for the SSP connection before failing (0 = forever)",
+          0, G_MAXUINT64, DEFAULT_CONNECT_TIMEOUT,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_META_TIMEOUT,
+      g_param_spec_uint64 ("meta-timeout", "Metadata Timeout",
+          "Time in ns to wait for stream metadata after connecting before failing (0 = forever)",
+          0, G_MAXUINT64, DEFAULT_META_TIMEOUT,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_FIRST_FRAME_TIMEOUT,
+      g_param_spec_uint64 ("first-frame-timeout", "First Frame Timeout",
+          "Time in ns to wait for the first keyframe after the metadata before failing (0 = forever)",
+          0, G_MAXUINT64, DEFAULT_FIRST_FRAME_TIMEOUT,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SOCKET_BUFFER_SIZE,
+      g_param_spec_uint ("socket-buffer-size", "Socket Buffer Size",
+          "Kernel receive buffer (SO_RCVBUF) in bytes (0 = kernel autotuning)",
+          0, G_MAXINT / 2, DEFAULT_SOCKET_BUFFER_SIZE,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOW_LATENCY,
+      g_param_spec_boolean ("low-latency", "Low Latency",
+          "Set TCP_NODELAY and TCP_QUICKACK on the connection", DEFAULT_LOW_LATENCY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_RECEIVE_INFO,
+      g_param_spec_boxed ("receive-info", "Receive Info",
+          "Receive path settings in effect, socket values as reported by the kernel once connected",
+          GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_RECONNECT,
+      g_param_spec_boolean ("reconnect", "Reconnect",
+          "Reconnect when the camera drops after sending its metadata instead of failing",
+          DEFAULT_RECONNECT, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_RECONNECT_DELAY,
+      g_param_spec_uint64 ("reconnect-delay", "Reconnect Delay",
+          "Time in ns before the first reconnect attempt, doubled on every further attempt",
+          0, G_MAXUINT64, DEFAULT_RECONNECT_DELAY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_RECONNECT_MAX_DELAY,
+      g_param_spec_uint64 ("reconnect-max-delay", "Reconnect Max Delay",
+          "Upper bound in ns of the delay between reconnect attempts",
+          0, G_MAXUINT64, DEFAULT_RECONNECT_MAX_DELAY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_RECONNECT_ATTEMPTS,
+      g_param_spec_uint ("reconnect-attempts", "Reconnect Attempts",
+          "Attempts per outage before failing (0 = unlimited)",
+          0, G_MAXUINT, DEFAULT_RECONNECT_ATTEMPTS,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STALL_FRAMES,
+      g_param_spec_uint ("stall-frames", "Stall Frames",
+          "Frame intervals without a frame before the connection counts as "
+          "stalled and is replaced (0 = rely on libssp's disconnect only)",
+          0, G_MAXUINT, DEFAULT_STALL_FRAMES,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint64 ("gop-cache-size", "GOP Cache Size",
+          "Bytes of the current video GOP kept for replay after a flush or on "
+          "a force-key-unit request (0 = disabled)",
+          0, G_MAXUINT64, DEFAULT_GOP_CACHE_SIZE,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_REPLAY,
+      g_param_spec_enum ("gop-replay", "GOP Replay",
+          "Timestamps of frames replayed from the GOP cache",
+          GST_TYPE_SSP_GOP_REPLAY, DEFAULT_GOP_REPLAY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP_THREADS,
+      g_param_spec_int ("loop-threads", "Loop Threads",
+          "Receive on a process-wide pool of this many libssp loop threads "
+          "shared with other sources (0 = own loop thread, -1 = from the "
+          SSP_LOOP_THREADS_ENV " environment variable, own thread if unset)",
+          -1, 256, DEFAULT_LOOP_THREADS,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP_STATS,
+      g_param_spec_boxed ("loop-stats", "Loop Stats",
+          "Loop this source receives on and the load of every loop in the shared pool",
+          GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_LOOP_CPUS,
+      g_param_spec_string ("loop-cpus", "Loop CPUs",
+          "CPUs such as \"2-3,6\" to pin the libssp loop thread to (NULL = no pinning, "
+          "not applied to shared loop-threads)", DEFAULT_LOOP_CPUS,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STREAMING_CPUS,
+      g_param_spec_string ("streaming-cpus", "Streaming CPUs",
+          "CPUs such as \"4-5\" to pin the streaming threads to (NULL = no pinning)",
+          DEFAULT_STREAMING_CPUS,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SCHED_POLICY,
+      g_param_spec_enum ("sched-policy", "Scheduling Policy",
+          "Scheduling policy of the loop and streaming threads, the real-time "
+          "policies need CAP_SYS_NICE or an RLIMIT_RTPRIO",
+          GST_TYPE_SSP_SCHED_POLICY, DEFAULT_SCHED_POLICY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SCHED_PRIORITY,
+      g_param_spec_int ("sched-priority", "Scheduling Priority",
+          "Real-time priority with sched-policy fifo or rr",
+          1, 99, DEFAULT_SCHED_PRIORITY,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_NICE,
+      g_param_spec_int ("nice", "Nice",
+          "Nice value of the loop and streaming threads with sched-policy other "
+          "(0 = inherited)", -20, 19, DEFAULT_NICE,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_THREAD_INFO,
+      g_param_spec_boxed ("thread-info", "Thread Info",
+          "Name, CPUs, scheduling and CPU time of the loop and streaming threads "
+          "as the kernel reports them",
+          GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Receive counters per stream, queue depth and connection events",
+          GST_TYPE_STRUCTURE, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Statistics Interval",
+          "Time in ns between ssp-stats element messages carrying the stats "
+          "(0 = none)", 0, G_MAXUINT64, DEFAULT_STATS_INTERVAL,
+          (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_INGEST_META,
+      g_param_spec_boolean ("ingest-meta", "Ingest Meta",
+          "Attach a GstSspIngestMeta with per-stage timestamps to every buffer "
+          "(always on while the sspsrc-latency tracer is loaded)",
+          DEFAULT_INGEST_META, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CAPTURE_LOCATION,
+      g_param_spec_string ("capture-location", "Capture Location",
+          "Record everything libssp delivers to this file for replay with "
+          "sspfilesrc (NULL = no capture)", DEFAULT_CAPTURE_LOCATION,
           (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   gst_element_class_set_static_metadata (gstelement_class,
@@ -178,16 +576,26 @@ gst_ssp_src_class_init (GstSspSrcClass * klass)
       "Your Name <your.email@example.com>");
 
   gst_element_class_add_static_pad_template (gstelement_class, &src_template);
+  gst_element_class_add_static_pad_template (gstelement_class, &audio_template);
+
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_ssp_src_change_state);
+  gstelement_class->post_message = GST_DEBUG_FUNCPTR (gst_ssp_src_post_message);
 
   gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_ssp_src_start);
   gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_ssp_src_stop);
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_ssp_src_unlock);
   gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_ssp_src_unlock_stop);
   gstbasesrc_class->get_times = GST_DEBUG_FUNCPTR (gst_ssp_src_get_times);
+  gstbasesrc_class->event = GST_DEBUG_FUNCPTR (gst_ssp_src_event);
 
   gstpushsrc_class->create = GST_DEBUG_FUNCPTR (gst_ssp_src_create);
 
+  klass->start_client = GST_DEBUG_FUNCPTR (gst_ssp_src_default_start_client);
+
   GST_DEBUG_CATEGORY_INIT (gst_ssp_src_debug, "sspsrc", 0, "SSP source");
+
+  ntp_caps = gst_static_caps_get (&ntp_reference_caps);
+  GST_MINI_OBJECT_FLAG_SET (ntp_caps, GST_MINI_OBJECT_FLAG_MAY_BE_LEAKED);
 }
 
 static void
@@ -200,12 +608,52 @@ gst_ssp_src_init (GstSspSrc * src)
   src->buffer_size = DEFAULT_BUFFER_SIZE;
   src->capability = DEFAULT_CAPABILITY;
   src->is_hlg = DEFAULT_IS_HLG;
+  src->max_queue_frames = DEFAULT_MAX_QUEUE_FRAMES;
+  src->max_queue_bytes = DEFAULT_MAX_QUEUE_BYTES;
+  src->max_queue_time = DEFAULT_MAX_QUEUE_TIME;
+  src->timestamp_mode = DEFAULT_TIMESTAMP_MODE;
+  src->timecode_format = DEFAULT_TIMECODE_FORMAT;
+  src->stream_format = DEFAULT_STREAM_FORMAT;
+  src->overflow_policy = DEFAULT_OVERFLOW_POLICY;
+  src->connect_timeout = DEFAULT_CONNECT_TIMEOUT;
+  src->meta_timeout = DEFAULT_META_TIMEOUT;
+  src->first_frame_timeout = DEFAULT_FIRST_FRAME_TIMEOUT;
+  src->socket_buffer_size = DEFAULT_SOCKET_BUFFER_SIZE;
+  src->low_latency = DEFAULT_LOW_LATENCY;
+  src->reconnect = DEFAULT_RECONNECT;
+  src->reconnect_delay = DEFAULT_RECONNECT_DELAY;
+  src->reconnect_max_delay = DEFAULT_RECONNECT_MAX_DELAY;
+  src->reconnect_attempts = DEFAULT_RECONNECT_ATTEMPTS;
+  src->stall_frames = DEFAULT_STALL_FRAMES;
+  src->gop_cache_size = DEFAULT_GOP_CACHE_SIZE;
+  src->gop_replay = DEFAULT_GOP_REPLAY;
+  src->loop_threads = DEFAULT_LOOP_THREADS;
+  src->loop_cpus = g_strdup (DEFAULT_LOOP_CPUS);
+  src->streaming_cpus = g_strdup (DEFAULT_STREAMING_CPUS);
+  src->sched_policy = DEFAULT_SCHED_POLICY;
+  src->sched_priority = DEFAULT_SCHED_PRIORITY;
+  src->nice = DEFAULT_NICE;
+  src->stats_interval = DEFAULT_STATS_INTERVAL;
+  src->ingest_meta = DEFAULT_INGEST_META;
+  src->capture_location = g_strdup (DEFAULT_CAPTURE_LOCATION);
+  src->video_origin = 0;
+  src->audio_origin = 0;
+  src->loop_tid = 0;
+  src->src_tid = 0;
+  src->audio_tid = 0;
+  src->src_thread = NULL;
+  src->audio_thread = NULL;
+  src->src_sched = NULL;
+  src->audio_sched = NULL;
+  src->loop_index = -1;
 
   src->ssp_thread = NULL;
-  src->video_pad = NULL;
+  src->capture = NULL;
   src->audio_pad = NULL;
-  src->video_queue = g_async_queue_new ();
-  src->audio_queue = g_async_queue_new ();
+  src->video_ring = NULL;
+  src->audio_ring = NULL;
+  src->audio_stream_started = FALSE;
+  src->audio_need_segment = TRUE;
 
   src->started = FALSE;
   src->connected = FALSE;
@@ -213,10 +661,55 @@ gst_ssp_src_init (GstSspSrc * src)
   src->has_audio_meta = FALSE;
   src->video_caps_set = FALSE;
   src->audio_caps_set = FALSE;
-
-  /* Initialize timestamp tracking */
-  src->timestamp = 0;
-  src->first_timestamp = GST_CLOCK_TIME_NONE;
+  src->flushing = FALSE;
+  src->startup_done = FALSE;
+  src->reconnect_thread = NULL;
+  src->reconnect_stop = FALSE;
+  src->reconnect_requested = FALSE;
+  src->reconnecting = FALSE;
+  src->reconnect_attempt_failed = FALSE;
+  src->disconnect_reason = NULL;
+  src->recovering = FALSE;
+  src->segment_pending = FALSE;
+  src->audio_segment_pending = FALSE;
+  src->video_discont = FALSE;
+  src->audio_discont = FALSE;
+  src->last_arrival = GST_CLOCK_TIME_NONE;
+  src->frame_interval = GST_CLOCK_TIME_NONE;
+  src->gop_cache = NULL;
+  src->replay_pending = FALSE;
+  g_queue_init (&src->replay_queue);
+  src->socket_found = FALSE;
+  src->socket_ambiguous = FALSE;
+  src->effective_socket_buffer_size = 0;
+  src->effective_nodelay = FALSE;
+  src->io_backend = NULL;
+  src->video_caps = NULL;
+  src->audio_caps = NULL;
+  src->audio_caps_changed = FALSE;
+  src->param_sets = NULL;
+
+  gst_video_time_code_init (&src->tc, 0, 1, NULL,
+      GST_VIDEO_TIME_CODE_FLAGS_NONE, 0, 0, 0, 0, 0);
+  src->tc_valid = FALSE;
+  src->tc_resync = FALSE;
+  src->tc_frm_no = 0;
+
+  src->video_stats = new SspStreamStats ();
+  src->audio_stats = new SspStreamStats ();
+  src->buffer_full_events = 0;
+  src->disconnects = 0;
+  src->reconnects = 0;
+  src->stats_id = NULL;
+
+  /* Timestampers are created in start() */
+  src->clock_epoch = NULL;
+  src->video_ts = NULL;
+  src->audio_ts = NULL;
+  src->video_ntp_delta = GST_CLOCK_STIME_NONE;
+  src->audio_ntp_delta = GST_CLOCK_STIME_NONE;
+  src->ntp_clock = NULL;
+  src->ntp_offset = 0;
 
   g_mutex_init (&src->lock);
   g_cond_init (&src->cond);
@@ -236,14 +729,195 @@ gst_ssp_src_finalize (GObject * object)
   GstSspSrc *src = GST_SSP_SRC (object);
 
   g_free (src->ip);
-  g_async_queue_unref (src->video_queue);
-  g_async_queue_unref (src->audio_queue);
+  g_free (src->loop_cpus);
+  g_free (src->streaming_cpus);
+  g_free (src->capture_location);
+  delete (SspStreamStats *) src->video_stats;
+  delete (SspStreamStats *) src->audio_stats;
+  gst_object_replace ((GstObject **) & src->ntp_clock, NULL);
   g_mutex_clear (&src->lock);
   g_cond_clear (&src->cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* socket-buffer-size is what the kernel reports, Linux doubles the request
+ * for bookkeeping overhead */
+static GstStructure *
+gst_ssp_src_receive_info (GstSspSrc * src)
+{
+  GstStructure *s;
+
+  g_mutex_lock (&src->lock);
+  s = gst_structure_new ("receive-info",
+      "client", G_TYPE_STRING, SSP_CLIENT,
+      "buffer-size", G_TYPE_UINT, src->buffer_size,
+      "capability", G_TYPE_UINT, src->capability,
+      "connected", G_TYPE_BOOLEAN, src->connected,
+      "socket-found", G_TYPE_BOOLEAN, src->socket_found, NULL);
+  if (src->io_backend)
+    gst_structure_set (s, "io-backend", G_TYPE_STRING, src->io_backend, NULL);
+  if (src->socket_ambiguous)
+    gst_structure_set (s, "socket-ambiguous", G_TYPE_BOOLEAN, TRUE, NULL);
+  if (src->socket_found)
+    gst_structure_set (s,
+        "socket-buffer-size", G_TYPE_INT, src->effective_socket_buffer_size,
+        "tcp-nodelay", G_TYPE_BOOLEAN, src->effective_nodelay, NULL);
+  g_mutex_unlock (&src->lock);
+
+  return s;
+}
+
+/* bitrate and utilization are rates over the last second or more */
+static GstStructure *
+gst_ssp_src_loop_stats (GstSspSrc * src)
+{
+  std::vector<SspLoopStats> stats;
+  GValue loops = G_VALUE_INIT;
+  GstStructure *s;
+  gint loop_index;
+  gint64 syscalls;
+
+  SspLoopPool::get_global_stats (&stats);
+
+  g_mutex_lock (&src->lock);
+  loop_index = src->loop_index;
+  g_mutex_unlock (&src->lock);
+
+  g_value_init (&loops, GST_TYPE_ARRAY);
+  for (guint i = 0; i < stats.size (); i++) {
+    GValue v = G_VALUE_INIT;
+
+    g_value_init (&v, GST_TYPE_STRUCTURE);
+    g_value_take_boxed (&v, gst_structure_new ("ssp-loop",
+            "index", G_TYPE_UINT, i,
+            "clients", G_TYPE_UINT, stats[i].clients,
+            "bitrate", G_TYPE_UINT64, stats[i].bitrate,
+            "utilization", G_TYPE_DOUBLE, stats[i].utilization,
+            "bytes", G_TYPE_UINT64, stats[i].bytes,
+            "frames", G_TYPE_UINT64, stats[i].frames,
+            "busy", G_TYPE_UINT64, stats[i].busy, NULL));
+    gst_value_array_append_and_take_value (&loops, &v);
+  }
+
+  s = gst_structure_new ("loop-stats",
+      "loop-threads", G_TYPE_UINT, (guint) stats.size (),
+      "loop", G_TYPE_INT, loop_index, NULL);
+  gst_structure_take_value (s, "loops", &loops);
+
+  /* Process wide, for syscalls per frame in A/B runs */
+  syscalls = SspThread::get_receive_syscalls ();
+  if (syscalls >= 0)
+    gst_structure_set (s, "receive-syscalls", G_TYPE_UINT64, (guint64) syscalls,
+        NULL);
+
+  return s;
+}
+
+static GstStructure *
+gst_ssp_src_stream_stats (SspStreamStats * stats, SspFrameRing * ring,
+    const gchar * name, gboolean video, GstClockTime now)
+{
+  SspStreamStatsSnapshot snap;
+  GstStructure *s;
+
+  stats->get (now, &snap);
+  s = gst_structure_new (name,
+      "frames", G_TYPE_UINT64, snap.frames,
+      "bytes", G_TYPE_UINT64, snap.bytes,
+      "dropped-frames", G_TYPE_UINT64, snap.dropped_frames,
+      "dropped-bytes", G_TYPE_UINT64, snap.dropped_bytes,
+      "queued-frames", G_TYPE_UINT, ring ? ring->length () : 0,
+      "queued-bytes", G_TYPE_UINT64, ring ? ring->bytes () : 0,
+      "fps", G_TYPE_DOUBLE, snap.fps,
+      "bitrate", G_TYPE_UINT64, snap.bitrate,
+      "jitter", G_TYPE_UINT64, snap.jitter,
+      "jitter-max", G_TYPE_UINT64, snap.jitter_max, NULL);
+  if (video)
+    gst_structure_set (s,
+        "keyframes", G_TYPE_UINT64, snap.keyframes,
+        "frame-gaps", G_TYPE_UINT64, snap.frame_gaps,
+        "missing-frames", G_TYPE_UINT64, snap.missing_frames, NULL);
+
+  return s;
+}
+
+/* fps, bitrate and jitter cover the last second. The lock only keeps
+ * stop() from freeing the rings underneath. */
+static GstStructure *
+gst_ssp_src_stats (GstSspSrc * src)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  GstStructure *s, *stream;
+
+  s = gst_structure_new ("ssp-stats",
+      "buffer-full", G_TYPE_UINT, (guint) g_atomic_int_get (&src->buffer_full_events),
+      "disconnects", G_TYPE_UINT, (guint) g_atomic_int_get (&src->disconnects),
+      "reconnects", G_TYPE_UINT, (guint) g_atomic_int_get (&src->reconnects), NULL);
+
+  g_mutex_lock (&src->lock);
+  gst_structure_set (s, "connected", G_TYPE_BOOLEAN, src->connected, NULL);
+  if (src->mode != GST_SSP_MODE_AUDIO_ONLY) {
+    stream = gst_ssp_src_stream_stats ((SspStreamStats *) src->video_stats,
+        (SspFrameRing *) src->video_ring, "video", TRUE, now);
+    gst_structure_set (s, "video", GST_TYPE_STRUCTURE, stream, NULL);
+    gst_structure_free (stream);
+  }
+  if (src->mode != GST_SSP_MODE_VIDEO_ONLY) {
+    stream = gst_ssp_src_stream_stats ((SspStreamStats *) src->audio_stats,
+        (SspFrameRing *) src->audio_ring, "audio", FALSE, now);
+    gst_structure_set (s, "audio", GST_TYPE_STRUCTURE, stream, NULL);
+    gst_structure_free (stream);
+  }
+  g_mutex_unlock (&src->lock);
+
+  return s;
+}
+
+/* Periodic stats-interval tick, on the system clock's thread */
+static gboolean
+gst_ssp_src_stats_tick (GstClock * clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  GstSspSrc *src = GST_SSP_SRC (user_data);
+  gboolean current;
+
+  g_mutex_lock (&src->lock);
+  current = src->stats_id == id;
+  g_mutex_unlock (&src->lock);
+
+  if (current)
+    gst_ssp_src_post_element (src, gst_ssp_src_stats (src));
+  return TRUE;
+}
+
+/* Threads not started yet or already gone are left out */
+static GstStructure *
+gst_ssp_src_thread_info (GstSspSrc * src)
+{
+  const gchar *fields[] = { "loop", "streaming", "audio" };
+  gint tids[3];
+  GstStructure *s;
+
+  g_mutex_lock (&src->lock);
+  tids[0] = src->loop_tid;
+  tids[1] = src->src_tid;
+  tids[2] = src->audio_tid;
+  g_mutex_unlock (&src->lock);
+
+  s = gst_structure_new_empty ("thread-info");
+  for (guint i = 0; i < G_N_ELEMENTS (tids); i++) {
+    GstStructure *thread = ssp_sched_describe (tids[i]);
+
+    if (thread) {
+      gst_structure_set (s, fields[i], GST_TYPE_STRUCTURE, thread, NULL);
+      gst_structure_free (thread);
+    }
+  }
+
+  return s;
+}
+
 static void
 gst_ssp_src_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -273,6 +947,96 @@ gst_ssp_src_set_property (GObject * object, guint prop_id,
     case PROP_IS_HLG:
       src->is_hlg = g_value_get_boolean (value);
       break;
+    case PROP_MAX_QUEUE_FRAMES:
+      src->max_queue_frames = g_value_get_uint (value);
+      break;
+    case PROP_MAX_QUEUE_BYTES:
+      src->max_queue_bytes = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_QUEUE_TIME:
+      src->max_queue_time = g_value_get_uint64 (value);
+      break;
+    case PROP_TIMESTAMP_MODE:
+      src->timestamp_mode = (GstSspTimestampMode) g_value_get_enum (value);
+      break;
+    case PROP_TIMECODE_FORMAT:
+      src->timecode_format = (GstSspTimecodeFormat) g_value_get_enum (value);
+      break;
+    case PROP_STREAM_FORMAT:
+      src->stream_format = (GstSspStreamFormat) g_value_get_enum (value);
+      break;
+    case PROP_OVERFLOW_POLICY:
+      src->overflow_policy = (GstSspOverflowPolicy) g_value_get_enum (value);
+      break;
+    case PROP_CONNECT_TIMEOUT:
+      src->connect_timeout = g_value_get_uint64 (value);
+      break;
+    case PROP_META_TIMEOUT:
+      src->meta_timeout = g_value_get_uint64 (value);
+      break;
+    case PROP_FIRST_FRAME_TIMEOUT:
+      src->first_frame_timeout = g_value_get_uint64 (value);
+      break;
+    case PROP_SOCKET_BUFFER_SIZE:
+      src->socket_buffer_size = g_value_get_uint (value);
+      break;
+    case PROP_LOW_LATENCY:
+      src->low_latency = g_value_get_boolean (value);
+      break;
+    case PROP_RECONNECT:
+      src->reconnect = g_value_get_boolean (value);
+      break;
+    case PROP_RECONNECT_DELAY:
+      src->reconnect_delay = g_value_get_uint64 (value);
+      break;
+    case PROP_RECONNECT_MAX_DELAY:
+      src->reconnect_max_delay = g_value_get_uint64 (value);
+      break;
+    case PROP_RECONNECT_ATTEMPTS:
+      src->reconnect_attempts = g_value_get_uint (value);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      src->gop_cache_size = g_value_get_uint64 (value);
+      break;
+    case PROP_GOP_REPLAY:
+      src->gop_replay = (GstSspGopReplay) g_value_get_enum (value);
+      break;
+    case PROP_STALL_FRAMES:
+      g_mutex_lock (&src->lock);
+      src->stall_frames = g_value_get_uint (value);
+      g_cond_broadcast (&src->cond);
+      g_mutex_unlock (&src->lock);
+      break;
+    case PROP_LOOP_THREADS:
+      src->loop_threads = g_value_get_int (value);
+      break;
+    case PROP_LOOP_CPUS:
+      g_free (src->loop_cpus);
+      src->loop_cpus = g_value_dup_string (value);
+      break;
+    case PROP_STREAMING_CPUS:
+      g_free (src->streaming_cpus);
+      src->streaming_cpus = g_value_dup_string (value);
+      break;
+    case PROP_SCHED_POLICY:
+      src->sched_policy = (GstSspSchedPolicy) g_value_get_enum (value);
+      break;
+    case PROP_SCHED_PRIORITY:
+      src->sched_priority = g_value_get_int (value);
+      break;
+    case PROP_NICE:
+      src->nice = g_value_get_int (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      src->stats_interval = g_value_get_uint64 (value);
+      break;
+    case PROP_INGEST_META:
+      src->ingest_meta = g_value_get_boolean (value);
+      break;
+    case PROP_CAPTURE_LOCATION:
+      g_free (src->capture_location);
+      src->capture_location = g_value_dup_string (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -307,231 +1071,1910 @@ gst_ssp_src_get_property (GObject * object, guint prop_id,
     case PROP_IS_HLG:
       g_value_set_boolean (value, src->is_hlg);
       break;
+    case PROP_MAX_QUEUE_FRAMES:
+      g_value_set_uint (value, src->max_queue_frames);
+      break;
+    case PROP_MAX_QUEUE_BYTES:
+      g_value_set_uint64 (value, src->max_queue_bytes);
+      break;
+    case PROP_MAX_QUEUE_TIME:
+      g_value_set_uint64 (value, src->max_queue_time);
+      break;
+    case PROP_TIMESTAMP_MODE:
+      g_value_set_enum (value, src->timestamp_mode);
+      break;
+    case PROP_TIMECODE_FORMAT:
+      g_value_set_enum (value, src->timecode_format);
+      break;
+    case PROP_STREAM_FORMAT:
+      g_value_set_enum (value, src->stream_format);
+      break;
+    case PROP_OVERFLOW_POLICY:
+      g_value_set_enum (value, src->overflow_policy);
+      break;
+    case PROP_CONNECT_TIMEOUT:
+      g_value_set_uint64 (value, src->connect_timeout);
+      break;
+    case PROP_META_TIMEOUT:
+      g_value_set_uint64 (value, src->meta_timeout);
+      break;
+    case PROP_FIRST_FRAME_TIMEOUT:
+      g_value_set_uint64 (value, src->first_frame_timeout);
+      break;
+    case PROP_SOCKET_BUFFER_SIZE:
+      g_value_set_uint (value, src->socket_buffer_size);
+      break;
+    case PROP_LOW_LATENCY:
+      g_value_set_boolean (value, src->low_latency);
+      break;
+    case PROP_RECEIVE_INFO:
+      g_value_take_boxed (value, gst_ssp_src_receive_info (src));
+      break;
+    case PROP_RECONNECT:
+      g_value_set_boolean (value, src->reconnect);
+      break;
+    case PROP_RECONNECT_DELAY:
+      g_value_set_uint64 (value, src->reconnect_delay);
+      break;
+    case PROP_RECONNECT_MAX_DELAY:
+      g_value_set_uint64 (value, src->reconnect_max_delay);
+      break;
+    case PROP_RECONNECT_ATTEMPTS:
+      g_value_set_uint (value, src->reconnect_attempts);
+      break;
+    case PROP_STALL_FRAMES:
+      g_value_set_uint (value, src->stall_frames);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      g_value_set_uint64 (value, src->gop_cache_size);
+      break;
+    case PROP_GOP_REPLAY:
+      g_value_set_enum (value, src->gop_replay);
+      break;
+    case PROP_LOOP_THREADS:
+      g_value_set_int (value, src->loop_threads);
+      break;
+    case PROP_LOOP_STATS:
+      g_value_take_boxed (value, gst_ssp_src_loop_stats (src));
+      break;
+    case PROP_LOOP_CPUS:
+      g_value_set_string (value, src->loop_cpus);
+      break;
+    case PROP_STREAMING_CPUS:
+      g_value_set_string (value, src->streaming_cpus);
+      break;
+    case PROP_SCHED_POLICY:
+      g_value_set_enum (value, src->sched_policy);
+      break;
+    case PROP_SCHED_PRIORITY:
+      g_value_set_int (value, src->sched_priority);
+      break;
+    case PROP_NICE:
+      g_value_set_int (value, src->nice);
+      break;
+    case PROP_THREAD_INFO:
+      g_value_take_boxed (value, gst_ssp_src_thread_info (src));
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_ssp_src_stats (src));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, src->stats_interval);
+      break;
+    case PROP_INGEST_META:
+      g_value_set_boolean (value, src->ingest_meta);
+      break;
+    case PROP_CAPTURE_LOCATION:
+      g_value_set_string (value, src->capture_location);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
-static gboolean
-gst_ssp_src_start (GstBaseSrc * basesrc)
+/* The always pad carries audio in mode=audio and video otherwise */
+static SspFrameRing *
+gst_ssp_src_get_src_ring (GstSspSrc * src)
 {
-  GstSspSrc *src = GST_SSP_SRC (basesrc);
-  SspThread *ssp_thread;
+  if (src->mode == GST_SSP_MODE_AUDIO_ONLY)
+    return (SspFrameRing *) src->audio_ring;
+  return (SspFrameRing *) src->video_ring;
+}
 
-  GST_DEBUG_OBJECT (src, "Starting SSP source");
+static void
+gst_ssp_src_add_audio_pad (GstSspSrc * src)
+{
+  GstPad *pad;
 
-  /* Create SSP thread */
-  ssp_thread = new SspThread();
-  src->ssp_thread = (gpointer) ssp_thread;
+  pad = gst_pad_new_from_static_template (&audio_template, "audio");
+  gst_pad_set_query_function (pad, GST_DEBUG_FUNCPTR (gst_ssp_src_audio_query));
+  gst_pad_use_fixed_caps (pad);
 
-  /* Set up callbacks */
-  if (src->mode == GST_SSP_MODE_VIDEO_ONLY || src->mode == GST_SSP_MODE_BOTH) {
-    ssp_thread->set_video_callback (on_video_data_cb, src);
-  }
-  if (src->mode == GST_SSP_MODE_AUDIO_ONLY || src->mode == GST_SSP_MODE_BOTH) {
-    ssp_thread->set_audio_callback (on_audio_data_cb, src);
-  }
-  ssp_thread->set_meta_callback (on_meta_cb, src);
-  ssp_thread->set_connected_callback (on_connected_cb, src);
-  ssp_thread->set_disconnected_callback (on_disconnected_cb, src);
-  ssp_thread->set_exception_callback (on_exception_cb, src);
+  src->audio_stream_started = FALSE;
+  src->audio_need_segment = TRUE;
+  src->audio_pad = (GstPad *) gst_object_ref (pad);
 
-  /* Start the SSP client */
-  if (!ssp_thread->start (std::string(src->ip), src->port, src->stream_style)) {
-    GST_ERROR_OBJECT (src, "Failed to start SSP thread");
-    delete ssp_thread;
-    src->ssp_thread = NULL;
-    return FALSE;
-  }
+  gst_pad_set_active (pad, TRUE);
+  gst_element_add_pad (GST_ELEMENT (src), pad);
+  gst_element_no_more_pads (GST_ELEMENT (src));
 
-  src->started = TRUE;
-  
+  GST_DEBUG_OBJECT (src, "Added audio pad");
+}
+
+static void
+gst_ssp_src_remove_audio_pad (GstSspSrc * src)
+{
+  SspFrameRing *ring = (SspFrameRing *) src->audio_ring;
+  GstPad *pad = src->audio_pad;
+
+  if (pad == NULL)
+    return;
+
+  if (ring)
+    ring->set_flushing (TRUE);
+  gst_pad_stop_task (pad);
+  if (ring)
+    ring->set_flushing (FALSE);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (GST_ELEMENT (src), pad);
+  src->audio_pad = NULL;
+  gst_object_unref (pad);
+
+  GST_DEBUG_OBJECT (src, "Removed audio pad");
+}
+
+static void
+gst_ssp_src_pause_audio_pad (GstSspSrc * src)
+{
+  SspFrameRing *ring = (SspFrameRing *) src->audio_ring;
+
+  if (src->audio_pad == NULL)
+    return;
+
+  if (ring)
+    ring->set_flushing (TRUE);
+  gst_pad_pause_task (src->audio_pad);
+  if (ring)
+    ring->set_flushing (FALSE);
+}
+
+static GstStateChangeReturn
+gst_ssp_src_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSspSrc *src = GST_SSP_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      gst_ssp_src_pause_audio_pad (src);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* The audio task must be gone before stop() frees the rings */
+      gst_ssp_src_remove_audio_pad (src);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (src->mode == GST_SSP_MODE_BOTH)
+        gst_ssp_src_add_audio_pad (src);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      if (src->audio_pad) {
+        gst_pad_start_task (src->audio_pad,
+            (GstTaskFunction) gst_ssp_src_audio_loop, src->audio_pad, NULL);
+      }
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+/* GstTask posts stream-status leave from the thread it is leaving, the
+ * last chance to restore a pool thread the streaming code set up */
+static gboolean
+gst_ssp_src_post_message (GstElement * element, GstMessage * message)
+{
+  GstSspSrc *src = GST_SSP_SRC (element);
+
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_STREAM_STATUS) {
+    GstStreamStatusType type;
+    GstElement *owner;
+
+    gst_message_parse_stream_status (message, &type, &owner);
+    if (type == GST_STREAM_STATUS_TYPE_LEAVE && owner == element) {
+      if (src->src_thread == g_thread_self ())
+        gst_ssp_src_release_streaming_thread (src, &src->src_thread,
+            &src->src_tid, &src->src_sched);
+      else if (src->audio_thread == g_thread_self ())
+        gst_ssp_src_release_streaming_thread (src, &src->audio_thread,
+            &src->audio_tid, &src->audio_sched);
+    }
+  }
+
+  return GST_ELEMENT_CLASS (parent_class)->post_message (element, message);
+}
+
+static void
+gst_ssp_src_free_timestampers (GstSspSrc * src)
+{
+  delete (SspTimestamper *) src->video_ts;
+  delete (SspTimestamper *) src->audio_ts;
+  g_free (src->clock_epoch);
+  src->video_ts = NULL;
+  src->audio_ts = NULL;
+  src->clock_epoch = NULL;
+}
+
+/* loop-threads, with -1 resolved from the environment */
+static guint
+gst_ssp_src_loop_threads (GstSspSrc * src)
+{
+  const gchar *env;
+  gchar *end;
+  guint64 n;
+
+  if (src->loop_threads >= 0)
+    return src->loop_threads;
+
+  env = g_getenv (SSP_LOOP_THREADS_ENV);
+  if (!env || !*env)
+    return 0;
+
+  n = g_ascii_strtoull (env, &end, 10);
+  if (*end || n > 256) {
+    GST_WARNING_OBJECT (src, "Ignoring invalid " SSP_LOOP_THREADS_ENV "=%s",
+        env);
+    return 0;
+  }
+  return n;
+}
+
+static gboolean
+gst_ssp_src_default_start_client (GstSspSrc * src)
+{
+  SspClientOptions options;
+
+  options.buffer_size = src->buffer_size;
+  options.capability = src->capability;
+  options.socket_buffer_size = src->socket_buffer_size;
+  options.low_latency = src->low_latency;
+  options.loop_threads = gst_ssp_src_loop_threads (src);
+  options.loop_name = std::string ("ssp-loop-") + src->ip;
+  options.loop_cpus = src->loop_cpus ? src->loop_cpus : "";
+  options.sched_policy = (SspSchedPolicy) src->sched_policy;
+  options.sched_priority = src->sched_priority;
+  options.nice = src->nice;
+  options.capture = (SspCaptureWriter *) src->capture;
+
+  return ((SspThread *) src->ssp_thread)->start (std::string (src->ip),
+      src->port, src->stream_style, options);
+}
+
+static gboolean
+gst_ssp_src_start_client (GstSspSrc * src)
+{
+  return GST_SSP_SRC_GET_CLASS (src)->start_client (src);
+}
+
+static gboolean
+gst_ssp_src_start (GstBaseSrc * basesrc)
+{
+  GstSspSrc *src = GST_SSP_SRC (basesrc);
+  SspThread *ssp_thread;
+
+  GST_DEBUG_OBJECT (src, "Starting SSP source");
+
+  gchar *origin = g_strdup_printf ("%s/video", GST_OBJECT_NAME (src));
+  src->video_origin = g_quark_from_string (origin);
+  g_free (origin);
+  origin = g_strdup_printf ("%s/audio", GST_OBJECT_NAME (src));
+  src->audio_origin = g_quark_from_string (origin);
+  g_free (origin);
+
+  /* One file across reconnects, the gaps show in the arrival times */
+  if (src->capture_location && *src->capture_location) {
+    SspCaptureWriter *capture = new SspCaptureWriter ();
+
+    if (!capture->open (src->capture_location)) {
+      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_WRITE,
+          ("Could not create capture file %s", src->capture_location),
+          GST_ERROR_SYSTEM);
+      delete capture;
+      return FALSE;
+    }
+    src->capture = capture;
+  }
+
+  src->video_ring = new SspFrameRing (src->max_queue_frames,
+      src->max_queue_bytes, src->max_queue_time);
+  src->audio_ring = new SspFrameRing (src->max_queue_frames,
+      src->max_queue_bytes, src->max_queue_time);
+
+  SspClockEpoch *epoch = g_new0 (SspClockEpoch, 1);
+  SspTimestamper::reset_epoch (epoch);
+  SspTimestamper *video_ts = new SspTimestamper (epoch);
+  SspTimestamper *audio_ts = new SspTimestamper (epoch);
+  video_ts->set_use_arrival (src->timestamp_mode == GST_SSP_TIMESTAMP_ARRIVAL);
+  audio_ts->set_use_arrival (src->timestamp_mode == GST_SSP_TIMESTAMP_ARRIVAL);
+  src->clock_epoch = epoch;
+  src->video_ts = video_ts;
+  src->audio_ts = audio_ts;
+
+  memset (&src->video_drops, 0, sizeof (src->video_drops));
+  memset (&src->audio_drops, 0, sizeof (src->audio_drops));
+  ((SspStreamStats *) src->video_stats)->reset ();
+  ((SspStreamStats *) src->audio_stats)->reset ();
+  g_atomic_int_set (&src->buffer_full_events, 0);
+  g_atomic_int_set (&src->disconnects, 0);
+  g_atomic_int_set (&src->reconnects, 0);
+
+  if (src->gop_cache_size > 0 && src->mode != GST_SSP_MODE_AUDIO_ONLY)
+    src->gop_cache = new SspGopCache (src->gop_cache_size);
+  src->video_frames = 0;
+  src->last_video_offset = GST_BUFFER_OFFSET_NONE;
+  src->last_video_pts = GST_CLOCK_TIME_NONE;
+  src->last_video_duration = GST_CLOCK_TIME_NONE;
+
+  src->startup_done = FALSE;
+  src->startup_begin = gst_util_get_timestamp ();
+  src->startup_connected = GST_CLOCK_TIME_NONE;
+  src->startup_meta = GST_CLOCK_TIME_NONE;
+  src->startup_first_frame = GST_CLOCK_TIME_NONE;
+
+  /* Create SSP thread */
+  ssp_thread = new SspThread();
+  src->ssp_thread = (gpointer) ssp_thread;
+
+  /* Set up callbacks */
+  if (src->mode == GST_SSP_MODE_VIDEO_ONLY || src->mode == GST_SSP_MODE_BOTH) {
+    ssp_thread->set_video_callback (on_video_data_cb, src);
+  }
+  if (src->mode == GST_SSP_MODE_AUDIO_ONLY || src->mode == GST_SSP_MODE_BOTH) {
+    ssp_thread->set_audio_callback (on_audio_data_cb, src);
+  }
+  ssp_thread->set_meta_callback (on_meta_cb, src);
+  ssp_thread->set_connected_callback (on_connected_cb, src);
+  ssp_thread->set_disconnected_callback (on_disconnected_cb, src);
+  ssp_thread->set_exception_callback (on_exception_cb, src);
+  ssp_thread->set_buffer_full_callback (on_buffer_full_cb, src);
+  ssp_thread->set_end_callback (on_end_cb, src);
+
+  g_mutex_lock (&src->lock);
+  src->socket_found = FALSE;
+  src->socket_ambiguous = FALSE;
+  src->io_backend = NULL;
+  src->loop_index = -1;
+  src->loop_tid = 0;
+  src->src_tid = 0;
+  src->audio_tid = 0;
+  src->src_thread = NULL;
+  src->audio_thread = NULL;
+  src->reconnect_stop = FALSE;
+  src->reconnect_requested = FALSE;
+  src->reconnecting = FALSE;
+  src->recovering = FALSE;
+  src->segment_pending = FALSE;
+  src->audio_segment_pending = FALSE;
+  src->last_arrival = GST_CLOCK_TIME_NONE;
+  src->frame_interval = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&src->lock);
+  src->video_discont = FALSE;
+  src->audio_discont = FALSE;
+
+  /* Start the SSP client */
+  if (!gst_ssp_src_start_client (src)) {
+    GST_ERROR_OBJECT (src, "Failed to start SSP thread");
+    delete ssp_thread;
+    src->ssp_thread = NULL;
+    delete (SspCaptureWriter *) src->capture;
+    src->capture = NULL;
+    delete (SspFrameRing *) src->video_ring;
+    delete (SspFrameRing *) src->audio_ring;
+    src->video_ring = NULL;
+    src->audio_ring = NULL;
+    delete (SspGopCache *) src->gop_cache;
+    src->gop_cache = NULL;
+    gst_ssp_src_free_timestampers (src);
+    return FALSE;
+  }
+
+  src->started = TRUE;
+  src->reconnect_thread = g_thread_new ("sspsrc-reconnect",
+      gst_ssp_src_reconnect_loop, src);
+
+  if (src->stats_interval > 0) {
+    GstClock *clock = gst_system_clock_obtain ();
+    GstClockID id = gst_clock_new_periodic_id (clock,
+        gst_clock_get_time (clock) + src->stats_interval, src->stats_interval);
+
+    g_mutex_lock (&src->lock);
+    src->stats_id = id;
+    g_mutex_unlock (&src->lock);
+    gst_clock_id_wait_async (id, gst_ssp_src_stats_tick, gst_object_ref (src),
+        (GDestroyNotify) gst_object_unref);
+    gst_object_unref (clock);
+  }
+  
   GST_DEBUG_OBJECT (src, "SSP source started successfully");
   return TRUE;
 }
 
 static gboolean
-gst_ssp_src_stop (GstBaseSrc * basesrc)
+gst_ssp_src_stop (GstBaseSrc * basesrc)
+{
+  GstSspSrc *src = GST_SSP_SRC (basesrc);
+  SspThread *ssp_thread = (SspThread *) src->ssp_thread;
+
+  GST_DEBUG_OBJECT (src, "Stopping SSP source");
+
+  g_mutex_lock (&src->lock);
+  GstClockID stats_id = src->stats_id;
+  src->stats_id = NULL;
+  g_mutex_unlock (&src->lock);
+  if (stats_id) {
+    gst_clock_id_unschedule (stats_id);
+    gst_clock_id_unref (stats_id);
+  }
+
+  /* The supervisor restarts the SSP thread, it has to go first */
+  if (src->reconnect_thread) {
+    g_mutex_lock (&src->lock);
+    src->reconnect_stop = TRUE;
+    g_cond_broadcast (&src->cond);
+    g_mutex_unlock (&src->lock);
+    g_thread_join (src->reconnect_thread);
+    src->reconnect_thread = NULL;
+  }
+
+  /* With overflow-policy=block the loop thread may be waiting for room */
+  if (src->video_ring)
+    ((SspFrameRing *) src->video_ring)->set_flushing (TRUE);
+  if (src->audio_ring)
+    ((SspFrameRing *) src->audio_ring)->set_flushing (TRUE);
+
+  if (ssp_thread) {
+    ssp_thread->stop ();
+    delete ssp_thread;
+    src->ssp_thread = NULL;
+  }
+
+  /* Closing writes the index */
+  delete (SspCaptureWriter *) src->capture;
+  src->capture = NULL;
+
+  /* The SSP thread is gone, nobody produces into the rings any more */
+  SspRingStats ring_stats;
+  SspFrameRing *video_ring, *audio_ring;
+
+  /* Detached under the lock, the stats property reads the queue depth */
+  g_mutex_lock (&src->lock);
+  video_ring = (SspFrameRing *) src->video_ring;
+  audio_ring = (SspFrameRing *) src->audio_ring;
+  src->video_ring = NULL;
+  src->audio_ring = NULL;
+  g_mutex_unlock (&src->lock);
+
+  if (video_ring) {
+    SspFrameRing *ring = video_ring;
+    ring->get_stats (&ring_stats);
+    GST_INFO_OBJECT (src, "Video queue: %" G_GUINT64_FORMAT " pushed, %"
+        G_GUINT64_FORMAT " popped, %" G_GUINT64_FORMAT " rejected, %"
+        G_GUINT64_FORMAT " evicted, max latency %" GST_TIME_FORMAT,
+        ring_stats.pushed, ring_stats.popped, ring_stats.rejected,
+        ring_stats.dropped, GST_TIME_ARGS (ring_stats.latency_max));
+    delete ring;
+  }
+  if (audio_ring) {
+    SspFrameRing *ring = audio_ring;
+    ring->get_stats (&ring_stats);
+    GST_INFO_OBJECT (src, "Audio queue: %" G_GUINT64_FORMAT " pushed, %"
+        G_GUINT64_FORMAT " popped, %" G_GUINT64_FORMAT " rejected, %"
+        G_GUINT64_FORMAT " evicted, max latency %" GST_TIME_FORMAT,
+        ring_stats.pushed, ring_stats.popped, ring_stats.rejected,
+        ring_stats.dropped, GST_TIME_ARGS (ring_stats.latency_max));
+    delete ring;
+  }
+
+  if (src->gop_cache) {
+    SspGopCache *cache = (SspGopCache *) src->gop_cache;
+    SspGopCacheStats cache_stats;
+
+    cache->get_stats (&cache_stats);
+    GST_INFO_OBJECT (src, "GOP cache: %" G_GUINT64_FORMAT " hits, %"
+        G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " oversized GOPs",
+        cache_stats.hits, cache_stats.misses, cache_stats.overflows);
+    delete cache;
+    src->gop_cache = NULL;
+  }
+  GstBuffer *replayed;
+  while ((replayed = (GstBuffer *) g_queue_pop_head (&src->replay_queue)))
+    gst_buffer_unref (replayed);
+  src->replay_pending = FALSE;
+
+  src->started = FALSE;
+  src->connected = FALSE;
+  src->has_video_meta = FALSE;
+  src->has_audio_meta = FALSE;
+  src->video_caps_set = FALSE;
+  src->audio_caps_set = FALSE;
+  gst_caps_replace (&src->video_caps, NULL);
+  gst_caps_replace (&src->audio_caps, NULL);
+  src->audio_caps_changed = FALSE;
+  gst_buffer_replace (&src->param_sets, NULL);
+  
+  /* Reset timestamp tracking */
+  gst_ssp_src_free_timestampers (src);
+  src->tc_valid = FALSE;
+  src->tc_resync = FALSE;
+  src->video_ntp_delta = GST_CLOCK_STIME_NONE;
+  src->audio_ntp_delta = GST_CLOCK_STIME_NONE;
+  GST_OBJECT_LOCK (src);
+  gst_object_replace ((GstObject **) & src->ntp_clock, NULL);
+  GST_OBJECT_UNLOCK (src);
+
+  GstSspAllocatorStats mem_stats;
+  gst_ssp_allocator_get_stats (&mem_stats);
+  GST_INFO_OBJECT (src, "Memory: %" G_GUINT64_FORMAT " borrowed, %"
+      G_GUINT64_FORMAT " released without copy, %" G_GUINT64_FORMAT
+      " fallback copies (%" G_GUINT64_FORMAT " bytes), %" G_GUINT64_FORMAT
+      " block allocations, %" G_GUINT64_FORMAT " reuses",
+      mem_stats.borrowed, mem_stats.released, mem_stats.copies,
+      mem_stats.copied_bytes, mem_stats.allocs, mem_stats.reuses);
+
+  GST_DEBUG_OBJECT (src, "SSP source stopped");
+  return TRUE;
+}
+
+/* Wait on cond until @timeout after @since, forever if @timeout is 0.
+ * FALSE once the deadline has passed. Called with lock held. */
+static gboolean
+gst_ssp_src_wait_until (GstSspSrc * src, GstClockTime since, guint64 timeout)
+{
+  GstClockTime now, deadline;
+
+  if (timeout == 0) {
+    g_cond_wait (&src->cond, &src->lock);
+    return TRUE;
+  }
+
+  now = gst_util_get_timestamp ();
+  deadline = since + timeout;
+  if (now >= deadline)
+    return FALSE;
+  g_cond_wait_until (&src->cond, &src->lock,
+      g_get_monotonic_time () + (gint64) ((deadline - now) / GST_USECOND));
+  return TRUE;
+}
+
+/* Block the first create() until the camera is connected and has sent its
+ * metadata, failing once connect-timeout or meta-timeout expires */
+static GstFlowReturn
+gst_ssp_src_wait_startup (GstSspSrc * src)
+{
+  g_mutex_lock (&src->lock);
+
+  while (!src->connected && !src->flushing) {
+    if (!gst_ssp_src_wait_until (src, src->startup_begin, src->connect_timeout)) {
+      g_mutex_unlock (&src->lock);
+      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+          ("Could not connect to camera at %s:%u", src->ip, src->port),
+          ("No SSP connection after %" GST_TIME_FORMAT,
+              GST_TIME_ARGS (src->connect_timeout)));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  while (!src->has_video_meta && !src->has_audio_meta && src->connected &&
+      !src->flushing) {
+    if (!gst_ssp_src_wait_until (src, src->startup_connected, src->meta_timeout)) {
+      g_mutex_unlock (&src->lock);
+      GST_ELEMENT_ERROR (src, RESOURCE, READ,
+          ("Camera at %s:%u sent no stream metadata", src->ip, src->port),
+          ("No SSP metadata %" GST_TIME_FORMAT " after connecting",
+              GST_TIME_ARGS (src->meta_timeout)));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  if (src->flushing) {
+    g_mutex_unlock (&src->lock);
+    return GST_FLOW_FLUSHING;
+  }
+  /* Lost after the metadata, the supervisor is reconnecting */
+  if (!src->connected && !src->has_video_meta && !src->has_audio_meta) {
+    g_mutex_unlock (&src->lock);
+    GST_ELEMENT_ERROR (src, RESOURCE, READ,
+        ("Camera at %s:%u disconnected during startup", src->ip, src->port),
+        (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  g_mutex_unlock (&src->lock);
+  return GST_FLOW_OK;
+}
+
+/* The first buffer of the stream on the always pad, which starts with a
+ * keyframe. Fails once first-frame-timeout expires after the metadata, so a
+ * camera that never sends a keyframe does not block create() forever.
+ * NULL with GST_FLOW_OK when @ring is flushing or drained. */
+static GstFlowReturn
+gst_ssp_src_pop_first (GstSspSrc * src, SspFrameRing * ring, GstBuffer ** buffer,
+    GstClockTime * queued)
+{
+  gint64 timeout_us = -1;
+  gboolean flushing;
+
+  if (src->first_frame_timeout) {
+    GstClockTime now = gst_util_get_timestamp ();
+    GstClockTime deadline;
+
+    g_mutex_lock (&src->lock);
+    deadline = src->startup_meta + src->first_frame_timeout;
+    g_mutex_unlock (&src->lock);
+    timeout_us = now < deadline ? (gint64) ((deadline - now) / GST_USECOND) : 0;
+  }
+
+  *buffer = ring->pop (timeout_us, queued);
+  if (*buffer || ring->drained ())
+    return GST_FLOW_OK;
+
+  g_mutex_lock (&src->lock);
+  flushing = src->flushing;
+  g_mutex_unlock (&src->lock);
+  if (flushing)
+    return GST_FLOW_OK;
+
+  GST_ELEMENT_ERROR (src, RESOURCE, READ,
+      ("Camera at %s:%u sent no %s keyframe", src->ip, src->port,
+          src->mode == GST_SSP_MODE_AUDIO_ONLY ? "audio" : "video"),
+      ("No first frame %" GST_TIME_FORMAT " after the metadata",
+          GST_TIME_ARGS (src->first_frame_timeout)));
+  return GST_FLOW_ERROR;
+}
+
+/* Report how long each startup phase took, once the first buffer leaves */
+static void
+gst_ssp_src_post_startup (GstSspSrc * src)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  GstStructure *s;
+
+  g_mutex_lock (&src->lock);
+  src->startup_done = TRUE;
+  /* Arms the stall watchdog */
+  g_cond_broadcast (&src->cond);
+  s = gst_structure_new ("ssp-startup",
+      "connect", G_TYPE_UINT64, GST_CLOCK_DIFF (src->startup_begin, src->startup_connected),
+      "metadata", G_TYPE_UINT64, GST_CLOCK_DIFF (src->startup_connected, src->startup_meta),
+      "first-frame", G_TYPE_UINT64, GST_CLOCK_DIFF (src->startup_meta, src->startup_first_frame),
+      "first-buffer", G_TYPE_UINT64, GST_CLOCK_DIFF (src->startup_first_frame, now),
+      "total", G_TYPE_UINT64, GST_CLOCK_DIFF (src->startup_begin, now),
+      NULL);
+  g_mutex_unlock (&src->lock);
+
+  GST_INFO_OBJECT (src, "Startup: %" GST_PTR_FORMAT, s);
+  gst_element_post_message (GST_ELEMENT (src),
+      gst_message_new_element (GST_OBJECT (src), s));
+}
+
+static void
+gst_ssp_src_post_element (GstSspSrc * src, GstStructure * s)
+{
+  gst_element_post_message (GST_ELEMENT (src),
+      gst_message_new_element (GST_OBJECT (src), s));
+}
+
+/* Ask the supervisor for a new connection. Called from the loop thread.
+ * Before the metadata the first create() fails instead; after it the
+ * stream has started even if no keyframe was pushed yet, and create() is
+ * waiting for one. */
+static void
+gst_ssp_src_request_reconnect (GstSspSrc * src, const gchar * reason)
+{
+  g_mutex_lock (&src->lock);
+  if (src->reconnecting) {
+    /* The attempt in progress is lost as well */
+    src->reconnect_attempt_failed = TRUE;
+  } else if ((src->has_video_meta || src->has_audio_meta) &&
+      !src->reconnect_requested) {
+    src->reconnect_requested = TRUE;
+    src->disconnect_reason = reason;
+  }
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->lock);
+}
+
+/* reconnect-delay doubled per attempt up to reconnect-max-delay, plus up to
+ * 20% jitter so cameras dropped together do not come back in lockstep */
+static GstClockTime
+gst_ssp_src_backoff (GstSspSrc * src, guint attempt)
+{
+  GstClockTime delay = src->reconnect_delay;
+
+  while (--attempt > 0 && delay < src->reconnect_max_delay)
+    delay *= 2;
+  delay = MIN (delay, src->reconnect_max_delay);
+
+  return delay + (GstClockTime) (g_random_double () * delay / 5);
+}
+
+/* Tear down the SSP thread and start a new one. Called with lock held. */
+static gboolean
+gst_ssp_src_restart_client (GstSspSrc * src)
+{
+  SspThread *ssp_thread = (SspThread *) src->ssp_thread;
+  SspFrameRing *video_ring = (SspFrameRing *) src->video_ring;
+  SspFrameRing *audio_ring = (SspFrameRing *) src->audio_ring;
+  gboolean ret;
+
+  g_mutex_unlock (&src->lock);
+
+  /* With overflow-policy=block the loop thread may be waiting for room,
+   * frames already queued still go out */
+  video_ring->set_producer_flushing (TRUE);
+  audio_ring->set_producer_flushing (TRUE);
+  ssp_thread->stop ();
+  video_ring->set_producer_flushing (FALSE);
+  audio_ring->set_producer_flushing (FALSE);
+
+  /* No loop thread is running: reset its state for the new connection.
+   * Caps are only set again from the next keyframe, and only sent
+   * downstream if they changed. */
+  src->video_caps_set = FALSE;
+  src->audio_caps_set = FALSE;
+  src->video_discont = TRUE;
+  src->audio_discont = TRUE;
+  src->tc_resync = TRUE;
+  src->video_ntp_delta = GST_CLOCK_STIME_NONE;
+  src->audio_ntp_delta = GST_CLOCK_STIME_NONE;
+  ((SspStreamStats *) src->video_stats)->restart ();
+  ((SspStreamStats *) src->audio_stats)->restart ();
+  /* The new connection's frames do not reference the cached GOP */
+  if (src->gop_cache)
+    ((SspGopCache *) src->gop_cache)->invalidate ();
+
+  g_mutex_lock (&src->lock);
+  src->connected = FALSE;
+  src->reconnect_attempt_failed = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  ret = gst_ssp_src_start_client (src);
+
+  g_mutex_lock (&src->lock);
+  return ret;
+}
+
+/* Reconnect until it works, reconnect-attempts runs out or the element
+ * stops. Called with lock held. */
+static void
+gst_ssp_src_reconnect (GstSspSrc * src)
+{
+  const gchar *reason = src->disconnect_reason;
+  GstClockTime start = gst_util_get_timestamp ();
+  guint attempt;
+
+  src->reconnecting = TRUE;
+  src->outage_start = start;
+  g_mutex_unlock (&src->lock);
+
+  g_atomic_int_inc (&src->disconnects);
+  GST_WARNING_OBJECT (src, "Lost camera at %s:%u (%s)", src->ip, src->port, reason);
+  gst_ssp_src_post_element (src, gst_structure_new ("ssp-disconnected",
+          "reason", G_TYPE_STRING, reason, NULL));
+
+  if (!src->reconnect) {
+    GST_ELEMENT_ERROR (src, RESOURCE, READ,
+        ("Lost connection to camera at %s:%u", src->ip, src->port),
+        ("%s, reconnect disabled", reason));
+    g_mutex_lock (&src->lock);
+    src->reconnecting = FALSE;
+    return;
+  }
+
+  g_mutex_lock (&src->lock);
+  for (attempt = 1; !src->reconnect_stop; attempt++) {
+    GstClockTime delay, now;
+
+    if (src->reconnect_attempts && attempt > src->reconnect_attempts) {
+      g_mutex_unlock (&src->lock);
+      GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ,
+          ("Could not reconnect to camera at %s:%u", src->ip, src->port),
+          ("Gave up after %u attempts", src->reconnect_attempts));
+      g_mutex_lock (&src->lock);
+      break;
+    }
+
+    /* A stalled connection is still up, replace it right away */
+    if (attempt == 1 && g_str_equal (reason, "stall"))
+      delay = 0;
+    else
+      delay = gst_ssp_src_backoff (src, attempt);
+    g_mutex_unlock (&src->lock);
+
+    GST_INFO_OBJECT (src, "Reconnect attempt %u in %" GST_TIME_FORMAT,
+        attempt, GST_TIME_ARGS (delay));
+    gst_ssp_src_post_element (src, gst_structure_new ("ssp-reconnecting",
+            "attempt", G_TYPE_UINT, attempt,
+            "delay", G_TYPE_UINT64, delay,
+            "outage", G_TYPE_UINT64, gst_util_get_timestamp () - start, NULL));
+
+    g_mutex_lock (&src->lock);
+    now = gst_util_get_timestamp ();
+    while (delay > 0 && !src->reconnect_stop &&
+        gst_ssp_src_wait_until (src, now, delay));
+    if (src->reconnect_stop)
+      break;
+
+    if (!gst_ssp_src_restart_client (src))
+      continue;
+
+    now = gst_util_get_timestamp ();
+    while (!src->connected && !src->reconnect_attempt_failed &&
+        !src->reconnect_stop &&
+        gst_ssp_src_wait_until (src, now, src->connect_timeout));
+
+    if (src->connected) {
+      GST_INFO_OBJECT (src, "Reconnected after %u attempts", attempt);
+      g_atomic_int_inc (&src->reconnects);
+      src->outage_attempts = attempt;
+      src->outage_connected = gst_util_get_timestamp ();
+      src->recovering = TRUE;
+      /* The watchdog gives the new connection the same grace */
+      src->last_arrival = src->outage_connected;
+      break;
+    }
+  }
+  src->reconnecting = FALSE;
+}
+
+/* How long the always pad's stream may go without a frame, NONE while the
+ * watchdog is off. Called with lock held. */
+static GstClockTime
+gst_ssp_src_stall_timeout (GstSspSrc * src)
+{
+  if (src->stall_frames == 0 || !src->startup_done || !src->connected ||
+      !GST_CLOCK_TIME_IS_VALID (src->last_arrival) ||
+      !GST_CLOCK_TIME_IS_VALID (src->frame_interval) || src->frame_interval == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  return src->stall_frames * src->frame_interval;
+}
+
+/* The stall timeout expired. Called with lock held. */
+static void
+gst_ssp_src_stalled (GstSspSrc * src)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  GstClockTime gap = now - src->last_arrival;
+  GstClockTime interval = src->frame_interval;
+  SspFrameRing *ring = gst_ssp_src_get_src_ring (src);
+
+  /* overflow-policy=block holds the loop thread itself, not the camera */
+  if (src->overflow_policy == GST_SSP_OVERFLOW_BLOCK && ring->full (1)) {
+    src->last_arrival = now;
+    return;
+  }
+
+  src->reconnect_requested = TRUE;
+  src->disconnect_reason = "stall";
+  g_mutex_unlock (&src->lock);
+
+  GST_WARNING_OBJECT (src, "Stream stalled: no frame for %" GST_TIME_FORMAT
+      ", expected every %" GST_TIME_FORMAT, GST_TIME_ARGS (gap),
+      GST_TIME_ARGS (interval));
+  gst_ssp_src_post_element (src, gst_structure_new ("ssp-stall",
+          "gap", G_TYPE_UINT64, gap,
+          "frame-interval", G_TYPE_UINT64, interval, NULL));
+
+  g_mutex_lock (&src->lock);
+}
+
+/* Supervisor: replaces lost connections and watches for stalled ones */
+static gpointer
+gst_ssp_src_reconnect_loop (gpointer user_data)
+{
+  GstSspSrc *src = GST_SSP_SRC (user_data);
+
+  g_mutex_lock (&src->lock);
+  while (!src->reconnect_stop) {
+    GstClockTime timeout;
+
+    if (src->reconnect_requested) {
+      src->reconnect_requested = FALSE;
+      gst_ssp_src_reconnect (src);
+      continue;
+    }
+
+    timeout = gst_ssp_src_stall_timeout (src);
+    if (!GST_CLOCK_TIME_IS_VALID (timeout))
+      g_cond_wait (&src->cond, &src->lock);
+    else if (!gst_ssp_src_wait_until (src, src->last_arrival, timeout))
+      gst_ssp_src_stalled (src);
+  }
+  g_mutex_unlock (&src->lock);
+
+  return NULL;
+}
+
+static void
+gst_ssp_src_post_recovered (GstSspSrc * src)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  GstStructure *s;
+
+  g_mutex_lock (&src->lock);
+  if (!src->recovering) {
+    g_mutex_unlock (&src->lock);
+    return;
+  }
+  src->recovering = FALSE;
+  s = gst_structure_new ("ssp-recovered",
+      "attempts", G_TYPE_UINT, src->outage_attempts,
+      "reconnect", G_TYPE_UINT64, GST_CLOCK_DIFF (src->outage_start, src->outage_connected),
+      "outage", G_TYPE_UINT64, GST_CLOCK_DIFF (src->outage_start, now),
+      NULL);
+  g_mutex_unlock (&src->lock);
+
+  GST_INFO_OBJECT (src, "Recovered: %" GST_PTR_FORMAT, s);
+  gst_ssp_src_post_element (src, s);
+}
+
+/* First frame of a stream after a reconnect, on the loop thread: flag it
+ * discont and have its pad send a new segment first. The stream carried by
+ * the always pad reports the end of the outage. */
+static void
+gst_ssp_src_resume_stream (GstSspSrc * src, GstBuffer * buffer, gboolean audio)
+{
+  GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+
+  g_mutex_lock (&src->lock);
+  if (audio && src->mode == GST_SSP_MODE_BOTH)
+    src->audio_segment_pending = TRUE;
+  else
+    src->segment_pending = TRUE;
+  g_mutex_unlock (&src->lock);
+
+  if (audio == (src->mode == GST_SSP_MODE_AUDIO_ONLY))
+    gst_ssp_src_post_recovered (src);
+}
+
+/* Whether @buffer is the first on its pad after a reconnect and needs a
+ * new segment ahead of it */
+static gboolean
+gst_ssp_src_take_resume_segment (GstSspSrc * src, GstBuffer * buffer,
+    gboolean * pending)
+{
+  gboolean ret;
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT))
+    return FALSE;
+
+  g_mutex_lock (&src->lock);
+  ret = *pending;
+  *pending = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  return ret;
+}
+
+/* Ask create() to start over from the cached keyframe */
+static gboolean
+gst_ssp_src_request_replay (GstSspSrc * src, const gchar * reason)
+{
+  if (!src->gop_cache)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (src, "GOP replay requested (%s)", reason);
+  g_mutex_lock (&src->lock);
+  src->replay_pending = TRUE;
+  g_mutex_unlock (&src->lock);
+  return TRUE;
+}
+
+/* Queue the cached GOP up to the last frame pushed, so downstream gets its
+ * keyframe and every reference again, behind a DISCONT and a new segment.
+ * In live mode the replay is squeezed into the first half of the interval
+ * after the last frame pushed, so no timestamp goes back on any branch
+ * behind the pad, and all but its last frame are decode-only. Streaming
+ * thread. */
+static void
+gst_ssp_src_prepare_replay (GstSspSrc * src)
+{
+  SspGopCache *cache = (SspGopCache *) src->gop_cache;
+  GQueue frames = G_QUEUE_INIT;
+  GstClockTime step = 0;
+  GstBuffer *frame;
+  gboolean pending;
+  guint n, i;
+
+  g_mutex_lock (&src->lock);
+  pending = src->replay_pending;
+  src->replay_pending = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  if (!pending || src->last_video_offset == GST_BUFFER_OFFSET_NONE ||
+      !g_queue_is_empty (&src->replay_queue))
+    return;
+
+  if (!cache->snapshot (src->last_video_offset, &frames)) {
+    GST_INFO_OBJECT (src, "GOP cache miss, waiting for the next keyframe");
+    return;
+  }
+
+  n = frames.length;
+  GST_INFO_OBJECT (src, "Replaying %u frames from the GOP cache", n);
+  /* The next live frame is due one interval after the last one, half of it
+   * leaves room for jitter */
+  if (n > 0 && GST_CLOCK_TIME_IS_VALID (src->last_video_duration))
+    step = src->last_video_duration / (2 * n);
+
+  for (i = 0; (frame = (GstBuffer *) g_queue_pop_head (&frames)); i++) {
+    /* Shares the memory, timestamps and flags become our own */
+    GstBuffer *buffer = gst_buffer_copy (frame);
+    GstSspIngestMeta *meta = gst_buffer_get_ssp_ingest_meta (buffer);
+    gst_buffer_unref (frame);
+
+    /* Replays were not received now, keep them out of the latency data */
+    if (meta)
+      gst_buffer_remove_meta (buffer, (GstMeta *) meta);
+
+    if (i == 0) {
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+      g_mutex_lock (&src->lock);
+      src->segment_pending = TRUE;
+      g_mutex_unlock (&src->lock);
+    }
+
+    if (src->gop_replay == GST_SSP_GOP_REPLAY_LIVE &&
+        GST_CLOCK_TIME_IS_VALID (src->last_video_pts)) {
+      GstClockTime pts = src->last_video_pts + (i + 1) * step;
+
+      GST_BUFFER_PTS (buffer) = pts;
+      GST_BUFFER_DTS (buffer) = pts;
+      if (i < n - 1) {
+        GST_BUFFER_DURATION (buffer) = step;
+        GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+      } else if (GST_CLOCK_TIME_IS_VALID (src->last_video_duration)) {
+        /* Shown until the next live frame */
+        GST_BUFFER_DURATION (buffer) = src->last_video_duration - n * step;
+      }
+    }
+    g_queue_push_tail (&src->replay_queue, buffer);
+  }
+}
+
+/* Name, pin and prioritize the calling streaming thread. GstTask keeps its
+ * thread while paused, a new one only comes with a new start. The thread
+ * belongs to the task pool: what it was is saved in @sched and put back
+ * by gst_ssp_src_release_streaming_thread(). */
+static void
+gst_ssp_src_setup_streaming_thread (GstSspSrc * src, const gchar * role,
+    GThread ** thread, gint * tid, gpointer * sched)
+{
+  SspSchedParams params;
+  gchar *name;
+  gint id;
+
+  params.cpus = src->streaming_cpus;
+  params.policy = (SspSchedPolicy) src->sched_policy;
+  params.priority = src->sched_priority;
+  params.nice = src->nice;
+
+  if (*sched == NULL)
+    *sched = ssp_sched_save_self ();
+
+  name = g_strdup_printf ("ssp-%s-%s", role, src->ip);
+  id = ssp_sched_apply_self (name, &params);
+  GST_DEBUG_OBJECT (src, "Streaming thread %s is %d", name, id);
+  g_free (name);
+
+  *thread = g_thread_self ();
+  g_mutex_lock (&src->lock);
+  *tid = id;
+  g_mutex_unlock (&src->lock);
+}
+
+/* The task is leaving the calling thread, hand it back to the pool as it
+ * came */
+static void
+gst_ssp_src_release_streaming_thread (GstSspSrc * src, GThread ** thread,
+    gint * tid, gpointer * sched)
+{
+  GST_DEBUG_OBJECT (src, "Streaming thread %d left", *tid);
+  ssp_sched_restore_self ((SspSchedState *) *sched);
+  *sched = NULL;
+
+  *thread = NULL;
+  g_mutex_lock (&src->lock);
+  *tid = 0;
+  g_mutex_unlock (&src->lock);
+}
+
+static GstFlowReturn
+gst_ssp_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+{
+  GstSspSrc *src = GST_SSP_SRC (psrc);
+  GstBuffer *buffer = NULL;
+  GstClockTime queued = GST_CLOCK_TIME_NONE;
+  GstSspIngestMeta *meta;
+
+  if (!src->started) {
+    return GST_FLOW_ERROR;
+  }
+
+  if (G_UNLIKELY (src->src_thread != g_thread_self ()))
+    gst_ssp_src_setup_streaming_thread (src, "src", &src->src_thread,
+        &src->src_tid, &src->src_sched);
+
+  /* Connection and metadata are signalled on cond, no polling */
+  if (!src->startup_done) {
+    GstFlowReturn ret = gst_ssp_src_wait_startup (src);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
+
+  if (src->gop_cache)
+    gst_ssp_src_prepare_replay (src);
+
+  buffer = (GstBuffer *) g_queue_pop_head (&src->replay_queue);
+  if (buffer == NULL) {
+    /* Block until the stream carried by this pad has a buffer */
+    SspFrameRing *ring = gst_ssp_src_get_src_ring (src);
+    GST_DEBUG_OBJECT (src, "Waiting for buffer from queue (length=%u)", ring->length ());
+    if (!src->startup_done) {
+      GstFlowReturn ret = gst_ssp_src_pop_first (src, ring, &buffer, &queued);
+      if (ret != GST_FLOW_OK)
+        return ret;
+    } else {
+      buffer = ring->pop (-1, &queued);
+    }
+    if (buffer) {
+      GST_DEBUG_OBJECT (src, "Got buffer of size %zu", gst_buffer_get_size(buffer));
+    }
+
+    if (buffer == NULL) {
+      if (ring->drained ()) {
+        GST_DEBUG_OBJECT (src, "Replay finished and queue drained");
+        return GST_FLOW_EOS;
+      }
+      GST_DEBUG_OBJECT (src, "No buffer received, flushing");
+      return GST_FLOW_FLUSHING;
+    }
+
+    GST_LOG_OBJECT (src, "Buffer spent %" GST_TIME_FORMAT " in queue",
+        GST_TIME_ARGS (queued));
+
+    /* The GOP cache holds a ref on video frames: stamp a buffer of our
+     * own, which shares the memory and copies the metas */
+    meta = gst_buffer_get_ssp_ingest_meta (buffer);
+    if (meta) {
+      buffer = gst_buffer_make_writable (buffer);
+      meta = gst_buffer_get_ssp_ingest_meta (buffer);
+      meta->dequeued = gst_util_get_timestamp ();
+    }
+
+    /* Where a replay from the GOP cache has to stop */
+    if (src->mode != GST_SSP_MODE_AUDIO_ONLY) {
+      src->last_video_offset = GST_BUFFER_OFFSET (buffer);
+      src->last_video_pts = GST_BUFFER_PTS (buffer);
+      src->last_video_duration = GST_BUFFER_DURATION (buffer);
+    }
+  }
+
+  /* Apply caps the loop thread computed for this stream: audio caps as
+   * soon as they change, video caps with the keyframe they belong to */
+  GstCaps *caps = NULL;
+  if (src->mode == GST_SSP_MODE_AUDIO_ONLY) {
+    g_mutex_lock (&src->lock);
+    if (src->audio_caps_changed) {
+      caps = gst_caps_ref (src->audio_caps);
+      src->audio_caps_changed = FALSE;
+    }
+    g_mutex_unlock (&src->lock);
+  } else {
+    GstSspCapsMeta *caps_meta = gst_buffer_get_ssp_caps_meta (buffer);
+
+    if (caps_meta) {
+      GstCaps *current = gst_pad_get_current_caps (GST_BASE_SRC_PAD (src));
+
+      if (!current || !gst_caps_is_equal (current, caps_meta->caps))
+        caps = gst_caps_ref (caps_meta->caps);
+      if (current)
+        gst_caps_unref (current);
+
+      buffer = gst_buffer_make_writable (buffer);
+      gst_buffer_remove_meta (buffer,
+          (GstMeta *) gst_buffer_get_ssp_caps_meta (buffer));
+    }
+  }
+
+  if (caps) {
+    GST_INFO_OBJECT (src, "Setting caps %" GST_PTR_FORMAT, caps);
+    if (!gst_base_src_set_caps (GST_BASE_SRC (src), caps)) {
+      gst_caps_unref (caps);
+      gst_buffer_unref (buffer);
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
+    gst_caps_unref (caps);
+  }
+
+  if (gst_ssp_src_take_resume_segment (src, buffer, &src->segment_pending)) {
+    GstSegment segment;
+
+    GST_OBJECT_LOCK (src);
+    gst_segment_copy_into (&GST_BASE_SRC (src)->segment, &segment);
+    GST_OBJECT_UNLOCK (src);
+    GST_DEBUG_OBJECT (src, "New segment after a reconnect or GOP replay");
+    gst_pad_push_event (GST_BASE_SRC_PAD (src), gst_event_new_segment (&segment));
+  }
+
+  GST_DEBUG_OBJECT (src, "Returning buffer with PTS %" GST_TIME_FORMAT, 
+                    GST_TIME_ARGS(GST_BUFFER_PTS(buffer)));
+
+  if (!src->startup_done)
+    gst_ssp_src_post_startup (src);
+
+  meta = gst_buffer_get_ssp_ingest_meta (buffer);
+  if (meta) {
+    /* Replayed frames are copies already, nothing is copied here */
+    buffer = gst_buffer_make_writable (buffer);
+    meta = gst_buffer_get_ssp_ingest_meta (buffer);
+    meta->pushed = gst_util_get_timestamp ();
+  }
+
+  *buf = buffer;
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_ssp_src_unlock (GstBaseSrc * basesrc)
+{
+  GstSspSrc *src = GST_SSP_SRC (basesrc);
+  
+  /* Wake up create() if it is blocked on startup or its queue, the audio
+   * pad is flushed separately */
+  g_mutex_lock (&src->lock);
+  src->flushing = TRUE;
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->lock);
+
+  SspFrameRing *ring = gst_ssp_src_get_src_ring (src);
+  if (ring)
+    ring->set_flushing (TRUE);
+  
+  return TRUE;
+}
+
+static gboolean
+gst_ssp_src_unlock_stop (GstBaseSrc * basesrc)
+{
+  GstSspSrc *src = GST_SSP_SRC (basesrc);
+  
+  g_mutex_lock (&src->lock);
+  src->flushing = FALSE;
+  g_mutex_unlock (&src->lock);
+
+  SspFrameRing *ring = gst_ssp_src_get_src_ring (src);
+  if (ring)
+    ring->set_flushing (FALSE);
+  
+  return TRUE;
+}
+
+static void
+gst_ssp_src_audio_loop (GstPad * pad)
+{
+  GstSspSrc *src = GST_SSP_SRC (GST_PAD_PARENT (pad));
+  SspFrameRing *ring = (SspFrameRing *) src->audio_ring;
+  GstSspIngestMeta *meta;
+  GstBuffer *buffer;
+  GstCaps *caps = NULL;
+  GstFlowReturn ret;
+
+  if (G_UNLIKELY (src->audio_thread != g_thread_self ()))
+    gst_ssp_src_setup_streaming_thread (src, "audio", &src->audio_thread,
+        &src->audio_tid, &src->audio_sched);
+
+  if (!src->audio_stream_started) {
+    gchar *stream_id;
+    GstEvent *event;
+
+    stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT_CAST (src), "audio");
+    event = gst_event_new_stream_start (stream_id);
+    gst_event_set_group_id (event, gst_util_group_id_next ());
+    gst_pad_push_event (pad, event);
+    g_free (stream_id);
+    src->audio_stream_started = TRUE;
+  }
+
+  buffer = ring->pop ();
+  if (buffer == NULL) {
+    gst_pad_pause_task (pad);
+    if (ring->drained ()) {
+      GST_DEBUG_OBJECT (pad, "Replay finished, pausing audio task");
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    } else {
+      GST_DEBUG_OBJECT (pad, "Flushing, pausing audio task");
+    }
+    return;
+  }
+
+  meta = gst_buffer_get_ssp_ingest_meta (buffer);
+  if (meta)
+    meta->dequeued = gst_util_get_timestamp ();
+
+  g_mutex_lock (&src->lock);
+  if (src->audio_caps_changed) {
+    caps = gst_caps_ref (src->audio_caps);
+    src->audio_caps_changed = FALSE;
+  }
+  g_mutex_unlock (&src->lock);
+
+  if (caps) {
+    GST_INFO_OBJECT (pad, "Setting caps %" GST_PTR_FORMAT, caps);
+    gst_pad_push_event (pad, gst_event_new_caps (caps));
+    gst_caps_unref (caps);
+  }
+
+  if (src->audio_need_segment ||
+      gst_ssp_src_take_resume_segment (src, buffer, &src->audio_segment_pending)) {
+    GstSegment segment;
+
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    gst_pad_push_event (pad, gst_event_new_segment (&segment));
+    src->audio_need_segment = FALSE;
+  }
+
+  if (meta)
+    meta->pushed = gst_util_get_timestamp ();
+  ret = gst_pad_push (pad, buffer);
+  if (ret == GST_FLOW_OK)
+    return;
+
+  if (ret == GST_FLOW_NOT_LINKED) {
+    /* Audio is optional, never let it stall or fail the video stream */
+    GST_LOG_OBJECT (pad, "Audio pad not linked, dropping buffer");
+    return;
+  }
+
+  GST_DEBUG_OBJECT (pad, "Pausing audio task, reason %s", gst_flow_get_name (ret));
+  gst_pad_pause_task (pad);
+
+  if (ret == GST_FLOW_EOS || ret < GST_FLOW_EOS) {
+    if (ret != GST_FLOW_EOS)
+      GST_ELEMENT_FLOW_ERROR (src, ret);
+    gst_pad_push_event (pad, gst_event_new_eos ());
+  }
+}
+
+static gboolean
+gst_ssp_src_audio_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:
+      /* Live, we can't produce a buffer before it was received */
+      gst_query_set_latency (query, TRUE, 0, GST_CLOCK_TIME_NONE);
+      return TRUE;
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+/* Running time for a camera NTP time, FALSE until the element has a clock.
+ * NTP time is wall-clock time, so it maps onto the clock through the clock's
+ * own relation to the wall clock, taken once per clock: every source on the
+ * same clock, in any pipeline, then gives frames captured at the same
+ * instant the same absolute time. */
+static gboolean
+gst_ssp_src_ntp_to_running_time (GstSspSrc * src, GstClockTime ntp_ns,
+    GstClockTime * running)
+{
+  GstClock *clock;
+  GstClockTime base_time;
+  GstClockTimeDiff abs_time;
+
+  GST_OBJECT_LOCK (src);
+  clock = GST_ELEMENT_CLOCK (src);
+  if (clock == NULL) {
+    GST_OBJECT_UNLOCK (src);
+    return FALSE;
+  }
+  if (clock != src->ntp_clock) {
+    GstClock *old = src->ntp_clock;
+
+    src->ntp_clock = (GstClock *) gst_object_ref (clock);
+    src->ntp_offset = (GstClockTimeDiff) gst_clock_get_time (clock) -
+        (GstClockTimeDiff) SspTimestamper::ntp_now ();
+    GST_DEBUG_OBJECT (src, "NTP offset %" GST_STIME_FORMAT " on %" GST_PTR_FORMAT,
+        GST_STIME_ARGS (src->ntp_offset), clock);
+    if (old)
+      gst_object_unref (old);
+  }
+  abs_time = (GstClockTimeDiff) ntp_ns + src->ntp_offset;
+  base_time = GST_ELEMENT_CAST (src)->base_time;
+  GST_OBJECT_UNLOCK (src);
+
+  if (abs_time < (GstClockTimeDiff) base_time)
+    return FALSE;
+
+  *running = abs_time - base_time;
+  return TRUE;
+}
+
+/* FALSE for a frame to drop. With timestamp-mode=ntp a stream stays in
+ * NTP time: frames before its first NTP time are dropped, and a frame
+ * without one is placed by its camera time relative to the last frame that
+ * had one, until a discontinuity in the camera time breaks that relation. */
+static gboolean
+gst_ssp_src_apply_ntp (GstSspSrc * src, GstBuffer * buffer,
+    guint64 ntp_timestamp, GstClockTimeDiff * ntp_delta)
 {
-  GstSspSrc *src = GST_SSP_SRC (basesrc);
-  SspThread *ssp_thread = (SspThread *) src->ssp_thread;
+  GstClockTime ntp_ns = SspTimestamper::ntp_to_ns (ntp_timestamp);
+  GstClockTimeDiff pts = (GstClockTimeDiff) GST_BUFFER_PTS (buffer);
+  GstClockTime running;
 
-  GST_DEBUG_OBJECT (src, "Stopping SSP source");
+  if (GST_CLOCK_TIME_IS_VALID (ntp_ns))
+    gst_buffer_add_reference_timestamp_meta (buffer, ntp_caps, ntp_ns,
+        GST_CLOCK_TIME_NONE);
 
-  if (ssp_thread) {
-    ssp_thread->stop ();
-    delete ssp_thread;
-    src->ssp_thread = NULL;
-  }
+  if (src->timestamp_mode != GST_SSP_TIMESTAMP_NTP || !src->pts_is_wall_clock)
+    return TRUE;
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT))
+    *ntp_delta = GST_CLOCK_STIME_NONE;
 
-  /* Clear queues */
-  gpointer buffer;
-  while ((buffer = g_async_queue_try_pop (src->video_queue)) != NULL) {
-    gst_buffer_unref (GST_BUFFER (buffer));
+  if (GST_CLOCK_TIME_IS_VALID (ntp_ns) &&
+      gst_ssp_src_ntp_to_running_time (src, ntp_ns, &running)) {
+    *ntp_delta = (GstClockTimeDiff) running - pts;
+  } else if (*ntp_delta != GST_CLOCK_STIME_NONE && pts + *ntp_delta >= 0) {
+    running = pts + *ntp_delta;
+  } else {
+    GST_LOG_OBJECT (src, "Dropping frame without NTP time to anchor it");
+    return FALSE;
   }
-  while ((buffer = g_async_queue_try_pop (src->audio_queue)) != NULL) {
-    gst_buffer_unref (GST_BUFFER (buffer));
+
+  GST_BUFFER_PTS (buffer) = running;
+  GST_BUFFER_DTS (buffer) = running;
+  return TRUE;
+}
+
+/* Start a frame's GstSspIngestMeta when asked for or traced. The capture
+ * time maps the camera's wall clock onto ours through the current offset
+ * between the two, which only holds with NTP/PTP synchronized clocks. */
+static void
+gst_ssp_src_add_ingest_meta (GstSspSrc * src, GstBuffer * buffer,
+    GQuark origin, GstClockTime received, guint64 ntp_timestamp)
+{
+  GstClockTime ntp_ns = SspTimestamper::ntp_to_ns (ntp_timestamp);
+  GstSspIngestMeta *meta;
+
+  if (!src->ingest_meta && !gst_ssp_latency_tracer_is_active ())
+    return;
+
+  meta = gst_buffer_add_ssp_ingest_meta (buffer, origin);
+  meta->received = received;
+  if (GST_CLOCK_TIME_IS_VALID (ntp_ns)) {
+    GstClockTimeDiff capture = (GstClockTimeDiff) received +
+        GST_CLOCK_DIFF (SspTimestamper::ntp_now (), ntp_ns);
+
+    if (capture >= 0)
+      meta->capture = capture;
   }
+}
 
-  src->started = FALSE;
-  src->connected = FALSE;
-  src->has_video_meta = FALSE;
-  src->has_audio_meta = FALSE;
-  src->video_caps_set = FALSE;
-  src->audio_caps_set = FALSE;
-  
-  /* Reset timestamp tracking */
-  src->timestamp = 0;
-  src->first_timestamp = GST_CLOCK_TIME_NONE;
+/* SSP packs the timecode as HH:MM:SS:FF, one field per byte. Whether the
+ * bytes are BCD or binary is the camera's, given by timecode-format: many
+ * values are valid either way (0x16 is 16 in BCD, 22 in binary), so the
+ * layout cannot be told from the value. */
+static guint
+ssp_timecode_field (guint32 timecode, guint shift, gboolean bcd)
+{
+  guint v = (timecode >> shift) & 0xff;
 
-  GST_DEBUG_OBJECT (src, "SSP source stopped");
-  return TRUE;
+  return bcd ? (v >> 4) * 10 + (v & 0x0f) : v;
 }
 
-static GstFlowReturn
-gst_ssp_src_create (GstPushSrc * psrc, GstBuffer ** buf)
+/* Re-anchor the running timecode on the last SSP timecode at this frame */
+static void
+gst_ssp_src_resync_timecode (GstSspSrc * src, guint32 frm_no)
 {
-  GstSspSrc *src = GST_SSP_SRC (psrc);
-  GstBuffer *buffer = NULL;
+  gboolean bcd = src->timecode_format == GST_SSP_TIMECODE_BCD;
+  guint fps_n = src->video_timescale, fps_d = src->video_unit;
+  GstVideoTimeCodeFlags flags = GST_VIDEO_TIME_CODE_FLAGS_NONE;
 
-  if (!src->started) {
-    return GST_FLOW_ERROR;
+  src->tc_resync = FALSE;
+  src->tc_valid = FALSE;
+
+  if (fps_n == 0 || fps_d == 0)
+    return;
+
+  /* e.g. 90000/3003 -> 30000/1001, drop-frame is only valid for the latter */
+  guint gcd = gst_util_greatest_common_divisor (fps_n, fps_d);
+  fps_n /= gcd;
+  fps_d /= gcd;
+
+  if (src->tc_drop_frame)
+    flags = GST_VIDEO_TIME_CODE_FLAGS_DROP_FRAME;
+
+  gst_video_time_code_clear (&src->tc);
+  gst_video_time_code_init (&src->tc, fps_n, fps_d, NULL, flags,
+      ssp_timecode_field (src->timecode, 24, bcd),
+      ssp_timecode_field (src->timecode, 16, bcd),
+      ssp_timecode_field (src->timecode, 8, bcd),
+      ssp_timecode_field (src->timecode, 0, bcd), 0);
+
+  if (!gst_video_time_code_is_valid (&src->tc)) {
+    GST_WARNING_OBJECT (src, "Invalid SSP timecode 0x%08x at %u/%u fps%s",
+        src->timecode, fps_n, fps_d, src->tc_drop_frame ? " drop-frame" : "");
+    return;
   }
 
-  /* Wait for connection if not connected yet */
-  g_mutex_lock (&src->lock);
-  while (!src->connected && src->started) {
-    g_cond_wait (&src->cond, &src->lock);
+  src->tc_valid = TRUE;
+  src->tc_frm_no = frm_no;
+  GST_DEBUG_OBJECT (src, "Timecode anchored at frame %u", frm_no);
+}
+
+/* O(1) per frame: advance by the frame number delta and copy into the meta,
+ * no GDateTime or string is involved */
+static void
+gst_ssp_src_apply_timecode (GstSspSrc * src, GstBuffer * buffer, guint32 frm_no)
+{
+  guint32 delta;
+
+  if (src->tc_resync)
+    gst_ssp_src_resync_timecode (src, frm_no);
+
+  if (!src->tc_valid)
+    return;
+
+  /* Unsigned difference handles frm_no wrap, a step back or a gap of more
+   * than a day means the counter restarted. The last camera timecode no
+   * longer describes these frames, so none is attached until the camera
+   * sends a new one. */
+  delta = frm_no - src->tc_frm_no;
+  if (delta > 24 * 3600 * (src->video_timescale / src->video_unit + 1)) {
+    GST_DEBUG_OBJECT (src, "Frame number jumped from %u to %u, no timecode "
+        "until the next camera timecode", src->tc_frm_no, frm_no);
+    src->tc_valid = FALSE;
+    return;
   }
-  g_mutex_unlock (&src->lock);
 
-  if (!src->connected) {
-    GST_DEBUG_OBJECT (src, "Not connected, returning error");
-    return GST_FLOW_ERROR;
+  if (delta > 0)
+    gst_video_time_code_add_frames (&src->tc, delta);
+  src->tc_frm_no = frm_no;
+
+  gst_buffer_add_video_time_code_meta (buffer, &src->tc);
+}
+
+static void
+gst_ssp_src_begin_drops (GstSspSrc * src, GstSspDropEpisode * drops,
+    const gchar * reason)
+{
+  if (drops->active)
+    return;
+  drops->active = TRUE;
+  drops->reason = reason;
+  drops->frames = 0;
+  drops->bytes = 0;
+  drops->start = gst_util_get_timestamp ();
+}
+
+/* Called once a frame goes through again */
+static void
+gst_ssp_src_end_drops (GstSspSrc * src, GstSspDropEpisode * drops,
+    const gchar * stream)
+{
+  GEnumValue *policy;
+  GstStructure *s;
+
+  if (!drops->active)
+    return;
+  drops->active = FALSE;
+
+  policy = g_enum_get_value ((GEnumClass *) g_type_class_peek (GST_TYPE_SSP_OVERFLOW_POLICY),
+      src->overflow_policy);
+  GST_WARNING_OBJECT (src, "%s overflow (%s): dropped %" G_GUINT64_FORMAT
+      " frames, %" G_GUINT64_FORMAT " bytes", stream, drops->reason,
+      drops->frames, drops->bytes);
+
+  s = gst_structure_new ("ssp-overflow",
+      "stream", G_TYPE_STRING, stream,
+      "policy", G_TYPE_STRING, policy ? policy->value_nick : NULL,
+      "reason", G_TYPE_STRING, drops->reason,
+      "dropped-frames", G_TYPE_UINT64, drops->frames,
+      "dropped-bytes", G_TYPE_UINT64, drops->bytes,
+      "duration", G_TYPE_UINT64, gst_util_get_timestamp () - drops->start,
+      NULL);
+  gst_element_post_message (GST_ELEMENT (src),
+      gst_message_new_element (GST_OBJECT (src), s));
+}
+
+/* Evict queued frames until @size fits, then any delta frames left at the
+ * head of the queue whose references went with them. FALSE when the queue
+ * ran empty that way, i.e. a following delta frame has lost its chain. */
+static gboolean
+gst_ssp_src_evict (GstSspSrc * src, SspFrameRing * ring,
+    GstSspDropEpisode * drops, SspStreamStats * stats, gsize size)
+{
+  gboolean evicted = FALSE;
+  gsize bytes;
+
+  while (ring->full (size) && ring->drop_oldest (&bytes)) {
+    drops->frames++;
+    drops->bytes += bytes;
+    stats->frame_dropped (bytes);
+    evicted = TRUE;
   }
+  if (!evicted)
+    return TRUE;
 
-  /* Wait for metadata to be received - but be more tolerant */
-  g_mutex_lock (&src->lock);
-  int timeout_count = 0;
-  while (!src->has_video_meta && !src->has_audio_meta && src->connected && timeout_count < 200) {
-    g_mutex_unlock (&src->lock);
-    usleep(50000); /* 50ms sleep - longer intervals, more patience */
-    timeout_count++;
-    g_mutex_lock (&src->lock);
+  while (ring->oldest_is_delta () && ring->drop_oldest (&bytes)) {
+    drops->frames++;
+    drops->bytes += bytes;
+    stats->frame_dropped (bytes);
   }
-  g_mutex_unlock (&src->lock);
+  return ring->length () > 0;
+}
 
-  /* If still no metadata but we're connected, try to continue anyway */
-  if (!src->has_video_meta && !src->has_audio_meta) {
-    if (!src->connected) {
-      GST_DEBUG_OBJECT (src, "Disconnected while waiting for metadata");
-      return GST_FLOW_ERROR;
-    }
-    GST_DEBUG_OBJECT (src, "No metadata received yet but connected, trying to get data anyway");
-    /* Don't return GST_FLOW_NOT_LINKED immediately - try to get data */
+/* Queue a frame for the streaming thread according to overflow-policy.
+ * Takes ownership of @buffer; @borrowed is reclaimed only if the frame is
+ * actually queued. Queued frames also go to @cache, a dropped one breaks
+ * its GOP. */
+static void
+gst_ssp_src_enqueue (GstSspSrc * src, SspFrameRing * ring,
+    GstSspDropEpisode * drops, SspStreamStats * stats, const gchar * stream,
+    GstBuffer * buffer, GstMemory * borrowed, SspGopCache * cache)
+{
+  gsize size = gst_buffer_get_size (buffer);
+  gboolean keyframe = !GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  GstSspIngestMeta *meta;
+
+  /* Nothing decodes until the next keyframe once a reference is lost */
+  if (drops->wait_keyframe) {
+    if (!keyframe)
+      goto drop;
+    drops->wait_keyframe = FALSE;
   }
 
-  /* Get buffer from appropriate queue based on mode */
-  if (src->mode == GST_SSP_MODE_VIDEO_ONLY || 
-      (src->mode == GST_SSP_MODE_BOTH && (src->has_video_meta || !src->has_audio_meta))) {
-    /* Block until we get a video buffer */
-    GST_DEBUG_OBJECT (src, "Waiting for video buffer from queue (length=%d)", g_async_queue_length(src->video_queue));
-    buffer = GST_BUFFER (g_async_queue_pop (src->video_queue));
-    if (buffer) {
-      GST_DEBUG_OBJECT (src, "Got video buffer of size %zu", gst_buffer_get_size(buffer));
-    }
-  } else if (src->mode == GST_SSP_MODE_AUDIO_ONLY || 
-             (src->mode == GST_SSP_MODE_BOTH && src->has_audio_meta)) {
-    buffer = GST_BUFFER (g_async_queue_pop (src->audio_queue));
-    if (buffer) {
-      GST_DEBUG_OBJECT (src, "Got audio buffer of size %zu", gst_buffer_get_size(buffer));
+  if (ring->full (size)) {
+    gst_ssp_src_begin_drops (src, drops, "queue-full");
+
+    switch (src->overflow_policy) {
+      case GST_SSP_OVERFLOW_BLOCK:
+        /* Stalls the SSP loop, the camera sees TCP backpressure */
+        if (!ring->wait_space (size))
+          goto drop;
+        break;
+      case GST_SSP_OVERFLOW_DROP_OLDEST:
+        if (!gst_ssp_src_evict (src, ring, drops, stats, size) && !keyframe) {
+          drops->wait_keyframe = TRUE;
+          goto drop;
+        }
+        break;
+      case GST_SSP_OVERFLOW_DROP_TO_KEYFRAME:
+        if (!keyframe) {
+          drops->wait_keyframe = TRUE;
+          goto drop;
+        }
+        /* The keyframe restarts decoding, make room for it */
+        gst_ssp_src_evict (src, ring, drops, stats, size);
+        break;
     }
   }
 
-  if (buffer == NULL) {
-    GST_DEBUG_OBJECT (src, "No buffer received (disconnected?)");
-    return GST_FLOW_EOS;
+  /* libssp reuses the region once we return, take ownership before the
+   * buffer becomes visible to the streaming thread */
+  gst_ssp_memory_reclaim (borrowed);
+  meta = gst_buffer_get_ssp_ingest_meta (buffer);
+  if (meta)
+    meta->enqueued = gst_util_get_timestamp ();
+  /* The cache takes its ref before the consumer can see the buffer */
+  if (cache)
+    cache->append (buffer, keyframe);
+  if (!ring->push (buffer)) {
+    /* Only when flushing raced with the wait above */
+    drops->wait_keyframe = TRUE;
+    goto drop;
   }
 
-  GST_DEBUG_OBJECT (src, "Returning buffer with PTS %" GST_TIME_FORMAT, 
-                    GST_TIME_ARGS(GST_BUFFER_PTS(buffer)));
-
-  *buf = buffer;
-  return GST_FLOW_OK;
+  gst_ssp_src_end_drops (src, drops, stream);
+  return;
+
+drop:
+  GST_LOG_OBJECT (src, "Dropping %s frame of %" G_GSIZE_FORMAT " bytes", stream, size);
+  if (cache)
+    cache->invalidate ();
+  gst_ssp_src_begin_drops (src, drops, "queue-full");
+  drops->frames++;
+  drops->bytes += size;
+  stats->frame_dropped (size);
+  gst_buffer_unref (buffer);
 }
 
+/* Whether the parameter sets of this keyframe differ from the ones the
+ * current caps were built from */
 static gboolean
-gst_ssp_src_unlock (GstBaseSrc * basesrc)
+gst_ssp_src_param_sets_changed (GstSspSrc * src, const SspVideoData * data)
 {
-  GstSspSrc *src = GST_SSP_SRC (basesrc);
-  
-  /* Push EOS buffer to unblock create function */
-  GstBuffer *eos_buffer = gst_buffer_new ();
-  GST_BUFFER_FLAG_SET (eos_buffer, GST_BUFFER_FLAG_GAP);
-  
-  g_async_queue_push (src->video_queue, eos_buffer);
-  g_async_queue_push (src->audio_queue, gst_buffer_ref (eos_buffer));
-  
-  return TRUE;
+  const SspNalIndex *index = data->nal_index;
+  gsize offset = 0, total;
+  guint i;
+
+  if (!src->param_sets)
+    return TRUE;
+  total = gst_buffer_get_size (src->param_sets);
+
+  for (i = 0; i < index->n_units; i++) {
+    const SspNalUnit *unit = &index->units[i];
+
+    if (!ssp_nal_is_parameter_set (index->codec, unit->type))
+      continue;
+    if (offset + unit->size > total ||
+        gst_buffer_memcmp (src->param_sets, offset, data->data + unit->offset,
+            unit->size) != 0)
+      return TRUE;
+    offset += unit->size;
+  }
+  return offset != total;
 }
 
-static gboolean
-gst_ssp_src_unlock_stop (GstBaseSrc * basesrc)
+static void
+gst_ssp_src_store_param_sets (GstSspSrc * src, const SspVideoData * data)
 {
-  GstSspSrc *src = GST_SSP_SRC (basesrc);
+  const SspNalIndex *index = data->nal_index;
+  GstBuffer *param_sets;
+  gsize size = 0, offset = 0;
+  guint i;
+
+  for (i = 0; i < index->n_units; i++) {
+    if (ssp_nal_is_parameter_set (index->codec, index->units[i].type))
+      size += index->units[i].size;
+  }
+
+  param_sets = gst_buffer_new_allocate (NULL, size, NULL);
+  for (i = 0; i < index->n_units; i++) {
+    const SspNalUnit *unit = &index->units[i];
+
+    if (!ssp_nal_is_parameter_set (index->codec, unit->type))
+      continue;
+    gst_buffer_fill (param_sets, offset, data->data + unit->offset, unit->size);
+    offset += unit->size;
+  }
+  gst_buffer_replace (&src->param_sets, param_sets);
+  gst_buffer_unref (param_sets);
+}
+
+/* Caps for the stream as described by the parameter sets of a keyframe,
+ * NULL if the codec is unknown or packetized output lacks codec_data */
+static GstCaps *
+gst_ssp_src_make_video_caps (GstSspSrc * src, const SspVideoData * data)
+{
+  GstCaps *caps = NULL;
+  guint32 encoder = src->video_encoder;
+  SspVideoParams params;
+  gboolean have_params;
+  gboolean packetized = src->stream_format == GST_SSP_STREAM_FORMAT_PACKETIZED;
   
-  /* Clear any EOS buffers */
-  gpointer buffer;
-  while ((buffer = g_async_queue_try_pop (src->video_queue)) != NULL) {
-    if (GST_BUFFER_FLAG_IS_SET (GST_BUFFER (buffer), GST_BUFFER_FLAG_GAP)) {
-      gst_buffer_unref (GST_BUFFER (buffer));
-    } else {
-      g_async_queue_push_front (src->video_queue, buffer);
-      break;
-    }
+  /* Use detected codec if metadata encoder is unknown */
+  if (encoder == VIDEO_ENCODER_UNKNOWN && data->codec_type != 0) {
+    encoder = data->codec_type;
   }
-  while ((buffer = g_async_queue_try_pop (src->audio_queue)) != NULL) {
-    if (GST_BUFFER_FLAG_IS_SET (GST_BUFFER (buffer), GST_BUFFER_FLAG_GAP)) {
-      gst_buffer_unref (GST_BUFFER (buffer));
-    } else {
-      g_async_queue_push_front (src->audio_queue, buffer);
-      break;
+  
+  /* I-frames carry the parameter sets, which describe the stream exactly */
+  have_params = data->nal_index &&
+      ssp_param_sets_parse (data->nal_index, data->data, &params) &&
+      params.codec == encoder;
+  
+  if (encoder == VIDEO_ENCODER_H264) {
+    caps = gst_caps_new_simple ("video/x-h264",
+        "stream-format", G_TYPE_STRING, packetized ? "avc" : "byte-stream",
+        "alignment", G_TYPE_STRING, "au",
+        NULL);
+  } else if (encoder == VIDEO_ENCODER_H265) {
+    caps = gst_caps_new_simple ("video/x-h265",
+        "stream-format", G_TYPE_STRING, packetized ? "hvc1" : "byte-stream",
+        "alignment", G_TYPE_STRING, "au",
+        NULL);
+  } else {
+    return NULL;
+  }
+  
+  if (packetized) {
+    GstBuffer *codec_data = have_params ?
+        ssp_param_sets_codec_data (data->nal_index, data->data, &params) : NULL;
+    
+    if (!codec_data) {
+      GST_DEBUG_OBJECT (src, "No parameter sets for codec_data, waiting for next I-frame");
+      gst_caps_unref (caps);
+      return NULL;
     }
+    gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER, codec_data, NULL);
+    gst_buffer_unref (codec_data);
   }
   
-  return TRUE;
+  if (have_params) {
+    ssp_video_params_fill_caps (&params, caps);
+    GST_INFO_OBJECT (src, "Parsed SPS: profile_idc %u, level_idc %u, %ux%u, "
+        "%u-bit", params.profile_idc, params.level_idc, params.width,
+        params.height, params.bit_depth_luma);
+  } else if (src->has_video_meta && src->video_width > 0 && src->video_height > 0) {
+    /* No usable SPS, fall back to the metadata dimensions */
+    gst_caps_set_simple (caps,
+        "width", G_TYPE_INT, src->video_width,
+        "height", G_TYPE_INT, src->video_height,
+        NULL);
+  }
+  
+  /* is-hlg only fills in for streams whose VUI has no colour description.
+   * Older GStreamer has no bt2100-hlg, the colorimetry stays unset there. */
+  if (src->is_hlg && !(have_params && params.has_colour_description)) {
+#if GST_CHECK_VERSION(1, 18, 0)
+    gst_caps_set_simple (caps,
+        "colorimetry", G_TYPE_STRING, "bt2100-hlg",
+        NULL);
+    GST_INFO_OBJECT (src, "No VUI colour description, assuming HLG");
+#else
+    GST_INFO_OBJECT (src, "No VUI colour description, HLG needs GStreamer 1.18");
+#endif
+  }
+  
+  return caps;
+}
+
+/* Feeds the stall watchdog, for the stream carried by the always pad */
+static void
+gst_ssp_src_stamp_arrival (GstSspSrc * src, GstClockTime arrival)
+{
+  g_mutex_lock (&src->lock);
+  src->last_arrival = arrival;
+  g_mutex_unlock (&src->lock);
 }
 
 static void
 on_video_data_cb (SspVideoData data, gpointer user_data)
 {
   GstSspSrc *src = GST_SSP_SRC (user_data);
+  GstClockTime arrival = data.received;
+  GstClockTime pts, duration;
+  gboolean discont, keyframe, has_param_sets, timed;
+  SspStreamStats *video_stats = (SspStreamStats *) src->video_stats;
   GstBuffer *buffer;
-  GstMemory *memory;
   
   GST_DEBUG_OBJECT (src, "Received video frame: size=%zu, pts=%" G_GUINT64_FORMAT ", type=%u", 
                     data.len, data.pts, data.type);
+
+  if (src->mode != GST_SSP_MODE_AUDIO_ONLY)
+    gst_ssp_src_stamp_arrival (src, arrival);
   
-  /* Create GStreamer buffer */
-  memory = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data.data, data.len, 0, data.len, data.data, g_free);
+  /* Create GStreamer buffer around the borrowed receive region */
   buffer = gst_buffer_new ();
-  gst_buffer_append_memory (buffer, memory);
+  gst_buffer_append_memory (buffer, gst_memory_ref (data.memory));
+  gst_ssp_src_add_ingest_meta (src, buffer, src->video_origin, arrival,
+      data.ntp_timestamp);
   
-  /* Set timestamps based on wall clock for live stream */
-  GstClockTime now = gst_util_get_timestamp();
-  
-  if (src->first_timestamp == GST_CLOCK_TIME_NONE) {
-    src->first_timestamp = now;
-    src->timestamp = 0;
-  } else {
-    /* Calculate running time from first timestamp */
-    src->timestamp = now - src->first_timestamp;
-  }
+  /* Map camera PTS to running time, duration comes from the frame unit */
+  pts = ((SspTimestamper *) src->video_ts)->timestamp (data.pts, arrival,
+      &duration, &discont);
   
-  GST_BUFFER_PTS (buffer) = src->timestamp;
-  GST_BUFFER_DTS (buffer) = src->timestamp;
-  GST_BUFFER_DURATION (buffer) = GST_SECOND / 30; /* Assume 30fps for video */
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = duration;
+  if (discont)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+  timed = gst_ssp_src_apply_ntp (src, buffer, data.ntp_timestamp,
+      &src->video_ntp_delta);
+  gst_ssp_src_apply_timecode (src, buffer, data.frm_no);
   
   /* Update codec type if detected from stream and different from metadata */
   if (data.codec_type != 0 && src->video_encoder != data.codec_type) {
@@ -539,151 +2982,124 @@ on_video_data_cb (SspVideoData data, gpointer user_data)
     src->video_encoder = data.codec_type;
   }
   
-  /* Set caps only once when we first have metadata and caps aren't set yet */
-  /* For proper decoding, we should wait for an I-frame (keyframe) before setting caps */
-  if ((src->has_video_meta || data.codec_type != 0) && !src->video_caps_set && data.type == 5) {
-    GstCaps *caps = NULL;
-    guint32 encoder = src->video_encoder;
-    
-    /* Use detected codec if metadata encoder is unknown */
-    if (encoder == VIDEO_ENCODER_UNKNOWN && data.codec_type != 0) {
-      encoder = data.codec_type;
-    }
-    
-    if (encoder == VIDEO_ENCODER_H264) {
-      caps = gst_caps_new_simple ("video/x-h264",
-          "stream-format", G_TYPE_STRING, "byte-stream",
-          "alignment", G_TYPE_STRING, "nal",
-          NULL);
-      
-      /* Add dimensions if available */
-      if (src->has_video_meta && src->video_width > 0 && src->video_height > 0) {
-        gst_caps_set_simple (caps,
-            "width", G_TYPE_INT, src->video_width,
-            "height", G_TYPE_INT, src->video_height,
-            NULL);
-      }
-    } else if (encoder == VIDEO_ENCODER_H265) {
-      caps = gst_caps_new_simple ("video/x-h265",
-          "stream-format", G_TYPE_STRING, "byte-stream",
-          "alignment", G_TYPE_STRING, "nal",
-          NULL);
-      
-      /* Detect and set 10-bit profile and pixel format for Z-Log and HDR */
-      /* Type 5 frames often contain VPS/SPS which have profile info */
-      if (data.type == 5 && data.len > 32) {
-        /* Try to detect 10-bit encoding from NAL unit headers */
-        /* This is a simplified detection - proper parsing would be more complex */
-        gboolean is_10bit = FALSE;
-        
-        /* Look for Main 10 profile indicators in the stream */
-        for (size_t i = 0; i < data.len - 8 && i < 100; i++) {
-          /* Check for profile_tier_level structure indicators */
-          if (((unsigned char*)data.data)[i] == 0x00 && 
-              ((unsigned char*)data.data)[i+1] == 0x00 && 
-              ((unsigned char*)data.data)[i+2] == 0x01) {
-            /* Found start code, check NAL unit type */
-            unsigned char nal_type = (((unsigned char*)data.data)[i+3] >> 1) & 0x3F;
-            if (nal_type == 32) { /* VPS NAL unit */
-              /* Assume 10-bit for HDR/high-quality streams */
-              is_10bit = TRUE;
-              break;
-            }
-          }
-        }
-        
-        if (is_10bit) {
-          gst_caps_set_simple (caps,
-              "profile", G_TYPE_STRING, "main-10",
-              "chroma-format", G_TYPE_STRING, "4:2:0",
-              "bit-depth-luma", G_TYPE_INT, 10,
-              "bit-depth-chroma", G_TYPE_INT, 10,
-              NULL);
-          
-          /* Add color information for Z-Log and HDR support */
-          if (src->is_hlg) {
-            /* HLG (Hybrid Log-Gamma) color space */
-            gst_caps_set_simple (caps,
-                "colorimetry", G_TYPE_STRING, "bt2020",
-                "transfer-characteristics", G_TYPE_STRING, "arib-std-b67",
-                "color-primaries", G_TYPE_STRING, "bt2020",
-                "matrix-coefficients", G_TYPE_STRING, "bt2020-ncl",
-                NULL);
-            GST_INFO_OBJECT (src, "Detected 10-bit H.265 HLG stream with HDR color space");
-          } else {
-            /* Z-Log typically uses Rec.2020 color space with custom transfer function */
-            gst_caps_set_simple (caps,
-                "colorimetry", G_TYPE_STRING, "bt709",
-                "transfer-characteristics", G_TYPE_STRING, "bt709",
-                "color-primaries", G_TYPE_STRING, "bt709",
-                "matrix-coefficients", G_TYPE_STRING, "bt709",
-                NULL);
-            GST_INFO_OBJECT (src, "Detected 10-bit H.265 stream with Z-Log color characteristics");
-          }
-          
-          GST_INFO_OBJECT (src, "Detected 10-bit H.265 stream, setting Main 10 profile");
-        } else {
-          gst_caps_set_simple (caps,
-              "profile", G_TYPE_STRING, "main",
-              NULL);
-        }
-      }
-      
-      /* Add dimensions if available */
-      if (src->has_video_meta && src->video_width > 0 && src->video_height > 0) {
-        gst_caps_set_simple (caps,
-            "width", G_TYPE_INT, src->video_width,
-            "height", G_TYPE_INT, src->video_height,
-            NULL);
-      }
-    }
+  /* The NAL index knows IDR/IRAP slices, the SSP frame type is the fallback
+   * until the codec is known */
+  if (data.nal_index && data.nal_index->codec != SSP_NAL_CODEC_UNKNOWN) {
+    keyframe = data.nal_index->has_idr;
+    has_param_sets = data.nal_index->has_parameter_sets;
+  } else {
+    keyframe = data.type == 5;
+    has_param_sets = FALSE;
+  }
+
+  video_stats->frame_received (data.len, keyframe, arrival, duration);
+  video_stats->frame_number (data.frm_no);
+  if (!timed) {
+    gst_buffer_unref (buffer);
+    return;
+  }
+  
+  /* Caps are set on the first keyframe and rebuilt when the parameter sets
+   * change, e.g. on a resolution switch */
+  if ((src->has_video_meta || data.codec_type != 0) && keyframe &&
+      (!src->video_caps_set ||
+          (has_param_sets && gst_ssp_src_param_sets_changed (src, &data)))) {
+    GstCaps *caps = gst_ssp_src_make_video_caps (src, &data);
     
     if (caps) {
-      GST_INFO_OBJECT (src, "Setting video caps with I-frame: %" GST_PTR_FORMAT, caps);
-      if (gst_base_src_set_caps (GST_BASE_SRC (src), caps)) {
-        src->video_caps_set = TRUE;
-      }
-      gst_caps_unref (caps);
+      GST_INFO_OBJECT (src, "Video caps from I-frame: %" GST_PTR_FORMAT, caps);
+      /* Unchanged after a reconnect, downstream keeps its configuration */
+      if (src->video_caps && gst_caps_is_equal (caps, src->video_caps))
+        gst_caps_unref (caps);
+      else
+        gst_caps_take (&src->video_caps, caps);
+      g_mutex_lock (&src->lock);
+      if (!GST_CLOCK_TIME_IS_VALID (src->startup_first_frame))
+        src->startup_first_frame = gst_util_get_timestamp ();
+      g_mutex_unlock (&src->lock);
+      src->video_caps_set = TRUE;
+      if (has_param_sets)
+        gst_ssp_src_store_param_sets (src, &data);
     }
   }
   
-  /* Only push frames to queue if caps are set or it's an I-frame */
-  if (!src->video_caps_set && data.type != 5) {
-    GST_DEBUG_OBJECT (src, "Skipping P-frame before caps are set (waiting for I-frame)");
-    g_free (data.data);
+  /* Only push frames once caps are set, starting with a keyframe */
+  if (!src->video_caps_set) {
+    GST_DEBUG_OBJECT (src, "Skipping frame before caps are set (waiting for I-frame)");
+    gst_buffer_unref (buffer);
     return;
   }
   
-  g_async_queue_push (src->video_queue, buffer);
+  /* Every SSP frame is one access unit. Keyframes carry the caps through
+   * the queue: the frames still queued ahead of them keep the old caps, and
+   * whichever keyframe survives the overflow handling brings the new ones. */
+  if (!keyframe)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  else
+    gst_buffer_add_ssp_caps_meta (buffer, src->video_caps);
+
+  if (src->video_discont) {
+    src->video_discont = FALSE;
+    gst_ssp_src_resume_stream (src, buffer, FALSE);
+  }
+  
+  if (src->stream_format == GST_SSP_STREAM_FORMAT_PACKETIZED) {
+    /* Parameter sets move to codec_data, the rest gets length prefixes.
+     * The rewrite lands in pool memory so the borrowed region is released
+     * without the usual fallback copy. */
+    gsize size = ssp_nal_to_packetized (src->video_encoder, data.data, data.len, NULL);
+    GstMemory *memory = gst_ssp_memory_new (size);
+    GstMapInfo map;
+    
+    gst_memory_map (memory, &map, GST_MAP_WRITE);
+    ssp_nal_to_packetized (src->video_encoder, data.data, data.len, map.data);
+    gst_memory_unmap (memory, &map);
+    gst_buffer_replace_all_memory (buffer, memory);
+  } else if (has_param_sets) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_HEADER);
+  }
+  
+  GST_BUFFER_OFFSET (buffer) = src->video_frames++;
+  gst_ssp_src_enqueue (src, (SspFrameRing *) src->video_ring,
+      &src->video_drops, (SspStreamStats *) src->video_stats, "video", buffer,
+      data.memory, (SspGopCache *) src->gop_cache);
 }
 
 static void
 on_audio_data_cb (SspAudioData data, gpointer user_data)
 {
   GstSspSrc *src = GST_SSP_SRC (user_data);
+  GstClockTime arrival = data.received;
+  GstClockTime pts, duration;
+  gboolean discont, timed;
   GstBuffer *buffer;
-  GstMemory *memory;
+
+  if (src->mode == GST_SSP_MODE_AUDIO_ONLY)
+    gst_ssp_src_stamp_arrival (src, arrival);
   
-  /* Create GStreamer buffer */
-  memory = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, data.data, data.len, 0, data.len, data.data, g_free);
+  /* Create GStreamer buffer around the borrowed receive region */
   buffer = gst_buffer_new ();
-  gst_buffer_append_memory (buffer, memory);
+  gst_buffer_append_memory (buffer, gst_memory_ref (data.memory));
+  gst_ssp_src_add_ingest_meta (src, buffer, src->audio_origin, arrival,
+      data.ntp_timestamp);
   
-  /* Set timestamps based on wall clock for live stream */
-  GstClockTime now = gst_util_get_timestamp();
+  pts = ((SspTimestamper *) src->audio_ts)->timestamp (data.pts, arrival,
+      &duration, &discont);
   
-  if (src->first_timestamp == GST_CLOCK_TIME_NONE) {
-    src->first_timestamp = now;
-    src->timestamp = 0;
-  } else {
-    /* Calculate running time from first timestamp */
-    src->timestamp = now - src->first_timestamp;
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = duration;
+  if (discont)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+  timed = gst_ssp_src_apply_ntp (src, buffer, data.ntp_timestamp,
+      &src->audio_ntp_delta);
+  ((SspStreamStats *) src->audio_stats)->frame_received (data.len, FALSE,
+      arrival, duration);
+  if (!timed) {
+    gst_buffer_unref (buffer);
+    return;
   }
   
-  GST_BUFFER_PTS (buffer) = src->timestamp;
-  GST_BUFFER_DTS (buffer) = src->timestamp;
-  GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
-  
   /* Set caps only once when we first have metadata and caps aren't set yet */
   if (src->has_audio_meta && !src->audio_caps_set) {
     GstCaps *caps = NULL;
@@ -704,15 +3120,36 @@ on_audio_data_cb (SspAudioData data, gpointer user_data)
     }
     
     if (caps) {
-      GST_INFO_OBJECT (src, "Setting audio caps (once): %" GST_PTR_FORMAT, caps);
-      if (gst_base_src_set_caps (GST_BASE_SRC (src), caps)) {
-        src->audio_caps_set = TRUE;
+      GST_INFO_OBJECT (src, "Audio caps (once): %" GST_PTR_FORMAT, caps);
+      g_mutex_lock (&src->lock);
+      if (src->audio_caps && gst_caps_is_equal (caps, src->audio_caps)) {
+        gst_caps_unref (caps);
+      } else {
+        gst_caps_take (&src->audio_caps, caps);
+        src->audio_caps_changed = TRUE;
       }
-      gst_caps_unref (caps);
+      if (!GST_CLOCK_TIME_IS_VALID (src->startup_first_frame))
+        src->startup_first_frame = gst_util_get_timestamp ();
+      g_mutex_unlock (&src->lock);
+      src->audio_caps_set = TRUE;
     }
   }
   
-  g_async_queue_push (src->audio_queue, buffer);
+  /* Nothing can be pushed on the audio stream before its caps are known */
+  if (!src->audio_caps_set) {
+    GST_DEBUG_OBJECT (src, "Skipping audio buffer before caps are known");
+    gst_buffer_unref (buffer);
+    return;
+  }
+
+  if (src->audio_discont) {
+    src->audio_discont = FALSE;
+    gst_ssp_src_resume_stream (src, buffer, TRUE);
+  }
+  
+  gst_ssp_src_enqueue (src, (SspFrameRing *) src->audio_ring,
+      &src->audio_drops, (SspStreamStats *) src->audio_stats, "audio", buffer,
+      data.memory, NULL);
 }
 
 static void
@@ -731,7 +3168,6 @@ on_meta_cb (SspVideoMeta video_meta, SspAudioMeta audio_meta, SspMeta meta, gpoi
   src->video_timescale = video_meta.timescale;
   src->video_unit = video_meta.unit;
   src->video_gop = video_meta.gop;
-  src->has_video_meta = TRUE;
   
   /* Store audio metadata */
   src->audio_sample_rate = audio_meta.sample_rate;
@@ -741,24 +3177,59 @@ on_meta_cb (SspVideoMeta video_meta, SspAudioMeta audio_meta, SspMeta meta, gpoi
   src->audio_timescale = audio_meta.timescale;
   src->audio_unit = audio_meta.unit;
   src->audio_bitrate = audio_meta.bitrate;
-  src->has_audio_meta = TRUE;
+  
+  /* Frame durations and the PTS mapping follow the stream timescale */
+  ((SspTimestamper *) src->video_ts)->set_rate (video_meta.timescale, video_meta.unit);
+  ((SspTimestamper *) src->audio_ts)->set_rate (audio_meta.timescale, audio_meta.unit);
   
   /* Store general metadata */
   src->pts_is_wall_clock = meta.pts_is_wall_clock;
   src->tc_drop_frame = meta.tc_drop_frame;
   src->timecode = meta.timecode;
+  
+  /* The timecode belongs to the next video frame */
+  src->tc_resync = TRUE;
+  
+  /* Wakes a create() waiting for metadata, and the watchdog */
+  g_mutex_lock (&src->lock);
+  if (src->mode == GST_SSP_MODE_AUDIO_ONLY)
+    src->frame_interval = audio_meta.timescale ?
+        gst_util_uint64_scale (audio_meta.unit, GST_SECOND, audio_meta.timescale) :
+        GST_CLOCK_TIME_NONE;
+  else
+    src->frame_interval = video_meta.timescale ?
+        gst_util_uint64_scale (video_meta.unit, GST_SECOND, video_meta.timescale) :
+        GST_CLOCK_TIME_NONE;
+  src->has_video_meta = TRUE;
+  src->has_audio_meta = TRUE;
+  if (!GST_CLOCK_TIME_IS_VALID (src->startup_meta))
+    src->startup_meta = gst_util_get_timestamp ();
+  g_cond_broadcast (&src->cond);
+  g_mutex_unlock (&src->lock);
 }
 
 static void
 on_connected_cb (gpointer user_data)
 {
   GstSspSrc *src = GST_SSP_SRC (user_data);
-  
+  SspSocketInfo info;
+
   GST_INFO_OBJECT (src, "SSP client connected");
-  
+
+  ((SspThread *) src->ssp_thread)->get_socket_info (&info);
+
   g_mutex_lock (&src->lock);
   src->connected = TRUE;
-  g_cond_signal (&src->cond);
+  src->socket_found = info.found;
+  src->socket_ambiguous = info.ambiguous;
+  src->effective_socket_buffer_size = info.socket_buffer_size;
+  src->effective_nodelay = info.nodelay;
+  src->io_backend = info.io_backend;
+  src->loop_index = ((SspThread *) src->ssp_thread)->get_loop_index ();
+  src->loop_tid = ((SspThread *) src->ssp_thread)->get_loop_tid ();
+  if (!GST_CLOCK_TIME_IS_VALID (src->startup_connected))
+    src->startup_connected = gst_util_get_timestamp ();
+  g_cond_broadcast (&src->cond);
   g_mutex_unlock (&src->lock);
 }
 
@@ -772,6 +3243,33 @@ on_disconnected_cb (gpointer user_data)
   g_mutex_lock (&src->lock);
   src->connected = FALSE;
   g_mutex_unlock (&src->lock);
+
+  /* Before the metadata, the first create() fails on its own */
+  gst_ssp_src_request_reconnect (src, "disconnected");
+}
+
+static gboolean
+gst_ssp_src_event (GstBaseSrc * basesrc, GstEvent * event)
+{
+  GstSspSrc *src = GST_SSP_SRC (basesrc);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_STOP:
+      /* Decoders downstream start over and need a keyframe */
+      gst_ssp_src_request_replay (src, "flush");
+      break;
+    case GST_EVENT_CUSTOM_UPSTREAM:
+      /* A new consumer wants a keyframe. The camera cannot be asked for
+       * one, the cache can provide it. */
+      if (gst_video_event_is_force_key_unit (event) &&
+          gst_ssp_src_request_replay (src, "force-key-unit"))
+        return TRUE;
+      break;
+    default:
+      break;
+  }
+
+  return GST_BASE_SRC_CLASS (parent_class)->event (basesrc, event);
 }
 
 static void
@@ -799,3 +3297,27 @@ on_exception_cb (gint code, const gchar* description, gpointer user_data)
   
   GST_ERROR_OBJECT (src, "SSP client exception: code=%d, description=%s", code, description);
 }
+
+/* A replay ran out of records: the streaming threads drain their queue
+ * and end the stream */
+static void
+on_end_cb (gpointer user_data)
+{
+  GstSspSrc *src = GST_SSP_SRC (user_data);
+
+  GST_INFO_OBJECT (src, "End of replay");
+  ((SspFrameRing *) src->video_ring)->set_finished (TRUE);
+  ((SspFrameRing *) src->audio_ring)->set_finished (TRUE);
+}
+
+static void
+on_buffer_full_cb (gpointer user_data)
+{
+  GstSspSrc *src = GST_SSP_SRC (user_data);
+
+  /* libssp lost data, whatever video follows may reference it */
+  GST_WARNING_OBJECT (src, "SSP receive buffer full, dropping video until the next keyframe");
+  g_atomic_int_inc (&src->buffer_full_events);
+  gst_ssp_src_begin_drops (src, &src->video_drops, "recv-buffer-full");
+  src->video_drops.wait_keyframe = TRUE;
+}
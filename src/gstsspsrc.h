@@ -3,6 +3,7 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
+#include <gst/video/video.h>
 
 G_BEGIN_DECLS
 
@@ -16,6 +17,8 @@ G_BEGIN_DECLS
   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_SSP_SRC))
 #define GST_IS_SSP_SRC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_SSP_SRC))
+#define GST_SSP_SRC_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GST_TYPE_SSP_SRC,GstSspSrcClass))
 
 typedef struct _GstSspSrc      GstSspSrc;
 typedef struct _GstSspSrcClass GstSspSrcClass;
@@ -32,6 +35,49 @@ typedef enum {
   GST_SSP_MODE_BOTH = 2
 } GstSspMode;
 
+typedef enum {
+  GST_SSP_TIMESTAMP_CAMERA = 0,
+  GST_SSP_TIMESTAMP_ARRIVAL = 1,
+  GST_SSP_TIMESTAMP_NTP = 2
+} GstSspTimestampMode;
+
+typedef enum {
+  GST_SSP_TIMECODE_BCD = 0,
+  GST_SSP_TIMECODE_BINARY = 1
+} GstSspTimecodeFormat;
+
+typedef enum {
+  GST_SSP_STREAM_FORMAT_BYTE_STREAM = 0,
+  GST_SSP_STREAM_FORMAT_PACKETIZED = 1
+} GstSspStreamFormat;
+
+typedef enum {
+  GST_SSP_OVERFLOW_BLOCK = 0,
+  GST_SSP_OVERFLOW_DROP_OLDEST = 1,
+  GST_SSP_OVERFLOW_DROP_TO_KEYFRAME = 2
+} GstSspOverflowPolicy;
+
+typedef enum {
+  GST_SSP_GOP_REPLAY_ORIGINAL = 0,
+  GST_SSP_GOP_REPLAY_LIVE = 1
+} GstSspGopReplay;
+
+typedef enum {
+  GST_SSP_SCHED_OTHER = 0,
+  GST_SSP_SCHED_FIFO = 1,
+  GST_SSP_SCHED_RR = 2
+} GstSspSchedPolicy;
+
+/* A run of dropped frames on one stream, posted on the bus when it ends */
+typedef struct {
+  gboolean active;
+  gboolean wait_keyframe;     /* reference chain broken, drop deltas */
+  const gchar *reason;
+  guint64 frames;
+  guint64 bytes;
+  GstClockTime start;
+} GstSspDropEpisode;
+
 struct _GstSspSrc
 {
   GstPushSrc element;
@@ -44,13 +90,43 @@ struct _GstSspSrc
   guint buffer_size;
   guint32 capability;
   gboolean is_hlg;
+  guint max_queue_frames;
+  guint64 max_queue_bytes;
+  guint64 max_queue_time;
+  GstSspTimestampMode timestamp_mode;
+  GstSspTimecodeFormat timecode_format;
+  GstSspStreamFormat stream_format;
+  GstSspOverflowPolicy overflow_policy;
+  guint64 connect_timeout;
+  guint64 meta_timeout;
+  guint64 first_frame_timeout;
+  guint socket_buffer_size;
+  gboolean low_latency;
+  gboolean reconnect;
+  guint64 reconnect_delay;
+  guint64 reconnect_max_delay;
+  guint reconnect_attempts;
+  guint stall_frames;
+  guint64 gop_cache_size;
+  GstSspGopReplay gop_replay;
+  gint loop_threads;
+  gchar *loop_cpus;
+  gchar *streaming_cpus;
+  GstSspSchedPolicy sched_policy;
+  gint sched_priority;
+  gint nice;
+  guint64 stats_interval;
+  gboolean ingest_meta;
+  gchar *capture_location;
 
   /* private */
   gpointer ssp_thread;        /* SspThread* wrapped as gpointer for C compatibility */
-  GstPad *video_pad;
-  GstPad *audio_pad;
-  GAsyncQueue *video_queue;
-  GAsyncQueue *audio_queue;
+  gpointer capture;           /* SspCaptureWriter*, NULL unless capturing */
+  GstPad *audio_pad;          /* sometimes pad, only in mode=both */
+  gpointer video_ring;        /* SspFrameRing*, loop thread -> streaming thread */
+  gpointer audio_ring;
+  gboolean audio_stream_started;
+  gboolean audio_need_segment;
   
   gboolean started;
   gboolean connected;
@@ -58,6 +134,97 @@ struct _GstSspSrc
   gboolean has_audio_meta;
   gboolean video_caps_set;
   gboolean audio_caps_set;
+
+  /* startup phases, local clock, protected by lock and signalled on cond */
+  gboolean flushing;
+  gboolean startup_done;
+  GstClockTime startup_begin;
+  GstClockTime startup_connected;
+  GstClockTime startup_meta;
+  GstClockTime startup_first_frame;
+
+  /* reconnect supervisor, protected by lock and signalled on cond */
+  GThread *reconnect_thread;
+  gboolean reconnect_stop;
+  gboolean reconnect_requested;
+  gboolean reconnecting;
+  gboolean reconnect_attempt_failed;
+  const gchar *disconnect_reason;
+  guint outage_attempts;
+  GstClockTime outage_start;
+  GstClockTime outage_connected;
+  gboolean recovering;        /* until the first frame after a reconnect */
+  gboolean segment_pending;   /* new segment before the next discont buffer */
+  gboolean audio_segment_pending;
+
+  /* stall watchdog on the supervisor thread, protected by lock: arrival of
+   * the last frame of the always pad's stream and its expected interval */
+  GstClockTime last_arrival;
+  GstClockTime frame_interval;
+
+  /* first frame after a reconnect is marked discont, loop thread only */
+  gboolean video_discont;
+  gboolean audio_discont;
+
+  /* GOP cache: the loop thread numbers video frames in GST_BUFFER_OFFSET
+   * and fills gop_cache, the streaming thread replays from it once a
+   * replay is pending (protected by lock) */
+  gpointer gop_cache;         /* SspGopCache*, NULL when disabled */
+  guint64 video_frames;
+  gboolean replay_pending;
+  GQueue replay_queue;
+  guint64 last_video_offset;  /* last frame popped from the video ring */
+  GstClockTime last_video_pts;
+  GstClockTime last_video_duration;
+
+  /* receive statistics: per stream counters written by the loop thread,
+   * event counters updated atomically, periodic ssp-stats on the system
+   * clock (stats_id protected by lock) */
+  gpointer video_stats;       /* SspStreamStats*, live as long as the element */
+  gpointer audio_stats;
+  gint buffer_full_events;
+  gint disconnects;
+  gint reconnects;
+  GstClockID stats_id;
+
+  /* GstSspIngestMeta origins, "<name>/video" and "<name>/audio" */
+  GQuark video_origin;
+  GQuark audio_origin;
+
+  /* socket settings read back on connect, protected by lock */
+  gboolean socket_found;
+  gboolean socket_ambiguous;
+  gint effective_socket_buffer_size;
+  gboolean effective_nodelay;
+  const gchar *io_backend;    /* static string, NULL until connected */
+  gint loop_index;            /* in the shared loop pool, -1 with an own loop */
+
+  /* kernel ids of the threads serving this source, protected by lock. The
+   * streaming threads set themselves up again when GstTask moves them. */
+  gint loop_tid;
+  gint src_tid;
+  gint audio_tid;
+  GThread *src_thread;        /* streaming thread only */
+  GThread *audio_thread;      /* audio task only */
+  /* SspSchedState of the task pool thread before src_thread/audio_thread
+   * set itself up, put back when the task leaves it */
+  gpointer src_sched;
+  gpointer audio_sched;
+
+  /* video caps of the current parameter sets, loop thread only: every
+   * keyframe carries them to the streaming thread in a GstSspCapsMeta */
+  GstCaps *video_caps;
+  /* caps computed on the loop thread, applied by the streaming thread of the
+   * pad carrying the stream, protected by lock */
+  GstCaps *audio_caps;
+  gboolean audio_caps_changed;
+
+  /* overflow handling, only touched from the SSP loop thread */
+  GstSspDropEpisode video_drops;
+  GstSspDropEpisode audio_drops;
+
+  /* parameter sets the current video caps were built from */
+  GstBuffer *param_sets;
   
   /* current stream info */
   guint32 video_width;
@@ -78,10 +245,26 @@ struct _GstSspSrc
   gboolean pts_is_wall_clock;
   gboolean tc_drop_frame;
   guint32 timecode;
+
+  /* running SMPTE timecode, extrapolated by frm_no on the loop thread */
+  GstVideoTimeCode tc;
+  gboolean tc_valid;
+  gboolean tc_resync;
+  guint32 tc_frm_no;
   
-  /* timestamp tracking */
-  GstClockTime timestamp;
-  GstClockTime first_timestamp;
+  /* timestamp tracking, only touched from the SSP loop thread */
+  gpointer clock_epoch;       /* SspClockEpoch* shared by both timestampers */
+  gpointer video_ts;          /* SspTimestamper* */
+  gpointer audio_ts;
+  /* timestamp-mode=ntp: NTP running time minus camera running time per
+   * stream, GST_CLOCK_STIME_NONE until a frame with NTP time anchors it */
+  GstClockTimeDiff video_ntp_delta;
+  GstClockTimeDiff audio_ntp_delta;
+
+  /* timestamp-mode=ntp: clock the NTP offset was taken on (a ref) and its
+   * time minus the wall clock, protected by the object lock */
+  GstClock *ntp_clock;
+  GstClockTimeDiff ntp_offset;
   
   GMutex lock;
   GCond cond;
@@ -90,6 +273,10 @@ struct _GstSspSrc
 struct _GstSspSrcClass 
 {
   GstPushSrcClass parent_class;
+
+  /* Start ssp_thread, on start() and on every reconnect. The default
+   * connects to ip:port. */
+  gboolean (*start_client) (GstSspSrc * src);
 };
 
 GType gst_ssp_src_get_type (void);
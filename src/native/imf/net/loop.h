@@ -0,0 +1,75 @@
+#ifndef __IMF_NET_LOOP_H__
+#define __IMF_NET_LOOP_H__
+
+#include <glib.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+
+// In-tree stand-in for the part of libssp's event loop that SspThread,
+// SspLoopPool and the native SspClient use, built with -Dssp_client=native
+namespace imf {
+
+class Uring;
+
+class Loop {
+public:
+    typedef std::function<void()> Functor;
+    // Receives the epoll events of the descriptor, which have the values of
+    // their poll(2) counterparts (POLLIN, POLLOUT, POLLERR, POLLHUP)
+    typedef std::function<void(gint revents)> IoHandler;
+
+    Loop();
+    ~Loop();
+
+    // Any thread
+    void queueInLoop(const Functor& func);
+    // Run func on the loop thread and wait for it, directly when called there
+    void runInLoopSync(const Functor& func);
+    bool isInLoopThread() const { return g_thread_self() == thread_; }
+    void quit();
+
+    // Loop thread. Level triggered; a handler may unwatch any descriptor,
+    // its own included.
+    void watch(gint fd, gshort events, const IoHandler& handler);
+    void unwatch(gint fd);
+
+    // Loop thread. The loop's io_uring, set up on first use; nullptr when
+    // the kernel or the build has none, the caller then uses watch()
+    Uring* uring();
+
+    // System calls made to receive: epoll_wait, wakeup reads, recv/readv
+    // and io_uring_enter, over all loops of the process
+    static guint64 syscalls() { return syscalls_.load(std::memory_order_relaxed); }
+    static void add_syscalls(guint64 n) { syscalls_.fetch_add(n, std::memory_order_relaxed); }
+
+    // Dispatch until quit()
+    void run();
+
+private:
+    struct Watch {
+        gshort events;
+        IoHandler handler;
+    };
+
+    void wakeup();
+    void run_pending();
+
+    GMutex lock_;
+    std::vector<Functor> pending_;
+    gint epoll_fd_;
+    gint wake_fd_;              // eventfd
+    gboolean quit_;
+    GThread* thread_;
+
+    std::map<gint, Watch> watches_;
+    Uring* uring_;
+    gboolean uring_probed_;
+
+    static std::atomic<guint64> syscalls_;
+};
+
+} // namespace imf
+
+#endif /* __IMF_NET_LOOP_H__ */
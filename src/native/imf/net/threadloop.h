@@ -0,0 +1,33 @@
+#ifndef __IMF_NET_THREADLOOP_H__
+#define __IMF_NET_THREADLOOP_H__
+
+#include <functional>
+
+#include "imf/net/loop.h"
+
+namespace imf {
+
+// A Loop running on its own thread
+class ThreadLoop {
+public:
+    typedef std::function<void(Loop*)> InitCallback;
+
+    // init runs on the new thread before the loop dispatches anything
+    explicit ThreadLoop(const InitCallback& init);
+    ~ThreadLoop();
+
+    void start();
+    // Quit the loop and join the thread
+    void stop();
+
+private:
+    static gpointer thread_func(gpointer data);
+
+    InitCallback init_;
+    Loop* loop_;
+    GThread* thread_;
+};
+
+} // namespace imf
+
+#endif /* __IMF_NET_THREADLOOP_H__ */
@@ -0,0 +1,86 @@
+#ifndef __IMF_NET_URING_H__
+#define __IMF_NET_URING_H__
+
+#include <glib.h>
+#include <linux/io_uring.h>
+#include <functional>
+#include <map>
+#include <set>
+
+// Newer than the headers may be, the kernel decides at runtime (6.12)
+#ifndef IOU_PBUF_RING_INC
+#define IOU_PBUF_RING_INC 2
+#endif
+#ifndef IORING_CQE_F_BUF_MORE
+#define IORING_CQE_F_BUF_MORE (1U << 4)
+#endif
+
+namespace imf {
+
+// Just enough io_uring over the raw system calls for the native client's
+// receive path. A Loop owns one and reaps it when epoll reports the ring
+// readable; everything runs on the loop thread.
+class Uring {
+public:
+    // Receives the completions of the requests submitted with the id it
+    // was registered under as user_data
+    typedef std::function<void(const struct io_uring_cqe& cqe)> Handler;
+
+    // nullptr without io_uring, or without multishot receive into
+    // incrementally consumed buffer rings
+    static Uring* create();
+    // Handlers still registered get a final -ECANCELED completion
+    ~Uring();
+
+    gint fd() const { return fd_; }
+    // Set while the destructor cancels the handlers
+    bool closing() const { return closing_; }
+
+    guint64 add_handler(const Handler& handler);
+    void remove_handler(guint64 id);
+
+    // Zeroed, nullptr when the queue stays full after submitting
+    struct io_uring_sqe* get_sqe();
+    void submit();
+    // Dispatch every completion there is
+    void reap();
+
+    // Register @ring of @entries (a power of two, page aligned) under a
+    // free buffer group id, FALSE when the kernel refuses
+    gboolean register_buf_ring(struct io_uring_buf_ring* ring, guint entries, guint16 flags,
+                               guint16* bgid);
+    void unregister_buf_ring(guint16 bgid);
+
+private:
+    Uring();
+    gboolean setup();
+
+    gint fd_;
+    bool closing_;
+
+    guint32* sq_head_;
+    guint32* sq_tail_;
+    guint32 sq_mask_;
+    guint32 sq_entries_;
+    guint32* sq_flags_;
+    struct io_uring_sqe* sqes_;
+    guint32 sq_local_tail_;
+    guint32 to_submit_;
+
+    guint32* cq_head_;
+    guint32* cq_tail_;
+    guint32 cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    void* ring_map_;
+    gsize ring_map_size_;
+    gsize sqes_size_;
+
+    guint64 next_id_;
+    std::map<guint64, Handler> handlers_;
+    std::set<guint16> bgids_;
+};
+
+} // namespace imf
+
+#endif /* __IMF_NET_URING_H__ */
@@ -0,0 +1,198 @@
+#ifndef __IMF_SSP_SSPCLIENT_H__
+#define __IMF_SSP_SSPCLIENT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include "imf/net/loop.h"
+#include "sspwire.h"
+
+// Same values as libssp
+#define VIDEO_ENCODER_UNKNOWN 0
+#define VIDEO_ENCODER_H264 96
+#define VIDEO_ENCODER_H265 265
+#define AUDIO_ENCODER_UNKNOWN 0
+#define AUDIO_ENCODER_AAC 37
+#define AUDIO_ENCODER_PCM 23
+
+#define STREAM_DEFAULT 0
+#define STREAM_MAIN 1
+#define STREAM_SEC 2
+
+#define ERROR_SSP_CONNECTION_FAILED (-1002)
+#define ERROR_SSP_PROTOCOL (-1004)
+
+// Frames carry the GstMemory they were reassembled into, not in libssp
+#define IMF_SSP_FRAME_MEMORY 1
+// SspClient::ioBackend(), not in libssp
+#define IMF_SSP_IO_BACKEND 1
+// SspClient::setOnSocketCallback() and socketFd(), not in libssp
+#define IMF_SSP_SOCKET 1
+
+namespace imf {
+
+struct SspH264Data {
+    uint8_t* data;
+    size_t len;
+    uint64_t pts;
+    uint64_t ntp_timestamp;
+    uint32_t frm_no;
+    uint32_t type;
+    // GstMemory holding data, the receiver may keep a reference
+    void* memory;
+};
+
+struct SspAudioData {
+    uint8_t* data;
+    size_t len;
+    uint64_t pts;
+    uint64_t ntp_timestamp;
+    void* memory;
+};
+
+struct SspVideoMeta {
+    uint32_t width;
+    uint32_t height;
+    uint32_t timescale;
+    uint32_t unit;
+    uint32_t gop;
+    uint32_t encoder;
+};
+
+struct SspAudioMeta {
+    uint32_t timescale;
+    uint32_t unit;
+    uint32_t sample_rate;
+    uint32_t sample_size;
+    uint32_t channel;
+    uint32_t bitrate;
+    uint32_t encoder;
+};
+
+struct SspMeta {
+    bool pts_is_wall_clock;
+    bool tc_drop_frame;
+    uint32_t timecode;
+};
+
+typedef std::function<void(SspH264Data*)> OnH264DataCallback;
+typedef std::function<void(SspAudioData*)> OnAudioDataCallback;
+typedef std::function<void(SspVideoMeta*, SspAudioMeta*, SspMeta*)> OnMetaCallback;
+typedef std::function<void()> OnConnectionConnectedCallback;
+typedef std::function<void()> OnDisconnectedCallback;
+typedef std::function<void(int, const char*)> OnExceptionCallback;
+typedef std::function<void()> OnRecvBufferFullCallback;
+typedef std::function<void(int)> OnSocketCallback;
+
+// Native client for the stand-in framing of sspwire.h with libssp's
+// interface. Everything but the constructor runs on the loop thread, and
+// so do the callbacks. Headers and meta go through a small staging buffer;
+// frame payloads are received straight into a pooled GstMemory of their
+// exact size, which the callback may keep. bufSize only bounds the size of
+// a message: a larger one is skipped and reported as buffer full, as
+// libssp does.
+//
+// When the loop has an io_uring, the connection is received by a multishot
+// receive into a ring of kernel-provided buffers instead, consumed
+// incrementally so a frame is usually contiguous in one buffer and passed
+// on in place. Frames that straddle two buffers, or complete while few are
+// left to the kernel, are copied into pooled memory. GST_SSP_IO=epoll in
+// the environment keeps the epoll path.
+class SspClient {
+public:
+    SspClient(const std::string& ip, Loop* loop, size_t bufSize,
+              unsigned short port = 9999, uint32_t streamStyle = STREAM_DEFAULT);
+    ~SspClient();
+
+    int init();
+    int start();
+    void stop();
+
+    void setCapability(uint32_t capability) { capability_ = capability; }
+
+    void setOnH264DataCallback(const OnH264DataCallback& cb) { on_h264_ = cb; }
+    void setOnAudioDataCallback(const OnAudioDataCallback& cb) { on_audio_ = cb; }
+    void setOnMetaCallback(const OnMetaCallback& cb) { on_meta_ = cb; }
+    void setOnConnectionConnectedCallback(const OnConnectionConnectedCallback& cb) { on_connected_ = cb; }
+    void setOnDisconnectedCallback(const OnDisconnectedCallback& cb) { on_disconnected_ = cb; }
+    void setOnExceptionCallback(const OnExceptionCallback& cb) { on_exception_ = cb; }
+    void setOnRecvBufferFullCallback(const OnRecvBufferFullCallback& cb) { on_buffer_full_ = cb; }
+    // Called from init() with the new socket before it connects, where
+    // receive buffer sizes still take part in window scaling
+    void setOnSocketCallback(const OnSocketCallback& cb) { on_socket_ = cb; }
+
+    // The connection's socket, -1 before init() and after stop()
+    int socketFd() const { return fd_; }
+
+    // "io_uring" or "epoll", valid from the connected callback on
+    const char* ioBackend() const { return recv_ ? "io_uring" : "epoll"; }
+
+private:
+    struct UringRecv;
+
+    void on_connect_ready(int revents);
+    void on_readable(int revents);
+    // 1 to go on with the message, 0 when it is skipped, -1 once failed
+    int check_header(const uint8_t* msg, SspWireType* type, guint32* length);
+    // Dispatch the complete messages in buf_ and start the frame that
+    // follows them, FALSE once the connection failed
+    bool parse();
+    bool dispatch_meta(uint8_t* payload, size_t length);
+    void begin_frame(int type, const uint8_t* prefix, size_t size);
+    void alloc_frame();
+    bool finish_frame();
+    bool start_uring();
+    // A received chunk, at offset in provided buffer bid
+    void on_uring_data(const uint8_t* data, size_t len, unsigned bid, size_t offset);
+    void on_uring_buffer_done(unsigned bid);
+    void copy_out_frame();
+    void finish_uring_frame();
+    void fail(int code, const char* description);
+    void close_socket();
+
+    std::string ip_;
+    Loop* loop_;
+    unsigned short port_;
+    uint32_t stream_style_;
+    uint32_t capability_;
+    int fd_;
+    bool connected_;
+
+    size_t max_message_;
+    std::vector<uint8_t> buf_;  // staging
+    size_t fill_;
+    size_t skip_;              // bytes left of a message that did not fit
+
+    // Frame being received, its payload bypasses the staging buffer
+    GstMemory* frame_;
+    uint8_t* frame_data_;
+    size_t frame_size_;
+    size_t frame_fill_;
+    int frame_type_;
+    uint8_t frame_prefix_[SSP_WIRE_VIDEO_PREFIX_SIZE];
+
+    // io_uring receive, nullptr on the epoll path. A frame received in
+    // place has no frame_ until it completes, it starts at uring_offset_
+    // in buffer uring_bid_.
+    UringRecv* recv_;
+    int uring_bid_;
+    size_t uring_offset_;
+
+    OnH264DataCallback on_h264_;
+    OnAudioDataCallback on_audio_;
+    OnMetaCallback on_meta_;
+    OnConnectionConnectedCallback on_connected_;
+    OnDisconnectedCallback on_disconnected_;
+    OnExceptionCallback on_exception_;
+    OnRecvBufferFullCallback on_buffer_full_;
+    OnSocketCallback on_socket_;
+};
+
+} // namespace imf
+
+#endif /* __IMF_SSP_SSPCLIENT_H__ */
@@ -0,0 +1,227 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imf/net/loop.h"
+#ifdef HAVE_IO_URING
+#include "imf/net/uring.h"
+#endif
+
+#include <gst/gst.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// Events taken per epoll_wait, the rest wait for the next round
+#define LOOP_MAX_EVENTS 64
+
+G_STATIC_ASSERT(EPOLLIN == POLLIN && EPOLLOUT == POLLOUT && EPOLLERR == POLLERR &&
+                EPOLLHUP == POLLHUP);
+
+namespace imf {
+
+std::atomic<guint64> Loop::syscalls_(0);
+
+Loop::Loop()
+    : quit_(FALSE)
+    , thread_(nullptr)
+    , uring_(nullptr)
+    , uring_probed_(FALSE)
+{
+    struct epoll_event ev = {};
+
+    g_mutex_init(&lock_);
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        g_error("Cannot create the loop: %s", g_strerror(errno));
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+}
+
+Loop::~Loop()
+{
+#ifdef HAVE_IO_URING
+    // Cancels the receives of connections that were not stopped
+    delete uring_;
+#endif
+    close(wake_fd_);
+    close(epoll_fd_);
+    g_mutex_clear(&lock_);
+}
+
+void
+Loop::wakeup()
+{
+    guint64 one = 1;
+
+    // Only fails once the counter is near overflow, a wakeup is pending then
+    if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        GST_WARNING("Loop wakeup failed: %s", g_strerror(errno));
+    }
+}
+
+void
+Loop::queueInLoop(const Functor& func)
+{
+    g_mutex_lock(&lock_);
+    pending_.push_back(func);
+    g_mutex_unlock(&lock_);
+    wakeup();
+}
+
+void
+Loop::runInLoopSync(const Functor& func)
+{
+    if (isInLoopThread()) {
+        func();
+        return;
+    }
+
+    GMutex lock;
+    GCond cond;
+    gboolean done = FALSE;
+
+    g_mutex_init(&lock);
+    g_cond_init(&cond);
+
+    queueInLoop([&]() {
+        func();
+        g_mutex_lock(&lock);
+        done = TRUE;
+        g_cond_signal(&cond);
+        g_mutex_unlock(&lock);
+    });
+
+    g_mutex_lock(&lock);
+    while (!done) {
+        g_cond_wait(&cond, &lock);
+    }
+    g_mutex_unlock(&lock);
+
+    g_mutex_clear(&lock);
+    g_cond_clear(&cond);
+}
+
+void
+Loop::quit()
+{
+    g_mutex_lock(&lock_);
+    quit_ = TRUE;
+    g_mutex_unlock(&lock_);
+    wakeup();
+}
+
+void
+Loop::watch(gint fd, gshort events, const IoHandler& handler)
+{
+    struct epoll_event ev = {};
+    auto it = watches_.find(fd);
+
+    ev.events = (guint32)events;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, it == watches_.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) != 0) {
+        GST_ERROR("Cannot watch descriptor %d: %s", fd, g_strerror(errno));
+        return;
+    }
+
+    Watch& w = watches_[fd];
+    w.events = events;
+    w.handler = handler;
+}
+
+void
+Loop::unwatch(gint fd)
+{
+    if (watches_.erase(fd)) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+Uring*
+Loop::uring()
+{
+#ifdef HAVE_IO_URING
+    if (!uring_probed_) {
+        uring_probed_ = TRUE;
+        uring_ = Uring::create();
+        if (uring_) {
+            watch(uring_->fd(), POLLIN, [this](gint revents) { uring_->reap(); });
+        }
+    }
+#endif
+    return uring_;
+}
+
+void
+Loop::run_pending()
+{
+    std::vector<Functor> pending;
+    guint64 count;
+
+    add_syscalls(1);
+    if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        GST_WARNING("Loop wakeup read failed: %s", g_strerror(errno));
+    }
+
+    g_mutex_lock(&lock_);
+    pending.swap(pending_);
+    g_mutex_unlock(&lock_);
+
+    for (Functor& func : pending) {
+        func();
+    }
+}
+
+void
+Loop::run()
+{
+    struct epoll_event events[LOOP_MAX_EVENTS];
+
+    thread_ = g_thread_self();
+    for (;;) {
+        gboolean woken = FALSE;
+
+        g_mutex_lock(&lock_);
+        gboolean quit = quit_;
+        g_mutex_unlock(&lock_);
+        if (quit) {
+            break;
+        }
+
+        gint n = epoll_wait(epoll_fd_, events, LOOP_MAX_EVENTS, -1);
+        add_syscalls(1);
+        if (n < 0) {
+            if (errno != EINTR) {
+                GST_ERROR("epoll_wait failed: %s", g_strerror(errno));
+                break;
+            }
+            continue;
+        }
+
+        for (gint i = 0; i < n; i++) {
+            if (events[i].data.fd == wake_fd_) {
+                woken = TRUE;
+                continue;
+            }
+            // An earlier handler may have removed or replaced the watch
+            auto it = watches_.find(events[i].data.fd);
+            if (it == watches_.end()) {
+                continue;
+            }
+            IoHandler handler = it->second.handler;
+            handler((gint)events[i].events);
+        }
+
+        if (woken) {
+            run_pending();
+        }
+    }
+}
+
+} // namespace imf
@@ -0,0 +1,901 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "imf/ssp/sspclient.h"
+#include "gstsspmemory.h"
+#ifdef HAVE_IO_URING
+#include "imf/net/uring.h"
+#endif
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Headers, prefixes and meta are read through this much staging, so at
+// most this much of a frame is copied; the rest is received in place
+#define SSP_CLIENT_STAGING_SIZE (16 * 1024)
+
+// Provided buffers per connection: a few frames in place each, with room
+// for downstream to hold on to some
+#define SSP_CLIENT_URING_BUFFERS 8
+#define SSP_CLIENT_URING_BUFFER_SIZE (2 * 1024 * 1024)
+// Completed frames are copied out rather than keep a buffer once fewer
+// than this are left to the kernel
+#define SSP_CLIENT_URING_RESERVE 2
+
+namespace imf {
+
+#ifdef HAVE_IO_URING
+// The provided buffer ring of one connection and its multishot receive.
+// Referenced by the client, by the handler registration with the Uring and
+// by every frame still pointing into a buffer, the last one frees it.
+// Buffers go back to the ring once neither the kernel nor a frame uses
+// them; frames are released on any thread, hence the lock.
+struct SspClient::UringRecv {
+    struct Slot {
+        UringRecv* recv;
+        guint16 bid;
+    };
+
+    // Holds a reference in a functor the loop may drop without running it
+    struct Ref {
+        explicit Ref(UringRecv* r) : r(r) { r->ref(); }
+        Ref(const Ref& other) : r(other.r) { r->ref(); }
+        ~Ref() { r->unref(); }
+        UringRecv* r;
+    };
+
+    static UringRecv* create(Uring* uring, Loop* loop, SspClient* client);
+    ~UringRecv();
+
+    void ref() { refs.fetch_add(1, std::memory_order_relaxed); }
+    void unref()
+    {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    guint8* buffer(guint bid) const { return data + (gsize)bid * SSP_CLIENT_URING_BUFFER_SIZE; }
+    bool arm();
+    void rearm();
+    void on_cqe(const struct io_uring_cqe& cqe);
+    // The client is gone: cancel the receive, finish once it ended
+    void stop();
+    void finish();
+    // Frame memory in place, nullptr when it should be copied out
+    GstMemory* wrap(guint bid, gsize offset, gsize size);
+    static void release_frame(gpointer data);
+    void release_locked(guint bid);
+    void recycle_locked(guint bid);
+
+    std::atomic<gint> refs;
+    GMutex lock;
+    Uring* uring;               // loop thread, nullptr once the ring is gone
+    SspClient* client;          // loop thread, nullptr once stopped
+    Loop* loop;                 // under lock, nullptr once stopped
+    guint64 id;
+    guint16 bgid;
+    bool registered;            // under lock
+    bool armed;                 // loop thread
+    bool starved;               // under lock: ended for lack of buffers
+    bool rearm_queued;          // under lock
+
+    struct io_uring_buf_ring* ring;
+    gsize ring_size;
+    guint8* data;
+    guint16 tail;               // under lock
+    guint available;            // under lock: buffers the kernel may fill
+    gint buffer_refs[SSP_CLIENT_URING_BUFFERS];     // under lock
+    gsize consumed[SSP_CLIENT_URING_BUFFERS];       // loop thread
+    Slot slots[SSP_CLIENT_URING_BUFFERS];
+};
+
+SspClient::UringRecv*
+SspClient::UringRecv::create(Uring* uring, Loop* loop, SspClient* client)
+{
+    UringRecv* r = new UringRecv();
+
+    r->refs = 1;
+    g_mutex_init(&r->lock);
+    r->uring = uring;
+    r->client = client;
+    r->loop = loop;
+    r->id = 0;
+    r->bgid = 0;
+    r->registered = false;
+    r->armed = false;
+    r->starved = false;
+    r->rearm_queued = false;
+    r->tail = 0;
+    r->available = 0;
+
+    // Page aligned and zeroed, as the kernel wants the ring
+    r->ring_size = MAX(SSP_CLIENT_URING_BUFFERS * sizeof(struct io_uring_buf),
+                       (gsize)sysconf(_SC_PAGESIZE));
+    r->ring = (struct io_uring_buf_ring*)mmap(nullptr, r->ring_size, PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    r->data = (guint8*)mmap(nullptr, SSP_CLIENT_URING_BUFFERS * SSP_CLIENT_URING_BUFFER_SIZE,
+                            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r->ring == MAP_FAILED || r->data == MAP_FAILED ||
+        !uring->register_buf_ring(r->ring, SSP_CLIENT_URING_BUFFERS, IOU_PBUF_RING_INC,
+                                  &r->bgid)) {
+        r->unref();
+        return nullptr;
+    }
+
+    r->registered = true;
+    for (guint bid = 0; bid < SSP_CLIENT_URING_BUFFERS; bid++) {
+        r->slots[bid].recv = r;
+        r->slots[bid].bid = bid;
+        r->consumed[bid] = 0;
+        r->recycle_locked(bid);
+    }
+    r->id = uring->add_handler(std::bind(&UringRecv::on_cqe, r, std::placeholders::_1));
+    r->ref();
+    return r;
+}
+
+SspClient::UringRecv::~UringRecv()
+{
+    if (ring != MAP_FAILED) {
+        munmap(ring, ring_size);
+    }
+    if (data != MAP_FAILED) {
+        munmap(data, SSP_CLIENT_URING_BUFFERS * SSP_CLIENT_URING_BUFFER_SIZE);
+    }
+    g_mutex_clear(&lock);
+}
+
+bool
+SspClient::UringRecv::arm()
+{
+    struct io_uring_sqe* sqe = uring->get_sqe();
+
+    if (!sqe) {
+        return false;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = client->fd_;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bgid;
+    sqe->user_data = id;
+    uring->submit();
+    armed = true;
+    return true;
+}
+
+void
+SspClient::UringRecv::rearm()
+{
+    g_mutex_lock(&lock);
+    bool go = starved && available > 0;
+    rearm_queued = false;
+    if (go) {
+        starved = false;
+    }
+    g_mutex_unlock(&lock);
+
+    if (go && client && uring && !armed && !arm()) {
+        client->fail(ERROR_SSP_CONNECTION_FAILED, "io_uring submission queue full");
+    }
+}
+
+void
+SspClient::UringRecv::on_cqe(const struct io_uring_cqe& cqe)
+{
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        guint bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+        if (cqe.res > 0) {
+            gsize offset = consumed[bid];
+
+            // Each completion follows on from the last in the same buffer
+            consumed[bid] += cqe.res;
+            if (client) {
+                client->on_uring_data(buffer(bid) + offset, cqe.res, bid, offset);
+            }
+        }
+        if (!(cqe.flags & IORING_CQE_F_BUF_MORE)) {
+            // The kernel moved on to the next buffer
+            consumed[bid] = 0;
+            if (client) {
+                client->on_uring_buffer_done(bid);
+            }
+            g_mutex_lock(&lock);
+            available--;
+            release_locked(bid);
+            g_mutex_unlock(&lock);
+        }
+    }
+
+    if (uring && uring->closing()) {
+        uring = nullptr;
+        g_mutex_lock(&lock);
+        loop = nullptr;
+        registered = false;
+        g_mutex_unlock(&lock);
+    }
+    if (cqe.flags & IORING_CQE_F_MORE) {
+        return;
+    }
+
+    armed = false;
+    if (!client) {
+        finish();
+    } else if (cqe.res == -ENOBUFS) {
+        // Every buffer is held by frames, until one comes back
+        g_mutex_lock(&lock);
+        bool now = available > 0;
+        starved = !now;
+        g_mutex_unlock(&lock);
+        if (now && uring && !arm()) {
+            client->fail(ERROR_SSP_CONNECTION_FAILED, "io_uring submission queue full");
+        }
+    } else if (cqe.res == 0) {
+        GST_INFO("SSP server %s:%u closed the connection", client->ip_.c_str(), client->port_);
+        client->fail(0, nullptr);
+    } else if (cqe.res < 0) {
+        if (cqe.res != -ECANCELED) {
+            GST_WARNING("io_uring receive failed: %s", g_strerror(-cqe.res));
+        }
+        client->fail(0, nullptr);
+    } else if (uring && !arm()) {
+        // The kernel may end a multishot receive at any time
+        client->fail(ERROR_SSP_CONNECTION_FAILED, "io_uring submission queue full");
+    }
+}
+
+void
+SspClient::UringRecv::stop()
+{
+    client = nullptr;
+    g_mutex_lock(&lock);
+    loop = nullptr;
+    g_mutex_unlock(&lock);
+
+    if (armed && uring) {
+        // Ends with a last completion, which finishes
+        struct io_uring_sqe* sqe = uring->get_sqe();
+
+        if (sqe) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = id;
+            uring->submit();
+        }
+    } else {
+        finish();
+    }
+    unref();
+}
+
+void
+SspClient::UringRecv::finish()
+{
+    if (uring) {
+        uring->remove_handler(id);
+        uring->unregister_buf_ring(bgid);
+    }
+    g_mutex_lock(&lock);
+    registered = false;
+    g_mutex_unlock(&lock);
+    unref();
+}
+
+GstMemory*
+SspClient::UringRecv::wrap(guint bid, gsize offset, gsize size)
+{
+    g_mutex_lock(&lock);
+    if (available < SSP_CLIENT_URING_RESERVE) {
+        g_mutex_unlock(&lock);
+        return nullptr;
+    }
+    buffer_refs[bid]++;
+    g_mutex_unlock(&lock);
+
+    // Only the frame itself: the rest of the buffer belongs to the kernel,
+    // which may be receiving into it, and must not be reachable through
+    // gst_memory_resize() or a writable map
+    ref();
+    return gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY, buffer(bid) + offset, size, 0, size,
+                                  &slots[bid], release_frame);
+}
+
+void
+SspClient::UringRecv::release_frame(gpointer data)
+{
+    Slot* slot = (Slot*)data;
+    UringRecv* r = slot->recv;
+
+    g_mutex_lock(&r->lock);
+    r->release_locked(slot->bid);
+    g_mutex_unlock(&r->lock);
+    r->unref();
+}
+
+void
+SspClient::UringRecv::release_locked(guint bid)
+{
+    if (--buffer_refs[bid] == 0) {
+        recycle_locked(bid);
+    }
+}
+
+void
+SspClient::UringRecv::recycle_locked(guint bid)
+{
+    // The kernel's reference until it moves on from the buffer
+    buffer_refs[bid] = 1;
+    if (!registered) {
+        return;
+    }
+
+    // Not ring->bufs: in C++ the header's flexible array sits 8 bytes late
+    struct io_uring_buf* buf = (struct io_uring_buf*)ring + (tail & (SSP_CLIENT_URING_BUFFERS - 1));
+    buf->addr = (guint64)(guintptr)buffer(bid);
+    buf->len = SSP_CLIENT_URING_BUFFER_SIZE;
+    buf->bid = bid;
+    tail++;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    available++;
+
+    if (starved && loop && !rearm_queued) {
+        Ref ref(this);
+
+        rearm_queued = true;
+        loop->queueInLoop([ref]() { ref.r->rearm(); });
+    }
+}
+#endif
+
+
+SspClient::SspClient(const std::string& ip, Loop* loop, size_t bufSize,
+                     unsigned short port, uint32_t streamStyle)
+    : ip_(ip)
+    , loop_(loop)
+    , port_(port)
+    , stream_style_(streamStyle)
+    , capability_(0)
+    , fd_(-1)
+    , connected_(false)
+    , max_message_(MAX(bufSize, (size_t)SSP_WIRE_HEADER_SIZE + SSP_WIRE_META_SIZE))
+    , buf_(SSP_CLIENT_STAGING_SIZE)
+    , fill_(0)
+    , skip_(0)
+    , frame_(nullptr)
+    , frame_data_(nullptr)
+    , frame_size_(0)
+    , frame_fill_(0)
+    , frame_type_(0)
+    , recv_(nullptr)
+    , uring_bid_(-1)
+    , uring_offset_(0)
+{
+}
+
+SspClient::~SspClient()
+{
+    // Usually stopped already, possibly with the loop gone since
+    if (fd_ >= 0) {
+        stop();
+    }
+}
+
+int
+SspClient::init()
+{
+    struct addrinfo hints, *res = nullptr;
+    gchar port[8];
+    int ret;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    g_snprintf(port, sizeof(port), "%u", port_);
+
+    ret = getaddrinfo(ip_.c_str(), port, &hints, &res);
+    if (ret != 0) {
+        GST_ERROR("Cannot resolve %s: %s", ip_.c_str(), gai_strerror(ret));
+        return -1;
+    }
+
+    fd_ = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        GST_ERROR("Cannot create socket: %s", g_strerror(errno));
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    if (on_socket_) {
+        on_socket_(fd_);
+    }
+
+    ret = connect(fd_, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (ret != 0 && errno != EINPROGRESS) {
+        GST_ERROR("Cannot connect to %s:%u: %s", ip_.c_str(), port_, g_strerror(errno));
+        close_socket();
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+SspClient::start()
+{
+    if (fd_ < 0) {
+        return -1;
+    }
+    loop_->watch(fd_, POLLOUT, std::bind(&SspClient::on_connect_ready, this,
+                                         std::placeholders::_1));
+    return 0;
+}
+
+void
+SspClient::stop()
+{
+    // Callers may stop from any thread, the watch belongs to the loop
+    loop_->runInLoopSync(std::bind(&SspClient::close_socket, this));
+}
+
+void
+SspClient::close_socket()
+{
+#ifdef HAVE_IO_URING
+    if (recv_) {
+        // Frames received in place keep their buffers
+        recv_->stop();
+        recv_ = nullptr;
+    }
+#endif
+    uring_bid_ = -1;
+    if (fd_ >= 0) {
+        loop_->unwatch(fd_);
+        close(fd_);
+        fd_ = -1;
+    }
+    connected_ = false;
+    fill_ = 0;
+    skip_ = 0;
+    if (frame_) {
+        gst_memory_unref(frame_);
+        frame_ = nullptr;
+    }
+}
+
+void
+SspClient::fail(int code, const char* description)
+{
+    bool was_connected = connected_;
+
+    close_socket();
+    if (code && on_exception_) {
+        on_exception_(code, description);
+    }
+    if (was_connected && on_disconnected_) {
+        on_disconnected_();
+    }
+}
+
+void
+SspClient::on_connect_ready(int revents)
+{
+    guint8 hello[SSP_WIRE_HEADER_SIZE + SSP_WIRE_HELLO_SIZE];
+    SspWireHello h = { stream_style_, capability_ };
+    int error = 0;
+    socklen_t len = sizeof(error);
+
+    if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
+        error = errno;
+    }
+    if (error) {
+        GST_WARNING("Cannot connect to %s:%u: %s", ip_.c_str(), port_, g_strerror(error));
+        fail(ERROR_SSP_CONNECTION_FAILED, g_strerror(error));
+        return;
+    }
+
+    // A fresh socket always has room for the hello
+    ssp_wire_write_header(hello, SSP_WIRE_HELLO, SSP_WIRE_HELLO_SIZE);
+    ssp_wire_write_hello(hello + SSP_WIRE_HEADER_SIZE, &h);
+    if (send(fd_, hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+        fail(ERROR_SSP_CONNECTION_FAILED, g_strerror(errno));
+        return;
+    }
+
+    connected_ = true;
+    if (start_uring()) {
+        loop_->unwatch(fd_);
+    } else {
+        loop_->watch(fd_, POLLIN, std::bind(&SspClient::on_readable, this,
+                                            std::placeholders::_1));
+    }
+    if (on_connected_) {
+        on_connected_();
+    }
+}
+
+void
+SspClient::on_readable(int revents)
+{
+    ssize_t n;
+
+    if (frame_) {
+        // The rest of the frame in place, whatever follows into staging
+        struct iovec iov[2] = {
+            { frame_data_ + frame_fill_, frame_size_ - frame_fill_ },
+            { buf_.data() + fill_, buf_.size() - fill_ }
+        };
+        n = readv(fd_, iov, 2);
+    } else {
+        n = recv(fd_, buf_.data() + fill_, buf_.size() - fill_, 0);
+    }
+    Loop::add_syscalls(1);
+
+    if (n == 0) {
+        GST_INFO("SSP server %s:%u closed the connection", ip_.c_str(), port_);
+        fail(0, nullptr);
+        return;
+    }
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            fail(0, nullptr);
+        }
+        return;
+    }
+
+    if (frame_) {
+        size_t to_frame = MIN((size_t)n, frame_size_ - frame_fill_);
+
+        frame_fill_ += to_frame;
+        fill_ += n - to_frame;
+        if (frame_fill_ < frame_size_ || !finish_frame()) {
+            return;
+        }
+    } else {
+        fill_ += n;
+    }
+    parse();
+}
+
+bool
+SspClient::parse()
+{
+    size_t pos = 0;
+
+    while (fd_ >= 0 && !frame_) {
+        uint8_t* msg = buf_.data() + pos;
+        size_t avail = fill_ - pos;
+        SspWireType type;
+        guint32 length;
+
+        if (skip_) {
+            size_t n = MIN(skip_, avail);
+            skip_ -= n;
+            pos += n;
+            if (skip_) {
+                break;
+            }
+            continue;
+        }
+
+        if (avail < SSP_WIRE_HEADER_SIZE) {
+            break;
+        }
+        int check = check_header(msg, &type, &length);
+        if (check < 0) {
+            return false;
+        }
+        if (check == 0) {
+            pos += SSP_WIRE_HEADER_SIZE;
+            continue;
+        }
+
+        if (type == SSP_WIRE_VIDEO || type == SSP_WIRE_AUDIO) {
+            size_t prefix = type == SSP_WIRE_VIDEO ? SSP_WIRE_VIDEO_PREFIX_SIZE
+                                                   : SSP_WIRE_AUDIO_PREFIX_SIZE;
+            if (avail < SSP_WIRE_HEADER_SIZE + prefix) {
+                break;
+            }
+
+            // Whatever of the payload is already staged, the rest arrives
+            // directly in the frame
+            begin_frame(type, msg + SSP_WIRE_HEADER_SIZE, length - prefix);
+            alloc_frame();
+            size_t n = MIN(avail - SSP_WIRE_HEADER_SIZE - prefix, frame_size_);
+            memcpy(frame_data_, msg + SSP_WIRE_HEADER_SIZE + prefix, n);
+            frame_fill_ = n;
+            pos += SSP_WIRE_HEADER_SIZE + prefix + n;
+            if (frame_fill_ == frame_size_ && !finish_frame()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (avail < SSP_WIRE_HEADER_SIZE + (size_t)length) {
+            break;
+        }
+        if (type != SSP_WIRE_META || !dispatch_meta(msg + SSP_WIRE_HEADER_SIZE, length)) {
+            // A server never sends HELLO
+            if (fd_ >= 0) {
+                fail(ERROR_SSP_PROTOCOL, "malformed message");
+            }
+            return false;
+        }
+        pos += SSP_WIRE_HEADER_SIZE + length;
+    }
+
+    // Keep the partial message at the front for the next read. With a
+    // frame in progress everything staged has been consumed.
+    if (fd_ >= 0 && pos) {
+        memmove(buf_.data(), buf_.data() + pos, fill_ - pos);
+        fill_ -= pos;
+    }
+    return fd_ >= 0;
+}
+
+int
+SspClient::check_header(const uint8_t* msg, SspWireType* type, guint32* length)
+{
+    if (!ssp_wire_read_header(msg, type, length)) {
+        fail(ERROR_SSP_PROTOCOL, "unknown message type");
+        return -1;
+    }
+
+    if (SSP_WIRE_HEADER_SIZE + (size_t)*length > max_message_) {
+        // Like libssp, a frame beyond the buffer size is lost
+        GST_WARNING("SSP message of %u bytes exceeds the %" G_GSIZE_FORMAT
+                    " byte receive buffer", *length, max_message_);
+        if (on_buffer_full_) {
+            on_buffer_full_();
+        }
+        skip_ = *length;
+        return 0;
+    }
+
+    if (*type == SSP_WIRE_VIDEO || *type == SSP_WIRE_AUDIO) {
+        if (*length < (*type == SSP_WIRE_VIDEO ? SSP_WIRE_VIDEO_PREFIX_SIZE
+                                               : SSP_WIRE_AUDIO_PREFIX_SIZE)) {
+            fail(ERROR_SSP_PROTOCOL, "malformed message");
+            return -1;
+        }
+    } else if (SSP_WIRE_HEADER_SIZE + (size_t)*length > buf_.size()) {
+        // Anything but a frame is taken whole from staging
+        fail(ERROR_SSP_PROTOCOL, "malformed message");
+        return -1;
+    }
+    return 1;
+}
+
+bool
+SspClient::dispatch_meta(uint8_t* payload, size_t length)
+{
+    SspWireMeta m;
+
+    if (length < SSP_WIRE_META_SIZE) {
+        return false;
+    }
+    ssp_wire_read_meta(payload, &m);
+
+    SspVideoMeta video = { m.width, m.height, m.timescale, m.unit, m.gop, m.encoder };
+    SspAudioMeta audio = { m.audio_timescale, m.audio_unit, m.sample_rate,
+                           m.sample_size, m.channel, m.bitrate, m.audio_encoder };
+    SspMeta meta = { m.pts_is_wall_clock != 0, m.tc_drop_frame != 0, m.timecode };
+    if (on_meta_) {
+        on_meta_(&video, &audio, &meta);
+    }
+    return fd_ >= 0;
+}
+
+void
+SspClient::begin_frame(int type, const uint8_t* prefix, size_t size)
+{
+    frame_type_ = type;
+    memcpy(frame_prefix_, prefix,
+           type == SSP_WIRE_VIDEO ? SSP_WIRE_VIDEO_PREFIX_SIZE : SSP_WIRE_AUDIO_PREFIX_SIZE);
+    frame_size_ = size;
+    frame_fill_ = 0;
+}
+
+void
+SspClient::alloc_frame()
+{
+    GstMapInfo map;
+
+    // Pooled blocks do not move, the pointer outlives the mapping
+    frame_ = gst_ssp_memory_new(frame_size_);
+    gst_memory_map(frame_, &map, GST_MAP_WRITE);
+    frame_data_ = map.data;
+    gst_memory_unmap(frame_, &map);
+}
+
+bool
+SspClient::finish_frame()
+{
+    GstMemory* memory = frame_;
+    SspWireFrame frame;
+
+    frame_ = nullptr;
+    ssp_wire_read_frame(frame_prefix_, (SspWireType)frame_type_, &frame);
+
+    if (frame_type_ == SSP_WIRE_VIDEO) {
+        SspH264Data data = { frame_data_, frame_size_, frame.pts, frame.ntp_timestamp,
+                             frame.frm_no, frame.type, memory };
+        if (on_h264_) {
+            on_h264_(&data);
+        }
+    } else {
+        SspAudioData data = { frame_data_, frame_size_, frame.pts, frame.ntp_timestamp,
+                              memory };
+        if (on_audio_) {
+            on_audio_(&data);
+        }
+    }
+
+    gst_memory_unref(memory);
+    return fd_ >= 0;
+}
+
+bool
+SspClient::start_uring()
+{
+#ifdef HAVE_IO_URING
+    if (g_strcmp0(g_getenv("GST_SSP_IO"), "epoll") == 0) {
+        return false;
+    }
+    Uring* uring = loop_->uring();
+    if (!uring) {
+        return false;
+    }
+    recv_ = UringRecv::create(uring, loop_, this);
+    if (!recv_) {
+        return false;
+    }
+    if (!recv_->arm()) {
+        recv_->stop();
+        recv_ = nullptr;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_IO_URING
+void
+SspClient::on_uring_data(const uint8_t* data, size_t len, unsigned bid, size_t offset)
+{
+    while (len && fd_ >= 0) {
+        size_t n;
+
+        if (frame_ || uring_bid_ >= 0) {
+            n = MIN(len, frame_size_ - frame_fill_);
+            if (uring_bid_ >= 0 && !frame_fill_) {
+                // In place from its first byte on
+                uring_bid_ = bid;
+                uring_offset_ = offset;
+            } else if (uring_bid_ >= 0 &&
+                       ((unsigned)uring_bid_ != bid || uring_offset_ + frame_fill_ != offset)) {
+                copy_out_frame();
+            }
+            if (frame_) {
+                memcpy(frame_data_ + frame_fill_, data, n);
+            }
+            frame_fill_ += n;
+            data += n;
+            len -= n;
+            offset += n;
+            if (frame_fill_ == frame_size_) {
+                finish_uring_frame();
+            }
+            continue;
+        }
+
+        if (skip_) {
+            n = MIN(len, skip_);
+            skip_ -= n;
+            data += n;
+            len -= n;
+            offset += n;
+            continue;
+        }
+
+        // The header, then the frame prefix or the whole message, through
+        // staging
+        bool header = fill_ < SSP_WIRE_HEADER_SIZE;
+        size_t want = SSP_WIRE_HEADER_SIZE;
+        SspWireType type = SSP_WIRE_HELLO;
+        guint32 length = 0;
+
+        if (!header) {
+            ssp_wire_read_header(buf_.data(), &type, &length);
+            want += type == SSP_WIRE_VIDEO ? SSP_WIRE_VIDEO_PREFIX_SIZE
+                  : type == SSP_WIRE_AUDIO ? SSP_WIRE_AUDIO_PREFIX_SIZE
+                  : length;
+        }
+        n = MIN(len, want - fill_);
+        memcpy(buf_.data() + fill_, data, n);
+        fill_ += n;
+        data += n;
+        len -= n;
+        offset += n;
+        if (fill_ < want) {
+            continue;
+        }
+
+        if (header) {
+            int check = check_header(buf_.data(), &type, &length);
+            if (check < 0) {
+                return;
+            }
+            if (check == 0) {
+                fill_ = 0;
+            }
+            continue;
+        }
+
+        fill_ = 0;
+        if (type == SSP_WIRE_VIDEO || type == SSP_WIRE_AUDIO) {
+            begin_frame(type, buf_.data() + SSP_WIRE_HEADER_SIZE,
+                        length - (want - SSP_WIRE_HEADER_SIZE));
+            uring_bid_ = bid;
+            uring_offset_ = offset;
+            if (!frame_size_) {
+                finish_uring_frame();
+            }
+        } else if (type != SSP_WIRE_META || !dispatch_meta(buf_.data() + SSP_WIRE_HEADER_SIZE, length)) {
+            if (fd_ >= 0) {
+                fail(ERROR_SSP_PROTOCOL, "malformed message");
+            }
+            return;
+        }
+    }
+}
+
+void
+SspClient::on_uring_buffer_done(unsigned bid)
+{
+    // Its start is about to be reused
+    if (uring_bid_ == (int)bid && frame_fill_) {
+        copy_out_frame();
+    }
+}
+
+void
+SspClient::copy_out_frame()
+{
+    const uint8_t* start = recv_->buffer(uring_bid_) + uring_offset_;
+
+    uring_bid_ = -1;
+    alloc_frame();
+    memcpy(frame_data_, start, frame_fill_);
+}
+
+void
+SspClient::finish_uring_frame()
+{
+    if (uring_bid_ >= 0) {
+        frame_ = recv_->wrap(uring_bid_, uring_offset_, frame_size_);
+        if (frame_) {
+            frame_data_ = recv_->buffer(uring_bid_) + uring_offset_;
+            uring_bid_ = -1;
+        } else {
+            copy_out_frame();
+        }
+    }
+    finish_frame();
+}
+#endif
+
+} // namespace imf
@@ -0,0 +1,52 @@
+#include "imf/net/threadloop.h"
+
+namespace imf {
+
+ThreadLoop::ThreadLoop(const InitCallback& init)
+    : init_(init)
+    , loop_(nullptr)
+    , thread_(nullptr)
+{
+}
+
+ThreadLoop::~ThreadLoop()
+{
+    stop();
+}
+
+gpointer
+ThreadLoop::thread_func(gpointer data)
+{
+    ThreadLoop* self = static_cast<ThreadLoop*>(data);
+
+    if (self->init_) {
+        self->init_(self->loop_);
+    }
+    self->loop_->run();
+    return nullptr;
+}
+
+void
+ThreadLoop::start()
+{
+    if (thread_) {
+        return;
+    }
+    loop_ = new Loop();
+    thread_ = g_thread_new("ssp-loop", thread_func, this);
+}
+
+void
+ThreadLoop::stop()
+{
+    if (!thread_) {
+        return;
+    }
+    loop_->quit();
+    g_thread_join(thread_);
+    thread_ = nullptr;
+    delete loop_;
+    loop_ = nullptr;
+}
+
+} // namespace imf
@@ -0,0 +1,278 @@
+#include "imf/net/uring.h"
+#include "imf/net/loop.h"
+
+#include <gst/gst.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Submissions are a few per connection, completions arrive per received
+// chunk of every connection on the loop
+#define URING_SQ_ENTRIES 64
+#define URING_CQ_ENTRIES 4096
+
+namespace imf {
+
+static gint
+uring_setup(guint entries, struct io_uring_params* p)
+{
+    return (gint)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static gint
+uring_enter(gint fd, guint to_submit, guint flags)
+{
+    Loop::add_syscalls(1);
+    return (gint)syscall(__NR_io_uring_enter, fd, to_submit, 0, flags, nullptr, 0);
+}
+
+static gint
+uring_register(gint fd, guint opcode, void* arg, guint nr_args)
+{
+    return (gint)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+Uring::Uring()
+    : fd_(-1)
+    , closing_(false)
+    , sq_local_tail_(0)
+    , to_submit_(0)
+    , ring_map_(MAP_FAILED)
+    , ring_map_size_(0)
+    , sqes_size_(0)
+    , next_id_(1)
+{
+    sqes_ = (struct io_uring_sqe*)MAP_FAILED;
+}
+
+Uring::~Uring()
+{
+    std::map<guint64, Handler> handlers;
+
+    closing_ = true;
+    handlers.swap(handlers_);
+    for (auto& entry : handlers) {
+        struct io_uring_cqe cqe = {};
+
+        cqe.user_data = entry.first;
+        cqe.res = -ECANCELED;
+        entry.second(cqe);
+    }
+
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (ring_map_ != MAP_FAILED) {
+        munmap(ring_map_, ring_map_size_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+Uring*
+Uring::create()
+{
+    Uring* uring = new Uring();
+
+    if (!uring->setup()) {
+        delete uring;
+        return nullptr;
+    }
+    return uring;
+}
+
+gboolean
+Uring::setup()
+{
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = URING_CQ_ENTRIES;
+    fd_ = uring_setup(URING_SQ_ENTRIES, &p);
+    if (fd_ < 0) {
+        // ENOSYS, or EPERM with kernel.io_uring_disabled or a seccomp filter
+        GST_INFO("io_uring unavailable: %s", g_strerror(errno));
+        return FALSE;
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        GST_INFO("io_uring too old");
+        return FALSE;
+    }
+
+    ring_map_size_ = MAX(p.sq_off.array + p.sq_entries * sizeof(guint32),
+                         p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe));
+    ring_map_ = mmap(nullptr, ring_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     fd_, IORING_OFF_SQ_RING);
+    sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe*)mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (ring_map_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+        GST_WARNING("Cannot map the io_uring: %s", g_strerror(errno));
+        return FALSE;
+    }
+
+    guint8* base = (guint8*)ring_map_;
+    sq_head_ = (guint32*)(base + p.sq_off.head);
+    sq_tail_ = (guint32*)(base + p.sq_off.tail);
+    sq_mask_ = *(guint32*)(base + p.sq_off.ring_mask);
+    sq_entries_ = p.sq_entries;
+    sq_flags_ = (guint32*)(base + p.sq_off.flags);
+    cq_head_ = (guint32*)(base + p.cq_off.head);
+    cq_tail_ = (guint32*)(base + p.cq_off.tail);
+    cq_mask_ = *(guint32*)(base + p.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe*)(base + p.cq_off.cqes);
+
+    // SQEs are used in order, the index array never changes
+    guint32* array = (guint32*)(base + p.sq_off.array);
+    for (guint32 i = 0; i < p.sq_entries; i++) {
+        array[i] = i;
+    }
+    sq_local_tail_ = *sq_tail_;
+
+    // Incremental consumption (6.12) implies multishot receive (6.0);
+    // without it every receive would take a whole buffer
+    gsize page = sysconf(_SC_PAGESIZE);
+    void* probe = mmap(nullptr, page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    guint16 bgid;
+    gboolean ok = probe != MAP_FAILED &&
+                  register_buf_ring((struct io_uring_buf_ring*)probe, 1, IOU_PBUF_RING_INC, &bgid);
+    if (ok) {
+        unregister_buf_ring(bgid);
+    } else {
+        GST_INFO("io_uring lacks incrementally consumed buffer rings");
+    }
+    if (probe != MAP_FAILED) {
+        munmap(probe, page);
+    }
+    return ok;
+}
+
+guint64
+Uring::add_handler(const Handler& handler)
+{
+    guint64 id = next_id_++;
+
+    handlers_[id] = handler;
+    return id;
+}
+
+void
+Uring::remove_handler(guint64 id)
+{
+    handlers_.erase(id);
+}
+
+struct io_uring_sqe*
+Uring::get_sqe()
+{
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        submit();
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            return nullptr;
+        }
+    }
+
+    struct io_uring_sqe* sqe = &sqes_[sq_local_tail_ & sq_mask_];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_local_tail_++;
+    to_submit_++;
+    return sqe;
+}
+
+void
+Uring::submit()
+{
+    if (!to_submit_) {
+        return;
+    }
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    while (to_submit_) {
+        gint n = uring_enter(fd_, to_submit_, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EAGAIN/EBUSY: the kernel takes the rest with the next call
+            GST_WARNING("io_uring submit failed: %s", g_strerror(errno));
+            break;
+        }
+        to_submit_ -= MIN((guint32)n, to_submit_);
+    }
+}
+
+void
+Uring::reap()
+{
+    for (;;) {
+        guint32 head = *cq_head_;
+        guint32 tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            // Completions the kernel kept aside while the queue was full
+            if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+                uring_enter(fd_, 0, IORING_ENTER_GETEVENTS);
+                continue;
+            }
+            break;
+        }
+
+        for (; head != tail; head++) {
+            struct io_uring_cqe cqe = cqes_[head & cq_mask_];
+
+            // The slot is free again before a handler submits more
+            __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+            auto it = handlers_.find(cqe.user_data);
+            if (it != handlers_.end()) {
+                Handler handler = it->second;
+                handler(cqe);
+            }
+        }
+    }
+}
+
+gboolean
+Uring::register_buf_ring(struct io_uring_buf_ring* ring, guint entries, guint16 flags,
+                         guint16* bgid)
+{
+    struct io_uring_buf_reg reg;
+    guint16 id = 0;
+
+    while (bgids_.count(id)) {
+        id++;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (guint64)(guintptr)ring;
+    reg.ring_entries = entries;
+    reg.bgid = id;
+    // "pad" before the flags were added (6.6), same place
+    memcpy((guint8*)&reg + offsetof(struct io_uring_buf_reg, bgid) + sizeof(reg.bgid), &flags,
+           sizeof(flags));
+    if (uring_register(fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        GST_DEBUG("Cannot register a buffer ring: %s", g_strerror(errno));
+        return FALSE;
+    }
+    bgids_.insert(id);
+    *bgid = id;
+    return TRUE;
+}
+
+void
+Uring::unregister_buf_ring(guint16 bgid)
+{
+    struct io_uring_buf_reg reg;
+
+    if (closing_ || !bgids_.erase(bgid)) {
+        return;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = bgid;
+    uring_register(fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+}
+
+} // namespace imf
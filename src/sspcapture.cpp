@@ -0,0 +1,325 @@
+#include "sspcapture.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define SSP_CAPTURE_MAGIC "SSPCAP\0\0"
+#define SSP_CAPTURE_INDEX_MAGIC "SSPCIDX\0"
+#define SSP_CAPTURE_HEADER_SIZE 16
+#define SSP_CAPTURE_RECORD_HEADER_SIZE 16
+#define SSP_CAPTURE_TRAILER_SIZE 16
+// Writes reach the kernel in large chunks, the loop thread rarely syscalls
+#define SSP_CAPTURE_STDIO_BUFFER (4 * 1024 * 1024)
+
+static inline guint32
+read_u32(const guint8* in)
+{
+    guint32 v;
+    memcpy(&v, in, 4);
+    return GUINT32_FROM_LE(v);
+}
+
+static inline guint64
+read_u64(const guint8* in)
+{
+    guint64 v;
+    memcpy(&v, in, 8);
+    return GUINT64_FROM_LE(v);
+}
+
+static inline void
+write_u32(guint8* out, guint32 v)
+{
+    v = GUINT32_TO_LE(v);
+    memcpy(out, &v, 4);
+}
+
+static inline void
+write_u64(guint8* out, guint64 v)
+{
+    v = GUINT64_TO_LE(v);
+    memcpy(out, &v, 8);
+}
+
+static inline gsize
+padding(gsize len)
+{
+    return (8 - (len & 7)) & 7;
+}
+
+SspCaptureWriter::SspCaptureWriter()
+    : file_(nullptr)
+    , offset_(0)
+    , start_(0)
+    , failed_(FALSE)
+{
+}
+
+SspCaptureWriter::~SspCaptureWriter()
+{
+    close();
+}
+
+gboolean
+SspCaptureWriter::open(const std::string& path)
+{
+    guint8 header[SSP_CAPTURE_HEADER_SIZE];
+
+    file_ = fopen(path.c_str(), "wb");
+    if (!file_) {
+        GST_ERROR("Cannot create capture file %s: %s", path.c_str(), g_strerror(errno));
+        return FALSE;
+    }
+    setvbuf(file_, nullptr, _IOFBF, SSP_CAPTURE_STDIO_BUFFER);
+
+    memcpy(header, SSP_CAPTURE_MAGIC, 8);
+    write_u32(header + 8, SSP_CAPTURE_VERSION);
+    write_u32(header + 12, 0);
+    if (fwrite(header, sizeof(header), 1, file_) != 1) {
+        GST_ERROR("Cannot write capture file %s: %s", path.c_str(), g_strerror(errno));
+        fclose(file_);
+        file_ = nullptr;
+        return FALSE;
+    }
+
+    path_ = path;
+    offset_ = sizeof(header);
+    start_ = gst_util_get_timestamp();
+    failed_ = FALSE;
+    index_.clear();
+    return TRUE;
+}
+
+void
+SspCaptureWriter::write_record(SspCaptureType type, GstClockTime received,
+                               const guint8* prefix, gsize prefix_len,
+                               const guint8* data, gsize len)
+{
+    static const guint8 zeros[8] = { 0 };
+    guint8 header[SSP_CAPTURE_RECORD_HEADER_SIZE];
+    gsize length = prefix_len + len;
+    gsize pad = padding(length);
+
+    if (!file_ || failed_) {
+        return;
+    }
+
+    write_u32(header, type);
+    write_u32(header + 4, length);
+    write_u64(header + 8, received > start_ ? received - start_ : 0);
+
+    if (fwrite(header, sizeof(header), 1, file_) != 1 ||
+        (prefix_len && fwrite(prefix, prefix_len, 1, file_) != 1) ||
+        (len && fwrite(data, len, 1, file_) != 1) ||
+        (pad && fwrite(zeros, pad, 1, file_) != 1)) {
+        // Whatever made it out is still indexed by a scan
+        GST_ERROR("Capture to %s stopped: %s", path_.c_str(), g_strerror(errno));
+        failed_ = TRUE;
+        return;
+    }
+
+    if (type != SSP_CAPTURE_INDEX) {
+        index_.push_back(offset_);
+    }
+    offset_ += sizeof(header) + length + pad;
+}
+
+void
+SspCaptureWriter::write_meta(const SspWireMeta* meta, GstClockTime received)
+{
+    guint8 payload[SSP_WIRE_META_SIZE];
+
+    ssp_wire_write_meta(payload, meta);
+    write_record(SSP_CAPTURE_META, received, payload, sizeof(payload), nullptr, 0);
+}
+
+void
+SspCaptureWriter::write_frame(SspWireType type, const SspWireFrame* frame,
+                              const guint8* data, gsize len, GstClockTime received)
+{
+    guint8 prefix[SSP_WIRE_VIDEO_PREFIX_SIZE];
+    gsize prefix_len = type == SSP_WIRE_VIDEO ? SSP_WIRE_VIDEO_PREFIX_SIZE :
+        SSP_WIRE_AUDIO_PREFIX_SIZE;
+
+    ssp_wire_write_frame(prefix, type, frame);
+    write_record(type == SSP_WIRE_VIDEO ? SSP_CAPTURE_VIDEO : SSP_CAPTURE_AUDIO,
+                 received, prefix, prefix_len, data, len);
+}
+
+void
+SspCaptureWriter::close()
+{
+    if (!file_) {
+        return;
+    }
+
+    if (!failed_) {
+        std::vector<guint8> index(index_.size() * 8);
+        guint8 trailer[SSP_CAPTURE_TRAILER_SIZE];
+        guint64 index_offset = offset_;
+
+        for (gsize i = 0; i < index_.size(); i++) {
+            write_u64(index.data() + i * 8, index_[i]);
+        }
+        write_record(SSP_CAPTURE_INDEX, start_, nullptr, 0, index.data(), index.size());
+
+        write_u64(trailer, index_offset);
+        memcpy(trailer + 8, SSP_CAPTURE_INDEX_MAGIC, 8);
+        if (!failed_ && fwrite(trailer, sizeof(trailer), 1, file_) != 1) {
+            failed_ = TRUE;
+        }
+    }
+
+    if (fclose(file_) != 0) {
+        failed_ = TRUE;
+    }
+    if (failed_) {
+        GST_WARNING("Capture %s is incomplete", path_.c_str());
+    } else {
+        GST_INFO("Captured %" G_GSIZE_FORMAT " records to %s", index_.size(), path_.c_str());
+    }
+    file_ = nullptr;
+}
+
+SspCaptureReader::SspCaptureReader()
+    : file_(nullptr)
+    , data_(nullptr)
+    , size_(0)
+{
+}
+
+SspCaptureReader::~SspCaptureReader()
+{
+    close();
+}
+
+gboolean
+SspCaptureReader::open(const std::string& path)
+{
+    GError* error = nullptr;
+
+    // Frames are handed out read-only, a loop hands the same bytes out again
+    file_ = g_mapped_file_new(path.c_str(), FALSE, &error);
+    if (!file_) {
+        GST_ERROR("Cannot map capture file %s: %s", path.c_str(), error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+    data_ = (const guint8*)g_mapped_file_get_contents(file_);
+    size_ = g_mapped_file_get_length(file_);
+
+    if (size_ < SSP_CAPTURE_HEADER_SIZE || memcmp(data_, SSP_CAPTURE_MAGIC, 8) != 0 ||
+        read_u32(data_ + 8) != SSP_CAPTURE_VERSION) {
+        GST_ERROR("%s is not an SSP capture file", path.c_str());
+        close();
+        return FALSE;
+    }
+
+    index_.clear();
+    if (size_ >= SSP_CAPTURE_HEADER_SIZE + SSP_CAPTURE_TRAILER_SIZE &&
+        memcmp(data_ + size_ - 8, SSP_CAPTURE_INDEX_MAGIC, 8) == 0 &&
+        load_index(read_u64(data_ + size_ - SSP_CAPTURE_TRAILER_SIZE))) {
+        GST_INFO("Capture %s: %" G_GSIZE_FORMAT " records", path.c_str(), index_.size());
+    } else {
+        scan();
+        GST_WARNING("Capture %s has no index, scanned %" G_GSIZE_FORMAT " records",
+                    path.c_str(), index_.size());
+    }
+    return TRUE;
+}
+
+void
+SspCaptureReader::close()
+{
+    if (file_) {
+        g_mapped_file_unref(file_);
+    }
+    file_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    index_.clear();
+}
+
+GstMemory*
+SspCaptureReader::wrap(const guint8* data, gsize len) const
+{
+    return gst_memory_new_wrapped(GST_MEMORY_FLAG_READONLY, (gpointer)data, len, 0, len,
+                                  g_mapped_file_ref(file_), (GDestroyNotify)g_mapped_file_unref);
+}
+
+// Every entry must point at a whole record ahead of the index
+gboolean
+SspCaptureReader::load_index(guint64 offset)
+{
+    gsize end = size_ - SSP_CAPTURE_TRAILER_SIZE;
+    guint32 length;
+
+    if (offset < SSP_CAPTURE_HEADER_SIZE || offset + SSP_CAPTURE_RECORD_HEADER_SIZE > end ||
+        read_u32(data_ + offset) != SSP_CAPTURE_INDEX) {
+        return FALSE;
+    }
+    length = read_u32(data_ + offset + 4);
+    if (length % 8 || offset + SSP_CAPTURE_RECORD_HEADER_SIZE + length > end) {
+        return FALSE;
+    }
+
+    const guint8* entries = data_ + offset + SSP_CAPTURE_RECORD_HEADER_SIZE;
+    index_.resize(length / 8);
+    for (gsize i = 0; i < index_.size(); i++) {
+        guint64 record = read_u64(entries + i * 8);
+        if (record < SSP_CAPTURE_HEADER_SIZE ||
+            record + SSP_CAPTURE_RECORD_HEADER_SIZE > offset ||
+            record + SSP_CAPTURE_RECORD_HEADER_SIZE + read_u32(data_ + record + 4) > offset) {
+            index_.clear();
+            return FALSE;
+        }
+        index_[i] = record;
+    }
+    return TRUE;
+}
+
+// Up to the first truncated record, as left by a crash
+void
+SspCaptureReader::scan()
+{
+    guint64 pos = SSP_CAPTURE_HEADER_SIZE;
+
+    while (pos + SSP_CAPTURE_RECORD_HEADER_SIZE <= size_) {
+        guint32 type = read_u32(data_ + pos);
+        guint32 length = read_u32(data_ + pos + 4);
+
+        if (type < SSP_CAPTURE_META || type > SSP_CAPTURE_INDEX ||
+            pos + SSP_CAPTURE_RECORD_HEADER_SIZE + length > size_) {
+            break;
+        }
+        if (type != SSP_CAPTURE_INDEX) {
+            index_.push_back(pos);
+        }
+        pos += SSP_CAPTURE_RECORD_HEADER_SIZE + length + padding(length);
+    }
+}
+
+gboolean
+SspCaptureReader::get(gsize i, SspCaptureRecord* record) const
+{
+    if (i >= index_.size()) {
+        return FALSE;
+    }
+
+    const guint8* header = data_ + index_[i];
+    record->type = (SspCaptureType)read_u32(header);
+    record->length = read_u32(header + 4);
+    record->time = read_u64(header + 8);
+    record->payload = header + SSP_CAPTURE_RECORD_HEADER_SIZE;
+
+    switch (record->type) {
+    case SSP_CAPTURE_META:
+        return record->length >= SSP_WIRE_META_SIZE;
+    case SSP_CAPTURE_VIDEO:
+        return record->length >= SSP_WIRE_VIDEO_PREFIX_SIZE;
+    case SSP_CAPTURE_AUDIO:
+        return record->length >= SSP_WIRE_AUDIO_PREFIX_SIZE;
+    default:
+        return FALSE;
+    }
+}
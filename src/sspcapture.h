@@ -0,0 +1,86 @@
+#ifndef __SSP_CAPTURE_H__
+#define __SSP_CAPTURE_H__
+
+#include <gst/gst.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "sspwire.h"
+
+// Capture file of what libssp handed to SspThread, replayed by sspfilesrc.
+//
+// A 16 byte header ("SSPCAP\0\0", u32 version, u32 0) is followed by
+// records, each 8 byte aligned: u32 type, u32 length, u64 arrival in ns
+// since the capture started, then the payload in the sspwire layout (the
+// meta, or the frame prefix and the data). Closing appends an index record
+// with one entry per record and a 16 byte trailer with the index offset and
+// "SSPCIDX\0". A capture that was never closed is indexed by a scan.
+
+#define SSP_CAPTURE_VERSION 1
+
+enum SspCaptureType {
+    SSP_CAPTURE_META = 1,
+    SSP_CAPTURE_VIDEO = 2,
+    SSP_CAPTURE_AUDIO = 3,
+    SSP_CAPTURE_INDEX = 4
+};
+
+struct SspCaptureRecord {
+    SspCaptureType type;
+    GstClockTime time;          // since the capture started
+    const guint8* payload;      // inside the mapping, valid until close()
+    gsize length;
+};
+
+// Appends on the loop thread, through a large stdio buffer
+class SspCaptureWriter {
+public:
+    SspCaptureWriter();
+    ~SspCaptureWriter();
+
+    gboolean open(const std::string& path);
+    void close();
+
+    void write_meta(const SspWireMeta* meta, GstClockTime received);
+    void write_frame(SspWireType type, const SspWireFrame* frame,
+                     const guint8* data, gsize len, GstClockTime received);
+
+private:
+    void write_record(SspCaptureType type, GstClockTime received,
+                      const guint8* prefix, gsize prefix_len,
+                      const guint8* data, gsize len);
+
+    FILE* file_;
+    std::string path_;
+    guint64 offset_;
+    GstClockTime start_;
+    gboolean failed_;
+    std::vector<guint64> index_;
+};
+
+// Maps the whole file, records are read in place
+class SspCaptureReader {
+public:
+    SspCaptureReader();
+    ~SspCaptureReader();
+
+    gboolean open(const std::string& path);
+    void close();
+
+    gsize n_records() const { return index_.size(); }
+    gboolean get(gsize i, SspCaptureRecord* record) const;
+    // Read-only memory over part of a payload, keeps the mapping alive
+    GstMemory* wrap(const guint8* data, gsize len) const;
+
+private:
+    gboolean load_index(guint64 offset);
+    void scan();
+
+    GMappedFile* file_;
+    const guint8* data_;
+    gsize size_;
+    std::vector<guint64> index_;
+};
+
+#endif /* __SSP_CAPTURE_H__ */
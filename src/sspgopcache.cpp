@@ -0,0 +1,97 @@
+#include "sspgopcache.h"
+
+SspGopCache::SspGopCache(guint64 max_bytes)
+    : bytes_(0)
+    , max_bytes_(max_bytes)
+    , valid_(FALSE)
+    , hits_(0)
+    , misses_(0)
+    , overflows_(0)
+{
+    g_mutex_init(&lock_);
+    g_queue_init(&frames_);
+}
+
+SspGopCache::~SspGopCache()
+{
+    clear();
+    g_mutex_clear(&lock_);
+}
+
+void
+SspGopCache::clear()
+{
+    GstBuffer* buffer;
+    while ((buffer = (GstBuffer*)g_queue_pop_head(&frames_)) != nullptr) {
+        gst_buffer_unref(buffer);
+    }
+    bytes_ = 0;
+}
+
+void
+SspGopCache::append(GstBuffer* buffer, gboolean keyframe)
+{
+    gsize size = gst_buffer_get_size(buffer);
+
+    g_mutex_lock(&lock_);
+    if (keyframe) {
+        clear();
+        valid_ = TRUE;
+    }
+
+    if (valid_ && bytes_ + size > max_bytes_) {
+        GST_DEBUG("GOP exceeds %" G_GUINT64_FORMAT " bytes, not cached", max_bytes_);
+        clear();
+        valid_ = FALSE;
+        overflows_++;
+    }
+
+    if (valid_) {
+        g_queue_push_tail(&frames_, gst_buffer_ref(buffer));
+        bytes_ += size;
+    }
+    g_mutex_unlock(&lock_);
+}
+
+void
+SspGopCache::invalidate()
+{
+    g_mutex_lock(&lock_);
+    clear();
+    valid_ = FALSE;
+    g_mutex_unlock(&lock_);
+}
+
+gboolean
+SspGopCache::snapshot(guint64 max_offset, GQueue* out)
+{
+    g_mutex_lock(&lock_);
+    if (!valid_) {
+        misses_++;
+        g_mutex_unlock(&lock_);
+        return FALSE;
+    }
+
+    for (GList* l = frames_.head; l; l = l->next) {
+        GstBuffer* buffer = (GstBuffer*)l->data;
+        if (GST_BUFFER_OFFSET(buffer) > max_offset) {
+            break;
+        }
+        g_queue_push_tail(out, gst_buffer_ref(buffer));
+    }
+    hits_++;
+    g_mutex_unlock(&lock_);
+    return TRUE;
+}
+
+void
+SspGopCache::get_stats(SspGopCacheStats* stats)
+{
+    g_mutex_lock(&lock_);
+    stats->hits = hits_;
+    stats->misses = misses_;
+    stats->overflows = overflows_;
+    stats->frames = frames_.length;
+    stats->bytes = bytes_;
+    g_mutex_unlock(&lock_);
+}
@@ -0,0 +1,49 @@
+#ifndef __SSP_GOP_CACHE_H__
+#define __SSP_GOP_CACHE_H__
+
+#include <gst/gst.h>
+
+struct SspGopCacheStats {
+    guint64 hits;                // replays served from an intact GOP
+    guint64 misses;              // replays requested without one
+    guint64 overflows;           // GOPs abandoned for exceeding max_bytes
+    guint frames;                // currently cached
+    guint64 bytes;
+};
+
+// Frames of the current GOP from its keyframe on, so a consumer that lost
+// its decoder state can restart from the keyframe instead of waiting for
+// the next one. The libssp loop thread appends, the streaming thread takes
+// snapshots; frames are ordered by GST_BUFFER_OFFSET.
+class SspGopCache {
+public:
+    explicit SspGopCache(guint64 max_bytes);
+    ~SspGopCache();
+
+    // Takes a ref. A keyframe starts a new GOP. A GOP that outgrows
+    // max_bytes is dropped and nothing is cached until the next keyframe.
+    void append(GstBuffer* buffer, gboolean keyframe);
+    // The chain is broken, e.g. a frame was lost
+    void invalidate();
+
+    // Refs of the cached frames with offset <= max_offset, keyframe first,
+    // appended to out. FALSE, counted as a miss, without an intact GOP.
+    gboolean snapshot(guint64 max_offset, GQueue* out);
+
+    void get_stats(SspGopCacheStats* stats);
+
+private:
+    void clear();
+
+    GMutex lock_;
+    GQueue frames_;
+    guint64 bytes_;
+    guint64 max_bytes_;
+    gboolean valid_;
+
+    guint64 hits_;
+    guint64 misses_;
+    guint64 overflows_;
+};
+
+#endif /* __SSP_GOP_CACHE_H__ */
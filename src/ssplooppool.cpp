@@ -0,0 +1,261 @@
+#include "ssplooppool.h"
+#include "sspsched.h"
+
+// Guards the process-wide pool pointer and its reference count
+static GMutex pool_lock;
+static SspLoopPool* pool = nullptr;
+
+SspLoopPool::SspLoopPool(guint n_threads)
+    : sample_time_(g_get_monotonic_time())
+    , refs_(0)
+{
+    g_mutex_init(&lock_);
+    g_cond_init(&cond_);
+
+    for (guint i = 0; i < n_threads; i++) {
+        Entry* entry = new Entry();
+        entry->index = i;
+        entry->loop = nullptr;
+        entry->thread = nullptr;
+        entry->bytes.store(0, std::memory_order_relaxed);
+        entry->frames.store(0, std::memory_order_relaxed);
+        entry->busy.store(0, std::memory_order_relaxed);
+        entry->clients = 0;
+        entry->reserved = 0;
+        entry->bitrate = 0;
+        entry->utilization = 0.0;
+        entry->sample_bytes = 0;
+        entry->sample_busy = 0;
+        entries_.emplace_back(entry);
+
+        entry->thread_loop.reset(new imf::ThreadLoop(
+            std::bind(&SspLoopPool::on_loop_started, this, entry, std::placeholders::_1)));
+        entry->thread_loop->start();
+    }
+
+    // Clients are only handed a loop once it runs
+    g_mutex_lock(&lock_);
+    for (auto& entry : entries_) {
+        while (!entry->loop) {
+            g_cond_wait(&cond_, &lock_);
+        }
+    }
+    g_mutex_unlock(&lock_);
+
+    GST_INFO("Started SSP loop pool with %u threads", n_threads);
+}
+
+SspLoopPool::~SspLoopPool()
+{
+    for (auto& entry : entries_) {
+        entry->thread_loop->stop();
+    }
+    entries_.clear();
+
+    g_mutex_clear(&lock_);
+    g_cond_clear(&cond_);
+}
+
+void
+SspLoopPool::on_loop_started(Entry* entry, imf::Loop* loop)
+{
+    gchar* name = g_strdup_printf("ssp-pool-%u", entry->index);
+    ssp_sched_apply_self(name, nullptr);
+    g_free(name);
+
+    g_mutex_lock(&lock_);
+    entry->loop = loop;
+    entry->thread = g_thread_self();
+    g_cond_broadcast(&cond_);
+    g_mutex_unlock(&lock_);
+}
+
+SspLoopPool*
+SspLoopPool::acquire(guint n_threads)
+{
+    SspLoopPool* ret;
+
+    g_mutex_lock(&pool_lock);
+    if (!pool) {
+        pool = new SspLoopPool(MAX(n_threads, 1));
+    } else if (n_threads != pool->size()) {
+        GST_WARNING("SSP loop pool already runs %u threads, ignoring a request for %u",
+                    pool->size(), n_threads);
+    }
+    pool->refs_++;
+    ret = pool;
+    g_mutex_unlock(&pool_lock);
+
+    return ret;
+}
+
+void
+SspLoopPool::release(SspLoopPool* released)
+{
+    g_mutex_lock(&pool_lock);
+    g_assert(released == pool);
+    if (--pool->refs_ == 0) {
+        GST_INFO("Stopping SSP loop pool");
+        delete pool;
+        pool = nullptr;
+    }
+    g_mutex_unlock(&pool_lock);
+}
+
+void
+SspLoopPool::get_global_stats(std::vector<SspLoopStats>* stats)
+{
+    stats->clear();
+
+    g_mutex_lock(&pool_lock);
+    if (pool) {
+        g_mutex_lock(&pool->lock_);
+        pool->sample_locked();
+        pool->get_stats_locked(stats);
+        g_mutex_unlock(&pool->lock_);
+    }
+    g_mutex_unlock(&pool_lock);
+}
+
+// Refresh the per loop rates, at most once a second so short calls in a
+// row do not produce noisy values
+void
+SspLoopPool::sample_locked()
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 elapsed = now - sample_time_;
+
+    if (elapsed < G_USEC_PER_SEC) {
+        return;
+    }
+
+    for (auto& entry : entries_) {
+        guint64 bytes = entry->bytes.load(std::memory_order_relaxed);
+        guint64 busy = entry->busy.load(std::memory_order_relaxed);
+
+        entry->bitrate = gst_util_uint64_scale(bytes - entry->sample_bytes, 8 * G_USEC_PER_SEC,
+                                               elapsed);
+        entry->utilization = (gdouble)(busy - entry->sample_busy) / (elapsed * 1000);
+        entry->sample_bytes = bytes;
+        entry->sample_busy = busy;
+    }
+    sample_time_ = now;
+}
+
+void
+SspLoopPool::get_stats_locked(std::vector<SspLoopStats>* stats) const
+{
+    for (const auto& entry : entries_) {
+        SspLoopStats s;
+        s.clients = entry->clients;
+        s.bitrate = entry->bitrate;
+        s.utilization = entry->utilization;
+        s.bytes = entry->bytes.load(std::memory_order_relaxed);
+        s.frames = entry->frames.load(std::memory_order_relaxed);
+        s.busy = entry->busy.load(std::memory_order_relaxed);
+        stats->push_back(s);
+    }
+}
+
+guint
+SspLoopPool::attach(guint64 bitrate_hint)
+{
+    guint best = 0;
+    guint64 best_load = G_MAXUINT64;
+
+    g_mutex_lock(&lock_);
+    sample_locked();
+
+    // A loop's load is what it measurably receives, or what its clients are
+    // expected to bring while they are still connecting. Between equal
+    // loads the one with fewer clients wins, so simultaneous starts spread.
+    for (guint i = 0; i < entries_.size(); i++) {
+        const Entry* entry = entries_[i].get();
+        guint64 load = MAX(entry->bitrate, entry->reserved);
+
+        if (load < best_load ||
+            (load == best_load && entry->clients < entries_[best]->clients)) {
+            best = i;
+            best_load = load;
+        }
+    }
+
+    entries_[best]->clients++;
+    entries_[best]->reserved += bitrate_hint;
+    g_mutex_unlock(&lock_);
+
+    GST_DEBUG("Attached client with bitrate hint %" G_GUINT64_FORMAT " to SSP loop %u "
+              "(load %" G_GUINT64_FORMAT ")", bitrate_hint, best, best_load);
+    return best;
+}
+
+void
+SspLoopPool::detach(guint index, guint64 bitrate_hint)
+{
+    g_mutex_lock(&lock_);
+    Entry* entry = entries_[index].get();
+    entry->clients--;
+    entry->reserved -= MIN(bitrate_hint, entry->reserved);
+    g_mutex_unlock(&lock_);
+}
+
+imf::Loop*
+SspLoopPool::loop(guint index) const
+{
+    return entries_[index]->loop;
+}
+
+void
+SspLoopPool::run(guint index, const std::function<void()>& func)
+{
+    entries_[index]->loop->queueInLoop(func);
+}
+
+void
+SspLoopPool::run_sync(guint index, const std::function<void()>& func)
+{
+    if (g_thread_self() == entries_[index]->thread) {
+        func();
+        return;
+    }
+
+    GMutex lock;
+    GCond cond;
+    gboolean done = FALSE;
+
+    g_mutex_init(&lock);
+    g_cond_init(&cond);
+
+    run(index, [&]() {
+        func();
+        g_mutex_lock(&lock);
+        done = TRUE;
+        g_cond_signal(&cond);
+        g_mutex_unlock(&lock);
+    });
+
+    g_mutex_lock(&lock);
+    while (!done) {
+        g_cond_wait(&cond, &lock);
+    }
+    g_mutex_unlock(&lock);
+
+    g_mutex_clear(&lock);
+    g_cond_clear(&cond);
+}
+
+void
+SspLoopPool::account(guint index, gsize bytes, GstClockTime busy)
+{
+    Entry* entry = entries_[index].get();
+
+    entry->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    entry->frames.fetch_add(1, std::memory_order_relaxed);
+    entry->busy.fetch_add(busy, std::memory_order_relaxed);
+}
+
+guint
+SspLoopPool::size() const
+{
+    return entries_.size();
+}
@@ -0,0 +1,88 @@
+#ifndef __SSP_LOOP_POOL_H__
+#define __SSP_LOOP_POOL_H__
+
+#include <gst/gst.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "imf/net/threadloop.h"
+
+// Environment variable selecting the pool size for elements that leave
+// loop-threads at its default
+#define SSP_LOOP_THREADS_ENV "GST_SSP_LOOP_THREADS"
+
+struct SspLoopStats {
+    guint clients;
+    guint64 bitrate;             // bits/s received over the last sample period
+    gdouble utilization;         // share of that period spent in frame callbacks
+    guint64 bytes;
+    guint64 frames;
+    GstClockTime busy;           // total time spent in frame callbacks
+};
+
+// Process-wide set of libssp loop threads that many SspClients share
+// instead of running one loop thread each. Clients go to the loop with the
+// lowest bitrate. The pool lives while any client is attached.
+class SspLoopPool {
+public:
+    // Shared pool, created with n_threads loops by the first caller. Later
+    // callers asking for another size get the existing pool.
+    static SspLoopPool* acquire(guint n_threads);
+    static void release(SspLoopPool* pool);
+
+    // Per loop load of the current pool, empty when there is none
+    static void get_global_stats(std::vector<SspLoopStats>* stats);
+
+    // Pick a loop for a client expected to receive bitrate_hint bits/s
+    // (0 when unknown) and account it there. detach() takes the same hint.
+    guint attach(guint64 bitrate_hint);
+    void detach(guint index, guint64 bitrate_hint);
+
+    imf::Loop* loop(guint index) const;
+    // Queue func on the loop thread
+    void run(guint index, const std::function<void()>& func);
+    // Run func on the loop thread and wait for it to return
+    void run_sync(guint index, const std::function<void()>& func);
+
+    // From the loop thread, once per frame
+    void account(guint index, gsize bytes, GstClockTime busy);
+
+    guint size() const;
+
+private:
+    struct Entry {
+        guint index;
+        std::unique_ptr<imf::ThreadLoop> thread_loop;
+        imf::Loop* loop;
+        GThread* thread;
+
+        std::atomic<guint64> bytes;
+        std::atomic<guint64> frames;
+        std::atomic<guint64> busy;
+
+        // Protected by the pool lock
+        guint clients;
+        guint64 reserved;        // sum of the clients' bitrate hints
+        guint64 bitrate;
+        gdouble utilization;
+        guint64 sample_bytes;
+        guint64 sample_busy;
+    };
+
+    explicit SspLoopPool(guint n_threads);
+    ~SspLoopPool();
+
+    void on_loop_started(Entry* entry, imf::Loop* loop);
+    void sample_locked();
+    void get_stats_locked(std::vector<SspLoopStats>* stats) const;
+
+    GMutex lock_;
+    GCond cond_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    gint64 sample_time_;
+    guint refs_;
+};
+
+#endif /* __SSP_LOOP_POOL_H__ */
@@ -0,0 +1,311 @@
+#include "sspnal.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSP_NAL_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if SSP_NAL_HAVE_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define SSP_NAL_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+static inline guint
+ctz32 (guint32 v)
+{
+  unsigned long i;
+  _BitScanForward (&i, v);
+  return i;
+}
+#else
+#define ctz32(v) ((guint) __builtin_ctz (v))
+#endif
+
+/* H.264 nal_unit_type */
+#define H264_NAL_SLICE 1
+#define H264_NAL_IDR 5
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+
+/* H.265 nal_unit_type */
+#define H265_NAL_BLA_W_LP 16
+#define H265_NAL_IDR_W_RADL 19
+#define H265_NAL_IDR_N_LP 20
+#define H265_NAL_CRA 21
+#define H265_NAL_VPS 32
+#define H265_NAL_SPS 33
+#define H265_NAL_PPS 34
+
+static const guint8 *
+find_start_code_scalar (const guint8 * p, const guint8 * end)
+{
+  /* Look at the third byte first: anything above 1 lets us skip three */
+  while (p + 3 <= end) {
+    if (p[2] > 1) {
+      p += 3;
+    } else if (p[2] == 0) {
+      p++;
+    } else if (p[0] == 0 && p[1] == 0) {
+      return p;
+    } else {
+      p += 3;
+    }
+  }
+  return end;
+}
+
+#if SSP_NAL_HAVE_SSE2
+static const guint8 *
+find_start_code_sse2 (const guint8 * p, const guint8 * end)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i one = _mm_set1_epi8 (1);
+
+  /* Loads reach 2 bytes ahead of the 16 candidate positions */
+  while (p + 18 <= end) {
+    __m128i b0 = _mm_loadu_si128 ((const __m128i *) p);
+    __m128i b1 = _mm_loadu_si128 ((const __m128i *) (p + 1));
+    __m128i b2 = _mm_loadu_si128 ((const __m128i *) (p + 2));
+    __m128i m = _mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8 (b0, zero),
+            _mm_cmpeq_epi8 (b1, zero)), _mm_cmpeq_epi8 (b2, one));
+    int mask = _mm_movemask_epi8 (m);
+
+    if (mask)
+      return p + ctz32 (mask);
+    p += 16;
+  }
+  return find_start_code_scalar (p, end);
+}
+#endif
+
+#if SSP_NAL_HAVE_AVX2
+__attribute__ ((target ("avx2")))
+static const guint8 *
+find_start_code_avx2 (const guint8 * p, const guint8 * end)
+{
+  const __m256i zero = _mm256_setzero_si256 ();
+  const __m256i one = _mm256_set1_epi8 (1);
+
+  while (p + 34 <= end) {
+    __m256i b0 = _mm256_loadu_si256 ((const __m256i *) p);
+    __m256i b1 = _mm256_loadu_si256 ((const __m256i *) (p + 1));
+    __m256i b2 = _mm256_loadu_si256 ((const __m256i *) (p + 2));
+    __m256i m = _mm256_and_si256 (_mm256_and_si256 (_mm256_cmpeq_epi8 (b0,
+                zero), _mm256_cmpeq_epi8 (b1, zero)), _mm256_cmpeq_epi8 (b2,
+            one));
+    guint32 mask = (guint32) _mm256_movemask_epi8 (m);
+
+    if (mask)
+      return p + ctz32 (mask);
+    p += 32;
+  }
+  return find_start_code_sse2 (p, end);
+}
+#endif
+
+typedef const guint8 *(*FindStartCodeFunc) (const guint8 * p, const guint8 * end);
+
+static FindStartCodeFunc
+select_find_start_code (void)
+{
+#if SSP_NAL_HAVE_AVX2
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    return find_start_code_avx2;
+#endif
+#if SSP_NAL_HAVE_SSE2
+  return find_start_code_sse2;
+#else
+  return find_start_code_scalar;
+#endif
+}
+
+const guint8 *
+ssp_nal_find_start_code (const guint8 * data, const guint8 * end)
+{
+  static FindStartCodeFunc func = select_find_start_code ();
+
+  return func (data, end);
+}
+
+guint8
+ssp_nal_type (guint32 codec, guint8 header)
+{
+  if (codec == SSP_NAL_CODEC_H265)
+    return (header >> 1) & 0x3f;
+  return header & 0x1f;
+}
+
+gboolean
+ssp_nal_is_vcl (guint32 codec, guint8 type)
+{
+  if (codec == SSP_NAL_CODEC_H265)
+    return type < 32;
+  return type >= H264_NAL_SLICE && type <= H264_NAL_IDR;
+}
+
+gboolean
+ssp_nal_is_parameter_set (guint32 codec, guint8 type)
+{
+  if (codec == SSP_NAL_CODEC_H265)
+    return type >= H265_NAL_VPS && type <= H265_NAL_PPS;
+  return type == H264_NAL_SPS || type == H264_NAL_PPS;
+}
+
+gboolean
+ssp_nal_is_idr (guint32 codec, guint8 type)
+{
+  if (codec == SSP_NAL_CODEC_H265)
+    return type >= H265_NAL_BLA_W_LP && type <= H265_NAL_CRA;
+  return type == H264_NAL_IDR;
+}
+
+static gboolean
+is_h264_profile_idc (guint8 profile_idc)
+{
+  switch (profile_idc) {
+    case 44: case 66: case 77: case 83: case 86: case 88: case 100:
+    case 110: case 118: case 122: case 128: case 134: case 135:
+    case 138: case 139: case 144: case 244:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* Only parameter sets are conclusive: slice headers of one codec are valid
+ * headers of the other */
+static guint32
+detect_codec (const guint8 * nal, gsize size)
+{
+  if (size < 2 || (nal[0] & 0x80))
+    return SSP_NAL_CODEC_UNKNOWN;
+
+  /* nuh_layer_id 0, nuh_temporal_id_plus1 1 */
+  if (nal[1] == 0x01) {
+    guint8 type = (nal[0] >> 1) & 0x3f;
+    if (type >= H265_NAL_VPS && type <= H265_NAL_PPS)
+      return SSP_NAL_CODEC_H265;
+  }
+
+  if ((nal[0] & 0x1f) == H264_NAL_SPS && (nal[0] & 0x60) &&
+      is_h264_profile_idc (nal[1]))
+    return SSP_NAL_CODEC_H264;
+
+  return SSP_NAL_CODEC_UNKNOWN;
+}
+
+void
+ssp_nal_index_build (SspNalIndex * index, const guint8 * data, gsize size,
+    guint32 codec, gboolean stop_at_vcl)
+{
+  const guint8 *end = data + size;
+  const guint8 *sc;
+  SspNalUnit *unit = NULL;
+
+  index->codec = codec;
+  index->n_units = 0;
+  index->complete = TRUE;
+  index->has_parameter_sets = FALSE;
+  index->has_idr = FALSE;
+
+  sc = ssp_nal_find_start_code (data, end);
+
+  while (sc < end) {
+    const guint8 *nal = sc + 3;
+
+    if (unit) {
+      /* Trailing zero of a 4-byte start code belongs to the next unit */
+      const guint8 *unit_end = (sc > data && sc[-1] == 0) ? sc - 1 : sc;
+      unit->size = (guint32) (unit_end - (data + unit->offset));
+    }
+
+    if (nal >= end)
+      break;
+
+    if (index->n_units == SSP_NAL_INDEX_MAX_UNITS) {
+      index->complete = FALSE;
+      return;
+    }
+
+    if (index->codec == SSP_NAL_CODEC_UNKNOWN) {
+      index->codec = detect_codec (nal, end - nal);
+      for (guint i = 0; i < index->n_units; i++)
+        index->units[i].type = ssp_nal_type (index->codec, index->units[i].header);
+    }
+
+    unit = &index->units[index->n_units++];
+    unit->offset = (guint32) (nal - data);
+    unit->size = (guint32) (end - nal);
+    unit->header = nal[0];
+    unit->type = ssp_nal_type (index->codec, nal[0]);
+    unit->start_code_size = (sc > data && sc[-1] == 0) ? 4 : 3;
+
+    if (index->codec != SSP_NAL_CODEC_UNKNOWN) {
+      if (ssp_nal_is_parameter_set (index->codec, unit->type))
+        index->has_parameter_sets = TRUE;
+
+      if (ssp_nal_is_vcl (index->codec, unit->type)) {
+        if (ssp_nal_is_idr (index->codec, unit->type))
+          index->has_idr = TRUE;
+        if (stop_at_vcl) {
+          index->complete = FALSE;
+          return;
+        }
+      }
+    }
+
+    sc = ssp_nal_find_start_code (nal + 1, end);
+  }
+}
+
+const SspNalUnit *
+ssp_nal_index_find (const SspNalIndex * index, guint8 type)
+{
+  guint i;
+
+  for (i = 0; i < index->n_units; i++) {
+    if (index->units[i].type == type)
+      return &index->units[i];
+  }
+  return NULL;
+}
+
+gsize
+ssp_nal_to_packetized (guint32 codec, const guint8 * data, gsize size,
+    guint8 * out)
+{
+  const guint8 *end = data + size;
+  const guint8 *sc = ssp_nal_find_start_code (data, end);
+  gsize written = 0;
+
+  while (sc < end) {
+    const guint8 *nal = sc + 3;
+    const guint8 *next = ssp_nal_find_start_code (nal, end);
+    const guint8 *nal_end = next;
+    gsize n;
+
+    /* A NAL unit never ends in a zero byte, those are trailing_zero_8bits
+     * or the first byte of a 4-byte start code */
+    while (nal_end > nal && nal_end[-1] == 0)
+      nal_end--;
+    n = nal_end - nal;
+
+    if (n > 0 && !ssp_nal_is_parameter_set (codec, ssp_nal_type (codec, nal[0]))) {
+      if (out) {
+        out[written] = (guint8) (n >> 24);
+        out[written + 1] = (guint8) (n >> 16);
+        out[written + 2] = (guint8) (n >> 8);
+        out[written + 3] = (guint8) n;
+        memcpy (out + written + 4, nal, n);
+      }
+      written += 4 + n;
+    }
+    sc = next;
+  }
+  return written;
+}
@@ -0,0 +1,60 @@
+#ifndef __SSP_NAL_H__
+#define __SSP_NAL_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Same values as libssp's VIDEO_ENCODER_H264/H265 */
+#define SSP_NAL_CODEC_UNKNOWN 0
+#define SSP_NAL_CODEC_H264 96
+#define SSP_NAL_CODEC_H265 265
+
+#define SSP_NAL_INDEX_MAX_UNITS 256
+
+typedef struct {
+  guint32 offset;            /* of the NAL header, after the start code */
+  guint32 size;              /* up to the next start code */
+  guint8 header;             /* first header byte */
+  guint8 type;               /* codec specific nal_unit_type */
+  guint8 start_code_size;    /* 3 or 4 */
+} SspNalUnit;
+
+typedef struct {
+  guint32 codec;
+  guint n_units;
+  gboolean complete;         /* FALSE when stopped at the first slice or full */
+  gboolean has_parameter_sets;
+  gboolean has_idr;          /* H.265: any IRAP picture */
+  SspNalUnit units[SSP_NAL_INDEX_MAX_UNITS];
+} SspNalIndex;
+
+/* Position of the next 00 00 01 in [data, end), or end. Uses AVX2 or SSE2
+ * when available. */
+const guint8 * ssp_nal_find_start_code (const guint8 * data, const guint8 * end);
+
+/* Index the Annex-B NAL units of one frame. With @codec unknown the codec
+ * is detected from the parameter sets. With @stop_at_vcl the scan ends at
+ * the first slice, whose size then extends to the end of the frame: the
+ * slice payload, i.e. almost all of the frame, is never read. */
+void ssp_nal_index_build (SspNalIndex * index, const guint8 * data,
+    gsize size, guint32 codec, gboolean stop_at_vcl);
+
+guint8 ssp_nal_type (guint32 codec, guint8 header);
+gboolean ssp_nal_is_vcl (guint32 codec, guint8 type);
+gboolean ssp_nal_is_parameter_set (guint32 codec, guint8 type);
+/* H.264 IDR, H.265 IRAP (BLA, IDR, CRA) */
+gboolean ssp_nal_is_idr (guint32 codec, guint8 type);
+
+/* First unit of @type, NULL if absent */
+const SspNalUnit * ssp_nal_index_find (const SspNalIndex * index, guint8 type);
+
+/* Rewrite an Annex-B access unit with 4-byte length prefixes (avc/hvc1),
+ * leaving out parameter sets. Returns the output size; with @out NULL only
+ * the size is computed. */
+gsize ssp_nal_to_packetized (guint32 codec, const guint8 * data, gsize size,
+    guint8 * out);
+
+G_END_DECLS
+
+#endif /* __SSP_NAL_H__ */
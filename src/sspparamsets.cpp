@@ -0,0 +1,843 @@
+#include "sspparamsets.h"
+
+#include <gst/base/gstbytewriter.h>
+#include <gst/video/video.h>
+#include <string.h>
+
+/* Parameter sets are a few hundred bytes at most, anything beyond this is
+ * not needed for the fields we read */
+#define SSP_PARAM_SET_MAX_SIZE 1024
+
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H265_NAL_VPS 32
+#define H265_NAL_SPS 33
+#define H265_NAL_PPS 34
+
+/* H.265 general_*_constraint_flag bits in SspVideoParams.rext_flags */
+#define H265_MAX_12BIT (1 << 8)
+#define H265_MAX_10BIT (1 << 7)
+#define H265_MAX_8BIT (1 << 6)
+#define H265_MAX_422CHROMA (1 << 5)
+#define H265_MAX_420CHROMA (1 << 4)
+#define H265_MAX_MONOCHROME (1 << 3)
+#define H265_INTRA (1 << 2)
+#define H265_ONE_PICTURE_ONLY (1 << 1)
+
+typedef struct {
+  const guint8 *data;
+  guint size;
+  guint pos;                 /* in bits */
+  gboolean error;
+} BitReader;
+
+/* Table E-1 */
+static const gint sar_table[][2] = {
+  {0, 0}, {1, 1}, {12, 11}, {10, 11}, {16, 11}, {40, 33}, {24, 11},
+  {20, 11}, {32, 11}, {80, 33}, {18, 11}, {15, 11}, {64, 33}, {160, 99},
+  {4, 3}, {3, 2}, {2, 1}
+};
+
+/* Strip emulation prevention bytes */
+static guint
+unescape (const guint8 * nal, gsize size, guint8 * out, guint max)
+{
+  guint n = 0, zeros = 0;
+  gsize i;
+
+  for (i = 0; i < size && n < max; i++) {
+    if (zeros >= 2 && nal[i] == 0x03) {
+      zeros = 0;
+      continue;
+    }
+    out[n++] = nal[i];
+    zeros = nal[i] == 0 ? zeros + 1 : 0;
+  }
+  return n;
+}
+
+static guint32
+read_bits (BitReader * br, guint n)
+{
+  guint32 value = 0;
+  guint i;
+
+  if (br->error || br->pos + n > br->size * 8) {
+    br->error = TRUE;
+    return 0;
+  }
+
+  for (i = 0; i < n; i++, br->pos++)
+    value = (value << 1) | ((br->data[br->pos >> 3] >> (7 - (br->pos & 7))) & 1);
+  return value;
+}
+
+static void
+skip_bits (BitReader * br, guint n)
+{
+  if (br->pos + n > br->size * 8)
+    br->error = TRUE;
+  else
+    br->pos += n;
+}
+
+static guint32
+read_ue (BitReader * br)
+{
+  guint zeros = 0;
+
+  while (!br->error && read_bits (br, 1) == 0) {
+    if (++zeros > 31) {
+      br->error = TRUE;
+      return 0;
+    }
+  }
+  if (zeros == 0)
+    return 0;
+  return (guint32) ((1ull << zeros) - 1 + read_bits (br, zeros));
+}
+
+static gint32
+read_se (BitReader * br)
+{
+  guint32 k = read_ue (br);
+
+  return (k & 1) ? (gint32) ((k + 1) / 2) : -(gint32) (k / 2);
+}
+
+static void
+set_framerate (SspVideoParams * params, guint64 num, guint64 den)
+{
+  guint64 a = num, b = den;
+
+  if (num == 0 || den == 0)
+    return;
+
+  while (b) {
+    guint64 t = a % b;
+    a = b;
+    b = t;
+  }
+  num /= a;
+  den /= a;
+  if (num > G_MAXINT || den > G_MAXINT)
+    return;
+
+  params->fps_n = (gint) num;
+  params->fps_d = (gint) den;
+}
+
+/* The part of the VUI that H.264 and H.265 share, up to chroma location */
+static void
+parse_vui_common (BitReader * br, SspVideoParams * params)
+{
+  if (read_bits (br, 1)) {      /* aspect_ratio_info_present_flag */
+    guint idc = read_bits (br, 8);
+
+    if (idc == 255) {
+      params->par_n = read_bits (br, 16);
+      params->par_d = read_bits (br, 16);
+    } else if (idc > 0 && idc < G_N_ELEMENTS (sar_table)) {
+      params->par_n = sar_table[idc][0];
+      params->par_d = sar_table[idc][1];
+    }
+  }
+
+  if (read_bits (br, 1))        /* overscan_info_present_flag */
+    skip_bits (br, 1);
+
+  if (read_bits (br, 1)) {      /* video_signal_type_present_flag */
+    skip_bits (br, 3);          /* video_format */
+    params->full_range = read_bits (br, 1);
+    if (read_bits (br, 1)) {    /* colour_description_present_flag */
+      params->colour_primaries = read_bits (br, 8);
+      params->transfer_characteristics = read_bits (br, 8);
+      params->matrix_coefficients = read_bits (br, 8);
+      params->has_colour_description = !br->error;
+    }
+  }
+
+  if (read_bits (br, 1)) {      /* chroma_loc_info_present_flag */
+    read_ue (br);
+    read_ue (br);
+  }
+}
+
+static void
+h264_skip_scaling_list (BitReader * br, guint size)
+{
+  gint last = 8, next = 8;
+  guint i;
+
+  for (i = 0; i < size && !br->error; i++) {
+    if (next != 0)
+      next = (last + read_se (br) + 256) % 256;
+    last = next == 0 ? last : next;
+  }
+}
+
+static gboolean
+h264_parse_sps (BitReader * br, SspVideoParams * params)
+{
+  guint separate_colour_plane = 0;
+  guint frame_mbs_only, width_mbs, height_map_units;
+  guint crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+  guint crop_unit_x, crop_unit_y;
+
+  params->profile_idc = read_bits (br, 8);
+  params->constraint_flags = read_bits (br, 8);
+  params->level_idc = read_bits (br, 8);
+  read_ue (br);                 /* seq_parameter_set_id */
+
+  params->chroma_format_idc = 1;
+  params->bit_depth_luma = 8;
+  params->bit_depth_chroma = 8;
+
+  switch (params->profile_idc) {
+    case 100: case 110: case 122: case 244: case 44: case 83: case 86:
+    case 118: case 128: case 138: case 139: case 134: case 135:
+      params->chroma_format_idc = read_ue (br);
+      if (params->chroma_format_idc == 3)
+        separate_colour_plane = read_bits (br, 1);
+      params->bit_depth_luma = read_ue (br) + 8;
+      params->bit_depth_chroma = read_ue (br) + 8;
+      skip_bits (br, 1);        /* qpprime_y_zero_transform_bypass_flag */
+      if (read_bits (br, 1)) {  /* seq_scaling_matrix_present_flag */
+        guint i, n = params->chroma_format_idc != 3 ? 8 : 12;
+
+        for (i = 0; i < n; i++) {
+          if (read_bits (br, 1))
+            h264_skip_scaling_list (br, i < 6 ? 16 : 64);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  read_ue (br);                 /* log2_max_frame_num_minus4 */
+  switch (read_ue (br)) {       /* pic_order_cnt_type */
+    case 0:
+      read_ue (br);             /* log2_max_pic_order_cnt_lsb_minus4 */
+      break;
+    case 1:{
+      guint i, n;
+
+      skip_bits (br, 1);        /* delta_pic_order_always_zero_flag */
+      read_se (br);             /* offset_for_non_ref_pic */
+      read_se (br);             /* offset_for_top_to_bottom_field */
+      n = read_ue (br);
+      if (n > 255)
+        return FALSE;
+      for (i = 0; i < n; i++)
+        read_se (br);
+      break;
+    }
+    default:
+      break;
+  }
+
+  read_ue (br);                 /* max_num_ref_frames */
+  skip_bits (br, 1);            /* gaps_in_frame_num_value_allowed_flag */
+  width_mbs = read_ue (br) + 1;
+  height_map_units = read_ue (br) + 1;
+  frame_mbs_only = read_bits (br, 1);
+  if (!frame_mbs_only)
+    skip_bits (br, 1);          /* mb_adaptive_frame_field_flag */
+  skip_bits (br, 1);            /* direct_8x8_inference_flag */
+
+  if (read_bits (br, 1)) {      /* frame_cropping_flag */
+    crop_left = read_ue (br);
+    crop_right = read_ue (br);
+    crop_top = read_ue (br);
+    crop_bottom = read_ue (br);
+  }
+
+  if (br->error || width_mbs > 1024 || height_map_units > 1024)
+    return FALSE;
+
+  if (separate_colour_plane || params->chroma_format_idc == 0) {
+    crop_unit_x = 1;
+    crop_unit_y = 2 - frame_mbs_only;
+  } else {
+    crop_unit_x = params->chroma_format_idc == 3 ? 1 : 2;
+    crop_unit_y = (params->chroma_format_idc == 1 ? 2 : 1) * (2 - frame_mbs_only);
+  }
+
+  params->width = width_mbs * 16;
+  params->height = (2 - frame_mbs_only) * height_map_units * 16;
+  if ((crop_left + crop_right) * crop_unit_x < params->width &&
+      (crop_top + crop_bottom) * crop_unit_y < params->height) {
+    params->width -= (crop_left + crop_right) * crop_unit_x;
+    params->height -= (crop_top + crop_bottom) * crop_unit_y;
+  }
+
+  if (read_bits (br, 1)) {      /* vui_parameters_present_flag */
+    parse_vui_common (br, params);
+    if (read_bits (br, 1)) {    /* timing_info_present_flag */
+      guint32 num_units_in_tick = read_bits (br, 32);
+      guint32 time_scale = read_bits (br, 32);
+
+      if (!br->error)
+        set_framerate (params, time_scale, 2 * (guint64) num_units_in_tick);
+    }
+  }
+
+  /* A truncated VUI still leaves everything before it usable */
+  return TRUE;
+}
+
+static void
+h265_parse_profile_tier_level (BitReader * br, guint max_sub_layers_minus1,
+    SspVideoParams * params)
+{
+  guint8 sub_layer_profile_present[8], sub_layer_level_present[8];
+  guint i;
+
+  skip_bits (br, 2);            /* general_profile_space */
+  params->tier = read_bits (br, 1);
+  params->profile_idc = read_bits (br, 5);
+  skip_bits (br, 32);           /* general_profile_compatibility_flag[] */
+  skip_bits (br, 4);            /* progressive, interlaced, non_packed, frame_only */
+  params->rext_flags = read_bits (br, 9);
+  skip_bits (br, 35);
+  params->level_idc = read_bits (br, 8);
+
+  for (i = 0; i < max_sub_layers_minus1; i++) {
+    sub_layer_profile_present[i] = read_bits (br, 1);
+    sub_layer_level_present[i] = read_bits (br, 1);
+  }
+  if (max_sub_layers_minus1 > 0)
+    skip_bits (br, 2 * (8 - max_sub_layers_minus1));
+  for (i = 0; i < max_sub_layers_minus1; i++) {
+    if (sub_layer_profile_present[i])
+      skip_bits (br, 88);
+    if (sub_layer_level_present[i])
+      skip_bits (br, 8);
+  }
+}
+
+static void
+h265_skip_scaling_list_data (BitReader * br)
+{
+  guint size_id, matrix_id, i;
+
+  for (size_id = 0; size_id < 4; size_id++) {
+    for (matrix_id = 0; matrix_id < 6; matrix_id += size_id == 3 ? 3 : 1) {
+      if (!read_bits (br, 1)) { /* scaling_list_pred_mode_flag */
+        read_ue (br);           /* scaling_list_pred_matrix_id_delta */
+      } else {
+        guint coef_num = MIN (64, 1 << (4 + (size_id << 1)));
+
+        if (size_id > 1)
+          read_se (br);         /* scaling_list_dc_coef_minus8 */
+        for (i = 0; i < coef_num && !br->error; i++)
+          read_se (br);
+      }
+    }
+  }
+}
+
+static gboolean
+h265_skip_short_term_ref_pic_sets (BitReader * br, guint num_sets)
+{
+  guint num_delta_pocs[64];
+  guint idx, i;
+
+  for (idx = 0; idx < num_sets && !br->error; idx++) {
+    gboolean inter_rps_pred = idx != 0 && read_bits (br, 1);
+
+    if (inter_rps_pred) {
+      guint count = 0;
+
+      skip_bits (br, 1);        /* delta_rps_sign */
+      read_ue (br);             /* abs_delta_rps_minus1 */
+      for (i = 0; i <= num_delta_pocs[idx - 1]; i++) {
+        gboolean used = read_bits (br, 1);
+        gboolean use_delta = used || read_bits (br, 1);
+
+        if (use_delta)
+          count++;
+      }
+      num_delta_pocs[idx] = count;
+    } else {
+      guint num_negative = read_ue (br);
+      guint num_positive = read_ue (br);
+
+      if (num_negative > 16 || num_positive > 16)
+        return FALSE;
+      for (i = 0; i < num_negative + num_positive; i++) {
+        read_ue (br);           /* delta_poc_minus1 */
+        skip_bits (br, 1);      /* used_by_curr_pic_flag */
+      }
+      num_delta_pocs[idx] = num_negative + num_positive;
+    }
+
+    if (num_delta_pocs[idx] > 32)
+      return FALSE;
+  }
+  return !br->error;
+}
+
+static gboolean
+h265_parse_sps (BitReader * br, SspVideoParams * params)
+{
+  guint max_sub_layers_minus1, log2_max_poc_lsb, i;
+  guint separate_colour_plane = 0;
+  guint crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+  guint crop_unit_x, crop_unit_y, num_sets;
+
+  skip_bits (br, 4);            /* sps_video_parameter_set_id */
+  max_sub_layers_minus1 = read_bits (br, 3);
+  skip_bits (br, 1);            /* sps_temporal_id_nesting_flag */
+  if (max_sub_layers_minus1 > 6)
+    return FALSE;
+  h265_parse_profile_tier_level (br, max_sub_layers_minus1, params);
+
+  read_ue (br);                 /* sps_seq_parameter_set_id */
+  params->chroma_format_idc = read_ue (br);
+  if (params->chroma_format_idc == 3)
+    separate_colour_plane = read_bits (br, 1);
+  params->width = read_ue (br);
+  params->height = read_ue (br);
+
+  if (read_bits (br, 1)) {      /* conformance_window_flag */
+    crop_left = read_ue (br);
+    crop_right = read_ue (br);
+    crop_top = read_ue (br);
+    crop_bottom = read_ue (br);
+  }
+
+  params->bit_depth_luma = read_ue (br) + 8;
+  params->bit_depth_chroma = read_ue (br) + 8;
+
+  if (br->error || params->chroma_format_idc > 3 ||
+      params->width == 0 || params->width > 16888 ||
+      params->height == 0 || params->height > 16888)
+    return FALSE;
+
+  if (separate_colour_plane || params->chroma_format_idc == 0) {
+    crop_unit_x = 1;
+    crop_unit_y = 1;
+  } else {
+    crop_unit_x = params->chroma_format_idc == 3 ? 1 : 2;
+    crop_unit_y = params->chroma_format_idc == 1 ? 2 : 1;
+  }
+  if ((crop_left + crop_right) * crop_unit_x < params->width &&
+      (crop_top + crop_bottom) * crop_unit_y < params->height) {
+    params->width -= (crop_left + crop_right) * crop_unit_x;
+    params->height -= (crop_top + crop_bottom) * crop_unit_y;
+  }
+
+  /* Everything below only matters for reaching the VUI */
+  log2_max_poc_lsb = read_ue (br) + 4;
+  i = read_bits (br, 1) ? 0 : max_sub_layers_minus1;    /* sub_layer_ordering_info_present_flag */
+  for (; i <= max_sub_layers_minus1; i++) {
+    read_ue (br);
+    read_ue (br);
+    read_ue (br);
+  }
+  for (i = 0; i < 6; i++)
+    read_ue (br);               /* coding/transform block sizes and depths */
+
+  if (read_bits (br, 1) && read_bits (br, 1))   /* scaling_list_enabled, sps_scaling_list_data_present */
+    h265_skip_scaling_list_data (br);
+
+  skip_bits (br, 2);            /* amp_enabled_flag, sample_adaptive_offset_enabled_flag */
+  if (read_bits (br, 1)) {      /* pcm_enabled_flag */
+    skip_bits (br, 8);
+    read_ue (br);
+    read_ue (br);
+    skip_bits (br, 1);
+  }
+
+  num_sets = read_ue (br);
+  if (num_sets > 64 || !h265_skip_short_term_ref_pic_sets (br, num_sets))
+    return TRUE;
+
+  if (read_bits (br, 1)) {      /* long_term_ref_pics_present_flag */
+    guint num_long_term = read_ue (br);
+
+    if (num_long_term > 32)
+      return TRUE;
+    for (i = 0; i < num_long_term; i++)
+      skip_bits (br, log2_max_poc_lsb + 1);
+  }
+  skip_bits (br, 2);            /* sps_temporal_mvp_enabled_flag, strong_intra_smoothing_enabled_flag */
+
+  if (read_bits (br, 1)) {      /* vui_parameters_present_flag */
+    parse_vui_common (br, params);
+    skip_bits (br, 3);          /* neutral_chroma, field_seq, frame_field_info */
+    if (read_bits (br, 1)) {    /* default_display_window_flag */
+      for (i = 0; i < 4; i++)
+        read_ue (br);
+    }
+    if (read_bits (br, 1)) {    /* vui_timing_info_present_flag */
+      guint32 num_units_in_tick = read_bits (br, 32);
+      guint32 time_scale = read_bits (br, 32);
+
+      if (!br->error)
+        set_framerate (params, time_scale, num_units_in_tick);
+    }
+  }
+
+  return TRUE;
+}
+
+/* Only the timing info, as a fallback when the SPS has none */
+static void
+h265_parse_vps_timing (BitReader * br, SspVideoParams * params)
+{
+  SspVideoParams ptl;
+  guint max_sub_layers_minus1, max_layer_id, num_layer_sets, i;
+
+  skip_bits (br, 12);           /* id, base layer flags, max_layers_minus1 */
+  max_sub_layers_minus1 = read_bits (br, 3);
+  skip_bits (br, 17);           /* temporal_id_nesting_flag, reserved 0xffff */
+  if (max_sub_layers_minus1 > 6)
+    return;
+  h265_parse_profile_tier_level (br, max_sub_layers_minus1, &ptl);
+
+  i = read_bits (br, 1) ? 0 : max_sub_layers_minus1;
+  for (; i <= max_sub_layers_minus1; i++) {
+    read_ue (br);
+    read_ue (br);
+    read_ue (br);
+  }
+  max_layer_id = read_bits (br, 6);
+  num_layer_sets = read_ue (br) + 1;
+  if (num_layer_sets > 1024)
+    return;
+  skip_bits (br, (num_layer_sets - 1) * (max_layer_id + 1));
+
+  if (read_bits (br, 1)) {      /* vps_timing_info_present_flag */
+    guint32 num_units_in_tick = read_bits (br, 32);
+    guint32 time_scale = read_bits (br, 32);
+
+    if (!br->error)
+      set_framerate (params, time_scale, num_units_in_tick);
+  }
+}
+
+static void
+reader_init (BitReader * br, const SspNalUnit * unit, const guint8 * data,
+    guint8 * rbsp, guint header_size)
+{
+  br->data = rbsp;
+  br->size = unescape (data + unit->offset, unit->size, rbsp,
+      SSP_PARAM_SET_MAX_SIZE);
+  br->pos = 0;
+  br->error = FALSE;
+  skip_bits (br, header_size * 8);
+}
+
+gboolean
+ssp_param_sets_parse (const SspNalIndex * index, const guint8 * data,
+    SspVideoParams * params)
+{
+  guint8 rbsp[SSP_PARAM_SET_MAX_SIZE];
+  const SspNalUnit *sps, *vps;
+  BitReader br;
+
+  memset (params, 0, sizeof (*params));
+  params->codec = index->codec;
+
+  if (index->codec == SSP_NAL_CODEC_H264) {
+    sps = ssp_nal_index_find (index, H264_NAL_SPS);
+    if (!sps)
+      return FALSE;
+    reader_init (&br, sps, data, rbsp, 1);
+    return h264_parse_sps (&br, params);
+  }
+
+  if (index->codec == SSP_NAL_CODEC_H265) {
+    sps = ssp_nal_index_find (index, H265_NAL_SPS);
+    if (!sps)
+      return FALSE;
+    reader_init (&br, sps, data, rbsp, 2);
+    if (!h265_parse_sps (&br, params))
+      return FALSE;
+
+    vps = ssp_nal_index_find (index, H265_NAL_VPS);
+    if (params->fps_n == 0 && vps) {
+      reader_init (&br, vps, data, rbsp, 2);
+      h265_parse_vps_timing (&br, params);
+    }
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static const gchar *
+h264_profile_string (const SspVideoParams * params)
+{
+  gboolean set1 = (params->constraint_flags & 0x40) != 0;
+  gboolean set3 = (params->constraint_flags & 0x10) != 0;
+  gboolean set4 = (params->constraint_flags & 0x08) != 0;
+  gboolean set5 = (params->constraint_flags & 0x04) != 0;
+
+  switch (params->profile_idc) {
+    case 66:
+      return set1 ? "constrained-baseline" : "baseline";
+    case 77:
+      return "main";
+    case 88:
+      return "extended";
+    case 100:
+      if (set4)
+        return set5 ? "constrained-high" : "progressive-high";
+      return "high";
+    case 110:
+      if (set3)
+        return "high-10-intra";
+      return set4 ? "progressive-high-10" : "high-10";
+    case 122:
+      return set3 ? "high-4:2:2-intra" : "high-4:2:2";
+    case 244:
+      return set3 ? "high-4:4:4-intra" : "high-4:4:4";
+    case 44:
+      return "cavlc-4:4:4-intra";
+    case 83:
+      return "scalable-baseline";
+    case 86:
+      return "scalable-high";
+    case 118:
+      return "multiview-high";
+    case 128:
+      return "stereo-high";
+    default:
+      return NULL;
+  }
+}
+
+/* Range extensions profiles are named after their constraint flags,
+ * e.g. main-422-10 or main-444-12-intra */
+static gchar *
+h265_profile_string (const SspVideoParams * params)
+{
+  const gchar *chroma, *suffix = "";
+  guint depth;
+
+  switch (params->profile_idc) {
+    case 1:
+      return g_strdup ("main");
+    case 2:
+      return g_strdup ("main-10");
+    case 3:
+      return g_strdup ("main-still-picture");
+    case 4:
+      break;
+    default:
+      return NULL;
+  }
+
+  if (params->rext_flags & H265_MAX_8BIT)
+    depth = 8;
+  else if (params->rext_flags & H265_MAX_10BIT)
+    depth = 10;
+  else if (params->rext_flags & H265_MAX_12BIT)
+    depth = 12;
+  else
+    depth = 16;
+
+  if (params->rext_flags & H265_MAX_MONOCHROME)
+    chroma = "monochrome";
+  else if (params->rext_flags & H265_MAX_420CHROMA)
+    chroma = "main";
+  else if (params->rext_flags & H265_MAX_422CHROMA)
+    chroma = "main-422";
+  else
+    chroma = "main-444";
+
+  if (params->rext_flags & H265_ONE_PICTURE_ONLY)
+    suffix = "-still-picture";
+  else if (params->rext_flags & H265_INTRA)
+    suffix = "-intra";
+
+  if (depth == 8)
+    return g_strconcat (chroma, suffix, NULL);
+  return g_strdup_printf ("%s-%u%s", chroma, depth, suffix);
+}
+
+static gchar *
+level_string (const SspVideoParams * params)
+{
+  guint major, minor;
+
+  if (params->level_idc == 0)
+    return NULL;
+
+  if (params->codec == SSP_NAL_CODEC_H265) {
+    major = params->level_idc / 30;
+    minor = (params->level_idc % 30) / 3;
+  } else {
+    /* Level 1b is either 9 or 11 with constraint_set3 below High */
+    if (params->level_idc == 9 || (params->level_idc == 11 &&
+            (params->constraint_flags & 0x10) && params->profile_idc < 100))
+      return g_strdup ("1b");
+    major = params->level_idc / 10;
+    minor = params->level_idc % 10;
+  }
+
+  if (minor == 0)
+    return g_strdup_printf ("%u", major);
+  return g_strdup_printf ("%u.%u", major, minor);
+}
+
+void
+ssp_video_params_fill_caps (const SspVideoParams * params, GstCaps * caps)
+{
+  static const gchar *chroma_formats[] = { "4:0:0", "4:2:0", "4:2:2", "4:4:4" };
+  gchar *profile, *level;
+
+  if (params->codec == SSP_NAL_CODEC_H265)
+    profile = h265_profile_string (params);
+  else
+    profile = g_strdup (h264_profile_string (params));
+  level = level_string (params);
+
+  if (profile)
+    gst_caps_set_simple (caps, "profile", G_TYPE_STRING, profile, NULL);
+  if (level)
+    gst_caps_set_simple (caps, "level", G_TYPE_STRING, level, NULL);
+  if (params->codec == SSP_NAL_CODEC_H265)
+    gst_caps_set_simple (caps, "tier", G_TYPE_STRING,
+        params->tier ? "high" : "main", NULL);
+  g_free (profile);
+  g_free (level);
+
+  if (params->chroma_format_idc < G_N_ELEMENTS (chroma_formats))
+    gst_caps_set_simple (caps,
+        "chroma-format", G_TYPE_STRING, chroma_formats[params->chroma_format_idc],
+        NULL);
+  gst_caps_set_simple (caps,
+      "bit-depth-luma", G_TYPE_UINT, (guint) params->bit_depth_luma,
+      "bit-depth-chroma", G_TYPE_UINT, (guint) params->bit_depth_chroma,
+      "width", G_TYPE_INT, (gint) params->width,
+      "height", G_TYPE_INT, (gint) params->height,
+      NULL);
+
+  if (params->par_n > 0 && params->par_d > 0)
+    gst_caps_set_simple (caps, "pixel-aspect-ratio", GST_TYPE_FRACTION,
+        params->par_n, params->par_d, NULL);
+  if (params->fps_n > 0)
+    gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION,
+        params->fps_n, params->fps_d, NULL);
+
+#if GST_CHECK_VERSION(1, 18, 0)
+  if (params->has_colour_description) {
+    GstVideoColorimetry cinfo;
+    gchar *colorimetry;
+
+    cinfo.range = params->full_range ? GST_VIDEO_COLOR_RANGE_0_255 :
+        GST_VIDEO_COLOR_RANGE_16_235;
+    cinfo.matrix = gst_video_color_matrix_from_iso (params->matrix_coefficients);
+    cinfo.transfer =
+        gst_video_transfer_function_from_iso (params->transfer_characteristics);
+    cinfo.primaries =
+        gst_video_color_primaries_from_iso (params->colour_primaries);
+
+    colorimetry = gst_video_colorimetry_to_string (&cinfo);
+    if (colorimetry)
+      gst_caps_set_simple (caps, "colorimetry", G_TYPE_STRING, colorimetry, NULL);
+    g_free (colorimetry);
+  }
+#endif
+}
+
+static guint
+count_units (const SspNalIndex * index, guint8 type)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < index->n_units; i++) {
+    if (index->units[i].type == type)
+      n++;
+  }
+  return n;
+}
+
+static void
+put_units (GstByteWriter * bw, const SspNalIndex * index,
+    const guint8 * data, guint8 type)
+{
+  guint i;
+
+  for (i = 0; i < index->n_units; i++) {
+    const SspNalUnit *unit = &index->units[i];
+    gsize size = unit->size;
+
+    if (unit->type != type)
+      continue;
+    /* Drop trailing_zero_8bits */
+    while (size > 0 && data[unit->offset + size - 1] == 0)
+      size--;
+    gst_byte_writer_put_uint16_be (bw, (guint16) size);
+    gst_byte_writer_put_data (bw, data + unit->offset, size);
+  }
+}
+
+GstBuffer *
+ssp_param_sets_codec_data (const SspNalIndex * index, const guint8 * data,
+    const SspVideoParams * params)
+{
+  GstByteWriter bw;
+
+  if (index->codec == SSP_NAL_CODEC_H264) {
+    const SspNalUnit *sps = ssp_nal_index_find (index, H264_NAL_SPS);
+    guint n_sps = count_units (index, H264_NAL_SPS);
+    guint n_pps = count_units (index, H264_NAL_PPS);
+
+    if (!sps || sps->size < 4 || n_pps == 0 || n_sps > 31 || n_pps > 255)
+      return NULL;
+
+    gst_byte_writer_init (&bw);
+    gst_byte_writer_put_uint8 (&bw, 1);         /* configurationVersion */
+    gst_byte_writer_put_data (&bw, data + sps->offset + 1, 3);  /* profile, compatibility, level */
+    gst_byte_writer_put_uint8 (&bw, 0xff);      /* lengthSizeMinusOne = 3 */
+    gst_byte_writer_put_uint8 (&bw, 0xe0 | n_sps);
+    put_units (&bw, index, data, H264_NAL_SPS);
+    gst_byte_writer_put_uint8 (&bw, n_pps);
+    put_units (&bw, index, data, H264_NAL_PPS);
+    return gst_byte_writer_reset_and_get_buffer (&bw);
+  }
+
+  if (index->codec == SSP_NAL_CODEC_H265) {
+    const SspNalUnit *sps = ssp_nal_index_find (index, H265_NAL_SPS);
+    guint8 rbsp[16];
+    guint8 sub_layers;
+
+    if (!sps || !ssp_nal_index_find (index, H265_NAL_VPS) ||
+        !ssp_nal_index_find (index, H265_NAL_PPS))
+      return NULL;
+
+    /* general profile_tier_level() is 12 bytes after the NAL header and
+     * the vps id/sub layer byte, and often contains emulation prevention */
+    if (unescape (data + sps->offset, sps->size, rbsp, sizeof (rbsp)) < 15)
+      return NULL;
+    sub_layers = rbsp[2];
+
+    gst_byte_writer_init (&bw);
+    gst_byte_writer_put_uint8 (&bw, 1);         /* configurationVersion */
+    gst_byte_writer_put_data (&bw, rbsp + 3, 12);
+    gst_byte_writer_put_uint16_be (&bw, 0xf000);        /* min_spatial_segmentation_idc */
+    gst_byte_writer_put_uint8 (&bw, 0xfc);      /* parallelismType */
+    gst_byte_writer_put_uint8 (&bw, 0xfc | params->chroma_format_idc);
+    gst_byte_writer_put_uint8 (&bw, 0xf8 | (params->bit_depth_luma - 8));
+    gst_byte_writer_put_uint8 (&bw, 0xf8 | (params->bit_depth_chroma - 8));
+    gst_byte_writer_put_uint16_be (&bw, 0);     /* avgFrameRate */
+    /* numTemporalLayers, temporalIdNested, lengthSizeMinusOne = 3 */
+    gst_byte_writer_put_uint8 (&bw,
+        ((((sub_layers >> 1) & 0x7) + 1) << 3) | ((sub_layers & 1) << 2) | 3);
+    gst_byte_writer_put_uint8 (&bw, 3);         /* numOfArrays */
+    for (guint8 type = H265_NAL_VPS; type <= H265_NAL_PPS; type++) {
+      gst_byte_writer_put_uint8 (&bw, 0x80 | type);     /* array_completeness */
+      gst_byte_writer_put_uint16_be (&bw, count_units (index, type));
+      put_units (&bw, index, data, type);
+    }
+    return gst_byte_writer_reset_and_get_buffer (&bw);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef __SSP_PARAM_SETS_H__
+#define __SSP_PARAM_SETS_H__
+
+#include <gst/gst.h>
+
+#include "sspnal.h"
+
+G_BEGIN_DECLS
+
+/* Stream properties read from the H.264 SPS or the H.265 VPS/SPS. Fields
+ * that the bitstream does not signal are left at 0. */
+typedef struct {
+  guint32 codec;
+
+  guint8 profile_idc;
+  guint8 constraint_flags;   /* H.264 constraint_set0..5 in the top bits */
+  guint16 rext_flags;        /* H.265 general_max_12bit.. constraint flags */
+  guint8 tier;               /* H.265 general_tier_flag */
+  guint8 level_idc;
+
+  guint8 chroma_format_idc;
+  guint8 bit_depth_luma;
+  guint8 bit_depth_chroma;
+
+  guint width;               /* after cropping */
+  guint height;
+  gint par_n, par_d;
+  gint fps_n, fps_d;
+
+  gboolean has_colour_description;
+  gboolean full_range;
+  guint8 colour_primaries;
+  guint8 transfer_characteristics;
+  guint8 matrix_coefficients;
+} SspVideoParams;
+
+/* Parse the parameter sets found in @index, which indexes @data. FALSE
+ * when there is no SPS or it cannot be parsed. */
+gboolean ssp_param_sets_parse (const SspNalIndex * index, const guint8 * data,
+    SspVideoParams * params);
+
+/* Fill profile, level, tier, chroma-format, bit depths, dimensions,
+ * pixel-aspect-ratio, framerate and colorimetry into @caps */
+void ssp_video_params_fill_caps (const SspVideoParams * params, GstCaps * caps);
+
+/* AVCDecoderConfigurationRecord or HEVCDecoderConfigurationRecord with
+ * 4-byte lengths from the parameter sets in @index, NULL if any required
+ * set is missing */
+GstBuffer * ssp_param_sets_codec_data (const SspNalIndex * index,
+    const guint8 * data, const SspVideoParams * params);
+
+G_END_DECLS
+
+#endif /* __SSP_PARAM_SETS_H__ */
@@ -0,0 +1,369 @@
+#include "sspring.h"
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+SspFrameRing::SspFrameRing(guint max_frames, guint64 max_bytes, GstClockTime max_time)
+    : max_frames_(MAX(max_frames, 1))
+    , max_bytes_(max_bytes)
+    , max_time_(max_time)
+    , head_(0)
+    , tail_(0)
+    , bytes_(0)
+    , seq_(0)
+    , waiters_(0)
+    , space_seq_(0)
+    , space_waiters_(0)
+    , flushing_(FALSE)
+    , producer_flushing_(FALSE)
+    , finished_(FALSE)
+    , pushed_(0)
+    , rejected_(0)
+    , dropped_(0)
+    , popped_(0)
+    , latency_last_(GST_CLOCK_TIME_NONE)
+    , latency_max_(0)
+    , latency_sum_(0)
+{
+    guint capacity = 1;
+    while (capacity < max_frames_) {
+        capacity <<= 1;
+    }
+    mask_ = capacity - 1;
+    slots_ = new Slot[capacity]();
+
+#ifndef __linux__
+    g_mutex_init(&lock_);
+    g_cond_init(&cond_);
+#endif
+}
+
+SspFrameRing::~SspFrameRing()
+{
+    clear();
+    delete[] slots_;
+
+#ifndef __linux__
+    g_mutex_clear(&lock_);
+    g_cond_clear(&cond_);
+#endif
+}
+
+void*
+SspFrameRing::operator new(size_t size)
+{
+    guint8* raw = (guint8*)g_malloc(size + SSP_CACHE_LINE_SIZE + sizeof(gpointer));
+    guint8* aligned = (guint8*)(((guintptr)raw + sizeof(gpointer) + SSP_CACHE_LINE_SIZE - 1) &
+                                ~(guintptr)(SSP_CACHE_LINE_SIZE - 1));
+    ((gpointer*)aligned)[-1] = raw;
+    return aligned;
+}
+
+void
+SspFrameRing::operator delete(void* ptr)
+{
+    if (ptr) {
+        g_free(((gpointer*)ptr)[-1]);
+    }
+}
+
+gboolean
+SspFrameRing::full(gsize size) const
+{
+    guint head = head_.load(std::memory_order_relaxed);
+    guint tail = tail_.load(std::memory_order_acquire);
+
+    // Never refuse into an empty ring, a single oversized frame must pass
+    if (head == tail) {
+        return FALSE;
+    }
+
+    return head - tail >= max_frames_ ||
+        (max_bytes_ && bytes_.load(std::memory_order_relaxed) + size > max_bytes_) ||
+        (max_time_ && gst_util_get_timestamp() -
+            slots_[tail & mask_].enqueued.load(std::memory_order_relaxed) > max_time_);
+}
+
+gboolean
+SspFrameRing::push(GstBuffer* buffer)
+{
+    guint head = head_.load(std::memory_order_relaxed);
+    gsize size = gst_buffer_get_size(buffer);
+
+    if (full(size)) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return FALSE;
+    }
+
+    Slot& slot = slots_[head & mask_];
+    slot.buffer.store(buffer, std::memory_order_relaxed);
+    slot.size.store(size, std::memory_order_relaxed);
+    slot.enqueued.store(gst_util_get_timestamp(), std::memory_order_relaxed);
+    slot.delta.store(GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT),
+                     std::memory_order_relaxed);
+
+    bytes_.fetch_add(size, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+
+    wake(seq_, waiters_);
+    return TRUE;
+}
+
+GstBuffer*
+SspFrameRing::take_oldest(gsize* size, GstClockTime* enqueued)
+{
+    guint tail = tail_.load(std::memory_order_acquire);
+
+    for (;;) {
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        // Read the slot before claiming it: once the tail moves on the
+        // producer may refill it
+        Slot& slot = slots_[tail & mask_];
+        GstBuffer* buffer = slot.buffer.load(std::memory_order_relaxed);
+        *size = slot.size.load(std::memory_order_relaxed);
+        *enqueued = slot.enqueued.load(std::memory_order_relaxed);
+
+        if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+            bytes_.fetch_sub(*size, std::memory_order_relaxed);
+            wake(space_seq_, space_waiters_);
+            return buffer;
+        }
+    }
+}
+
+GstBuffer*
+SspFrameRing::try_pop(GstClockTime* latency)
+{
+    gsize size;
+    GstClockTime enqueued;
+    GstBuffer* buffer = take_oldest(&size, &enqueued);
+
+    if (!buffer) {
+        return nullptr;
+    }
+
+    GstClockTime waited = gst_util_get_timestamp() - enqueued;
+    popped_.fetch_add(1, std::memory_order_relaxed);
+    latency_last_.store(waited, std::memory_order_relaxed);
+    latency_sum_.fetch_add(waited, std::memory_order_relaxed);
+    if (waited > latency_max_.load(std::memory_order_relaxed)) {
+        latency_max_.store(waited, std::memory_order_relaxed);
+    }
+
+    if (latency) {
+        *latency = waited;
+    }
+    return buffer;
+}
+
+GstBuffer*
+SspFrameRing::pop(gint64 timeout_us, GstClockTime* latency)
+{
+    gint64 deadline = timeout_us < 0 ? -1 : g_get_monotonic_time() + timeout_us;
+
+    for (;;) {
+        if (flushing_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        // Read first: every push before set_finished() is then visible
+        gboolean finished = finished_.load(std::memory_order_acquire);
+        GstBuffer* buffer = try_pop(latency);
+        if (buffer) {
+            return buffer;
+        }
+        if (finished) {
+            return nullptr;
+        }
+
+        if (deadline >= 0 && g_get_monotonic_time() >= deadline) {
+            return nullptr;
+        }
+
+        // Announce ourselves before re-checking so a concurrent push either
+        // becomes visible here or bumps seq_ and wakes us
+        guint32 seq = seq_.load(std::memory_order_acquire);
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        if (head_.load(std::memory_order_seq_cst) == tail_.load(std::memory_order_seq_cst) &&
+            !flushing_.load(std::memory_order_seq_cst) &&
+            !finished_.load(std::memory_order_seq_cst)) {
+            wait(seq_, seq, deadline);
+        }
+        waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+gboolean
+SspFrameRing::wait_space(gsize size)
+{
+    for (;;) {
+        if (flushing_.load(std::memory_order_acquire) ||
+            producer_flushing_.load(std::memory_order_acquire)) {
+            return FALSE;
+        }
+        if (!full(size)) {
+            return TRUE;
+        }
+
+        guint32 seq = space_seq_.load(std::memory_order_acquire);
+        space_waiters_.fetch_add(1, std::memory_order_seq_cst);
+        if (full(size) && !flushing_.load(std::memory_order_seq_cst) &&
+            !producer_flushing_.load(std::memory_order_seq_cst)) {
+            // The time limit frees space without any pop, poll for it
+            gint64 deadline = max_time_ ? g_get_monotonic_time() + 10 * 1000 : -1;
+            wait(space_seq_, seq, deadline);
+        }
+        space_waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+gboolean
+SspFrameRing::drop_oldest(gsize* bytes)
+{
+    gsize size;
+    GstClockTime enqueued;
+    GstBuffer* buffer = take_oldest(&size, &enqueued);
+
+    if (!buffer) {
+        return FALSE;
+    }
+
+    gst_buffer_unref(buffer);
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    if (bytes) {
+        *bytes = size;
+    }
+    return TRUE;
+}
+
+gboolean
+SspFrameRing::oldest_is_delta() const
+{
+    guint tail = tail_.load(std::memory_order_acquire);
+
+    if (tail == head_.load(std::memory_order_acquire)) {
+        return FALSE;
+    }
+    return slots_[tail & mask_].delta.load(std::memory_order_relaxed);
+}
+
+void
+SspFrameRing::wait(std::atomic<guint32>& seq, guint32 value, gint64 deadline_us)
+{
+#ifdef __linux__
+    struct timespec ts;
+    struct timespec* tsp = nullptr;
+
+    if (deadline_us >= 0) {
+        gint64 remaining = MAX(deadline_us - g_get_monotonic_time(), 0);
+        ts.tv_sec = remaining / G_USEC_PER_SEC;
+        ts.tv_nsec = (remaining % G_USEC_PER_SEC) * 1000;
+        tsp = &ts;
+    }
+    syscall(SYS_futex, (guint32*)&seq, FUTEX_WAIT_PRIVATE, value, tsp, nullptr, 0);
+#else
+    g_mutex_lock(&lock_);
+    while (seq.load(std::memory_order_acquire) == value) {
+        if (deadline_us < 0) {
+            g_cond_wait(&cond_, &lock_);
+        } else if (!g_cond_wait_until(&cond_, &lock_, deadline_us)) {
+            break;
+        }
+    }
+    g_mutex_unlock(&lock_);
+#endif
+}
+
+void
+SspFrameRing::wake(std::atomic<guint32>& seq, std::atomic<gint>& waiters)
+{
+    seq.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+
+#ifdef __linux__
+    syscall(SYS_futex, (guint32*)&seq, FUTEX_WAKE_PRIVATE, G_MAXINT, nullptr, nullptr, 0);
+#else
+    g_mutex_lock(&lock_);
+    g_cond_broadcast(&cond_);
+    g_mutex_unlock(&lock_);
+#endif
+}
+
+void
+SspFrameRing::set_flushing(gboolean flushing)
+{
+    flushing_.store(flushing, std::memory_order_seq_cst);
+    if (flushing) {
+        wake(seq_, waiters_);
+        wake(space_seq_, space_waiters_);
+    }
+}
+
+void
+SspFrameRing::set_producer_flushing(gboolean flushing)
+{
+    producer_flushing_.store(flushing, std::memory_order_seq_cst);
+    if (flushing) {
+        wake(space_seq_, space_waiters_);
+    }
+}
+
+void
+SspFrameRing::set_finished(gboolean finished)
+{
+    finished_.store(finished, std::memory_order_seq_cst);
+    if (finished) {
+        wake(seq_, waiters_);
+    }
+}
+
+gboolean
+SspFrameRing::drained() const
+{
+    return finished_.load(std::memory_order_acquire) &&
+        !flushing_.load(std::memory_order_acquire) && length() == 0;
+}
+
+void
+SspFrameRing::clear()
+{
+    GstBuffer* buffer;
+    while ((buffer = try_pop()) != nullptr) {
+        gst_buffer_unref(buffer);
+    }
+}
+
+guint
+SspFrameRing::length() const
+{
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+
+guint64
+SspFrameRing::bytes() const
+{
+    return bytes_.load(std::memory_order_relaxed);
+}
+
+void
+SspFrameRing::get_stats(SspRingStats* stats) const
+{
+    stats->pushed = pushed_.load(std::memory_order_relaxed);
+    stats->popped = popped_.load(std::memory_order_relaxed);
+    stats->rejected = rejected_.load(std::memory_order_relaxed);
+    stats->dropped = dropped_.load(std::memory_order_relaxed);
+    stats->latency_last = latency_last_.load(std::memory_order_relaxed);
+    stats->latency_max = latency_max_.load(std::memory_order_relaxed);
+    stats->latency_sum = latency_sum_.load(std::memory_order_relaxed);
+}
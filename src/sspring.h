@@ -0,0 +1,110 @@
+#ifndef __SSP_RING_H__
+#define __SSP_RING_H__
+
+#include <gst/gst.h>
+#include <atomic>
+
+#define SSP_CACHE_LINE_SIZE 64
+
+struct SspRingStats {
+    guint64 pushed;
+    guint64 popped;
+    guint64 rejected;            // push refused because a limit was reached
+    guint64 dropped;             // queued frames evicted by the producer
+    GstClockTime latency_last;   // enqueue-to-dequeue of the last popped frame
+    GstClockTime latency_max;
+    GstClockTime latency_sum;
+};
+
+// Bounded single-producer/single-consumer ring of GstBuffers handed from the
+// libssp loop thread to a streaming thread. push() never blocks and never
+// allocates; pop() sleeps on a futex (Linux) or a GCond elsewhere. The
+// producer may also evict the oldest frame, both sides advance the tail
+// with a CAS so each frame is taken exactly once.
+class SspFrameRing {
+public:
+    // A limit of 0 disables that bound, max_frames is always enforced
+    SspFrameRing(guint max_frames, guint64 max_bytes, GstClockTime max_time);
+    ~SspFrameRing();
+
+    // Producer side. Takes ownership of buffer only when TRUE is returned.
+    gboolean push(GstBuffer* buffer);
+    // Whether push() would refuse a frame of size bytes right now
+    gboolean full(gsize size) const;
+    // Sleep until a frame of size bytes fits. FALSE when flushing or when
+    // the producer is being torn down.
+    gboolean wait_space(gsize size);
+    // Evict the oldest queued frame, FALSE when empty. bytes receives its size.
+    gboolean drop_oldest(gsize* bytes);
+    // Whether the oldest queued frame is a delta unit
+    gboolean oldest_is_delta() const;
+
+    // Consumer side. Returns NULL when flushing or when timeout_us (-1 for
+    // forever) expires. latency receives the time the frame spent queued.
+    GstBuffer* pop(gint64 timeout_us = -1, GstClockTime* latency = nullptr);
+    GstBuffer* try_pop(GstClockTime* latency = nullptr);
+
+    // Wakes a blocked pop() and makes further pops return NULL until unset
+    void set_flushing(gboolean flushing);
+    // Wakes a blocked wait_space() only, the consumer keeps draining
+    void set_producer_flushing(gboolean flushing);
+    // The producer is done: pop() drains what is queued, then returns NULL
+    void set_finished(gboolean finished);
+    // Finished and drained, as opposed to a pop() interrupted by flushing
+    gboolean drained() const;
+    // Drop everything queued, only when the producer is quiescent
+    void clear();
+
+    guint length() const;
+    guint64 bytes() const;
+    void get_stats(SspRingStats* stats) const;
+
+    // C++11 new does not honour the cache line alignment of the members
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr);
+
+private:
+    // Atomic because the producer may read a slot the consumer is taking
+    struct Slot {
+        std::atomic<GstBuffer*> buffer;
+        std::atomic<gsize> size;
+        std::atomic<GstClockTime> enqueued;
+        std::atomic<gboolean> delta;
+    };
+
+    GstBuffer* take_oldest(gsize* size, GstClockTime* enqueued);
+    void wait(std::atomic<guint32>& seq, guint32 value, gint64 deadline_us);
+    void wake(std::atomic<guint32>& seq, std::atomic<gint>& waiters);
+
+    Slot* slots_;
+    guint mask_;
+    guint max_frames_;
+    guint64 max_bytes_;
+    GstClockTime max_time_;
+
+    alignas(SSP_CACHE_LINE_SIZE) std::atomic<guint> head_;   // written by producer
+    alignas(SSP_CACHE_LINE_SIZE) std::atomic<guint> tail_;   // written by consumer
+    alignas(SSP_CACHE_LINE_SIZE) std::atomic<guint64> bytes_;
+    std::atomic<guint32> seq_;            // bumped on push, consumer sleeps on it
+    std::atomic<gint> waiters_;
+    std::atomic<guint32> space_seq_;      // bumped on pop, producer sleeps on it
+    std::atomic<gint> space_waiters_;
+    std::atomic<gboolean> flushing_;
+    std::atomic<gboolean> producer_flushing_;
+    std::atomic<gboolean> finished_;
+
+    std::atomic<guint64> pushed_;
+    std::atomic<guint64> rejected_;
+    std::atomic<guint64> dropped_;
+    alignas(SSP_CACHE_LINE_SIZE) std::atomic<guint64> popped_;
+    std::atomic<guint64> latency_last_;
+    std::atomic<guint64> latency_max_;
+    std::atomic<guint64> latency_sum_;
+
+#ifndef __linux__
+    GMutex lock_;
+    GCond cond_;
+#endif
+};
+
+#endif /* __SSP_RING_H__ */
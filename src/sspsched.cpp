@@ -0,0 +1,349 @@
+#include "sspsched.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Linux thread names, without the terminator */
+#define SSP_SCHED_NAME_MAX 15
+
+/* "ssp-loop-192.168.9.86" becomes "sl-192.168.9.86": the role stays
+ * recognizable and the end of the address tells cameras apart */
+static void
+shorten_name (const gchar * name, gchar * comm)
+{
+  const gchar *last = strrchr (name, '-');
+  const gchar *p;
+  gsize n = 0, len;
+
+  if (strlen (name) <= SSP_SCHED_NAME_MAX || !last) {
+    g_strlcpy (comm, name, SSP_SCHED_NAME_MAX + 1);
+    return;
+  }
+
+  for (p = name; p < last && n < SSP_SCHED_NAME_MAX / 2; p++) {
+    if (p == name || p[-1] == '-')
+      comm[n++] = *p;
+  }
+  comm[n++] = '-';
+
+  len = strlen (last + 1);
+  if (len > SSP_SCHED_NAME_MAX - n)
+    last += len - (SSP_SCHED_NAME_MAX - n);
+  g_strlcpy (comm + n, last + 1, SSP_SCHED_NAME_MAX + 1 - n);
+}
+
+#ifdef __linux__
+static gboolean
+parse_cpus (const gchar * list, cpu_set_t * set)
+{
+  gchar **ranges = g_strsplit (list, ",", -1);
+  gboolean ret = TRUE;
+  guint i;
+
+  CPU_ZERO (set);
+
+  for (i = 0; ranges[i] && ret; i++) {
+    gchar *range = g_strstrip (ranges[i]);
+    gchar *end;
+    guint64 first, last;
+
+    first = g_ascii_strtoull (range, &end, 10);
+    if (end == range) {
+      ret = FALSE;
+      break;
+    }
+
+    last = first;
+    if (*end == '-') {
+      gchar *start = end + 1;
+      last = g_ascii_strtoull (start, &end, 10);
+      if (end == start)
+        ret = FALSE;
+    }
+
+    if (*end || last < first || last >= CPU_SETSIZE) {
+      ret = FALSE;
+      break;
+    }
+
+    for (; first <= last; first++)
+      CPU_SET (first, set);
+  }
+  g_strfreev (ranges);
+
+  return ret && CPU_COUNT (set) > 0;
+}
+
+static gchar *
+format_cpus (const cpu_set_t * set)
+{
+  GString *s = g_string_new (NULL);
+  gint cpu = 0;
+
+  while (cpu < CPU_SETSIZE) {
+    gint last;
+
+    if (!CPU_ISSET (cpu, set)) {
+      cpu++;
+      continue;
+    }
+
+    last = cpu;
+    while (last + 1 < CPU_SETSIZE && CPU_ISSET (last + 1, set))
+      last++;
+
+    if (s->len)
+      g_string_append_c (s, ',');
+    if (last == cpu)
+      g_string_append_printf (s, "%d", cpu);
+    else
+      g_string_append_printf (s, "%d-%d", cpu, last);
+    cpu = last + 1;
+  }
+
+  return g_string_free (s, FALSE);
+}
+
+static const gchar *
+policy_name (gint policy)
+{
+  switch (policy) {
+    case SCHED_OTHER:
+      return "other";
+    case SCHED_FIFO:
+      return "fifo";
+    case SCHED_RR:
+      return "rr";
+#ifdef SCHED_BATCH
+    case SCHED_BATCH:
+      return "batch";
+#endif
+#ifdef SCHED_IDLE
+    case SCHED_IDLE:
+      return "idle";
+#endif
+    default:
+      return "unknown";
+  }
+}
+
+/* utime + stime, fields 14 and 15 of /proc/<pid>/task/<tid>/stat */
+static gboolean
+read_cpu_time (gint tid, GstClockTime * cpu_time)
+{
+  gchar *path = g_strdup_printf ("/proc/self/task/%d/stat", tid);
+  gchar *contents = NULL;
+  gboolean ret = FALSE;
+
+  if (g_file_get_contents (path, &contents, NULL, NULL)) {
+    /* The name in parentheses may contain spaces, count from its end */
+    const gchar *p = strrchr (contents, ')');
+    guint64 utime, stime;
+
+    if (p && sscanf (p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %"
+            G_GUINT64_FORMAT " %" G_GUINT64_FORMAT, &utime, &stime) == 2) {
+      *cpu_time = gst_util_uint64_scale (utime + stime, GST_SECOND,
+          sysconf (_SC_CLK_TCK));
+      ret = TRUE;
+    }
+  }
+
+  g_free (contents);
+  g_free (path);
+  return ret;
+}
+#endif
+
+gint
+ssp_sched_apply_self (const gchar * name, const SspSchedParams * params)
+{
+#ifdef __linux__
+  gint tid = (gint) syscall (SYS_gettid);
+  gint err;
+
+  if (name) {
+    gchar comm[SSP_SCHED_NAME_MAX + 1];
+
+    shorten_name (name, comm);
+    pthread_setname_np (pthread_self (), comm);
+  }
+
+  if (!params)
+    return tid;
+
+  if (params->cpus && *params->cpus) {
+    cpu_set_t set;
+
+    if (!parse_cpus (params->cpus, &set)) {
+      GST_WARNING ("Invalid CPU list \"%s\"", params->cpus);
+    } else if (sched_setaffinity (0, sizeof (set), &set) != 0) {
+      GST_WARNING ("Failed to pin thread %d to CPUs %s: %s", tid,
+          params->cpus, g_strerror (errno));
+    }
+  }
+
+  if (params->policy != SSP_SCHED_OTHER) {
+    struct sched_param sp;
+    gint policy = params->policy == SSP_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+
+    memset (&sp, 0, sizeof (sp));
+    sp.sched_priority = CLAMP (params->priority, sched_get_priority_min (policy),
+        sched_get_priority_max (policy));
+    err = pthread_setschedparam (pthread_self (), policy, &sp);
+    if (err != 0) {
+      GST_WARNING ("Failed to set %s priority %d on thread %d: %s",
+          policy_name (policy), sp.sched_priority, tid, g_strerror (err));
+    }
+  } else if (params->nice != 0) {
+    /* Linux applies PRIO_PROCESS with a thread id to that thread only */
+    if (setpriority (PRIO_PROCESS, tid, params->nice) != 0) {
+      GST_WARNING ("Failed to set nice %d on thread %d: %s", params->nice,
+          tid, g_strerror (errno));
+    }
+  }
+
+  GST_DEBUG ("Thread %d (%s) set up", tid, GST_STR_NULL (name));
+  return tid;
+#else
+  if (params && ((params->cpus && *params->cpus) ||
+          params->policy != SSP_SCHED_OTHER || params->nice != 0)) {
+    GST_WARNING ("Thread affinity and scheduling are not supported on this "
+        "platform");
+  }
+  return 0;
+#endif
+}
+
+#ifdef __linux__
+struct _SspSchedState
+{
+  gchar comm[SSP_SCHED_NAME_MAX + 1];
+  gboolean have_cpus;
+  cpu_set_t cpus;
+  gint policy;
+  struct sched_param param;
+  gint nice;
+};
+#endif
+
+SspSchedState *
+ssp_sched_save_self (void)
+{
+#ifdef __linux__
+  SspSchedState *state = g_new0 (SspSchedState, 1);
+
+  if (pthread_getname_np (pthread_self (), state->comm, sizeof (state->comm)) != 0)
+    state->comm[0] = '\0';
+  state->have_cpus = sched_getaffinity (0, sizeof (state->cpus), &state->cpus) == 0;
+  if (pthread_getschedparam (pthread_self (), &state->policy, &state->param) != 0)
+    state->policy = -1;
+  errno = 0;
+  state->nice = getpriority (PRIO_PROCESS, (gint) syscall (SYS_gettid));
+  if (errno != 0)
+    state->nice = G_MININT;
+
+  return state;
+#else
+  return NULL;
+#endif
+}
+
+void
+ssp_sched_restore_self (SspSchedState * state)
+{
+#ifdef __linux__
+  gint tid = (gint) syscall (SYS_gettid);
+  gint err;
+
+  if (!state)
+    return;
+
+  if (state->comm[0])
+    pthread_setname_np (pthread_self (), state->comm);
+
+  if (state->have_cpus &&
+      sched_setaffinity (0, sizeof (state->cpus), &state->cpus) != 0) {
+    GST_WARNING ("Failed to restore the CPUs of thread %d: %s", tid,
+        g_strerror (errno));
+  }
+
+  /* Policy first: nice only applies to SCHED_OTHER */
+  if (state->policy >= 0) {
+    err = pthread_setschedparam (pthread_self (), state->policy, &state->param);
+    if (err != 0) {
+      GST_WARNING ("Failed to restore %s priority %d on thread %d: %s",
+          policy_name (state->policy), state->param.sched_priority, tid,
+          g_strerror (err));
+    }
+  }
+
+  if (state->nice != G_MININT && setpriority (PRIO_PROCESS, tid, state->nice) != 0) {
+    GST_WARNING ("Failed to restore nice %d on thread %d: %s", state->nice,
+        tid, g_strerror (errno));
+  }
+
+  GST_DEBUG ("Thread %d (%s) restored", tid, state->comm);
+  g_free (state);
+#endif
+}
+
+GstStructure *
+ssp_sched_describe (gint tid)
+{
+#ifdef __linux__
+  GstStructure *s;
+  gchar *path, *comm = NULL;
+  cpu_set_t set;
+  struct sched_param sp;
+  GstClockTime cpu_time;
+  gint policy, nice;
+
+  if (tid <= 0)
+    return NULL;
+
+  path = g_strdup_printf ("/proc/self/task/%d/comm", tid);
+  if (!g_file_get_contents (path, &comm, NULL, NULL)) {
+    g_free (path);
+    return NULL;
+  }
+  g_free (path);
+
+  s = gst_structure_new ("thread",
+      "name", G_TYPE_STRING, g_strchomp (comm),
+      "tid", G_TYPE_INT, tid, NULL);
+  g_free (comm);
+
+  if (sched_getaffinity (tid, sizeof (set), &set) == 0) {
+    gchar *cpus = format_cpus (&set);
+    gst_structure_set (s, "cpus", G_TYPE_STRING, cpus, NULL);
+    g_free (cpus);
+  }
+
+  policy = sched_getscheduler (tid);
+  if (policy >= 0 && sched_getparam (tid, &sp) == 0) {
+    gst_structure_set (s,
+        "policy", G_TYPE_STRING, policy_name (policy),
+        "priority", G_TYPE_INT, sp.sched_priority, NULL);
+  }
+
+  errno = 0;
+  nice = getpriority (PRIO_PROCESS, tid);
+  if (errno == 0)
+    gst_structure_set (s, "nice", G_TYPE_INT, nice, NULL);
+
+  if (read_cpu_time (tid, &cpu_time))
+    gst_structure_set (s, "cpu-time", G_TYPE_UINT64, cpu_time, NULL);
+
+  return s;
+#else
+  return NULL;
+#endif
+}
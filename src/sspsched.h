@@ -0,0 +1,46 @@
+#ifndef __SSP_SCHED_H__
+#define __SSP_SCHED_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  SSP_SCHED_OTHER = 0,
+  SSP_SCHED_FIFO = 1,
+  SSP_SCHED_RR = 2
+} SspSchedPolicy;
+
+typedef struct {
+  const gchar *cpus;         /* CPU list such as "2-3,6", NULL or "" to keep */
+  SspSchedPolicy policy;
+  gint priority;             /* fifo and rr, 1-99 */
+  gint nice;                 /* other, 0 keeps the inherited value */
+} SspSchedParams;
+
+/* Name the calling thread and apply @params, which may be NULL. Failures,
+ * typically EPERM for real-time policies, are logged and leave that setting
+ * as it was. Returns the kernel thread id, 0 where unsupported. Names over
+ * the kernel's 15 bytes keep the initials of their dash-separated prefix and
+ * the end of the last part: ssp-loop-192.168.9.86 becomes sl-192.168.9.86. */
+gint ssp_sched_apply_self (const gchar * name, const SspSchedParams * params);
+
+typedef struct _SspSchedState SspSchedState;
+
+/* Name, affinity, policy, priority and nice value of the calling thread,
+ * for threads that are only borrowed, such as those of a GstTaskPool. NULL
+ * where unsupported. */
+SspSchedState * ssp_sched_save_self (void);
+
+/* Put back and free what ssp_sched_save_self() saved on this thread. A
+ * setting the thread may no longer raise, typically a lower nice value
+ * without CAP_SYS_NICE, is logged and left as it is. */
+void ssp_sched_restore_self (SspSchedState * state);
+
+/* Name, affinity, policy, priority, nice value and CPU time of thread @tid
+ * of this process as the kernel reports them, NULL once it exited */
+GstStructure * ssp_sched_describe (gint tid);
+
+G_END_DECLS
+
+#endif /* __SSP_SCHED_H__ */
@@ -0,0 +1,141 @@
+#include "sspstats.h"
+
+SspStreamStats::SspStreamStats()
+{
+    reset();
+}
+
+void
+SspStreamStats::reset()
+{
+    frames_.store(0, std::memory_order_relaxed);
+    bytes_.store(0, std::memory_order_relaxed);
+    keyframes_.store(0, std::memory_order_relaxed);
+    frame_gaps_.store(0, std::memory_order_relaxed);
+    missing_frames_.store(0, std::memory_order_relaxed);
+    dropped_frames_.store(0, std::memory_order_relaxed);
+    dropped_bytes_.store(0, std::memory_order_relaxed);
+
+    for (Bucket& b : buckets_) {
+        // Never matches a current index, so the bucket is reset before use
+        b.index.store(G_MAXUINT64, std::memory_order_relaxed);
+        b.frames.store(0, std::memory_order_relaxed);
+        b.bytes.store(0, std::memory_order_relaxed);
+        b.jitter_sum.store(0, std::memory_order_relaxed);
+        b.jitter_count.store(0, std::memory_order_relaxed);
+        b.jitter_max.store(0, std::memory_order_relaxed);
+    }
+
+    restart();
+}
+
+void
+SspStreamStats::restart()
+{
+    last_arrival_ = GST_CLOCK_TIME_NONE;
+    have_frm_no_ = FALSE;
+}
+
+SspStreamStats::Bucket*
+SspStreamStats::bucket(GstClockTime now)
+{
+    guint64 index = now / SSP_STATS_BUCKET_TIME;
+    Bucket* b = &buckets_[index % SSP_STATS_BUCKETS];
+
+    if (b->index.load(std::memory_order_relaxed) != index) {
+        b->frames.store(0, std::memory_order_relaxed);
+        b->bytes.store(0, std::memory_order_relaxed);
+        b->jitter_sum.store(0, std::memory_order_relaxed);
+        b->jitter_count.store(0, std::memory_order_relaxed);
+        b->jitter_max.store(0, std::memory_order_relaxed);
+        b->index.store(index, std::memory_order_release);
+    }
+    return b;
+}
+
+void
+SspStreamStats::frame_received(gsize bytes, gboolean keyframe, GstClockTime arrival,
+                               GstClockTime duration)
+{
+    Bucket* b = bucket(arrival);
+
+    add(frames_, 1);
+    add(bytes_, bytes);
+    if (keyframe) {
+        add(keyframes_, 1);
+    }
+
+    add(b->frames, 1);
+    add(b->bytes, bytes);
+
+    if (GST_CLOCK_TIME_IS_VALID(last_arrival_) && GST_CLOCK_TIME_IS_VALID(duration)) {
+        GstClockTime interval = arrival - last_arrival_;
+        guint64 deviation = interval > duration ? interval - duration : duration - interval;
+
+        add(b->jitter_sum, deviation);
+        add(b->jitter_count, 1);
+        if (deviation > b->jitter_max.load(std::memory_order_relaxed)) {
+            b->jitter_max.store(deviation, std::memory_order_relaxed);
+        }
+    }
+    last_arrival_ = arrival;
+}
+
+void
+SspStreamStats::frame_number(guint32 frm_no)
+{
+    if (have_frm_no_) {
+        // Unsigned difference handles wrap, a step back counts as no gap
+        guint32 delta = frm_no - last_frm_no_;
+
+        if (delta > 1 && delta < G_MAXUINT32 / 2) {
+            add(frame_gaps_, 1);
+            add(missing_frames_, delta - 1);
+        }
+    }
+    last_frm_no_ = frm_no;
+    have_frm_no_ = TRUE;
+}
+
+void
+SspStreamStats::frame_dropped(gsize bytes)
+{
+    add(dropped_frames_, 1);
+    add(dropped_bytes_, bytes);
+}
+
+void
+SspStreamStats::get(GstClockTime now, SspStreamStatsSnapshot* snapshot) const
+{
+    guint64 current = now / SSP_STATS_BUCKET_TIME;
+    guint64 frames = 0, bytes = 0, jitter_sum = 0, jitter_count = 0, jitter_max = 0;
+    GstClockTime span;
+
+    snapshot->frames = frames_.load(std::memory_order_relaxed);
+    snapshot->bytes = bytes_.load(std::memory_order_relaxed);
+    snapshot->keyframes = keyframes_.load(std::memory_order_relaxed);
+    snapshot->frame_gaps = frame_gaps_.load(std::memory_order_relaxed);
+    snapshot->missing_frames = missing_frames_.load(std::memory_order_relaxed);
+    snapshot->dropped_frames = dropped_frames_.load(std::memory_order_relaxed);
+    snapshot->dropped_bytes = dropped_bytes_.load(std::memory_order_relaxed);
+
+    // The window is the completed buckets plus the current, partial one
+    for (const Bucket& b : buckets_) {
+        guint64 index = b.index.load(std::memory_order_acquire);
+
+        if (index > current || current - index >= SSP_STATS_BUCKETS) {
+            continue;
+        }
+        frames += b.frames.load(std::memory_order_relaxed);
+        bytes += b.bytes.load(std::memory_order_relaxed);
+        jitter_sum += b.jitter_sum.load(std::memory_order_relaxed);
+        jitter_count += b.jitter_count.load(std::memory_order_relaxed);
+        jitter_max = MAX(jitter_max, b.jitter_max.load(std::memory_order_relaxed));
+    }
+
+    span = (SSP_STATS_BUCKETS - 1) * SSP_STATS_BUCKET_TIME + now % SSP_STATS_BUCKET_TIME;
+    snapshot->fps = span ? (gdouble)frames * GST_SECOND / span : 0.0;
+    snapshot->bitrate = span ? gst_util_uint64_scale(bytes, 8 * GST_SECOND, span) : 0;
+    snapshot->jitter = jitter_count ? jitter_sum / jitter_count : 0;
+    snapshot->jitter_max = jitter_max;
+}
@@ -0,0 +1,82 @@
+#ifndef __SSP_STATS_H__
+#define __SSP_STATS_H__
+
+#include <gst/gst.h>
+#include <atomic>
+
+// Sliding window of SSP_STATS_BUCKETS buckets of SSP_STATS_BUCKET_TIME
+#define SSP_STATS_BUCKETS 10
+#define SSP_STATS_BUCKET_TIME (100 * GST_MSECOND)
+
+struct SspStreamStatsSnapshot {
+    guint64 frames;              // received from libssp
+    guint64 bytes;
+    guint64 keyframes;
+    guint64 frame_gaps;          // jumps in the camera frame number
+    guint64 missing_frames;      // frame numbers skipped by those jumps
+    guint64 dropped_frames;      // received but never queued
+    guint64 dropped_bytes;
+
+    // Over the sliding window
+    gdouble fps;
+    guint64 bitrate;             // bits/s
+    GstClockTime jitter;         // mean deviation of inter-arrival from frame duration
+    GstClockTime jitter_max;
+};
+
+// Receive counters of one stream. Only the libssp loop thread writes, any
+// thread reads: every counter is a relaxed atomic updated by a plain load
+// and store, so instrumenting a frame costs a few ordinary memory accesses.
+// Readers may see a window bucket half way through its reset.
+class SspStreamStats {
+public:
+    SspStreamStats();
+
+    // Only while no loop thread runs
+    void reset();
+    // A new connection, its frame numbers and arrivals start over
+    void restart();
+
+    // Loop thread. duration may be GST_CLOCK_TIME_NONE.
+    void frame_received(gsize bytes, gboolean keyframe, GstClockTime arrival,
+                        GstClockTime duration);
+    void frame_number(guint32 frm_no);
+    void frame_dropped(gsize bytes);
+
+    void get(GstClockTime now, SspStreamStatsSnapshot* snapshot) const;
+
+private:
+    struct Bucket {
+        std::atomic<guint64> index;   // start time / SSP_STATS_BUCKET_TIME
+        std::atomic<guint64> frames;
+        std::atomic<guint64> bytes;
+        std::atomic<guint64> jitter_sum;
+        std::atomic<guint64> jitter_count;
+        std::atomic<guint64> jitter_max;
+    };
+
+    static void add(std::atomic<guint64>& counter, guint64 value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value,
+                      std::memory_order_relaxed);
+    }
+
+    Bucket* bucket(GstClockTime now);
+
+    std::atomic<guint64> frames_;
+    std::atomic<guint64> bytes_;
+    std::atomic<guint64> keyframes_;
+    std::atomic<guint64> frame_gaps_;
+    std::atomic<guint64> missing_frames_;
+    std::atomic<guint64> dropped_frames_;
+    std::atomic<guint64> dropped_bytes_;
+
+    Bucket buckets_[SSP_STATS_BUCKETS];
+
+    // Loop thread only
+    GstClockTime last_arrival_;
+    guint32 last_frm_no_;
+    gboolean have_frm_no_;
+};
+
+#endif /* __SSP_STATS_H__ */
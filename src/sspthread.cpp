@@ -1,20 +1,61 @@
 #include "sspthread.h"
+#include "gstsspmemory.h"
 #include <gst/gst.h>
+#include <string.h>
+#include <vector>
+
+#ifndef G_OS_WIN32
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 SspThread::SspThread()
     : thread_loop_(nullptr)
+    , pool_(nullptr)
+    , loop_index_(0)
+    , loop_tid_(0)
     , client_(nullptr)
+    , options_()
+    , socket_info_()
     , running_(false)
+    , bytes_(0)
+    , start_time_(0)
+    , bitrate_(0)
+    , codec_type_(SSP_NAL_CODEC_UNKNOWN)
+    , reader_(nullptr)
+    , replay_thread_(nullptr)
+    , replay_stop_(FALSE)
+    , replay_paced_(FALSE)
+    , replay_loop_(FALSE)
+    , video_callback_(nullptr)
+    , audio_callback_(nullptr)
+    , meta_callback_(nullptr)
+    , connected_callback_(nullptr)
+    , disconnected_callback_(nullptr)
+    , exception_callback_(nullptr)
+    , buffer_full_callback_(nullptr)
+    , end_callback_(nullptr)
+    , user_data_(nullptr)
 {
+    g_mutex_init(&replay_lock_);
+    g_cond_init(&replay_cond_);
 }
 
 SspThread::~SspThread()
 {
     stop();
+    g_mutex_clear(&replay_lock_);
+    g_cond_clear(&replay_cond_);
 }
 
 gboolean
-SspThread::start(const std::string& ip, guint16 port, guint32 stream_style)
+SspThread::start(const std::string& ip, guint16 port, guint32 stream_style,
+                 const SspClientOptions& options)
 {
     if (running_) {
         GST_WARNING("SSP thread already running");
@@ -24,10 +65,22 @@ SspThread::start(const std::string& ip, guint16 port, guint32 stream_style)
     ip_ = ip;
     port_ = port;
     stream_style_ = stream_style;
+    options_ = options;
+    memset(&socket_info_, 0, sizeof(socket_info_));
+    codec_type_ = SSP_NAL_CODEC_UNKNOWN;
+    bytes_ = 0;
+    start_time_ = g_get_monotonic_time();
 
     try {
-        thread_loop_.reset(new imf::ThreadLoop(std::bind(&SspThread::setup_client, this, std::placeholders::_1)));
-        thread_loop_->start();
+        if (options_.loop_threads) {
+            pool_ = SspLoopPool::acquire(options_.loop_threads);
+            loop_index_ = pool_->attach(bitrate_);
+            pool_->run(loop_index_, std::bind(&SspThread::setup_client, this,
+                                              pool_->loop(loop_index_)));
+        } else {
+            thread_loop_.reset(new imf::ThreadLoop(std::bind(&SspThread::setup_client, this, std::placeholders::_1)));
+            thread_loop_->start();
+        }
         running_ = true;
         return TRUE;
     } catch (const std::exception& e) {
@@ -36,6 +89,35 @@ SspThread::start(const std::string& ip, guint16 port, guint32 stream_style)
     }
 }
 
+gboolean
+SspThread::start_replay(const std::string& path, gboolean paced, gboolean loop,
+                        SspCaptureWriter* capture)
+{
+    if (running_) {
+        GST_WARNING("SSP thread already running");
+        return FALSE;
+    }
+
+    reader_ = new SspCaptureReader();
+    if (!reader_->open(path)) {
+        delete reader_;
+        reader_ = nullptr;
+        return FALSE;
+    }
+
+    options_ = SspClientOptions();
+    options_.capture = capture;
+    codec_type_ = SSP_NAL_CODEC_UNKNOWN;
+    bytes_ = 0;
+    start_time_ = g_get_monotonic_time();
+    replay_stop_ = FALSE;
+    replay_paced_ = paced;
+    replay_loop_ = loop;
+    replay_thread_ = g_thread_new("ssp-replay", replay_func, this);
+    running_ = true;
+    return TRUE;
+}
+
 void
 SspThread::stop()
 {
@@ -45,133 +127,244 @@ SspThread::stop()
 
     running_ = false;
 
+    if (replay_thread_) {
+        g_mutex_lock(&replay_lock_);
+        replay_stop_ = TRUE;
+        g_cond_broadcast(&replay_cond_);
+        g_mutex_unlock(&replay_lock_);
+        g_thread_join(replay_thread_);
+        replay_thread_ = nullptr;
+        delete reader_;
+        reader_ = nullptr;
+    }
+
+    if (pool_) {
+        // The loop keeps serving other clients, ours must go on its thread
+        pool_->run_sync(loop_index_, std::bind(&SspThread::teardown_client, this));
+        pool_->detach(loop_index_, bitrate_);
+    } else {
+        teardown_client();
+    }
+
+    if (thread_loop_) {
+        thread_loop_->stop();
+        thread_loop_.reset();
+    }
+
+    // Only a connection that lasted gives a meaningful rate
+    gint64 elapsed = g_get_monotonic_time() - start_time_;
+    if (elapsed >= G_USEC_PER_SEC) {
+        bitrate_ = gst_util_uint64_scale(bytes_, 8 * G_USEC_PER_SEC, elapsed);
+    }
+
+    if (pool_) {
+        SspLoopPool::release(pool_);
+        pool_ = nullptr;
+    }
+}
+
+void
+SspThread::teardown_client()
+{
     if (client_) {
         client_->stop();
         delete client_;
         client_ = nullptr;
     }
+}
 
-    if (thread_loop_) {
-        thread_loop_->stop();
-        thread_loop_.reset();
+gint
+SspThread::get_loop_index() const
+{
+    return pool_ ? (gint)loop_index_ : -1;
+}
+
+gint
+SspThread::get_loop_tid() const
+{
+    return loop_tid_;
+}
+
+gint64
+SspThread::get_receive_syscalls()
+{
+#ifdef IMF_SSP_IO_BACKEND
+    return (gint64)imf::Loop::syscalls();
+#else
+    return -1;
+#endif
+}
+
+// Load accounting for the pool, which balances by what its loops receive
+void
+SspThread::account(gsize len, GstClockTime begin)
+{
+    bytes_ += len;
+    if (pool_) {
+        pool_->account(loop_index_, len, gst_util_get_timestamp() - begin);
     }
 }
 
 void
 SspThread::setup_client(imf::Loop* loop)
 {
+    if (pool_) {
+        if (!options_.loop_cpus.empty() || options_.sched_policy != SSP_SCHED_OTHER ||
+            options_.nice != 0) {
+            GST_WARNING("Loop thread scheduling is not applied to shared pool threads");
+        }
+        loop_tid_ = ssp_sched_apply_self(nullptr, nullptr);
+    } else {
+        SspSchedParams params = {
+            .cpus = options_.loop_cpus.c_str(),
+            .policy = options_.sched_policy,
+            .priority = options_.sched_priority,
+            .nice = options_.nice
+        };
+        loop_tid_ = ssp_sched_apply_self(options_.loop_name.c_str(), &params);
+    }
+
     try {
-        // Use larger buffer size like ezdump (4MB instead of 4MB)
-        client_ = new imf::SspClient(ip_, loop, 4 * 1024 * 1024, port_, stream_style_);
-        
+        client_ = new imf::SspClient(ip_, loop, options_.buffer_size, port_, stream_style_);
+#ifdef IMF_SSP_SOCKET
+        client_->setOnSocketCallback(std::bind(&SspThread::on_socket, this, std::placeholders::_1));
+#endif
+
         if (client_->init() != 0) {
             GST_ERROR("Failed to initialize SSP client");
             return;
         }
 
         // Set up callbacks in the same order as ezdump
-        client_->setOnH264DataCallback(std::bind(&SspThread::on_video_data, this, std::placeholders::_1));
+        client_->setOnH264DataCallback(std::bind(&SspThread::on_video_data, this, std::placeholders::_1, nullptr));
         client_->setOnMetaCallback(std::bind(&SspThread::on_meta_data, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
         client_->setOnDisconnectedCallback(std::bind(&SspThread::on_disconnected, this));
-        client_->setOnAudioDataCallback(std::bind(&SspThread::on_audio_data, this, std::placeholders::_1));
+        client_->setOnAudioDataCallback(std::bind(&SspThread::on_audio_data, this, std::placeholders::_1, nullptr));
         client_->setOnExceptionCallback(std::bind(&SspThread::on_exception, this, std::placeholders::_1, std::placeholders::_2));
         client_->setOnRecvBufferFullCallback(std::bind(&SspThread::on_recv_buffer_full, this));
         client_->setOnConnectionConnectedCallback(std::bind(&SspThread::on_connected, this));
 
+        if (options_.capability) {
+            client_->setCapability(options_.capability);
+        }
+
         if (client_->start() != 0) {
             GST_ERROR("Failed to start SSP client");
             return;
         }
 
-        GST_INFO("SSP client started successfully with 4MB buffer");
+        GST_INFO("SSP client started with a %u byte buffer, capability 0x%x",
+                 options_.buffer_size, options_.capability);
     } catch (const std::exception& e) {
         GST_ERROR("Exception in SSP client setup: %s", e.what());
     }
 }
 
+template <typename T>
+static GstMemory*
+frame_memory(const guint8* data, gsize len, const T* frame)
+{
+#ifdef IMF_SSP_FRAME_MEMORY
+    if (frame->memory) {
+        return gst_memory_ref((GstMemory*)frame->memory);
+    }
+#endif
+    return gst_ssp_memory_new_borrowed(data, len);
+}
+
 void
-SspThread::on_video_data(struct imf::SspH264Data* h264)
+SspThread::on_video_data(struct imf::SspH264Data* h264, GstMemory* memory)
 {
+    GstClockTime begin = gst_util_get_timestamp();
+
     GST_DEBUG("SSP thread received video data: size=%zu, frm_no=%u, type=%u, pts=%" G_GUINT64_FORMAT, 
               h264->len, h264->frm_no, h264->type, h264->pts);
+
+    if (options_.capture) {
+        SspWireFrame frame = { h264->pts, h264->ntp_timestamp, h264->frm_no, h264->type };
+        options_.capture->write_frame(SSP_WIRE_VIDEO, &frame, h264->data, h264->len, begin);
+    }
               
     if (!video_callback_) {
         GST_WARNING("No video callback set, dropping frame");
+        if (memory) {
+            gst_memory_unref(memory);
+        }
+        account(h264->len, begin);
         return;
     }
 
-    // Create a copy of the data since the callback requires it
-    guint8* data_copy = (guint8*)g_malloc(h264->len);
-    memcpy(data_copy, h264->data, h264->len);
-
-    // Detect codec type from stream data if not already known
-    guint32 codec_type = 0;
-    if (h264->len >= 4) {
-        // Look for NAL unit start codes to determine codec type
-        // H.264: NAL unit type in bits 0-4 of first byte after start code
-        // H.265: NAL unit type in bits 1-6 of first byte after start code
-        
-        // Find start code (0x00000001 or 0x000001)
-        guint8* nal_start = nullptr;
-        for (size_t i = 0; i < h264->len - 4; i++) {
-            if (h264->data[i] == 0x00 && h264->data[i+1] == 0x00) {
-                if (h264->data[i+2] == 0x00 && h264->data[i+3] == 0x01) {
-                    nal_start = &h264->data[i+4];
-                    break;
-                } else if (h264->data[i+2] == 0x01) {
-                    nal_start = &h264->data[i+3];
-                    break;
-                }
-            }
-        }
-        
-        if (nal_start && (nal_start - h264->data) < (long)h264->len) {
-            guint8 nal_byte = *nal_start;
-            
-            // H.265 detection: NAL unit type is in bits 1-6
-            guint8 h265_nal_type = (nal_byte >> 1) & 0x3F;
-            if (h265_nal_type >= 32 && h265_nal_type <= 40) {
-                // H.265 VPS, SPS, PPS, or other H.265-specific NAL types
-                codec_type = 265; // VIDEO_ENCODER_H265
-            } else {
-                // Assume H.264 for other cases
-                codec_type = 96;  // VIDEO_ENCODER_H264
-            }
-        }
+    // Wrap the receive buffer in place, the payload is only copied if the
+    // consumer still holds it when libssp takes the region back. The native
+    // client and the replay hand over memory that needs neither.
+    if (!memory) {
+        memory = frame_memory(h264->data, h264->len, h264);
+    }
+
+    // One pass over the frame prefix serves codec detection and caps
+    // probing. Once the codec is latched the scan stops at the first slice
+    // and never touches the slice payload.
+    ssp_nal_index_build(&nal_index_, h264->data, h264->len, codec_type_, TRUE);
+    if (codec_type_ == SSP_NAL_CODEC_UNKNOWN && nal_index_.codec != SSP_NAL_CODEC_UNKNOWN) {
+        codec_type_ = nal_index_.codec;
+        GST_INFO("Detected codec %u from parameter sets", codec_type_);
     }
 
     SspVideoData video_data = {
-        .data = data_copy,
+        .data = h264->data,
+        .memory = memory,
         .len = h264->len,
         .pts = h264->pts,
         .ntp_timestamp = h264->ntp_timestamp,
+        .received = begin,
         .frm_no = h264->frm_no,
         .type = h264->type,
-        .codec_type = codec_type
+        .codec_type = codec_type_,
+        .nal_index = &nal_index_
     };
 
     video_callback_(video_data, user_data_);
+
+    gst_ssp_memory_reclaim(memory);
+    gst_memory_unref(memory);
+    account(h264->len, begin);
 }
 
 void
-SspThread::on_audio_data(struct imf::SspAudioData* audio)
+SspThread::on_audio_data(struct imf::SspAudioData* audio, GstMemory* memory)
 {
+    GstClockTime begin = gst_util_get_timestamp();
+
+    if (options_.capture) {
+        SspWireFrame frame = { audio->pts, audio->ntp_timestamp, 0, 0 };
+        options_.capture->write_frame(SSP_WIRE_AUDIO, &frame, audio->data, audio->len, begin);
+    }
+
     if (!audio_callback_) {
+        if (memory) {
+            gst_memory_unref(memory);
+        }
         return;
     }
 
-    // Create a copy of the data since the callback requires it
-    guint8* data_copy = (guint8*)g_malloc(audio->len);
-    memcpy(data_copy, audio->data, audio->len);
+    if (!memory) {
+        memory = frame_memory(audio->data, audio->len, audio);
+    }
 
     SspAudioData audio_data = {
-        .data = data_copy,
+        .data = audio->data,
+        .memory = memory,
         .len = audio->len,
         .pts = audio->pts,
-        .ntp_timestamp = audio->ntp_timestamp
+        .ntp_timestamp = audio->ntp_timestamp,
+        .received = begin
     };
 
     audio_callback_(audio_data, user_data_);
+
+    gst_ssp_memory_reclaim(memory);
+    gst_memory_unref(memory);
+    account(audio->len, begin);
 }
 
 void
@@ -179,6 +372,23 @@ SspThread::on_meta_data(struct imf::SspVideoMeta* video_meta,
                        struct imf::SspAudioMeta* audio_meta, 
                        struct imf::SspMeta* meta)
 {
+    if (options_.capture) {
+        SspWireMeta m = {
+            video_meta->width, video_meta->height, video_meta->timescale,
+            video_meta->unit, video_meta->gop, video_meta->encoder,
+            audio_meta->timescale, audio_meta->unit, audio_meta->sample_rate,
+            audio_meta->sample_size, audio_meta->channel, audio_meta->bitrate,
+            audio_meta->encoder, meta->pts_is_wall_clock, meta->tc_drop_frame,
+            meta->timecode
+        };
+        options_.capture->write_meta(&m, gst_util_get_timestamp());
+    }
+
+    if (codec_type_ == SSP_NAL_CODEC_UNKNOWN &&
+        (video_meta->encoder == SSP_NAL_CODEC_H264 || video_meta->encoder == SSP_NAL_CODEC_H265)) {
+        codec_type_ = video_meta->encoder;
+    }
+
     if (!meta_callback_) {
         return;
     }
@@ -211,10 +421,345 @@ SspThread::on_meta_data(struct imf::SspVideoMeta* video_meta,
     meta_callback_(v_meta, a_meta, m_meta, user_data_);
 }
 
+gpointer
+SspThread::replay_func(gpointer data)
+{
+    static_cast<SspThread*>(data)->replay();
+    return nullptr;
+}
+
+// Sleep until deadline on the gst_util_get_timestamp() clock, FALSE once
+// stop() was called
+gboolean
+SspThread::replay_wait(GstClockTime deadline)
+{
+    gboolean stopped;
+
+    g_mutex_lock(&replay_lock_);
+    for (;;) {
+        GstClockTime now = gst_util_get_timestamp();
+        if (replay_stop_ || now >= deadline) {
+            break;
+        }
+        g_cond_wait_until(&replay_cond_, &replay_lock_,
+                          g_get_monotonic_time() + (gint64)((deadline - now) / GST_USECOND));
+    }
+    stopped = replay_stop_;
+    g_mutex_unlock(&replay_lock_);
+    return !stopped;
+}
+
+// Feeds the records to the same handlers libssp calls, each frame as
+// read-only memory over the mapping that a queued buffer keeps alive, so
+// nothing is copied when the handler returns. On later passes of
+// a loop pts and frame numbers are shifted by the length of the capture,
+// and the NTP times, which cannot be shifted meaningfully, are left out.
+void
+SspThread::replay()
+{
+    guint64 video_shift = 0, audio_shift = 0;
+    guint32 frm_shift = 0;
+    GstClockTime time_shift = 0, last_time = 0;
+    guint64 video_first = 0, video_last = 0, audio_first = 0, audio_last = 0;
+    guint32 frm_first = 0, frm_last = 0, video_unit = 0, audio_unit = 0;
+    gboolean has_video = FALSE, has_audio = FALSE;
+    gsize n = reader_->n_records();
+    GstClockTime begin;
+
+    loop_tid_ = ssp_sched_apply_self(nullptr, nullptr);
+    on_connected();
+
+    begin = gst_util_get_timestamp();
+    for (guint pass = 0;; pass++) {
+        for (gsize i = 0; i < n; i++) {
+            SspCaptureRecord record;
+            SspWireFrame frame;
+
+            if (!reader_->get(i, &record)) {
+                GST_WARNING("Skipping malformed capture record %" G_GSIZE_FORMAT, i);
+                continue;
+            }
+            if (replay_paced_) {
+                if (!replay_wait(begin + time_shift + record.time)) {
+                    return;
+                }
+            } else if (g_atomic_int_get(&replay_stop_)) {
+                return;
+            }
+            last_time = record.time;
+
+            switch (record.type) {
+            case SSP_CAPTURE_META: {
+                SspWireMeta m;
+                ssp_wire_read_meta(record.payload, &m);
+
+                imf::SspVideoMeta video = imf::SspVideoMeta();
+                video.width = m.width;
+                video.height = m.height;
+                video.timescale = m.timescale;
+                video.unit = m.unit;
+                video.gop = m.gop;
+                video.encoder = m.encoder;
+                imf::SspAudioMeta audio = imf::SspAudioMeta();
+                audio.timescale = m.audio_timescale;
+                audio.unit = m.audio_unit;
+                audio.sample_rate = m.sample_rate;
+                audio.sample_size = m.sample_size;
+                audio.channel = m.channel;
+                audio.bitrate = m.bitrate;
+                audio.encoder = m.audio_encoder;
+                imf::SspMeta meta = imf::SspMeta();
+                meta.pts_is_wall_clock = m.pts_is_wall_clock != 0;
+                meta.tc_drop_frame = m.tc_drop_frame != 0;
+                meta.timecode = m.timecode;
+
+                video_unit = m.unit;
+                audio_unit = m.audio_unit;
+                on_meta_data(&video, &audio, &meta);
+                break;
+            }
+            case SSP_CAPTURE_VIDEO: {
+                ssp_wire_read_frame(record.payload, SSP_WIRE_VIDEO, &frame);
+                if (pass == 0) {
+                    if (!has_video) {
+                        video_first = frame.pts;
+                        frm_first = frame.frm_no;
+                        has_video = TRUE;
+                    }
+                    video_last = frame.pts;
+                    frm_last = frame.frm_no;
+                }
+
+                imf::SspH264Data h264 = imf::SspH264Data();
+                h264.data = (uint8_t*)record.payload + SSP_WIRE_VIDEO_PREFIX_SIZE;
+                h264.len = record.length - SSP_WIRE_VIDEO_PREFIX_SIZE;
+                h264.pts = frame.pts + video_shift;
+                h264.ntp_timestamp = pass ? 0 : frame.ntp_timestamp;
+                h264.frm_no = frame.frm_no + frm_shift;
+                h264.type = frame.type;
+                on_video_data(&h264, reader_->wrap(h264.data, h264.len));
+                break;
+            }
+            case SSP_CAPTURE_AUDIO: {
+                ssp_wire_read_frame(record.payload, SSP_WIRE_AUDIO, &frame);
+                if (pass == 0) {
+                    if (!has_audio) {
+                        audio_first = frame.pts;
+                        has_audio = TRUE;
+                    }
+                    audio_last = frame.pts;
+                }
+
+                imf::SspAudioData audio = imf::SspAudioData();
+                audio.data = (uint8_t*)record.payload + SSP_WIRE_AUDIO_PREFIX_SIZE;
+                audio.len = record.length - SSP_WIRE_AUDIO_PREFIX_SIZE;
+                audio.pts = frame.pts + audio_shift;
+                audio.ntp_timestamp = pass ? 0 : frame.ntp_timestamp;
+                on_audio_data(&audio, reader_->wrap(audio.data, audio.len));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        if (!replay_loop_ || n == 0) {
+            break;
+        }
+
+        // The next pass follows one frame after the last
+        if (has_video) {
+            video_shift += video_last - video_first + video_unit;
+            frm_shift += frm_last - frm_first + 1;
+        }
+        if (has_audio) {
+            audio_shift += audio_last - audio_first + audio_unit;
+        }
+        time_shift += last_time + last_time / MAX(n - 1, 1);
+    }
+
+    GST_INFO("Replay reached the end of the capture");
+    if (end_callback_) {
+        end_callback_(user_data_);
+    }
+}
+
+#ifndef G_OS_WIN32
+#ifndef IMF_SSP_SOCKET
+static gboolean
+peer_matches(gint fd, gboolean is_v4, const struct in_addr* v4, const struct in6_addr* v6,
+             guint16 port)
+{
+    struct sockaddr_storage peer;
+    socklen_t len = sizeof(peer);
+
+    if (getpeername(fd, (struct sockaddr*)&peer, &len) != 0) {
+        return FALSE;
+    }
+    if (is_v4 && peer.ss_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)&peer;
+        return in->sin_port == htons(port) && in->sin_addr.s_addr == v4->s_addr;
+    }
+    if (!is_v4 && peer.ss_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)&peer;
+        return in6->sin6_port == htons(port) && memcmp(&in6->sin6_addr, v6, sizeof(*v6)) == 0;
+    }
+    return FALSE;
+}
+
+// libssp keeps its socket to itself: find it among our descriptors by the
+// camera's address. Every connection to the same ip:port matches, other
+// sources' included. Only the open descriptors are tried where /proc
+// lists them.
+static std::vector<gint>
+find_peer_sockets(const std::string& ip, guint16 port)
+{
+    std::vector<gint> fds;
+    struct in_addr v4;
+    struct in6_addr v6;
+    gboolean is_v4 = inet_pton(AF_INET, ip.c_str(), &v4) == 1;
+
+    if (!is_v4 && inet_pton(AF_INET6, ip.c_str(), &v6) != 1) {
+        GST_WARNING("Cannot match the SSP socket against non-numeric address %s", ip.c_str());
+        return fds;
+    }
+
+    GDir* dir = g_dir_open("/proc/self/fd", 0, nullptr);
+    if (dir) {
+        const gchar* name;
+
+        while ((name = g_dir_read_name(dir))) {
+            gint fd = atoi(name);
+
+            if (peer_matches(fd, is_v4, &v4, &v6, port)) {
+                fds.push_back(fd);
+            }
+        }
+        g_dir_close(dir);
+        return fds;
+    }
+
+    glong max_fd = sysconf(_SC_OPEN_MAX);
+    if (max_fd <= 0 || max_fd > 65536) {
+        max_fd = 65536;
+    }
+    for (gint fd = 0; fd < max_fd; fd++) {
+        if (peer_matches(fd, is_v4, &v4, &v6, port)) {
+            fds.push_back(fd);
+        }
+    }
+    return fds;
+}
+#endif
+
+// socket-buffer-size and low-latency on @fd
+static void
+set_socket_options(gint fd, const SspClientOptions& options)
+{
+    if (options.socket_buffer_size) {
+        int size = (int)MIN(options.socket_buffer_size, (guint)G_MAXINT / 2);
+        gboolean set = FALSE;
+#ifdef SO_RCVBUFFORCE
+        // Goes past net.core.rmem_max when we have CAP_NET_ADMIN
+        set = setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) == 0;
+#endif
+        if (!set && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) {
+            GST_WARNING("Failed to set SO_RCVBUF to %d: %s", size, g_strerror(errno));
+        }
+    }
+
+    if (options.low_latency) {
+        int one = 1;
+        if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
+            GST_WARNING("Failed to set TCP_NODELAY: %s", g_strerror(errno));
+        }
+#ifdef TCP_QUICKACK
+        setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+#endif
+    }
+}
+
+// What the kernel made of the options
+static void
+read_socket_info(gint fd, SspSocketInfo* info)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &value, &len) == 0) {
+        info->socket_buffer_size = value;
+    }
+    len = sizeof(value);
+    if (getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, &len) == 0) {
+        info->nodelay = value != 0;
+    }
+    info->found = TRUE;
+}
+#endif
+
+void
+SspThread::apply_socket_options()
+{
+    memset(&socket_info_, 0, sizeof(socket_info_));
+
+#ifdef IMF_SSP_SOCKET
+    // Set in on_socket() before connecting, only read back here
+    read_socket_info(client_->socketFd(), &socket_info_);
+#elif !defined(G_OS_WIN32)
+    std::vector<gint> fds = find_peer_sockets(ip_, port_);
+
+    if (fds.empty()) {
+        GST_WARNING("SSP socket to %s:%u not found, socket options not applied",
+                    ip_.c_str(), port_);
+        return;
+    }
+    // Another connection to the camera, ours cannot be told apart from it
+    if (fds.size() > 1) {
+        GST_WARNING("%u sockets to %s:%u, socket options not applied", (guint)fds.size(),
+                    ip_.c_str(), port_);
+        socket_info_.ambiguous = TRUE;
+        return;
+    }
+
+    set_socket_options(fds[0], options_);
+    read_socket_info(fds[0], &socket_info_);
+#else
+    if (options_.socket_buffer_size || options_.low_latency) {
+        GST_WARNING("Socket options are not supported on this platform");
+    }
+    return;
+#endif
+
+    GST_INFO("SSP socket to %s:%u: SO_RCVBUF %d, TCP_NODELAY %d", ip_.c_str(), port_,
+             socket_info_.socket_buffer_size, socket_info_.nodelay);
+}
+
+#ifdef IMF_SSP_SOCKET
+void
+SspThread::on_socket(int fd)
+{
+    set_socket_options(fd, options_);
+}
+#endif
+
+void
+SspThread::get_socket_info(SspSocketInfo* info) const
+{
+    *info = socket_info_;
+}
+
 void
 SspThread::on_connected()
 {
     GST_INFO("SSP client connected");
+    if (!reader_) {
+        apply_socket_options();
+#ifdef IMF_SSP_IO_BACKEND
+        socket_info_.io_backend = client_->ioBackend();
+#else
+        socket_info_.io_backend = "libssp";
+#endif
+    }
     if (connected_callback_) {
         connected_callback_(user_data_);
     }
@@ -233,6 +778,9 @@ void
 SspThread::on_recv_buffer_full()
 {
     GST_WARNING("SSP client receive buffer full - may cause frame drops");
+    if (buffer_full_callback_) {
+        buffer_full_callback_(user_data_);
+    }
 }
 
 void
@@ -285,3 +833,17 @@ SspThread::set_exception_callback(SspExceptionCallback callback, gpointer user_d
     exception_callback_ = callback;
     user_data_ = user_data;
 }
+
+void
+SspThread::set_buffer_full_callback(SspBufferFullCallback callback, gpointer user_data)
+{
+    buffer_full_callback_ = callback;
+    user_data_ = user_data;
+}
+
+void
+SspThread::set_end_callback(SspEndCallback callback, gpointer user_data)
+{
+    end_callback_ = callback;
+    user_data_ = user_data;
+}
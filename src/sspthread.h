@@ -2,6 +2,7 @@
 #define __SSP_THREAD_H__
 
 #include <glib.h>
+#include <gst/gst.h>
 #include <memory>
 #include <string>
 #include <functional>
@@ -9,24 +10,38 @@
 #include "imf/net/threadloop.h"
 #include "imf/ssp/sspclient.h"
 
+#include "sspcapture.h"
+#include "ssplooppool.h"
+#include "sspnal.h"
+#include "sspsched.h"
+
 G_BEGIN_DECLS
 
 // GStreamer-friendly data structures
+// data points into the libssp receive buffer and is only valid during the
+// callback. memory is a borrowed GstMemory wrapping the same region: take a
+// ref and call gst_ssp_memory_reclaim() before handing it to another thread.
 struct SspVideoData {
     guint8* data;
+    GstMemory* memory;
     gsize len;
     guint64 pts;
     guint64 ntp_timestamp;
+    GstClockTime received;  // gst_util_get_timestamp() at callback entry
     guint32 frm_no;
     guint32 type;
     guint32 codec_type;  // Added to identify H.264 vs H.265
+    // NAL units up to and including the first slice, valid during the callback
+    const SspNalIndex* nal_index;
 };
 
 struct SspAudioData {
     guint8* data;
+    GstMemory* memory;
     gsize len;
     guint64 pts;
     guint64 ntp_timestamp;
+    GstClockTime received;
 };
 
 struct SspVideoMeta {
@@ -54,6 +69,33 @@ struct SspMeta {
     guint32 timecode;
 };
 
+// Receive path settings, handed to libssp or applied to its socket
+struct SspClientOptions {
+    guint buffer_size;          // libssp receive buffer, must hold a frame
+    guint32 capability;         // SSP capability flags, 0 keeps the default
+    guint socket_buffer_size;   // SO_RCVBUF, 0 keeps kernel autotuning
+    gboolean low_latency;       // TCP_NODELAY and TCP_QUICKACK
+    guint loop_threads;         // share a process-wide loop pool, 0 for an own loop
+    // Own loop thread only, pool threads are shared between cameras
+    std::string loop_name;
+    std::string loop_cpus;      // CPU list, empty keeps the inherited affinity
+    SspSchedPolicy sched_policy;
+    gint sched_priority;
+    gint nice;
+    // Records every libssp callback, owned by the caller, NULL for none
+    SspCaptureWriter* capture;
+};
+
+// Socket settings as reported by the kernel after connecting
+struct SspSocketInfo {
+    gboolean found;             // the connection's socket could be located
+    gboolean ambiguous;         // several sockets to the camera, none touched
+    gint socket_buffer_size;
+    gboolean nodelay;
+    // How the client receives: "libssp", or "epoll"/"io_uring" in native builds
+    const gchar* io_backend;
+};
+
 // Callback function types
 typedef void (*SspVideoCallback) (SspVideoData data, gpointer user_data);
 typedef void (*SspAudioCallback) (SspAudioData data, gpointer user_data);
@@ -61,6 +103,8 @@ typedef void (*SspMetaCallback) (SspVideoMeta video_meta, SspAudioMeta audio_met
 typedef void (*SspConnectedCallback) (gpointer user_data);
 typedef void (*SspDisconnectedCallback) (gpointer user_data);
 typedef void (*SspExceptionCallback) (gint code, const gchar* description, gpointer user_data);
+typedef void (*SspBufferFullCallback) (gpointer user_data);
+typedef void (*SspEndCallback) (gpointer user_data);
 
 G_END_DECLS
 
@@ -70,33 +114,89 @@ public:
     SspThread();
     ~SspThread();
 
-    gboolean start(const std::string& ip, guint16 port = 9999, guint32 stream_style = 0);
+    gboolean start(const std::string& ip, guint16 port, guint32 stream_style,
+                   const SspClientOptions& options);
+    // Play a capture instead of connecting: the records go through the same
+    // callbacks, on a replay thread, at their recorded arrival times or as
+    // fast as the consumers take them. With loop the capture starts over
+    // with pts and frame numbers continuing.
+    gboolean start_replay(const std::string& path, gboolean paced, gboolean loop,
+                          SspCaptureWriter* capture);
     void stop();
 
+    // Valid from the connected callback on, on the loop thread
+    void get_socket_info(SspSocketInfo* info) const;
+    // Index in the loop pool, -1 with an own loop
+    gint get_loop_index() const;
+    // Kernel id of the loop thread, valid from the connected callback on
+    gint get_loop_tid() const;
+    // System calls all loop threads made to receive so far, -1 when the
+    // client does not count them (libssp)
+    static gint64 get_receive_syscalls();
+
     void set_video_callback(SspVideoCallback callback, gpointer user_data);
     void set_audio_callback(SspAudioCallback callback, gpointer user_data);
     void set_meta_callback(SspMetaCallback callback, gpointer user_data);
     void set_connected_callback(SspConnectedCallback callback, gpointer user_data);
     void set_disconnected_callback(SspDisconnectedCallback callback, gpointer user_data);
     void set_exception_callback(SspExceptionCallback callback, gpointer user_data);
+    // libssp ran out of receive buffer and lost data
+    void set_buffer_full_callback(SspBufferFullCallback callback, gpointer user_data);
+    // A replay reached the end of the capture
+    void set_end_callback(SspEndCallback callback, gpointer user_data);
 
 private:
     void setup_client(imf::Loop* loop);
-    void on_video_data(struct imf::SspH264Data* h264);
-    void on_audio_data(struct imf::SspAudioData* audio);
+    void teardown_client();
+    void account(gsize len, GstClockTime begin);
+    // memory, when set, is the frame's own and is taken over
+    void on_video_data(struct imf::SspH264Data* h264, GstMemory* memory);
+    void on_audio_data(struct imf::SspAudioData* audio, GstMemory* memory);
     void on_meta_data(struct imf::SspVideoMeta* video_meta, struct imf::SspAudioMeta* audio_meta, struct imf::SspMeta* meta);
     void on_connected();
     void on_disconnected();
     void on_recv_buffer_full();
     void on_exception(int code, const char* description);
+    void apply_socket_options();
+#ifdef IMF_SSP_SOCKET
+    void on_socket(int fd);
+#endif
+    static gpointer replay_func(gpointer data);
+    void replay();
+    gboolean replay_wait(GstClockTime deadline);
 
     std::unique_ptr<imf::ThreadLoop> thread_loop_;
+    SspLoopPool* pool_;
+    guint loop_index_;
+    gint loop_tid_;
     imf::SspClient* client_;
     std::string ip_;
     guint16 port_;
     guint32 stream_style_;
+    SspClientOptions options_;
+    SspSocketInfo socket_info_;
     gboolean running_;
 
+    // Received during the current connection, the measured bitrate is the
+    // pool's balancing hint for the next one
+    guint64 bytes_;
+    gint64 start_time_;
+    guint64 bitrate_;
+
+    // Latched from the metadata or the first parameter sets, after which the
+    // per-frame index only covers the NAL units before the first slice
+    guint32 codec_type_;
+    SspNalIndex nal_index_;
+
+    // Replay instead of a client, replay_stop_ protected by replay_lock_
+    SspCaptureReader* reader_;
+    GThread* replay_thread_;
+    GMutex replay_lock_;
+    GCond replay_cond_;
+    gboolean replay_stop_;
+    gboolean replay_paced_;
+    gboolean replay_loop_;
+
     // Callbacks
     SspVideoCallback video_callback_;
     SspAudioCallback audio_callback_;
@@ -104,6 +204,8 @@ private:
     SspConnectedCallback connected_callback_;
     SspDisconnectedCallback disconnected_callback_;
     SspExceptionCallback exception_callback_;
+    SspBufferFullCallback buffer_full_callback_;
+    SspEndCallback end_callback_;
     gpointer user_data_;
 };
 
@@ -0,0 +1,168 @@
+#include "ssptimestamp.h"
+
+// A camera time jump larger than this against the expected next timestamp
+// is treated as a discontinuity and rebased on the arrival clock
+#define SSP_TIMESTAMP_MAX_JUMP (2 * GST_SECOND)
+
+// Seconds between 1900-01-01 (NTP) and 1970-01-01 (Unix)
+#define SSP_NTP_UNIX_OFFSET G_GUINT64_CONSTANT(2208988800)
+
+SspTimestamper::SspTimestamper(SspClockEpoch* epoch)
+    : epoch_(epoch)
+    , use_arrival_(FALSE)
+    , timescale_(0)
+    , unit_(0)
+    , frame_duration_(GST_CLOCK_TIME_NONE)
+{
+    reset();
+}
+
+void
+SspTimestamper::reset()
+{
+    has_last_ = FALSE;
+    last_raw_ = 0;
+    wrap_offset_ = 0;
+    offset_ = 0;
+    last_running_ = GST_CLOCK_TIME_NONE;
+}
+
+void
+SspTimestamper::reset_epoch(SspClockEpoch* epoch)
+{
+    epoch->arrival_base = GST_CLOCK_TIME_NONE;
+    epoch->has_pts = FALSE;
+    epoch->pts_offset = 0;
+}
+
+GstClockTime
+SspTimestamper::ntp_now()
+{
+    return g_get_real_time() * GST_USECOND + SSP_NTP_UNIX_OFFSET * GST_SECOND;
+}
+
+GstClockTime
+SspTimestamper::ntp_to_ns(guint64 ntp)
+{
+    if (ntp == 0) {
+        return GST_CLOCK_TIME_NONE;
+    }
+
+    // libssp does not document the unit, tell them apart by magnitude.
+    // A 32.32 NTP timestamp after 1970 has at least 2208988800 in its
+    // upper word, which no Unix ns/us/ms count reaches before 2250.
+    if ((ntp >> 32) >= SSP_NTP_UNIX_OFFSET) {
+        return (ntp >> 32) * GST_SECOND +
+            gst_util_uint64_scale(ntp & G_MAXUINT32, GST_SECOND, G_GUINT64_CONSTANT(1) << 32);
+    }
+
+    GstClockTime unix_ns;
+    if (ntp >= G_GUINT64_CONSTANT(100000000000000000)) {
+        unix_ns = ntp;
+    } else if (ntp >= G_GUINT64_CONSTANT(100000000000000)) {
+        unix_ns = ntp * GST_USECOND;
+    } else {
+        unix_ns = ntp * GST_MSECOND;
+    }
+
+    return unix_ns + SSP_NTP_UNIX_OFFSET * GST_SECOND;
+}
+
+void
+SspTimestamper::set_rate(guint32 timescale, guint32 unit)
+{
+    if (timescale != timescale_) {
+        // Ticks change meaning, start over from the next frame
+        reset();
+    }
+
+    timescale_ = timescale;
+    unit_ = unit;
+
+    if (timescale_ > 0 && unit_ > 0) {
+        frame_duration_ = gst_util_uint64_scale(unit_, GST_SECOND, timescale_);
+    } else {
+        frame_duration_ = GST_CLOCK_TIME_NONE;
+    }
+}
+
+GstClockTime
+SspTimestamper::arrival_running(GstClockTime arrival)
+{
+    if (!GST_CLOCK_TIME_IS_VALID(epoch_->arrival_base)) {
+        epoch_->arrival_base = arrival;
+    }
+    return arrival > epoch_->arrival_base ? arrival - epoch_->arrival_base : 0;
+}
+
+guint64
+SspTimestamper::unwrap(guint64 pts)
+{
+    // Cameras with a 32-bit tick counter wrap every few hours at 90 kHz
+    if (has_last_ && pts < last_raw_ && last_raw_ <= G_MAXUINT32 &&
+        last_raw_ - pts > G_MAXUINT32 / 2) {
+        wrap_offset_ += G_GUINT64_CONSTANT(1) << 32;
+    }
+
+    last_raw_ = pts;
+    has_last_ = TRUE;
+    return pts + wrap_offset_;
+}
+
+GstClockTime
+SspTimestamper::timestamp(guint64 pts, GstClockTime arrival,
+                          GstClockTime* duration, gboolean* discont)
+{
+    GstClockTime now = arrival_running(arrival);
+    GstClockTimeDiff running;
+
+    *duration = frame_duration_;
+    *discont = !GST_CLOCK_TIME_IS_VALID(last_running_);
+
+    if (use_arrival_ || timescale_ == 0) {
+        last_running_ = now;
+        return now;
+    }
+
+    gboolean first = !has_last_;
+    GstClockTime pts_ns = gst_util_uint64_scale(unwrap(pts), GST_SECOND, timescale_);
+
+    if (first) {
+        GstClockTimeDiff own = (GstClockTimeDiff)now - (GstClockTimeDiff)pts_ns;
+
+        if (!epoch_->has_pts) {
+            epoch_->has_pts = TRUE;
+            epoch_->pts_offset = own;
+        }
+
+        // The other stream may run on a different camera clock
+        offset_ = epoch_->pts_offset;
+        if (ABS(own - offset_) > (GstClockTimeDiff)SSP_TIMESTAMP_MAX_JUMP) {
+            GST_DEBUG("stream clock differs from epoch by %" GST_STIME_FORMAT ", using own origin",
+                      GST_STIME_ARGS(own - offset_));
+            offset_ = own;
+        }
+    }
+
+    running = (GstClockTimeDiff)pts_ns + offset_;
+
+    if (!first && GST_CLOCK_TIME_IS_VALID(last_running_)) {
+        GstClockTimeDiff expected = (GstClockTimeDiff)last_running_ +
+            (GST_CLOCK_TIME_IS_VALID(frame_duration_) ? (GstClockTimeDiff)frame_duration_ : 0);
+
+        if (ABS(running - expected) > (GstClockTimeDiff)SSP_TIMESTAMP_MAX_JUMP) {
+            GST_INFO("camera pts jumped by %" GST_STIME_FORMAT ", rebasing on arrival time",
+                     GST_STIME_ARGS(running - expected));
+            offset_ = (GstClockTimeDiff)now - (GstClockTimeDiff)pts_ns;
+            running = now;
+            *discont = TRUE;
+        }
+    }
+
+    if (running < 0) {
+        running = 0;
+    }
+
+    last_running_ = running;
+    return running;
+}
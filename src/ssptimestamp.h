@@ -0,0 +1,59 @@
+#ifndef __SSP_TIMESTAMP_H__
+#define __SSP_TIMESTAMP_H__
+
+#include <gst/gst.h>
+
+// Shared by the video and audio timestampers of one source so both streams
+// are mapped onto the same running time origin.
+struct SspClockEpoch {
+    GstClockTime arrival_base;    // local clock at the first frame of any stream
+    gboolean has_pts;
+    GstClockTimeDiff pts_offset;  // running time = camera time in ns + offset
+};
+
+// Maps camera PTS ticks to running time. Ticks are converted through the
+// stream timescale, unwrapped across 32-bit counter wraparound and rebased
+// on the arrival clock when they jump. Falls back to arrival time when no
+// timescale is known or when use_arrival is set.
+class SspTimestamper {
+public:
+    explicit SspTimestamper(SspClockEpoch* epoch);
+
+    void reset();
+    void set_rate(guint32 timescale, guint32 unit);
+    void set_use_arrival(gboolean use_arrival) { use_arrival_ = use_arrival; }
+
+    // arrival is a monotonic local timestamp taken when the frame came in.
+    // Returns the running time, duration and discont receive per-frame
+    // results.
+    GstClockTime timestamp(guint64 pts, GstClockTime arrival,
+                           GstClockTime* duration, gboolean* discont);
+
+    GstClockTime frame_duration() const { return frame_duration_; }
+
+    static void reset_epoch(SspClockEpoch* epoch);
+
+    // Camera NTP time to nanoseconds since the NTP epoch (1900), as used by
+    // timestamp/x-ntp reference metas. GST_CLOCK_TIME_NONE when unset.
+    static GstClockTime ntp_to_ns(guint64 ntp);
+    // Local wall-clock time on the same scale
+    static GstClockTime ntp_now();
+
+private:
+    guint64 unwrap(guint64 pts);
+    GstClockTime arrival_running(GstClockTime arrival);
+
+    SspClockEpoch* epoch_;
+    gboolean use_arrival_;
+    guint32 timescale_;
+    guint32 unit_;
+    GstClockTime frame_duration_;
+
+    gboolean has_last_;
+    guint64 last_raw_;
+    guint64 wrap_offset_;
+    GstClockTimeDiff offset_;     // running time = camera ns + offset
+    GstClockTime last_running_;
+};
+
+#endif /* __SSP_TIMESTAMP_H__ */
@@ -0,0 +1,136 @@
+#include "sspwire.h"
+
+#include <string.h>
+
+static inline void
+put_u32 (guint8 * out, guint32 v)
+{
+  v = GUINT32_TO_LE (v);
+  memcpy (out, &v, 4);
+}
+
+static inline void
+put_u64 (guint8 * out, guint64 v)
+{
+  v = GUINT64_TO_LE (v);
+  memcpy (out, &v, 8);
+}
+
+static inline guint32
+get_u32 (const guint8 * in)
+{
+  guint32 v;
+
+  memcpy (&v, in, 4);
+  return GUINT32_FROM_LE (v);
+}
+
+static inline guint64
+get_u64 (const guint8 * in)
+{
+  guint64 v;
+
+  memcpy (&v, in, 8);
+  return GUINT64_FROM_LE (v);
+}
+
+void
+ssp_wire_write_header (guint8 * out, SspWireType type, guint32 length)
+{
+  put_u32 (out, type);
+  put_u32 (out + 4, length);
+}
+
+gboolean
+ssp_wire_read_header (const guint8 * in, SspWireType * type, guint32 * length)
+{
+  guint32 t = get_u32 (in);
+
+  *length = get_u32 (in + 4);
+  if (t < SSP_WIRE_HELLO || t > SSP_WIRE_AUDIO)
+    return FALSE;
+
+  *type = (SspWireType) t;
+  return TRUE;
+}
+
+void
+ssp_wire_write_hello (guint8 * out, const SspWireHello * hello)
+{
+  put_u32 (out, SSP_WIRE_MAGIC);
+  put_u32 (out + 4, SSP_WIRE_VERSION);
+  put_u32 (out + 8, hello->stream_style);
+  put_u32 (out + 12, hello->capability);
+}
+
+gboolean
+ssp_wire_read_hello (const guint8 * in, SspWireHello * hello)
+{
+  if (get_u32 (in) != SSP_WIRE_MAGIC || get_u32 (in + 4) != SSP_WIRE_VERSION)
+    return FALSE;
+
+  hello->stream_style = get_u32 (in + 8);
+  hello->capability = get_u32 (in + 12);
+  return TRUE;
+}
+
+/* The meta is sixteen u32 in declaration order */
+void
+ssp_wire_write_meta (guint8 * out, const SspWireMeta * meta)
+{
+  const guint32 fields[] = {
+    meta->width, meta->height, meta->timescale, meta->unit, meta->gop,
+    meta->encoder, meta->audio_timescale, meta->audio_unit,
+    meta->sample_rate, meta->sample_size, meta->channel, meta->bitrate,
+    meta->audio_encoder, meta->pts_is_wall_clock, meta->tc_drop_frame,
+    meta->timecode
+  };
+  guint i;
+
+  G_STATIC_ASSERT (sizeof (fields) == SSP_WIRE_META_SIZE);
+  for (i = 0; i < G_N_ELEMENTS (fields); i++)
+    put_u32 (out + 4 * i, fields[i]);
+}
+
+void
+ssp_wire_read_meta (const guint8 * in, SspWireMeta * meta)
+{
+  guint32 *fields[] = {
+    &meta->width, &meta->height, &meta->timescale, &meta->unit, &meta->gop,
+    &meta->encoder, &meta->audio_timescale, &meta->audio_unit,
+    &meta->sample_rate, &meta->sample_size, &meta->channel, &meta->bitrate,
+    &meta->audio_encoder, &meta->pts_is_wall_clock, &meta->tc_drop_frame,
+    &meta->timecode
+  };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fields); i++)
+    *fields[i] = get_u32 (in + 4 * i);
+}
+
+void
+ssp_wire_write_frame (guint8 * out, SspWireType type,
+    const SspWireFrame * frame)
+{
+  put_u64 (out, frame->pts);
+  put_u64 (out + 8, frame->ntp_timestamp);
+  if (type == SSP_WIRE_VIDEO) {
+    put_u32 (out + 16, frame->frm_no);
+    put_u32 (out + 20, frame->type);
+  }
+}
+
+void
+ssp_wire_read_frame (const guint8 * in, SspWireType type,
+    SspWireFrame * frame)
+{
+  frame->pts = get_u64 (in);
+  frame->ntp_timestamp = get_u64 (in + 8);
+  if (type == SSP_WIRE_VIDEO) {
+    frame->frm_no = get_u32 (in + 16);
+    frame->type = get_u32 (in + 20);
+  } else {
+    frame->frm_no = 0;
+    frame->type = 0;
+  }
+}
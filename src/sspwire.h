@@ -0,0 +1,95 @@
+#ifndef __SSP_WIRE_H__
+#define __SSP_WIRE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Stand-in SSP framing spoken by the in-tree native client and the mock
+ * server. Camera SSP is only implemented inside the prebuilt libssp, so
+ * this is not the camera's wire format and libssp cannot connect to the
+ * mock server: it carries exactly what libssp hands to its callbacks.
+ *
+ * Every message is a header of two little-endian u32, type and payload
+ * length, followed by the payload. After connecting the client sends one
+ * HELLO; the server answers with META, repeated whenever the stream
+ * changes, followed by VIDEO and AUDIO frames in sending order. */
+
+#define SSP_WIRE_MAGIC 0x4d505353      /* "SSPM" */
+#define SSP_WIRE_VERSION 1
+
+#define SSP_WIRE_HEADER_SIZE 8
+#define SSP_WIRE_HELLO_SIZE 16
+#define SSP_WIRE_META_SIZE 64
+#define SSP_WIRE_VIDEO_PREFIX_SIZE 24  /* payload starts after it */
+#define SSP_WIRE_AUDIO_PREFIX_SIZE 16
+
+/* Same values as libssp's AUDIO_ENCODER_AAC/PCM, video uses SSP_NAL_CODEC_* */
+#define SSP_WIRE_AUDIO_AAC 37
+#define SSP_WIRE_AUDIO_PCM 23
+
+/* SSP frame type of a keyframe, every other frame is sent as 1 */
+#define SSP_WIRE_FRAME_IDR 5
+
+typedef enum {
+  SSP_WIRE_HELLO = 1,
+  SSP_WIRE_META = 2,
+  SSP_WIRE_VIDEO = 3,
+  SSP_WIRE_AUDIO = 4
+} SspWireType;
+
+typedef struct {
+  guint32 stream_style;
+  guint32 capability;
+} SspWireHello;
+
+typedef struct {
+  guint32 width;
+  guint32 height;
+  guint32 timescale;
+  guint32 unit;
+  guint32 gop;
+  guint32 encoder;
+
+  guint32 audio_timescale;
+  guint32 audio_unit;
+  guint32 sample_rate;
+  guint32 sample_size;
+  guint32 channel;
+  guint32 bitrate;
+  guint32 audio_encoder;
+
+  guint32 pts_is_wall_clock;
+  guint32 tc_drop_frame;
+  guint32 timecode;
+} SspWireMeta;
+
+/* VIDEO and AUDIO payload prefix, frm_no and type are video only */
+typedef struct {
+  guint64 pts;
+  guint64 ntp_timestamp;
+  guint32 frm_no;
+  guint32 type;
+} SspWireFrame;
+
+void ssp_wire_write_header (guint8 * out, SspWireType type, guint32 length);
+/* FALSE for an unknown type */
+gboolean ssp_wire_read_header (const guint8 * in, SspWireType * type,
+    guint32 * length);
+
+void ssp_wire_write_hello (guint8 * out, const SspWireHello * hello);
+/* FALSE unless magic and version match */
+gboolean ssp_wire_read_hello (const guint8 * in, SspWireHello * hello);
+
+void ssp_wire_write_meta (guint8 * out, const SspWireMeta * meta);
+void ssp_wire_read_meta (const guint8 * in, SspWireMeta * meta);
+
+/* SSP_WIRE_VIDEO_PREFIX_SIZE or SSP_WIRE_AUDIO_PREFIX_SIZE bytes */
+void ssp_wire_write_frame (guint8 * out, SspWireType type,
+    const SspWireFrame * frame);
+void ssp_wire_read_frame (const guint8 * in, SspWireType type,
+    SspWireFrame * frame);
+
+G_END_DECLS
+
+#endif /* __SSP_WIRE_H__ */
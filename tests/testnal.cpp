@@ -0,0 +1,233 @@
+// Fixed vectors for the Annex-B scanner and the SPS parser: what a camera
+// can send that a well-formed encoder never would, truncated parameter
+// sets and out of range Exp-Golomb codes, next to the escaping every
+// stream has.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <vector>
+
+#include "sspnal.h"
+#include "sspparamsets.h"
+
+// High profile level 4.0 1920x1080 (1088 cropped by 8), VUI with 1:1 PAR,
+// BT.709 colour and timing 60/(2 * 1): num_units_in_tick = 1 puts
+// 00 00 00 in the RBSP, escaped here as 00 00 03 00.
+static const guint8 sps_1080p[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xda, 0x01, 0xe0, 0x08, 0x9f, 0x97, 0x01, 0x6a,
+    0x02, 0x02, 0x02, 0x80, 0x00, 0x00, 0x03, 0x00, 0x80, 0x00, 0x00, 0x1e, 0x42
+};
+
+// Bytes up to the end of frame_cropping, where the SPS becomes usable
+#define SPS_1080P_MIN_SIZE 11
+
+// The same SPS with seq_parameter_set_id coded with 32 leading zeros
+static const guint8 sps_ue_32_zeros[] = {
+    0x67, 0x64, 0x00, 0x28, 0x00, 0x00, 0x03, 0x00, 0x00, 0x80, 0x00, 0x00,
+    0x03, 0x00, 0x2c, 0xda, 0x01, 0xe0, 0x08, 0x9f, 0x97, 0x01, 0x6a, 0x02,
+    0x02, 0x02, 0x80, 0x00, 0x00, 0x03, 0x00, 0x80, 0x00, 0x00, 0x1e, 0x42
+};
+
+// The same SPS with the largest ue(v), 2^32 - 2, as pic_width_in_mbs_minus1
+static const guint8 sps_ue_max_width[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xda, 0x00, 0x00, 0x03, 0x00, 0x00, 0xff,
+    0xff, 0xff, 0xff, 0x02, 0x27, 0xe5, 0xc0, 0x5a, 0x80, 0x80, 0x80, 0xa0,
+    0x00, 0x00, 0x03, 0x00, 0x20, 0x00, 0x00, 0x07, 0x90, 0x80
+};
+
+static const guint8 pps[] = { 0x68, 0xee, 0x3c, 0x80 };
+static const guint8 idr[] = { 0x65, 0x88, 0x84, 0x21, 0xa0 };
+
+static const guint8 start_code4[] = { 0x00, 0x00, 0x00, 0x01 };
+static const guint8 start_code3[] = { 0x00, 0x00, 0x01 };
+
+static void
+append(std::vector<guint8>& frame, const guint8* data, gsize size)
+{
+    frame.insert(frame.end(), data, data + size);
+}
+
+// SPS behind a 4-byte start code, PPS behind a 3-byte one, then the slice
+static std::vector<guint8>
+make_frame(const guint8* sps, gsize sps_size)
+{
+    std::vector<guint8> frame;
+
+    append(frame, start_code4, sizeof(start_code4));
+    append(frame, sps, sps_size);
+    append(frame, start_code3, sizeof(start_code3));
+    append(frame, pps, sizeof(pps));
+    append(frame, start_code4, sizeof(start_code4));
+    append(frame, idr, sizeof(idr));
+    return frame;
+}
+
+static gboolean
+parse_sps(const guint8* sps, gsize sps_size, SspVideoParams* params)
+{
+    std::vector<guint8> frame;
+    SspNalIndex index;
+
+    append(frame, start_code4, sizeof(start_code4));
+    append(frame, sps, sps_size);
+    ssp_nal_index_build(&index, frame.data(), frame.size(), SSP_NAL_CODEC_H264, TRUE);
+    return ssp_param_sets_parse(&index, frame.data(), params);
+}
+
+// Every position relative to the 16 and 32 byte blocks of the SIMD scans
+static void
+test_find_start_code(void)
+{
+    guint8 buf[100];
+    gsize pos;
+
+    memset(buf, 0xff, sizeof(buf));
+    g_assert_true(ssp_nal_find_start_code(buf, buf + sizeof(buf)) == buf + sizeof(buf));
+
+    for (pos = 0; pos + 3 <= sizeof(buf); pos++) {
+        memset(buf, 0xff, sizeof(buf));
+        memcpy(buf + pos, start_code3, sizeof(start_code3));
+        g_assert_true(ssp_nal_find_start_code(buf, buf + sizeof(buf)) == buf + pos);
+        // Cut one byte short of the 01
+        g_assert_true(ssp_nal_find_start_code(buf, buf + pos + 2) == buf + pos + 2);
+    }
+
+    // Zeros ahead of the start code are not part of it
+    memset(buf, 0x00, sizeof(buf));
+    buf[sizeof(buf) - 1] = 0x01;
+    g_assert_true(ssp_nal_find_start_code(buf, buf + sizeof(buf)) == buf + sizeof(buf) - 3);
+}
+
+static void
+test_index(void)
+{
+    std::vector<guint8> frame = make_frame(sps_1080p, sizeof(sps_1080p));
+    SspNalIndex index;
+
+    ssp_nal_index_build(&index, frame.data(), frame.size(), SSP_NAL_CODEC_UNKNOWN, FALSE);
+    g_assert_cmpuint(index.codec, ==, SSP_NAL_CODEC_H264);
+    g_assert_cmpuint(index.n_units, ==, 3);
+    g_assert_true(index.complete);
+    g_assert_true(index.has_parameter_sets);
+    g_assert_true(index.has_idr);
+
+    g_assert_cmpuint(index.units[0].offset, ==, 4);
+    g_assert_cmpuint(index.units[0].size, ==, sizeof(sps_1080p));
+    g_assert_cmpuint(index.units[0].type, ==, 7);
+    g_assert_cmpuint(index.units[0].start_code_size, ==, 4);
+
+    // The zero ahead of the IDR start code is not counted in the PPS
+    g_assert_cmpuint(index.units[1].offset, ==, 4 + sizeof(sps_1080p) + 3);
+    g_assert_cmpuint(index.units[1].size, ==, sizeof(pps));
+    g_assert_cmpuint(index.units[1].type, ==, 8);
+    g_assert_cmpuint(index.units[1].start_code_size, ==, 3);
+
+    g_assert_cmpuint(index.units[2].offset, ==, frame.size() - sizeof(idr));
+    g_assert_cmpuint(index.units[2].size, ==, sizeof(idr));
+    g_assert_cmpuint(index.units[2].type, ==, 5);
+    g_assert_cmpuint(index.units[2].start_code_size, ==, 4);
+
+    // Stopping at the slice indexes the same units and says so
+    ssp_nal_index_build(&index, frame.data(), frame.size(), SSP_NAL_CODEC_H264, TRUE);
+    g_assert_cmpuint(index.n_units, ==, 3);
+    g_assert_false(index.complete);
+    g_assert_true(index.has_idr);
+
+    // Without parameter sets the codec stays unknown
+    ssp_nal_index_build(&index, frame.data() + index.units[2].offset - 4, 4 + sizeof(idr),
+                        SSP_NAL_CODEC_UNKNOWN, FALSE);
+    g_assert_cmpuint(index.codec, ==, SSP_NAL_CODEC_UNKNOWN);
+    g_assert_cmpuint(index.n_units, ==, 1);
+    g_assert_null(ssp_nal_index_find(&index, 7));
+}
+
+static void
+test_packetized(void)
+{
+    std::vector<guint8> frame = make_frame(sps_1080p, sizeof(sps_1080p));
+    std::vector<guint8> out;
+    gsize size;
+
+    size = ssp_nal_to_packetized(SSP_NAL_CODEC_H264, frame.data(), frame.size(), NULL);
+    g_assert_cmpuint(size, ==, 4 + sizeof(idr));
+
+    out.resize(size);
+    g_assert_cmpuint(ssp_nal_to_packetized(SSP_NAL_CODEC_H264, frame.data(), frame.size(),
+                                           out.data()),
+                     ==, size);
+    g_assert_cmpuint(out[3], ==, sizeof(idr));
+    g_assert_true(memcmp(out.data() + 4, idr, sizeof(idr)) == 0);
+}
+
+static void
+test_sps(void)
+{
+    SspVideoParams params;
+
+    g_assert_true(parse_sps(sps_1080p, sizeof(sps_1080p), &params));
+    g_assert_cmpuint(params.profile_idc, ==, 100);
+    g_assert_cmpuint(params.level_idc, ==, 40);
+    g_assert_cmpuint(params.chroma_format_idc, ==, 1);
+    g_assert_cmpuint(params.bit_depth_luma, ==, 8);
+    g_assert_cmpuint(params.width, ==, 1920);
+    g_assert_cmpuint(params.height, ==, 1080);
+    g_assert_cmpint(params.par_n, ==, 1);
+    g_assert_cmpint(params.par_d, ==, 1);
+    g_assert_true(params.has_colour_description);
+    g_assert_false(params.full_range);
+    g_assert_cmpuint(params.colour_primaries, ==, 1);
+    // Read past the emulation prevention byte, without unescaping this
+    // would be 3/1 fps
+    g_assert_cmpint(params.fps_n, ==, 30);
+    g_assert_cmpint(params.fps_d, ==, 1);
+}
+
+// Every length: nothing before the end of the cropping, dimensions without
+// the timing once that is cut off
+static void
+test_sps_truncated(void)
+{
+    SspVideoParams params;
+    gsize size;
+
+    for (size = 1; size <= sizeof(sps_1080p); size++) {
+        gboolean ok = parse_sps(sps_1080p, size, &params);
+
+        if (size < SPS_1080P_MIN_SIZE) {
+            g_assert_false(ok);
+            continue;
+        }
+        g_assert_true(ok);
+        g_assert_cmpuint(params.width, ==, 1920);
+        g_assert_cmpuint(params.height, ==, 1080);
+        g_assert_cmpint(params.fps_n, ==, size == sizeof(sps_1080p) ? 30 : 0);
+    }
+}
+
+static void
+test_sps_ue_oversized(void)
+{
+    SspVideoParams params;
+
+    g_assert_false(parse_sps(sps_ue_32_zeros, sizeof(sps_ue_32_zeros), &params));
+    g_assert_false(parse_sps(sps_ue_max_width, sizeof(sps_ue_max_width), &params));
+}
+
+int
+main(int argc, char* argv[])
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/nal/find-start-code", test_find_start_code);
+    g_test_add_func("/nal/index", test_index);
+    g_test_add_func("/nal/packetized", test_packetized);
+    g_test_add_func("/paramsets/sps", test_sps);
+    g_test_add_func("/paramsets/sps-truncated", test_sps_truncated);
+    g_test_add_func("/paramsets/sps-ue-oversized", test_sps_ue_oversized);
+
+    return g_test_run();
+}
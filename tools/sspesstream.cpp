@@ -0,0 +1,502 @@
+#include "sspesstream.h"
+
+#include <math.h>
+
+#include "sspnal.h"
+
+// A generated IDR frame is this many times the size of a P frame
+#define IDR_WEIGHT 4
+// H.265 coding blocks are 8x8 at least, the picture is a multiple of that
+#define H265_MIN_CB_SIZE 8
+#define H265_LOG2_MAX_POC_LSB 8
+
+class BitWriter {
+public:
+    BitWriter()
+        : acc_(0)
+        , n_(0)
+    {
+    }
+
+    void put(guint32 value, guint bits)
+    {
+        while (bits--) {
+            acc_ = (acc_ << 1) | ((value >> bits) & 1);
+            if (++n_ == 8) {
+                bytes_.push_back(acc_);
+                acc_ = 0;
+                n_ = 0;
+            }
+        }
+    }
+
+    void ue(guint32 value)
+    {
+        guint32 v = value + 1;
+        guint len = g_bit_storage(v);
+        put(0, len - 1);
+        put(v, len);
+    }
+
+    void se(gint32 value)
+    {
+        ue(value > 0 ? 2 * value - 1 : -2 * value);
+    }
+
+    void trailing()
+    {
+        put(1, 1);
+        while (n_) {
+            put(0, 1);
+        }
+    }
+
+    const std::vector<guint8>& bytes() const { return bytes_; }
+
+private:
+    std::vector<guint8> bytes_;
+    guint8 acc_;
+    guint n_;
+};
+
+// Start code, NAL header and the RBSP with emulation prevention. Every
+// H.264 unit is a reference (nal_ref_idc 3), H.265 units are on layer 0
+// with temporal id 1.
+static void
+append_nal(std::vector<guint8>* out, guint32 codec, guint8 type,
+           const std::vector<guint8>& rbsp)
+{
+    guint zeros = 0;
+
+    out->insert(out->end(), { 0, 0, 0, 1 });
+    if (codec == SSP_NAL_CODEC_H264) {
+        out->push_back(0x60 | type);
+    } else {
+        out->insert(out->end(), { (guint8)(type << 1), 1 });
+    }
+    for (guint8 b : rbsp) {
+        if (zeros >= 2 && b <= 3) {
+            out->push_back(3);
+            zeros = 0;
+        }
+        out->push_back(b);
+        zeros = b ? 0 : zeros + 1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// H.264: constrained baseline, CAVLC, all I or all P slices
+
+static std::vector<guint8>
+h264_sps(guint width, guint height, gdouble fps)
+{
+    BitWriter w;
+    guint mbw = (width + 15) / 16;
+    guint mbh = (height + 15) / 16;
+
+    w.put(66, 8);                  // baseline
+    w.put(0xc0, 8);                // constraint_set0/1
+    w.put(51, 8);                  // level 5.1
+    w.ue(0);                       // seq_parameter_set_id
+    w.ue(0);                       // log2_max_frame_num_minus4
+    w.ue(2);                       // pic_order_cnt_type
+    w.ue(1);                       // max_num_ref_frames
+    w.put(0, 1);
+    w.ue(mbw - 1);
+    w.ue(mbh - 1);
+    w.put(1, 1);                   // frame_mbs_only_flag
+    w.put(1, 1);                   // direct_8x8_inference_flag
+    if (mbw * 16 != width || mbh * 16 != height) {
+        w.put(1, 1);               // cropping in 2 pixel units for 4:2:0
+        w.ue(0);
+        w.ue((mbw * 16 - width) / 2);
+        w.ue(0);
+        w.ue((mbh * 16 - height) / 2);
+    } else {
+        w.put(0, 1);
+    }
+    w.put(1, 1);                   // vui_parameters_present_flag
+    w.put(0, 4);                   // aspect ratio, overscan, signal type, chroma loc
+    w.put(1, 1);                   // timing_info_present_flag
+    w.put(1000, 32);               // num_units_in_tick
+    w.put((guint32)llround(fps * 2000), 32);
+    w.put(1, 1);                   // fixed_frame_rate_flag
+    w.put(0, 3);                   // hrd, pic_struct, bitstream_restriction
+    w.trailing();
+    return w.bytes();
+}
+
+static std::vector<guint8>
+h264_pps()
+{
+    BitWriter w;
+
+    w.ue(0);                       // pic_parameter_set_id
+    w.ue(0);                       // seq_parameter_set_id
+    w.put(0, 2);                   // CAVLC, no bottom field pic order
+    w.ue(0);                       // num_slice_groups_minus1
+    w.ue(0);
+    w.ue(0);
+    w.put(0, 3);                   // weighted prediction
+    w.se(0);
+    w.se(0);
+    w.se(0);
+    w.put(1, 1);                   // deblocking_filter_control_present_flag
+    w.put(0, 2);
+    w.trailing();
+    return w.bytes();
+}
+
+static std::vector<guint8>
+h264_slice_header(gboolean idr, guint frame_num, guint idr_pic_id)
+{
+    BitWriter w;
+
+    w.ue(0);                       // first_mb_in_slice
+    w.ue(idr ? 7 : 5);             // all I or all P
+    w.ue(0);                       // pic_parameter_set_id
+    w.put(frame_num % 16, 4);
+    if (idr) {
+        w.ue(idr_pic_id);
+        w.put(0, 2);               // no_output_of_prior_pics, long_term_reference
+    } else {
+        w.put(0, 2);               // num_ref_idx_override, ref_pic_list_modification
+        w.put(0, 1);               // adaptive_ref_pic_marking_mode_flag
+    }
+    w.se(0);                       // slice_qp_delta
+    w.ue(1);                       // disable_deblocking_filter_idc
+    w.trailing();
+    return w.bytes();
+}
+
+// ---------------------------------------------------------------------------
+// H.265: Main 10 4:2:0 like the cameras, one slice per picture, IDR_W_RADL
+// and TRAIL_R pictures
+
+static void
+h265_profile_tier_level(BitWriter* w)
+{
+    w->put(0, 2);                  // general_profile_space
+    w->put(0, 1);                  // general_tier_flag
+    w->put(2, 5);                  // Main 10
+    w->put(0x60000000, 32);        // compatible with Main and Main 10
+    w->put(0x9, 4);                // progressive, frame only
+    w->put(0, 32);                 // 43 reserved bits and general_inbld_flag
+    w->put(0, 12);
+    w->put(153, 8);                // level 5.1
+}
+
+static std::vector<guint8>
+h265_vps(gdouble fps)
+{
+    BitWriter w;
+
+    w.put(0, 4);                   // vps_video_parameter_set_id
+    w.put(3, 2);                   // base layer internal and available
+    w.put(0, 6);                   // vps_max_layers_minus1
+    w.put(0, 3);                   // vps_max_sub_layers_minus1
+    w.put(1, 1);                   // vps_temporal_id_nesting_flag
+    w.put(0xffff, 16);
+    h265_profile_tier_level(&w);
+    w.put(1, 1);                   // vps_sub_layer_ordering_info_present_flag
+    w.ue(1);                       // max_dec_pic_buffering_minus1
+    w.ue(0);                       // max_num_reorder_pics
+    w.ue(0);                       // max_latency_increase_plus1
+    w.put(0, 6);                   // vps_max_layer_id
+    w.ue(0);                       // vps_num_layer_sets_minus1
+    w.put(1, 1);                   // vps_timing_info_present_flag
+    w.put(1000, 32);
+    w.put((guint32)llround(fps * 1000), 32);
+    w.put(0, 1);                   // vps_poc_proportional_to_timing_flag
+    w.ue(0);                       // vps_num_hrd_parameters
+    w.put(0, 1);                   // vps_extension_flag
+    w.trailing();
+    return w.bytes();
+}
+
+static std::vector<guint8>
+h265_sps(guint width, guint height, gdouble fps)
+{
+    BitWriter w;
+    guint coded_width = (width + H265_MIN_CB_SIZE - 1) / H265_MIN_CB_SIZE * H265_MIN_CB_SIZE;
+    guint coded_height = (height + H265_MIN_CB_SIZE - 1) / H265_MIN_CB_SIZE * H265_MIN_CB_SIZE;
+
+    w.put(0, 4);                   // sps_video_parameter_set_id
+    w.put(0, 3);                   // sps_max_sub_layers_minus1
+    w.put(1, 1);                   // sps_temporal_id_nesting_flag
+    h265_profile_tier_level(&w);
+    w.ue(0);                       // sps_seq_parameter_set_id
+    w.ue(1);                       // chroma_format_idc 4:2:0
+    w.ue(coded_width);
+    w.ue(coded_height);
+    if (coded_width != width || coded_height != height) {
+        w.put(1, 1);               // conformance window in 2 pixel units
+        w.ue(0);
+        w.ue((coded_width - width) / 2);
+        w.ue(0);
+        w.ue((coded_height - height) / 2);
+    } else {
+        w.put(0, 1);
+    }
+    w.ue(2);                       // bit_depth_luma_minus8
+    w.ue(2);                       // bit_depth_chroma_minus8
+    w.ue(H265_LOG2_MAX_POC_LSB - 4);
+    w.put(1, 1);                   // sps_sub_layer_ordering_info_present_flag
+    w.ue(1);
+    w.ue(0);
+    w.ue(0);
+    w.ue(0);                       // 8x8 minimum coding block
+    w.ue(3);                       // 64x64 CTB
+    w.ue(0);                       // 4x4 minimum transform block
+    w.ue(3);                       // 32x32 maximum transform block
+    w.ue(0);                       // max_transform_hierarchy_depth_inter
+    w.ue(0);                       // max_transform_hierarchy_depth_intra
+    w.put(0, 1);                   // scaling_list_enabled_flag
+    w.put(0, 2);                   // amp, sample_adaptive_offset
+    w.put(0, 1);                   // pcm_enabled_flag
+    w.ue(0);                       // num_short_term_ref_pic_sets
+    w.put(0, 1);                   // long_term_ref_pics_present_flag
+    w.put(0, 2);                   // temporal_mvp, strong_intra_smoothing
+    w.put(1, 1);                   // vui_parameters_present_flag
+    w.put(1, 1);                   // aspect_ratio_info_present_flag
+    w.put(1, 8);                   // 1:1
+    w.put(0, 1);                   // overscan_info_present_flag
+    w.put(1, 1);                   // video_signal_type_present_flag
+    w.put(5, 3);                   // unspecified video_format
+    w.put(0, 1);                   // limited range
+    w.put(1, 1);                   // colour_description_present_flag
+    w.put(1, 8);                   // BT.709 primaries, transfer, matrix
+    w.put(1, 8);
+    w.put(1, 8);
+    w.put(0, 1);                   // chroma_loc_info_present_flag
+    w.put(0, 3);                   // neutral_chroma, field_seq, frame_field_info
+    w.put(0, 1);                   // default_display_window_flag
+    w.put(1, 1);                   // vui_timing_info_present_flag
+    w.put(1000, 32);
+    w.put((guint32)llround(fps * 1000), 32);
+    w.put(0, 1);                   // vui_poc_proportional_to_timing_flag
+    w.put(0, 1);                   // vui_hrd_parameters_present_flag
+    w.put(0, 1);                   // bitstream_restriction_flag
+    w.put(0, 1);                   // sps_extension_present_flag
+    w.trailing();
+    return w.bytes();
+}
+
+static std::vector<guint8>
+h265_pps()
+{
+    BitWriter w;
+
+    w.ue(0);                       // pps_pic_parameter_set_id
+    w.ue(0);                       // pps_seq_parameter_set_id
+    w.put(0, 2);                   // dependent slices, output_flag_present
+    w.put(0, 3);                   // num_extra_slice_header_bits
+    w.put(0, 2);                   // sign_data_hiding, cabac_init_present
+    w.ue(0);                       // num_ref_idx_l0_default_active_minus1
+    w.ue(0);                       // num_ref_idx_l1_default_active_minus1
+    w.se(0);                       // init_qp_minus26
+    w.put(0, 3);                   // constrained_intra_pred, transform_skip, cu_qp_delta
+    w.se(0);                       // pps_cb_qp_offset
+    w.se(0);                       // pps_cr_qp_offset
+    w.put(0, 4);                   // chroma qp offsets, weighted pred/bipred, transquant bypass
+    w.put(0, 2);                   // tiles, entropy_coding_sync
+    w.put(0, 1);                   // pps_loop_filter_across_slices_enabled_flag
+    w.put(0, 1);                   // deblocking_filter_control_present_flag
+    w.put(0, 2);                   // scaling list data, lists_modification_present
+    w.ue(0);                       // log2_parallel_merge_level_minus2
+    w.put(0, 2);                   // slice header extension, pps_extension_present
+    w.trailing();
+    return w.bytes();
+}
+
+// Each P picture references the previous one through an explicit
+// short-term RPS, the SPS has none
+static std::vector<guint8>
+h265_slice_header(gboolean idr, guint poc)
+{
+    BitWriter w;
+
+    w.put(1, 1);                   // first_slice_segment_in_pic_flag
+    if (idr) {
+        w.put(0, 1);               // no_output_of_prior_pics_flag
+    }
+    w.ue(0);                       // slice_pic_parameter_set_id
+    w.ue(idr ? 2 : 1);             // I or P
+    if (!idr) {
+        w.put(poc % (1 << H265_LOG2_MAX_POC_LSB), H265_LOG2_MAX_POC_LSB);
+        w.put(0, 1);               // short_term_ref_pic_set_sps_flag
+        w.ue(1);                   // num_negative_pics
+        w.ue(0);                   // num_positive_pics
+        w.ue(0);                   // delta_poc_s0_minus1
+        w.put(1, 1);               // used_by_curr_pic_s0_flag
+        w.put(0, 1);               // num_ref_idx_active_override_flag
+        w.ue(0);                   // five_minus_max_num_merge_cand
+    }
+    w.se(0);                       // slice_qp_delta
+    w.trailing();                  // byte_alignment()
+    return w.bytes();
+}
+
+void
+ssp_es_generate(const SspEsParams& params, GRand* rand, SspEsStream* stream)
+{
+    gboolean h264 = params.codec == SSP_NAL_CODEC_H264;
+    guint64 avg = MAX(params.bitrate / 8 / params.fps, 64);
+    guint64 p_size = avg * params.gop / (IDR_WEIGHT + params.gop - 1);
+    std::vector<guint8>& out = stream->data;
+
+    for (guint g = 0; g < 2; g++) {
+        for (guint i = 0; i < params.gop; i++) {
+            gboolean idr = i == 0;
+            gsize start = out.size();
+            gsize target = idr ? p_size * IDR_WEIGHT : p_size;
+            std::vector<guint8> slice;
+
+            if (h264) {
+                out.insert(out.end(), { 0, 0, 0, 1, 0x09, 0xf0 });
+                if (idr) {
+                    append_nal(&out, params.codec, 7, h264_sps(params.width, params.height,
+                                                               params.fps));
+                    append_nal(&out, params.codec, 8, h264_pps());
+                }
+                slice = h264_slice_header(idr, i, g);
+            } else {
+                out.insert(out.end(), { 0, 0, 0, 1, 0x46, 0x01, 0x50 });
+                if (idr) {
+                    append_nal(&out, params.codec, 32, h265_vps(params.fps));
+                    append_nal(&out, params.codec, 33, h265_sps(params.width, params.height,
+                                                                params.fps));
+                    append_nal(&out, params.codec, 34, h265_pps());
+                }
+                slice = h265_slice_header(idr, i);
+            }
+            // Never zero, so the noise cannot form a start code
+            while (out.size() - start + 6 + slice.size() < target) {
+                slice.push_back(g_rand_int_range(rand, 1, 256));
+            }
+            append_nal(&out, params.codec, h264 ? (idr ? 5 : 1) : (idr ? 19 : 1), slice);
+            stream->frames.push_back({ start, out.size() - start, idr });
+        }
+    }
+    stream->codec = params.codec;
+    stream->gop = params.gop;
+}
+
+// ---------------------------------------------------------------------------
+// Annex-B files
+
+static guint32
+detect_codec(const guint8* data, gsize size)
+{
+    const guint8* end = data + size;
+    const guint8* p = ssp_nal_find_start_code(data, end);
+
+    for (; p < end; p = ssp_nal_find_start_code(p + 3, end)) {
+        guint8 header;
+
+        if (p + 3 >= end) {
+            break;
+        }
+        header = p[3];
+        if ((header & 0x1f) == 7 || (header & 0x1f) == 9) {
+            return SSP_NAL_CODEC_H264;
+        }
+        if (((header >> 1) & 0x3f) == 32 || ((header >> 1) & 0x3f) == 35) {
+            return SSP_NAL_CODEC_H265;
+        }
+    }
+    return SSP_NAL_CODEC_UNKNOWN;
+}
+
+// Whether a NAL unit opens a new access unit once the current one has a
+// slice: delimiters, parameter sets, prefix SEI, or the first slice of a
+// picture
+static gboolean
+starts_access_unit(guint32 codec, const guint8* nal, gsize size)
+{
+    guint8 type = ssp_nal_type(codec, nal[0]);
+    guint header_size = codec == SSP_NAL_CODEC_H264 ? 1 : 2;
+
+    if (ssp_nal_is_vcl(codec, type)) {
+        // first_mb_in_slice == 0 or first_slice_segment_in_pic_flag
+        return size > header_size && (nal[header_size] & 0x80);
+    }
+    if (codec == SSP_NAL_CODEC_H264) {
+        return type == 6 || type == 7 || type == 8 || type == 9 ||
+            (type >= 14 && type <= 18);
+    }
+    return (type >= 32 && type <= 35) || type == 39 ||
+        (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+}
+
+gboolean
+ssp_es_load(const gchar* path, SspEsStream* stream, GError** error)
+{
+    gchar* contents;
+    gsize size;
+
+    if (!g_file_get_contents(path, &contents, &size, error)) {
+        return FALSE;
+    }
+    stream->data.assign((guint8*)contents, (guint8*)contents + size);
+    g_free(contents);
+
+    const guint8* data = stream->data.data();
+    const guint8* end = data + size;
+    guint32 codec = detect_codec(data, size);
+
+    if (codec == SSP_NAL_CODEC_UNKNOWN) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                    "%s is not an H.264/H.265 Annex-B stream", path);
+        return FALSE;
+    }
+
+    const guint8* au_start = nullptr;
+    gboolean has_vcl = FALSE, keyframe = FALSE;
+    gint last_key = -1;
+
+    stream->frames.clear();
+    stream->gop = 0;
+    for (const guint8* p = ssp_nal_find_start_code(data, end); p < end;) {
+        const guint8* nal = p + 3;
+        const guint8* next = ssp_nal_find_start_code(nal, end);
+        // A 4-byte start code leaves its leading zero on the previous unit
+        gsize nal_size = next - nal;
+        const guint8* start = (p > data && p[-1] == 0) ? p - 1 : p;
+
+        if (nal < end) {
+            guint8 type = ssp_nal_type(codec, nal[0]);
+
+            if (!au_start || (has_vcl && starts_access_unit(codec, nal, nal_size))) {
+                if (au_start && has_vcl) {
+                    if (keyframe) {
+                        if (last_key >= 0 && stream->gop == 0) {
+                            stream->gop = stream->frames.size() - last_key;
+                        }
+                        last_key = stream->frames.size();
+                    }
+                    stream->frames.push_back({ (gsize)(au_start - data),
+                                               (gsize)(start - au_start), keyframe });
+                }
+                au_start = start;
+                has_vcl = FALSE;
+                keyframe = FALSE;
+            }
+            if (ssp_nal_is_vcl(codec, type)) {
+                has_vcl = TRUE;
+                keyframe |= ssp_nal_is_idr(codec, type);
+            }
+        }
+        p = next;
+    }
+    if (au_start && has_vcl) {
+        stream->frames.push_back({ (gsize)(au_start - data), (gsize)(end - au_start), keyframe });
+    }
+
+    if (stream->frames.empty()) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "No frames in %s", path);
+        return FALSE;
+    }
+    stream->codec = codec;
+    return TRUE;
+}
@@ -0,0 +1,42 @@
+#ifndef __SSP_ES_STREAM_H__
+#define __SSP_ES_STREAM_H__
+
+#include <glib.h>
+#include <vector>
+
+// H.264/H.265 elementary streams split into access units, for the mock
+// server and the benchmarks
+
+struct SspEsFrame {
+    gsize offset;               // into SspEsStream.data
+    gsize size;
+    gboolean keyframe;
+};
+
+struct SspEsStream {
+    guint32 codec;              // SSP_NAL_CODEC_H264 or SSP_NAL_CODEC_H265
+    guint gop;                  // 0 when a file has a single keyframe
+    std::vector<guint8> data;
+    std::vector<SspEsFrame> frames;
+};
+
+struct SspEsParams {
+    guint32 codec;
+    guint width;
+    guint height;
+    gdouble fps;
+    gint64 bitrate;             // sets the average frame size
+    guint gop;
+};
+
+// Two GOPs of generated access units, so consecutive IDRs differ. Parameter
+// sets, delimiters and slice headers are valid, slice data is noise:
+// parsers and sspsrc accept it, decoders do not. H.264 is constrained
+// baseline, H.265 Main 10 like the cameras. Keyframes carry the parameter
+// sets and are four times the size of the other frames.
+void ssp_es_generate(const SspEsParams& params, GRand* rand, SspEsStream* stream);
+
+// Split an Annex-B file at access unit boundaries, detecting the codec
+gboolean ssp_es_load(const gchar* path, SspEsStream* stream, GError** error);
+
+#endif /* __SSP_ES_STREAM_H__ */
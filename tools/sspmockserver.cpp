@@ -0,0 +1,596 @@
+// Mock SSP server. Serves an H.264/H.265 elementary stream, or a generated
+// one, plus optional AAC/PCM audio in the stand-in framing of
+// src/sspwire.h, so sspsrc built with -Dssp_client=native runs without a
+// camera; libssp cannot connect to it. Frame rate, bitrate, GOP,
+// resolution, send jitter, bursts and disconnects are configurable.
+
+#include <glib.h>
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "sspnal.h"
+#include "sspesstream.h"
+#include "sspwire.h"
+
+#define NTP_UNIX_OFFSET G_GUINT64_CONSTANT(2208988800)
+#define HELLO_TIMEOUT_MS 5000
+#define PCM_FRAME_SAMPLES 1024
+#define AAC_FRAME_SAMPLES 1024
+
+struct MockOptions {
+    gchar* bind;
+    gint port;
+    gchar* video;
+    gchar* codec;
+    gchar* audio;
+    gchar* audio_codec;
+    gint audio_rate;
+    gint audio_channels;
+    gdouble fps;
+    gint64 bitrate;
+    gint gop;
+    gint width;
+    gint height;
+    gdouble jitter_ms;
+    gint burst;
+    gint disconnect_after;
+    gboolean ntp;
+    gint seed;
+};
+
+struct Frame {
+    const guint8* data;
+    gsize size;
+    gboolean keyframe;
+};
+
+struct Stream {
+    guint32 codec;
+    guint32 gop;
+    std::vector<Frame> video;
+    SspEsStream es;
+
+    guint32 audio_codec;
+    guint32 sample_rate;
+    guint32 channels;
+    guint32 audio_frame_samples;
+    guint32 audio_bitrate;
+    std::vector<Frame> audio;
+    std::vector<guint8> audio_storage;
+};
+
+static MockOptions opts;
+static Stream stream;
+
+// ---------------------------------------------------------------------------
+// Video, generated or from a file, see sspesstream.h
+
+static void
+use_es()
+{
+    for (const SspEsFrame& frame : stream.es.frames) {
+        stream.video.push_back({ stream.es.data.data() + frame.offset, frame.size,
+                                 frame.keyframe });
+    }
+    stream.codec = stream.es.codec;
+    stream.gop = stream.es.gop ? stream.es.gop : opts.gop;
+}
+
+static void
+generate_video(guint32 codec, GRand* rand)
+{
+    SspEsParams params = { codec, (guint)opts.width, (guint)opts.height, opts.fps,
+                           opts.bitrate, (guint)opts.gop };
+
+    ssp_es_generate(params, rand, &stream.es);
+    use_es();
+}
+
+static gboolean
+load_video(const gchar* path, GError** error)
+{
+    if (!ssp_es_load(path, &stream.es, error)) {
+        return FALSE;
+    }
+    use_es();
+    return TRUE;
+}
+
+// ---------------------------------------------------------------------------
+// Audio files
+
+static gboolean
+load_aac(const gchar* path, GError** error)
+{
+    static const guint32 rates[] = {
+        96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+    };
+    gchar* contents;
+    gsize size, pos = 0, payload = 0;
+    std::vector<std::pair<gsize, gsize>> ranges;
+
+    if (!g_file_get_contents(path, &contents, &size, error)) {
+        return FALSE;
+    }
+    stream.audio_storage.assign((guint8*)contents, (guint8*)contents + size);
+    g_free(contents);
+
+    const guint8* d = stream.audio_storage.data();
+    while (pos + 7 <= size && d[pos] == 0xff && (d[pos + 1] & 0xf0) == 0xf0) {
+        const guint8* h = d + pos;
+        guint header = (h[1] & 1) ? 7 : 9;
+        gsize length = ((h[3] & 3) << 11) | (h[4] << 3) | (h[5] >> 5);
+
+        if (length <= header || pos + length > size) {
+            break;
+        }
+        if (ranges.empty()) {
+            guint index = (h[2] >> 2) & 0xf;
+            stream.sample_rate = index < G_N_ELEMENTS(rates) ? rates[index] : 48000;
+            stream.channels = ((h[2] & 1) << 2) | (h[3] >> 6);
+        }
+        // sspsrc announces raw AAC, the ADTS header stays behind
+        ranges.push_back({ pos + header, length - header });
+        payload += length - header;
+        pos += length;
+    }
+
+    if (ranges.empty()) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not an ADTS AAC stream", path);
+        return FALSE;
+    }
+    for (auto& r : ranges) {
+        stream.audio.push_back({ d + r.first, r.second, TRUE });
+    }
+    stream.audio_codec = SSP_WIRE_AUDIO_AAC;
+    stream.audio_frame_samples = AAC_FRAME_SAMPLES;
+    stream.audio_bitrate = (guint64)payload * 8 * stream.sample_rate /
+        (ranges.size() * AAC_FRAME_SAMPLES);
+    return TRUE;
+}
+
+// S16LE from a file, or a 1 kHz tone without one
+static gboolean
+load_pcm(const gchar* path, GError** error)
+{
+    gsize frame_size = PCM_FRAME_SAMPLES * opts.audio_channels * 2;
+
+    stream.sample_rate = opts.audio_rate;
+    stream.channels = opts.audio_channels;
+
+    if (path) {
+        gchar* contents;
+        gsize size;
+
+        if (!g_file_get_contents(path, &contents, &size, error)) {
+            return FALSE;
+        }
+        stream.audio_storage.assign((guint8*)contents, (guint8*)contents + size);
+        g_free(contents);
+    } else {
+        // One second, a whole number of tone periods
+        gsize n_frames = (opts.audio_rate + PCM_FRAME_SAMPLES - 1) / PCM_FRAME_SAMPLES;
+        stream.audio_storage.resize(n_frames * frame_size);
+        gint16* s = (gint16*)stream.audio_storage.data();
+        for (gsize i = 0; i < n_frames * PCM_FRAME_SAMPLES; i++) {
+            gint16 v = GINT16_TO_LE((gint16)(8000 * sin(2 * G_PI * 1000 * i / opts.audio_rate)));
+            for (gint c = 0; c < opts.audio_channels; c++) {
+                *s++ = v;
+            }
+        }
+    }
+
+    for (gsize pos = 0; pos + frame_size <= stream.audio_storage.size(); pos += frame_size) {
+        stream.audio.push_back({ stream.audio_storage.data() + pos, frame_size, TRUE });
+    }
+    if (stream.audio.empty()) {
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s holds less than one frame", path);
+        return FALSE;
+    }
+    stream.audio_codec = SSP_WIRE_AUDIO_PCM;
+    stream.audio_frame_samples = PCM_FRAME_SAMPLES;
+    stream.audio_bitrate = opts.audio_rate * opts.audio_channels * 16;
+    return TRUE;
+}
+
+// ---------------------------------------------------------------------------
+// Connections
+
+static guint64
+ntp_now()
+{
+    gint64 us = g_get_real_time();
+    guint64 seconds = us / G_USEC_PER_SEC + NTP_UNIX_OFFSET;
+    guint64 fraction = ((guint64)(us % G_USEC_PER_SEC) << 32) / G_USEC_PER_SEC;
+
+    return (seconds << 32) | fraction;
+}
+
+static gboolean
+send_all(gint fd, struct iovec* iov, gint n)
+{
+    while (n > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        while (n > 0 && (gsize)sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (guint8*)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return TRUE;
+}
+
+static gboolean
+send_meta(gint fd, guint32 timescale, guint32 unit)
+{
+    guint8 msg[SSP_WIRE_HEADER_SIZE + SSP_WIRE_META_SIZE];
+    SspWireMeta meta;
+    struct iovec iov = { msg, sizeof(msg) };
+
+    memset(&meta, 0, sizeof(meta));
+    meta.width = opts.width;
+    meta.height = opts.height;
+    meta.timescale = timescale;
+    meta.unit = unit;
+    meta.gop = stream.gop;
+    meta.encoder = stream.codec;
+    if (!stream.audio.empty()) {
+        meta.audio_timescale = stream.sample_rate;
+        meta.audio_unit = stream.audio_frame_samples;
+        meta.sample_rate = stream.sample_rate;
+        meta.sample_size = 16;
+        meta.channel = stream.channels;
+        meta.bitrate = stream.audio_bitrate;
+        meta.audio_encoder = stream.audio_codec;
+    }
+
+    ssp_wire_write_header(msg, SSP_WIRE_META, SSP_WIRE_META_SIZE);
+    ssp_wire_write_meta(msg + SSP_WIRE_HEADER_SIZE, &meta);
+    return send_all(fd, &iov, 1);
+}
+
+// Filler data NAL unit of about size bytes
+static void
+make_filler(guint32 codec, gsize size, std::vector<guint8>* out)
+{
+    out->clear();
+    if (size < 8) {
+        return;
+    }
+    if (codec == SSP_NAL_CODEC_H264) {
+        out->insert(out->end(), { 0, 0, 0, 1, 0x0c });
+    } else {
+        out->insert(out->end(), { 0, 0, 0, 1, 0x4c, 0x01 });
+    }
+    out->resize(size - 1, 0xff);
+    out->push_back(0x80);
+}
+
+static gboolean
+wait_hello(gint fd, SspWireHello* hello)
+{
+    guint8 msg[SSP_WIRE_HEADER_SIZE + SSP_WIRE_HELLO_SIZE];
+    gsize got = 0;
+    SspWireType type;
+    guint32 length;
+
+    while (got < sizeof(msg)) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, HELLO_TIMEOUT_MS) <= 0) {
+            return FALSE;
+        }
+        ssize_t n = recv(fd, msg + got, sizeof(msg) - got, 0);
+        if (n <= 0) {
+            return FALSE;
+        }
+        got += n;
+    }
+
+    return ssp_wire_read_header(msg, &type, &length) && type == SSP_WIRE_HELLO &&
+        length == SSP_WIRE_HELLO_SIZE && ssp_wire_read_hello(msg + SSP_WIRE_HEADER_SIZE, hello);
+}
+
+static void
+sleep_until(gint64 deadline)
+{
+    gint64 now = g_get_monotonic_time();
+
+    if (deadline > now) {
+        g_usleep(deadline - now);
+    }
+}
+
+// Video frames go out at their nominal time plus up to jitter_ms, held back
+// and sent together in groups of burst. Audio follows its own cadence.
+static void
+serve(gint fd, guint id)
+{
+    guint32 timescale = (guint32)llround(opts.fps * 1000);
+    guint32 unit = 1000;
+    gint64 frame_us = (gint64)(G_USEC_PER_SEC / opts.fps);
+    gint64 audio_us = stream.audio.empty() ? 0 :
+        (gint64)stream.audio_frame_samples * G_USEC_PER_SEC / stream.sample_rate;
+    guint64 bytes_per_frame = opts.bitrate / 8 / opts.fps;
+    GRand* rand = g_rand_new_with_seed(opts.seed + id);
+    std::vector<guint8> filler;
+    guint64 vi = 0, ai = 0, video_bytes = 0;
+    gint64 start, video_due, last_due = 0;
+    SspWireHello hello;
+
+    if (!wait_hello(fd, &hello)) {
+        g_printerr("client %u: no valid hello, closing\n", id);
+        g_rand_free(rand);
+        return;
+    }
+    g_print("client %u: stream style %u, capability 0x%x\n", id, hello.stream_style,
+            hello.capability);
+
+    if (!send_meta(fd, timescale, unit)) {
+        g_rand_free(rand);
+        return;
+    }
+
+    start = g_get_monotonic_time();
+    for (;;) {
+        // The whole burst waits for the nominal time of its last frame
+        guint64 group_end = (vi / opts.burst) * opts.burst + opts.burst - 1;
+        video_due = start + group_end * frame_us;
+        if (opts.jitter_ms > 0) {
+            video_due += (gint64)(g_rand_double(rand) * opts.jitter_ms * 1000);
+        }
+        video_due = MAX(video_due, last_due);
+
+        while (audio_us && start + (gint64)ai * audio_us <= video_due) {
+            const Frame& a = stream.audio[ai % stream.audio.size()];
+            guint8 prefix[SSP_WIRE_HEADER_SIZE + SSP_WIRE_AUDIO_PREFIX_SIZE];
+            SspWireFrame f = { ai * stream.audio_frame_samples, opts.ntp ? ntp_now() : 0, 0, 0 };
+            struct iovec iov[2] = { { prefix, sizeof(prefix) }, { (void*)a.data, a.size } };
+
+            sleep_until(start + ai * audio_us);
+            ssp_wire_write_header(prefix, SSP_WIRE_AUDIO, SSP_WIRE_AUDIO_PREFIX_SIZE + a.size);
+            ssp_wire_write_frame(prefix + SSP_WIRE_HEADER_SIZE, SSP_WIRE_AUDIO, &f);
+            if (!send_all(fd, iov, 2)) {
+                goto done;
+            }
+            ai++;
+        }
+
+        sleep_until(video_due);
+        last_due = video_due;
+
+        const Frame& v = stream.video[vi % stream.video.size()];
+        guint8 prefix[SSP_WIRE_HEADER_SIZE + SSP_WIRE_VIDEO_PREFIX_SIZE];
+        SspWireFrame f = { vi * unit, opts.ntp ? ntp_now() : 0, (guint32)vi,
+                           v.keyframe ? (guint32)SSP_WIRE_FRAME_IDR : 1 };
+
+        // Pad up to the average bitrate when the stream runs below it
+        filler.clear();
+        if (bytes_per_frame && opts.video) {
+            guint64 target = (vi + 1) * bytes_per_frame;
+            if (target > video_bytes + v.size) {
+                make_filler(stream.codec, target - video_bytes - v.size, &filler);
+            }
+        }
+        video_bytes += v.size + filler.size();
+
+        struct iovec iov[3] = { { prefix, sizeof(prefix) }, { (void*)v.data, v.size },
+                                { filler.data(), filler.size() } };
+        ssp_wire_write_header(prefix, SSP_WIRE_VIDEO,
+                              SSP_WIRE_VIDEO_PREFIX_SIZE + v.size + filler.size());
+        ssp_wire_write_frame(prefix + SSP_WIRE_HEADER_SIZE, SSP_WIRE_VIDEO, &f);
+        if (!send_all(fd, iov, filler.empty() ? 2 : 3)) {
+            goto done;
+        }
+        vi++;
+
+        if (opts.disconnect_after && vi >= (guint64)opts.disconnect_after) {
+            g_print("client %u: disconnecting after %" G_GUINT64_FORMAT " frames\n", id, vi);
+            break;
+        }
+    }
+
+done:
+    g_print("client %u: sent %" G_GUINT64_FORMAT " video and %" G_GUINT64_FORMAT
+            " audio frames\n", id, vi, ai);
+    g_rand_free(rand);
+}
+
+static gpointer
+connection_thread(gpointer data)
+{
+    static gint next_id = 0;
+    gint fd = GPOINTER_TO_INT(data);
+    guint id = g_atomic_int_add(&next_id, 1);
+
+    serve(fd, id);
+    close(fd);
+    return nullptr;
+}
+
+static gint
+listen_on(const gchar* host, gint port)
+{
+    struct addrinfo hints, *res = nullptr;
+    gchar service[8];
+    gint fd, one = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    g_snprintf(service, sizeof(service), "%d", port);
+
+    if (getaddrinfo(host, service, &hints, &res) != 0) {
+        return -1;
+    }
+    fd = socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, res->ai_addr, res->ai_addrlen) != 0 || listen(fd, 64) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int
+main(int argc, char** argv)
+{
+    GError* error = nullptr;
+    gint listen_fd;
+
+    opts.bind = g_strdup("127.0.0.1");
+    opts.port = 9999;
+    opts.audio_codec = nullptr;
+    opts.audio_rate = 48000;
+    opts.audio_channels = 2;
+    opts.fps = 30.0;
+    opts.bitrate = 0;
+    opts.gop = 30;
+    opts.width = 1920;
+    opts.height = 1080;
+    opts.burst = 1;
+    opts.seed = 1;
+
+    GOptionEntry entries[] = {
+        { "bind", 'b', 0, G_OPTION_ARG_STRING, &opts.bind, "Address to listen on (127.0.0.1)", "ADDR" },
+        { "port", 'p', 0, G_OPTION_ARG_INT, &opts.port, "Port to listen on, 0 for any free one (9999)", "PORT" },
+        { "video", 'v', 0, G_OPTION_ARG_FILENAME, &opts.video,
+          "H.264/H.265 Annex-B stream to loop, generated without", "FILE" },
+        { "codec", 'c', 0, G_OPTION_ARG_STRING, &opts.codec,
+          "Codec of the generated stream, h264 or h265 (h264)", "CODEC" },
+        { "audio", 'a', 0, G_OPTION_ARG_FILENAME, &opts.audio,
+          "ADTS AAC stream, or S16LE with --audio-codec=pcm", "FILE" },
+        { "audio-codec", 0, 0, G_OPTION_ARG_STRING, &opts.audio_codec,
+          "aac or pcm, pcm without --audio sends a 1 kHz tone", "CODEC" },
+        { "audio-rate", 0, 0, G_OPTION_ARG_INT, &opts.audio_rate, "PCM sample rate (48000)", "HZ" },
+        { "audio-channels", 0, 0, G_OPTION_ARG_INT, &opts.audio_channels, "PCM channels (2)", "N" },
+        { "fps", 'f', 0, G_OPTION_ARG_DOUBLE, &opts.fps, "Video frame rate (30)", "FPS" },
+        { "bitrate", 'r', 0, G_OPTION_ARG_INT64, &opts.bitrate,
+          "Video bits/s: generated frame size, or filler padding for a file (20000000 generated, "
+          "file rate otherwise)", "BPS" },
+        { "gop", 'g', 0, G_OPTION_ARG_INT, &opts.gop,
+          "Frames per GOP of the generated stream, reported GOP when a file has one keyframe (30)", "N" },
+        { "width", 'W', 0, G_OPTION_ARG_INT, &opts.width, "Reported and generated width (1920)", "PX" },
+        { "height", 'H', 0, G_OPTION_ARG_INT, &opts.height, "Reported and generated height (1080)", "PX" },
+        { "jitter", 'j', 0, G_OPTION_ARG_DOUBLE, &opts.jitter_ms,
+          "Delay each video frame by a random 0 to this many ms", "MS" },
+        { "burst", 0, 0, G_OPTION_ARG_INT, &opts.burst,
+          "Hold video frames back and send them in groups of N (1)", "N" },
+        { "disconnect-after", 0, 0, G_OPTION_ARG_INT, &opts.disconnect_after,
+          "Close each connection after N video frames (0 = never)", "N" },
+        { "ntp", 0, 0, G_OPTION_ARG_NONE, &opts.ntp, "Send the wall-clock NTP time with each frame", nullptr },
+        { "seed", 0, 0, G_OPTION_ARG_INT, &opts.seed, "Jitter and payload random seed (1)", "N" },
+        { nullptr }
+    };
+
+    GOptionContext* context = g_option_context_new("- mock SSP server");
+    g_option_context_add_main_entries(context, entries, nullptr);
+    if (!g_option_context_parse(context, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (opts.fps <= 0 || opts.gop < 1 || opts.burst < 1 || opts.width < 16 || opts.height < 16) {
+        g_printerr("fps, gop, burst, width and height must be positive\n");
+        return 1;
+    }
+
+    if (opts.video) {
+        if (!load_video(opts.video, &error)) {
+            g_printerr("%s\n", error->message);
+            return 1;
+        }
+    } else {
+        GRand* rand;
+        guint32 codec = SSP_NAL_CODEC_H264;
+
+        if (opts.codec && g_str_equal(opts.codec, "h265")) {
+            codec = SSP_NAL_CODEC_H265;
+        } else if (opts.codec && !g_str_equal(opts.codec, "h264")) {
+            g_printerr("Unknown codec %s\n", opts.codec);
+            return 1;
+        }
+        if (!opts.bitrate) {
+            opts.bitrate = 20000000;
+        }
+        rand = g_rand_new_with_seed(opts.seed);
+        generate_video(codec, rand);
+        g_rand_free(rand);
+    }
+
+    if (opts.audio || opts.audio_codec) {
+        gboolean pcm = opts.audio_codec && g_str_equal(opts.audio_codec, "pcm");
+        gboolean ok;
+
+        if (!pcm && !opts.audio) {
+            g_printerr("AAC audio needs --audio\n");
+            return 1;
+        }
+        ok = pcm ? load_pcm(opts.audio, &error) : load_aac(opts.audio, &error);
+        if (!ok) {
+            g_printerr("%s\n", error->message);
+            return 1;
+        }
+    }
+
+    listen_fd = listen_on(opts.bind, opts.port);
+    if (listen_fd < 0) {
+        g_printerr("Cannot listen on %s:%d: %s\n", opts.bind, opts.port, g_strerror(errno));
+        return 1;
+    }
+    if (opts.port == 0) {
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+
+        // Same offset in sockaddr_in and sockaddr_in6
+        getsockname(listen_fd, (struct sockaddr*)&addr, &len);
+        opts.port = ntohs(((struct sockaddr_in*)&addr)->sin_port);
+    }
+
+    g_print("Serving %s %" G_GSIZE_FORMAT " frames (GOP %u) at %.3f fps on %s:%d\n",
+            stream.codec == SSP_NAL_CODEC_H264 ? "H.264" : "H.265", stream.video.size(),
+            stream.gop, opts.fps, opts.bind, opts.port);
+    // Whoever started us may be waiting for the port on a pipe
+    fflush(stdout);
+
+    for (;;) {
+        gint fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            g_printerr("accept failed: %s\n", g_strerror(errno));
+            return 1;
+        }
+        g_thread_unref(g_thread_new("ssp-mock-conn", connection_thread, GINT_TO_POINTER(fd)));
+    }
+}